@@ -0,0 +1,326 @@
+/*
+--------------------------------------------------------------------------
+* Acoustic monitoring tool for Raspberry Pi based on miniaudio framework *
+*                                                                        *
+* Kaue Werner, 2024                                                      *
+--------------------------------------------------------------------------
+*/
+/**
+ * @file analysis.c
+ * @author Kaue Werner
+ * @date 10 Mar 2024
+ * @brief Definition of the background analysis worker used in AMT
+ * @version 0.1.0
+*/
+#include "analysis.h"
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+/**
+ * @brief timestamp of the frame at framePosition since the worker start
+ * 
+*/
+static void get_frame_timestamp(const analysis_worker* worker, unsigned long long framePosition, struct timeval* timestamp){
+    unsigned long long elapsedMicroseconds = (unsigned long long)((double) framePosition * 1e6 / worker->sampleRate) + worker->startTime.tv_usec;
+    timestamp->tv_sec = worker->startTime.tv_sec + (time_t)(elapsedMicroseconds / 1000000);
+    timestamp->tv_usec = (long)(elapsedMicroseconds % 1000000);
+}
+
+/**
+ * @brief open the band level file of the given date, appending to it if it 
+ * already exists (worker thread side)
+ * 
+*/
+static void open_band_level_file(analysis_worker* worker, const char* date){
+    char fileName[MAX_CHAR_LENGTH];
+    strcpy(fileName, worker->bandLevelFilePath);
+    if(worker->bandLevelFile){
+        fclose(worker->bandLevelFile);
+    }
+    worker->bandLevelFile = fopen(strcat(strcat(fileName, date), ".csv"), "a");
+    strcpy(worker->bandLevelDate, date);
+    if(!worker->bandLevelFile){
+        printf("Failed to open band level file %s.\n", fileName);
+        return;
+    }
+    // new file, write header with the exact band midband frequencies
+    fseek(worker->bandLevelFile, 0, SEEK_END);
+    if(ftell(worker->bandLevelFile) == 0){
+        fprintf(worker->bandLevelFile, "time,duration_s,Leq_dBFS");
+        for(unsigned b = 0; b < worker->bandLevels.numberOfBands; b++){
+            fprintf(worker->bandLevelFile, ",%.1fHz", worker->bandLevels.centerFrequencies[b]);
+        }
+        fprintf(worker->bandLevelFile, "\n");
+    }
+}
+
+/**
+ * @brief write band levels of the current integration period, one row per period (worker thread side)
+ * 
+*/
+static void write_band_levels(analysis_worker* worker){
+    struct timeval periodStart;
+    char date[MAX_CHAR_LENGTH];
+    char timeLabel[MAX_CHAR_LENGTH];
+    get_frame_timestamp(worker, worker->framesAnalyzed - worker->framesInPeriod, &periodStart);
+    time_t periodStartTime = periodStart.tv_sec;
+    // reentrant, the writer and telemetry threads format times concurrently
+    struct tm periodStartInfo;
+    localtime_r(&periodStartTime, &periodStartInfo);
+    strftime(date, MAX_CHAR_LENGTH, DATE_LABEL, &periodStartInfo);
+    strftime(timeLabel, MAX_CHAR_LENGTH, "%Y-%m-%d %H:%M:%S", &periodStartInfo);
+
+    float broadbandLevel = get_band_levels(&worker->bandLevels, worker->levels);
+    if(!worker->bandLevelFile || strcmp(date, worker->bandLevelDate)){
+        open_band_level_file(worker, date);
+    }
+    if(worker->bandLevelFile){
+        fprintf(worker->bandLevelFile, "%s,%.3f,%.1f", timeLabel, worker->framesInPeriod / worker->sampleRate, broadbandLevel);
+        for(unsigned b = 0; b < worker->bandLevels.numberOfBands; b++){
+            fprintf(worker->bandLevelFile, ",%.1f", worker->levels[b]);
+        }
+        fprintf(worker->bandLevelFile, "\n");
+        fflush(worker->bandLevelFile);
+    }
+    worker->framesInPeriod = 0;
+}
+
+/**
+ * @brief open the acoustic index file of the given date, appending to it if it 
+ * already exists (worker thread side)
+ * 
+*/
+static void open_acoustic_index_file(analysis_worker* worker, const char* date){
+    char fileName[MAX_CHAR_LENGTH];
+    strcpy(fileName, worker->acousticIndexFilePath);
+    if(worker->acousticIndexFile){
+        fclose(worker->acousticIndexFile);
+    }
+    worker->acousticIndexFile = fopen(strcat(strcat(fileName, date), ".csv"), "a");
+    strcpy(worker->acousticIndexDate, date);
+    if(!worker->acousticIndexFile){
+        printf("Failed to open acoustic index file %s.\n", fileName);
+        return;
+    }
+    fseek(worker->acousticIndexFile, 0, SEEK_END);
+    if(ftell(worker->acousticIndexFile) == 0){
+        fprintf(worker->acousticIndexFile, "time,duration_s,ACI,NDSI,BI,ADI\n");
+    }
+}
+
+/**
+ * @brief write acoustic indices of the current period, one row per period (worker thread side)
+ * 
+*/
+static void write_acoustic_indices(analysis_worker* worker){
+    struct timeval periodStart;
+    char date[MAX_CHAR_LENGTH];
+    char timeLabel[MAX_CHAR_LENGTH];
+    get_frame_timestamp(worker, worker->framesAnalyzed - worker->framesInIndexPeriod, &periodStart);
+    time_t periodStartTime = periodStart.tv_sec;
+    struct tm periodStartInfo;
+    localtime_r(&periodStartTime, &periodStartInfo);
+    strftime(date, MAX_CHAR_LENGTH, DATE_LABEL, &periodStartInfo);
+    strftime(timeLabel, MAX_CHAR_LENGTH, "%Y-%m-%d %H:%M:%S", &periodStartInfo);
+
+    acoustic_index_values values;
+    get_acoustic_indices(&worker->acousticIndices, &values);
+    // a period shorter than one STFT frame has no indices
+    if(values.numberOfFrames){
+        if(!worker->acousticIndexFile || strcmp(date, worker->acousticIndexDate)){
+            open_acoustic_index_file(worker, date);
+        }
+        if(worker->acousticIndexFile){
+            fprintf(worker->acousticIndexFile, "%s,%.3f,%.2f,%.3f,%.2f,%.3f\n", timeLabel, worker->framesInIndexPeriod / worker->sampleRate, 
+                    values.aci, values.ndsi, values.bi, values.adi);
+            fflush(worker->acousticIndexFile);
+        }
+    }
+    worker->framesInIndexPeriod = 0;
+}
+
+/**
+ * @brief analyze frames available up to the end of the current band level and 
+ * index periods, returns the number of frames analyzed (worker thread side)
+ * 
+*/
+static size_t process_pending_frames(analysis_worker* worker){
+    void* ptr;
+    size_t frameCount = ring_buffer_peek(&worker->frames, &ptr);
+    if(!frameCount){
+        return 0;
+    }
+    if(worker->bandLevelsEnabled && frameCount > worker->framesPerPeriod - worker->framesInPeriod){
+        frameCount = worker->framesPerPeriod - worker->framesInPeriod;
+    }
+    if(worker->acousticIndicesEnabled && frameCount > worker->framesPerIndexPeriod - worker->framesInIndexPeriod){
+        frameCount = worker->framesPerIndexPeriod - worker->framesInIndexPeriod;
+    }
+    if(worker->bandLevelsEnabled){
+        process_band_levels(&worker->bandLevels, (const float*) ptr, (unsigned)(frameCount * NUMBER_OF_INPUT_CHANNELS));
+        worker->framesInPeriod += frameCount;
+    }
+    if(worker->acousticIndicesEnabled){
+        process_acoustic_indices(&worker->acousticIndices, (const float*) ptr, (unsigned)(frameCount * NUMBER_OF_INPUT_CHANNELS));
+        worker->framesInIndexPeriod += frameCount;
+    }
+    ring_buffer_consume(&worker->frames, frameCount);
+    worker->framesAnalyzed += frameCount;
+    if(worker->bandLevelsEnabled && worker->framesInPeriod == worker->framesPerPeriod){
+        write_band_levels(worker);
+    }
+    if(worker->acousticIndicesEnabled && worker->framesInIndexPeriod == worker->framesPerIndexPeriod){
+        write_acoustic_indices(worker);
+    }
+    return frameCount;
+}
+
+/**
+ * @brief analysis thread main loop
+ * 
+*/
+static void* analysis_thread(void* arg){
+    analysis_worker* worker = (analysis_worker*) arg;
+    while(1){
+        if(process_pending_frames(worker)){
+            continue;
+        }
+        if(atomic_load(&worker->stopRequested)){
+            break;
+        }
+        usleep(WRITER_POLL_PERIOD_MS * 1000);
+    }
+    if(worker->bandLevelsEnabled && worker->framesInPeriod){
+        write_band_levels(worker);
+    }
+    if(worker->bandLevelFile){
+        fclose(worker->bandLevelFile);
+        worker->bandLevelFile = NULL;
+    }
+    if(worker->acousticIndicesEnabled && worker->framesInIndexPeriod){
+        write_acoustic_indices(worker);
+    }
+    if(worker->acousticIndexFile){
+        fclose(worker->acousticIndexFile);
+        worker->acousticIndexFile = NULL;
+    }
+    return NULL;
+}
+
+/**
+ * @brief free band level analyzer and acoustic index engine of the worker, if enabled
+ * 
+*/
+static void free_analyzers(analysis_worker* worker){
+    if(worker->bandLevelsEnabled){
+        free_band_level_analyzer(&worker->bandLevels);
+    }
+    if(worker->acousticIndicesEnabled){
+        free_acoustic_indices(&worker->acousticIndices);
+    }
+    free(worker->levels);
+    worker->levels = NULL;
+}
+
+/**
+ * @brief initialize analysis worker (analysis_worker) and start its thread, the first 
+ * pushed frame is taken at startTime, returns 0 on success
+ * 
+*/
+int init_analysis_worker(analysis_worker* worker, const analysis_config* config, double sampleRate, 
+                         const struct timeval* startTime, size_t capacityInFrames, size_t highWaterMarkInFrames){
+    worker->sampleRate = sampleRate;
+    worker->startTime = *startTime;
+    worker->framesAnalyzed = 0;
+    worker->bandLevelsEnabled = 0;
+    worker->framesInPeriod = 0;
+    worker->levels = NULL;
+    worker->bandLevelFile = NULL;
+    snprintf(worker->bandLevelFilePath, MAX_CHAR_LENGTH, "%s", config->bandLevelFilePath);
+    worker->bandLevelDate[0] = '\0';
+    worker->acousticIndicesEnabled = 0;
+    worker->framesInIndexPeriod = 0;
+    worker->acousticIndexFile = NULL;
+    snprintf(worker->acousticIndexFilePath, MAX_CHAR_LENGTH, "%s", config->acousticIndexFilePath);
+    worker->acousticIndexDate[0] = '\0';
+    atomic_init(&worker->stopRequested, 0);
+
+    if(config->bandLevelResolution){
+        if(init_band_level_analyzer(&worker->bandLevels, config->bandLevelResolution, sampleRate, ANALYSIS_BLOCK_SIZE)){
+            return -1;
+        }
+        worker->levels = malloc(worker->bandLevels.numberOfBands * sizeof(float));
+        worker->framesPerPeriod = (size_t)(config->bandLevelPeriod * sampleRate);
+        if(!worker->framesPerPeriod){
+            worker->framesPerPeriod = 1;
+        }
+        worker->bandLevelsEnabled = 1;
+    #ifdef DEBUG
+        printf("-> Band levels: %u bands (1/%u octave), %.1f s period\n", 
+               worker->bandLevels.numberOfBands, worker->bandLevels.bandsPerOctave, config->bandLevelPeriod);
+    #endif
+    }
+
+    if(config->acousticIndexPeriod > 0.0f){
+        if(init_acoustic_indices(&worker->acousticIndices, sampleRate, ACOUSTIC_INDEX_FFT_SIZE, config->adiThresholddBFS)){
+            free_analyzers(worker);
+            return -1;
+        }
+        worker->framesPerIndexPeriod = (size_t)(config->acousticIndexPeriod * sampleRate);
+        if(!worker->framesPerIndexPeriod){
+            worker->framesPerIndexPeriod = 1;
+        }
+        worker->acousticIndicesEnabled = 1;
+    #ifdef DEBUG
+        printf("-> Acoustic indices: %.1f s period, %u-point STFT\n", config->acousticIndexPeriod, ACOUSTIC_INDEX_FFT_SIZE);
+    #endif
+    }
+
+    if(init_ring_buffer(&worker->frames, capacityInFrames, NUMBER_OF_INPUT_CHANNELS * sizeof(float), highWaterMarkInFrames)){
+        free_analyzers(worker);
+        return -1;
+    }
+    if(pthread_create(&worker->thread, NULL, analysis_thread, worker)){
+        free_ring_buffer(&worker->frames);
+        free_analyzers(worker);
+        return -1;
+    }
+    return 0;
+}
+
+/**
+ * @brief analyze all pending frames, write the last (partial) period, stop the 
+ * worker thread and free analysis worker (analysis_worker)
+ * 
+*/
+void fini_analysis_worker(analysis_worker* worker){
+    atomic_store(&worker->stopRequested, 1);
+    pthread_join(worker->thread, NULL);
+#ifdef DEBUG
+    printf("-> Analysis overflows: %lu (%lu dropped frames)\n",
+           atomic_load(&worker->frames.overflowCount), atomic_load(&worker->frames.droppedFrames));
+#endif
+    free_ring_buffer(&worker->frames);
+    free_analyzers(worker);
+}
+
+/**
+ * @brief push processed frames to the analysis worker (audio callback side)
+ * 
+*/
+size_t analysis_push_frames(analysis_worker* worker, const float* frames, size_t frameCount){
+    return ring_buffer_write(&worker->frames, frames, frameCount);
+}
+
+/**
+ * @brief block until the analysis buffer has room for frameCount frames 
+ * (producer side, used when the producer is not real-time, e.g. file replay)
+ * 
+*/
+void analysis_wait_for_space(analysis_worker* worker, size_t frameCount){
+    while(worker->frames.capacityInFrames - ring_buffer_fill(&worker->frames) < frameCount){
+        usleep(WRITER_POLL_PERIOD_MS * 100);
+    }
+}
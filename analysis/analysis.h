@@ -0,0 +1,101 @@
+/*
+--------------------------------------------------------------------------
+* Acoustic monitoring tool for Raspberry Pi based on miniaudio framework *
+*                                                                        *
+* Kaue Werner, 2024                                                      *
+--------------------------------------------------------------------------
+*/
+/**
+ * @file analysis.h
+ * @author Kaue Werner
+ * @date 10 Mar 2024
+ * @brief Header with the background analysis worker used in AMT
+ * @version 0.1.0
+*/
+#ifndef ANALYSIS_H
+#define ANALYSIS_H
+#include "../config_defines.h"
+#include "../ring_buffer/ring_buffer.h"
+#include "../audio_proc/band_levels.h"
+#include "../audio_proc/acoustic_indices.h"
+#include <pthread.h>
+#include <stdio.h>
+#include <sys/time.h>
+
+/**
+ * @brief Analysis settings data struct
+ * bandLevelResolution is the number of bands per octave (1 or 3, 0 disables 
+ * band levels) and bandLevelPeriod the integration period in seconds, 
+ * acousticIndexPeriod the period of the acoustic indices in seconds (0 
+ * disables them) and adiThresholddBFS the active bin level of the ADI, 
+ * bandLevelFilePath and acousticIndexFilePath are the prefixes of the daily files
+*/
+typedef struct {
+    unsigned bandLevelResolution;
+    float bandLevelPeriod;
+    float acousticIndexPeriod;
+    float adiThresholddBFS;
+    const char* bandLevelFilePath;
+    const char* acousticIndexFilePath;
+} analysis_config;
+
+/**
+ * @brief Analysis worker data struct
+ * The audio callback pushes every processed frame, recording or not, and the 
+ * worker thread computes the continuous level time series and owns its files.
+*/
+typedef struct {
+    ring_buffer frames;
+    pthread_t thread;
+    atomic_int stopRequested;
+    double sampleRate;
+    struct timeval startTime;
+    unsigned long long framesAnalyzed;
+    /* fractional-octave band levels */
+    band_level_analyzer bandLevels;
+    unsigned bandLevelsEnabled:1;
+    size_t framesPerPeriod;
+    size_t framesInPeriod;
+    float* levels;
+    FILE* bandLevelFile;
+    char bandLevelFilePath[MAX_CHAR_LENGTH];
+    char bandLevelDate[MAX_CHAR_LENGTH];
+    /* ecoacoustic indices */
+    acoustic_indices acousticIndices;
+    unsigned acousticIndicesEnabled:1;
+    size_t framesPerIndexPeriod;
+    size_t framesInIndexPeriod;
+    FILE* acousticIndexFile;
+    char acousticIndexFilePath[MAX_CHAR_LENGTH];
+    char acousticIndexDate[MAX_CHAR_LENGTH];
+} analysis_worker;
+
+/**
+ * @brief initialize analysis worker (analysis_worker) and start its thread, the first 
+ * pushed frame is taken at startTime, returns 0 on success
+ * 
+*/
+int init_analysis_worker(analysis_worker* worker, const analysis_config* config, double sampleRate, 
+                         const struct timeval* startTime, size_t capacityInFrames, size_t highWaterMarkInFrames);
+
+/**
+ * @brief analyze all pending frames, write the last (partial) period, stop the 
+ * worker thread and free analysis worker (analysis_worker)
+ * 
+*/
+void fini_analysis_worker(analysis_worker* worker);
+
+/**
+ * @brief push processed frames to the analysis worker (audio callback side)
+ * 
+*/
+size_t analysis_push_frames(analysis_worker* worker, const float* frames, size_t frameCount);
+
+/**
+ * @brief block until the analysis buffer has room for frameCount frames 
+ * (producer side, used when the producer is not real-time, e.g. file replay)
+ * 
+*/
+void analysis_wait_for_space(analysis_worker* worker, size_t frameCount);
+
+#endif // ANALYSIS_H
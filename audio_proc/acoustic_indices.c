@@ -0,0 +1,203 @@
+/*
+--------------------------------------------------------------------------
+* Acoustic monitoring tool for Raspberry Pi based on miniaudio framework *
+*                                                                        *
+* Kaue Werner, 2024                                                      *
+--------------------------------------------------------------------------
+*/
+/**
+ * @file acoustic_indices.c
+ * @author Kaue Werner
+ * @date 10 Mar 2024
+ * @brief Definition of the ecoacoustic index engine (ACI, NDSI, BI, ADI) used in AMT
+ * 
+ * Definitions follow the R soundecology package on the calibrated STFT power 
+ * spectrum: ACI sums |a(t+1) - a(t)| / sum a(t) over all bins but DC, with the 
+ * whole period as temporal step; NDSI compares the power between 2-11 kHz and 
+ * 1-2 kHz; BI is the area of the mean spectrum in dB above its minimum between 
+ * 2 and 8 kHz; ADI is the Shannon entropy of the proportions of active bins 
+ * (above an absolute dBFS threshold, as levels are not known ahead) in the 
+ * 1 kHz bands up to 10 kHz. Bands above the Nyquist frequency are left out.
+ * @version 0.1.0
+*/
+#include "acoustic_indices.h"
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+/**
+ * @brief sum of the mean power of the bins from minFrequency (inclusive) to maxFrequency (exclusive)
+ * 
+*/
+static double get_band_power(const acoustic_indices* indices, double minFrequency, double maxFrequency){
+    double power = 0.0;
+    for(unsigned k = 1; k < indices->numberOfBins; k++){
+        double frequency = k * indices->transform.binWidth;
+        if(frequency >= minFrequency && frequency < maxFrequency){
+            power += indices->powerSum[k];
+        }
+    }
+    return power / indices->numberOfFrames;
+}
+
+/**
+ * @brief initialize acoustic index engine (acoustic_indices) on non-overlapping Hann frames of 
+ * fftSize samples, adiThresholdIndB is the bin level counted as active by the ADI, returns 0 on success. 
+ * Must not be called from the audio thread (creates an FFT plan).
+ * 
+*/
+int init_acoustic_indices(acoustic_indices* indices, double sampleRate, unsigned fftSize, float adiThresholdIndB){
+    memset(indices, 0, sizeof(acoustic_indices));
+    if(init_stft(&indices->transform, fftSize, fftSize, FFT_WINDOW_HANN, sampleRate)){
+        return -1;
+    }
+    indices->numberOfBins = indices->transform.fft.numberOfBins;
+    indices->adiThreshold = powf(10.0f, 0.1f * adiThresholdIndB);
+    double maxAdiFrequency = (sampleRate / 2.0 < ADI_MAX_FREQUENCY) ? sampleRate / 2.0 : ADI_MAX_FREQUENCY;
+    indices->numberOfAdiBands = (unsigned) ceil(maxAdiFrequency / ADI_BAND_WIDTH);
+
+    indices->amplitude = malloc(indices->numberOfBins * sizeof(float));
+    indices->amplitudeSum = calloc(indices->numberOfBins, sizeof(double));
+    indices->amplitudeDifferenceSum = calloc(indices->numberOfBins, sizeof(double));
+    indices->powerSum = calloc(indices->numberOfBins, sizeof(double));
+    indices->adiCounts = calloc(indices->numberOfAdiBands, sizeof(unsigned long));
+    indices->adiBandBins = calloc(indices->numberOfAdiBands, sizeof(unsigned));
+    if(!indices->amplitude || !indices->amplitudeSum || !indices->amplitudeDifferenceSum || !indices->powerSum || 
+       !indices->adiCounts || !indices->adiBandBins){
+        free_acoustic_indices(indices);
+        return -1;
+    }
+    for(unsigned k = 1; k < indices->numberOfBins; k++){
+        unsigned band = (unsigned)(k * indices->transform.binWidth / ADI_BAND_WIDTH);
+        if(band < indices->numberOfAdiBands){
+            indices->adiBandBins[band]++;
+        }
+    }
+    return 0;
+}
+
+/**
+ * @brief free acoustic index engine (acoustic_indices)
+ * 
+*/
+void free_acoustic_indices(acoustic_indices* indices){
+    free_stft(&indices->transform);
+    free(indices->amplitude);
+    free(indices->amplitudeSum);
+    free(indices->amplitudeDifferenceSum);
+    free(indices->powerSum);
+    free(indices->adiCounts);
+    free(indices->adiBandBins);
+    indices->amplitude = NULL;
+    indices->amplitudeSum = NULL;
+    indices->amplitudeDifferenceSum = NULL;
+    indices->powerSum = NULL;
+    indices->adiCounts = NULL;
+    indices->adiBandBins = NULL;
+}
+
+/**
+ * @brief update the running sums with the spectrum of one STFT frame
+ * 
+*/
+static void add_acoustic_indices_frame(acoustic_indices* indices){
+    const float* powerSpectrum = indices->transform.powerSpectrum;
+    for(unsigned k = 1; k < indices->numberOfBins; k++){
+        float amplitude = sqrtf(powerSpectrum[k]);
+        if(indices->hasPreviousFrame){
+            indices->amplitudeDifferenceSum[k] += fabsf(amplitude - indices->amplitude[k]);
+        }
+        indices->amplitude[k] = amplitude;
+        indices->amplitudeSum[k] += amplitude;
+        indices->powerSum[k] += powerSpectrum[k];
+        if(powerSpectrum[k] > indices->adiThreshold){
+            unsigned band = (unsigned)(k * indices->transform.binWidth / ADI_BAND_WIDTH);
+            if(band < indices->numberOfAdiBands){
+                indices->adiCounts[band]++;
+            }
+        }
+    }
+    indices->hasPreviousFrame = 1;
+    indices->numberOfFrames++;
+}
+
+/**
+ * @brief add a block of samples of any size to the current period
+ * 
+*/
+void process_acoustic_indices(acoustic_indices* indices, const float* input, unsigned numberOfSamples){
+    unsigned frameReady;
+    while(numberOfSamples){
+        unsigned consumed = process_stft(&indices->transform, input, numberOfSamples, &frameReady);
+        if(frameReady){
+            add_acoustic_indices_frame(indices);
+        }
+        input += consumed;
+        numberOfSamples -= consumed;
+    }
+}
+
+/**
+ * @brief get the indices of the frames added since the last call, then start a new period
+ * 
+*/
+void get_acoustic_indices(acoustic_indices* indices, acoustic_index_values* values){
+    memset(values, 0, sizeof(acoustic_index_values));
+    values->numberOfFrames = indices->numberOfFrames;
+    if(indices->numberOfFrames){
+        // ACI, bins without energy carry no complexity
+        double aci = 0.0;
+        for(unsigned k = 1; k < indices->numberOfBins; k++){
+            if(indices->amplitudeSum[k] > 0.0){
+                aci += indices->amplitudeDifferenceSum[k] / indices->amplitudeSum[k];
+            }
+        }
+        values->aci = (float) aci;
+
+        // NDSI, 0 without energy in both ranges
+        double anthrophony = get_band_power(indices, NDSI_ANTHROPHONY_MIN_FREQUENCY, NDSI_ANTHROPHONY_MAX_FREQUENCY);
+        double biophony = get_band_power(indices, NDSI_BIOPHONY_MIN_FREQUENCY, NDSI_BIOPHONY_MAX_FREQUENCY);
+        values->ndsi = (anthrophony + biophony > 0.0) ? (float)((biophony - anthrophony) / (biophony + anthrophony)) : 0.0f;
+
+        // BI, area of the mean spectrum above its minimum in dB x kHz
+        float minLevel = INFINITY;
+        double levelSum = 0.0;
+        unsigned numberOfBiBins = 0;
+        for(unsigned k = 1; k < indices->numberOfBins; k++){
+            double frequency = k * indices->transform.binWidth;
+            if(frequency >= BI_MIN_FREQUENCY && frequency < BI_MAX_FREQUENCY){
+                float level = 10.0f * log10f((float)(indices->powerSum[k] / indices->numberOfFrames) + ACOUSTIC_INDICES_MIN_ENERGY);
+                minLevel = (level < minLevel) ? level : minLevel;
+                levelSum += level;
+                numberOfBiBins++;
+            }
+        }
+        if(numberOfBiBins){
+            values->bi = (float)((levelSum - numberOfBiBins * minLevel) * indices->transform.binWidth / 1000.0);
+        }
+
+        // ADI, Shannon entropy of the normalized proportions of active bins per band
+        double proportions[(unsigned)(ADI_MAX_FREQUENCY / ADI_BAND_WIDTH)];
+        double proportionSum = 0.0;
+        for(unsigned b = 0; b < indices->numberOfAdiBands; b++){
+            proportions[b] = indices->adiBandBins[b] ? (double) indices->adiCounts[b] / ((double) indices->adiBandBins[b] * indices->numberOfFrames) : 0.0;
+            proportionSum += proportions[b];
+        }
+        double adi = 0.0;
+        for(unsigned b = 0; b < indices->numberOfAdiBands; b++){
+            if(proportions[b] > 0.0){
+                double p = proportions[b] / proportionSum;
+                adi -= p * log(p);
+            }
+        }
+        values->adi = (float) adi;
+    }
+
+    // restart accumulation, the STFT keeps its partial frame
+    memset(indices->amplitudeSum, 0, indices->numberOfBins * sizeof(double));
+    memset(indices->amplitudeDifferenceSum, 0, indices->numberOfBins * sizeof(double));
+    memset(indices->powerSum, 0, indices->numberOfBins * sizeof(double));
+    memset(indices->adiCounts, 0, indices->numberOfAdiBands * sizeof(unsigned long));
+    indices->numberOfFrames = 0;
+    indices->hasPreviousFrame = 0;
+}
@@ -0,0 +1,93 @@
+/*
+--------------------------------------------------------------------------
+* Acoustic monitoring tool for Raspberry Pi based on miniaudio framework *
+*                                                                        *
+* Kaue Werner, 2024                                                      *
+--------------------------------------------------------------------------
+*/
+/**
+ * @file acoustic_indices.h
+ * @author Kaue Werner
+ * @date 10 Mar 2024
+ * @brief Header with the ecoacoustic index engine (ACI, NDSI, BI, ADI) used in AMT
+ * @version 0.1.0
+*/
+#ifndef ACOUSTIC_INDICES_H
+#define ACOUSTIC_INDICES_H
+#include "../config_defines.h"
+#include "stft.h"
+
+// frequency ranges in Hz (defaults of the R soundecology package)
+#define NDSI_ANTHROPHONY_MIN_FREQUENCY 1000.0
+#define NDSI_ANTHROPHONY_MAX_FREQUENCY 2000.0
+#define NDSI_BIOPHONY_MIN_FREQUENCY 2000.0
+#define NDSI_BIOPHONY_MAX_FREQUENCY 11000.0
+#define BI_MIN_FREQUENCY 2000.0
+#define BI_MAX_FREQUENCY 8000.0
+#define ADI_MAX_FREQUENCY 10000.0
+#define ADI_BAND_WIDTH 1000.0
+#define ACOUSTIC_INDICES_MIN_ENERGY 1e-20f
+
+/**
+ * @brief Acoustic index values of one period
+ * aci: Acoustic Complexity Index (Pieretti et al. 2011) over the whole period
+ * ndsi: Normalized Difference Soundscape Index (Kasten et al. 2012), -1 to 1
+ * bi: Bioacoustic Index (Boelman et al. 2007) in dB x kHz
+ * adi: Acoustic Diversity Index (Villanueva-Rivera et al. 2011), Shannon entropy of the 1 kHz bands
+*/
+typedef struct {
+    float aci;
+    float ndsi;
+    float bi;
+    float adi;
+    unsigned long numberOfFrames;
+} acoustic_index_values;
+
+/**
+ * @brief Acoustic index engine data struct
+ * Every STFT frame only updates running sums (per bin amplitudes, amplitude 
+ * differences and powers, per band counts of bins above adiThresholdIndB), 
+ * the indices are computed from them when a period is read.
+*/
+typedef struct {
+    stft transform;
+    unsigned numberOfBins;
+    float* amplitude;
+    double* amplitudeSum;
+    double* amplitudeDifferenceSum;
+    double* powerSum;
+    unsigned long* adiCounts;
+    unsigned numberOfAdiBands;
+    unsigned* adiBandBins;
+    float adiThreshold;
+    unsigned long numberOfFrames;
+    unsigned hasPreviousFrame:1;
+} acoustic_indices;
+
+/**
+ * @brief initialize acoustic index engine (acoustic_indices) on non-overlapping Hann frames of 
+ * fftSize samples, adiThresholdIndB is the bin level counted as active by the ADI, returns 0 on success. 
+ * Must not be called from the audio thread (creates an FFT plan).
+ * 
+*/
+int init_acoustic_indices(acoustic_indices* indices, double sampleRate, unsigned fftSize, float adiThresholdIndB);
+
+/**
+ * @brief free acoustic index engine (acoustic_indices)
+ * 
+*/
+void free_acoustic_indices(acoustic_indices* indices);
+
+/**
+ * @brief add a block of samples of any size to the current period
+ * 
+*/
+void process_acoustic_indices(acoustic_indices* indices, const float* input, unsigned numberOfSamples);
+
+/**
+ * @brief get the indices of the frames added since the last call, then start a new period
+ * 
+*/
+void get_acoustic_indices(acoustic_indices* indices, acoustic_index_values* values);
+
+#endif // ACOUSTIC_INDICES_H
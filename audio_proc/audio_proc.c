@@ -13,7 +13,6 @@
  * @version 0.1.0
 */
 #include "audio_proc.h"
-#include <fftw3.h>
 #include <stdlib.h>
 #include <math.h>
 
@@ -143,6 +142,20 @@ void compute_biquad_filter_coeffs(double* coeffs, unsigned filterType, double fc
     }
 }
 
+/**
+ * @brief copy input scaled by gain to output (may be the input buffer), returns the sum of squares of the output samples
+ * 
+*/
+float apply_gain(const float* input, float* output, unsigned size, float gain)
+{
+    float sum = 0.0f;
+    for(unsigned n = 0; n < size; n++){
+        output[n] = input[n] * gain;
+        sum += output[n] * output[n];
+    }
+    return sum;
+}
+
 /**
  * @brief compute RMS of sample buffer, with output option set by flagLevel (either amplitude or dB)
  * 
@@ -164,40 +177,6 @@ float compute_rms(float* input, unsigned size, int flagLevel)
     return sum;
 }
 
-/**
- * @brief compute FFT of sample buffer
- * Not being used at the moment, but computation load was tested in the past 
- * and maybe it will used for future implementation... 
-*/
-void compute_fft(float *input, unsigned bufferSize){
-    // printf("\nFFT function called");
-    double *in;
-    unsigned n;
-    fftw_complex *intern;
-    fftw_plan p;
-    in = fftw_alloc_real(bufferSize);
-    intern = fftw_alloc_complex(bufferSize);
-    
-    /* fill in complex input buffers */
-    for(n = 0; n < bufferSize; n++){
-        in[n] = (double) input[n];
-    }
-
-    /* FFT */
-    p = fftw_plan_dft_r2c_1d(bufferSize, in, intern, FFTW_ESTIMATE);
-    fftw_execute(p); /* repeat as needed */
-    fftw_destroy_plan(p);
-    
-    /* FFT normalization */
-    for(n = 0; n < bufferSize; n++){
-        intern[n][0] /= bufferSize;
-        intern[n][1] /= bufferSize;
-    }    
-
-    fftw_free(in);
-    fftw_free(intern);
-}
-
 /**
  * @brief initialize biquad filter (biquad_filter_data)
  * 
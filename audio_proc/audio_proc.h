@@ -58,11 +58,10 @@ void process_filter(float* buffer, unsigned numberOfSamplesToBeProcessed, float
 void compute_biquad_filter_coeffs(double* coeffs, unsigned filterType, double fc, double q, double gain, double fs);
 
 /**
- * @brief compute FFT of sample buffer
- * Not being used at the moment, but computation load was tested in the past 
- * and maybe it will used for future implementation... 
+ * @brief copy input scaled by gain to output (may be the input buffer), returns the sum of squares of the output samples
+ * 
 */
-void compute_fft(float *input, unsigned bufferSize);
+float apply_gain(const float* input, float* output, unsigned size, float gain);
 
 /**
  * @brief compute RMS of sample buffer, with output option set by flagLevel (either amplitude or dB)
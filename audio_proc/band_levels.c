@@ -0,0 +1,173 @@
+/*
+--------------------------------------------------------------------------
+* Acoustic monitoring tool for Raspberry Pi based on miniaudio framework *
+*                                                                        *
+* Kaue Werner, 2024                                                      *
+--------------------------------------------------------------------------
+*/
+/**
+ * @file band_levels.c
+ * @author Kaue Werner
+ * @date 10 Mar 2024
+ * @brief Definition of the fractional-octave band level (Leq) analyzer used in AMT
+ * @version 0.1.0
+*/
+#include "band_levels.h"
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <complex.h>
+
+#ifndef PI
+# define PI	3.14159265358979323846264338327950288
+#endif
+
+#define BAND_LEVELS_REFERENCE_FREQUENCY 1000.0
+#define BAND_LEVELS_LOWEST_FREQUENCY 25.0
+#define BAND_LEVELS_MIN_ENERGY 1e-20
+
+/**
+ * @brief compute the biquad stages (coeffs = [b2, b1, b0, a2, a1] per stage) of a 
+ * Butterworth bandpass between lowerFrequency and upperFrequency, designed by 
+ * lowpass to bandpass transformation of the analog prototype and bilinear transform
+ * 
+*/
+static void compute_butterworth_bandpass_coeffs(double* coeffs, double lowerFrequency, double upperFrequency, double fs){
+    const double t = 2.0 * fs;
+    const double w1 = t * tan(PI * lowerFrequency / fs);
+    const double w2 = t * tan(PI * upperFrequency / fs);
+    const double bandwidth = w2 - w1;
+    const double centerSquared = w1 * w2;
+    unsigned stage = 0;
+
+    for(unsigned k = 0; k < (BAND_LEVELS_PROTOTYPE_ORDER + 1) / 2; k++){
+        // prototype pole p in the upper half plane, each maps to s^2 - p*B*s + w0^2 = 0
+        double complex p = cexp(I * PI * (2.0 * k + BAND_LEVELS_PROTOTYPE_ORDER + 1) / (2.0 * BAND_LEVELS_PROTOTYPE_ORDER));
+        double complex root = csqrt(p * p * bandwidth * bandwidth - 4.0 * centerSquared);
+        double complex poles[2] = {(p * bandwidth + root) / 2.0, (p * bandwidth - root) / 2.0};
+        // a real prototype pole gives one conjugate pair, a complex one two pairs
+        unsigned numberOfPairs = (fabs(cimag(p)) < 1e-9) ? 1 : 2;
+
+        for(unsigned n = 0; n < numberOfPairs; n++){
+            // analog section B*s / (s^2 + b*s + c) through bilinear transform
+            double b = -2.0 * creal(poles[n]);
+            double c = creal(poles[n]) * creal(poles[n]) + cimag(poles[n]) * cimag(poles[n]);
+            double a0 = t * t + b * t + c;
+            double* stageCoeffs = coeffs + stage * NUMBER_OF_BIQUAD_COEFFICIENTS;
+            stageCoeffs[0] = -bandwidth * t / a0;           // b2
+            stageCoeffs[1] = 0.0;                           // b1
+            stageCoeffs[2] = bandwidth * t / a0;            // b0
+            stageCoeffs[3] = (t * t - b * t + c) / a0;      // a2
+            stageCoeffs[4] = (2.0 * c - 2.0 * t * t) / a0;  // a1
+            stage++;
+        }
+    }
+}
+
+/**
+ * @brief initialize band level analyzer (band_level_analyzer) with 1/bandsPerOctave 
+ * octave bands (1 or 3) between 25 Hz and the Nyquist frequency, returns 0 on success
+ * 
+*/
+int init_band_level_analyzer(band_level_analyzer* analyzer, unsigned bandsPerOctave, double sampleRate, unsigned maxBlockSize){
+    const double octaveRatio = pow(10.0, 0.3);
+    const double bandwidthDesignator = (bandsPerOctave == 3) ? 3.0 : 1.0;
+    const double halfBand = pow(octaveRatio, 1.0 / (2.0 * bandwidthDesignator));
+
+    // band indexes x with fm = 1 kHz * G^(x/b), from the lowest band to the last band below Nyquist
+    int firstIndex = (int) ceil(bandwidthDesignator * log(BAND_LEVELS_LOWEST_FREQUENCY / BAND_LEVELS_REFERENCE_FREQUENCY) / log(octaveRatio));
+    int lastIndex = firstIndex;
+    while(BAND_LEVELS_REFERENCE_FREQUENCY * pow(octaveRatio, (lastIndex + 1) / bandwidthDesignator) * halfBand < 0.45 * sampleRate){
+        lastIndex++;
+    }
+
+    analyzer->bandsPerOctave = (unsigned) bandwidthDesignator;
+    analyzer->numberOfBands = (unsigned)(lastIndex - firstIndex + 1);
+    analyzer->maxBlockSize = maxBlockSize;
+    analyzer->centerFrequencies = malloc(analyzer->numberOfBands * sizeof(double));
+    analyzer->bandFilters = calloc(analyzer->numberOfBands, sizeof(sos_filter));
+    analyzer->bandEnergy = calloc(analyzer->numberOfBands, sizeof(double));
+    analyzer->scratch = malloc(maxBlockSize * sizeof(float));
+    analyzer->broadbandEnergy = 0.0;
+    analyzer->accumulatedSamples = 0;
+    if(!analyzer->centerFrequencies || !analyzer->bandFilters || !analyzer->bandEnergy || !analyzer->scratch){
+        free_band_level_analyzer(analyzer);
+        return -1;
+    }
+
+    double coeffs[BAND_LEVELS_PROTOTYPE_ORDER * NUMBER_OF_BIQUAD_COEFFICIENTS];
+    for(unsigned b = 0; b < analyzer->numberOfBands; b++){
+        double centerFrequency = BAND_LEVELS_REFERENCE_FREQUENCY * pow(octaveRatio, (firstIndex + (int) b) / bandwidthDesignator);
+        analyzer->centerFrequencies[b] = centerFrequency;
+        compute_butterworth_bandpass_coeffs(coeffs, centerFrequency / halfBand, centerFrequency * halfBand, sampleRate);
+        init_sos_filter(&analyzer->bandFilters[b], BAND_LEVELS_PROTOTYPE_ORDER);
+        for(unsigned k = 0; k < BAND_LEVELS_PROTOTYPE_ORDER; k++){
+            set_sos_filter_stage(&analyzer->bandFilters[b], k, coeffs + k * NUMBER_OF_BIQUAD_COEFFICIENTS);
+        }
+    }
+    return 0;
+}
+
+/**
+ * @brief free band level analyzer (band_level_analyzer)
+ * 
+*/
+void free_band_level_analyzer(band_level_analyzer* analyzer){
+    if(analyzer->bandFilters){
+        for(unsigned b = 0; b < analyzer->numberOfBands; b++){
+            free_sos_filter(&analyzer->bandFilters[b]);
+        }
+    }
+    free(analyzer->centerFrequencies);
+    free(analyzer->bandFilters);
+    free(analyzer->bandEnergy);
+    free(analyzer->scratch);
+    analyzer->centerFrequencies = NULL;
+    analyzer->bandFilters = NULL;
+    analyzer->bandEnergy = NULL;
+    analyzer->scratch = NULL;
+}
+
+/**
+ * @brief filter samples through all bands and accumulate band energies
+ * 
+*/
+void process_band_levels(band_level_analyzer* analyzer, const float* input, unsigned numberOfSamples){
+    while(numberOfSamples){
+        unsigned blockSize = (numberOfSamples < analyzer->maxBlockSize) ? numberOfSamples : analyzer->maxBlockSize;
+        float sum = 0.0f;
+        for(unsigned n = 0; n < blockSize; n++){
+            sum += input[n] * input[n];
+        }
+        analyzer->broadbandEnergy += sum;
+        for(unsigned b = 0; b < analyzer->numberOfBands; b++){
+            memcpy(analyzer->scratch, input, blockSize * sizeof(float));
+            process_sos_filter(&analyzer->bandFilters[b], analyzer->scratch, blockSize);
+            sum = 0.0f;
+            for(unsigned n = 0; n < blockSize; n++){
+                sum += analyzer->scratch[n] * analyzer->scratch[n];
+            }
+            analyzer->bandEnergy[b] += sum;
+        }
+        analyzer->accumulatedSamples += blockSize;
+        input += blockSize;
+        numberOfSamples -= blockSize;
+    }
+}
+
+/**
+ * @brief get Leq in dBFS of every band (levels) and broadband (return value) 
+ * since last call, then restart energy accumulation
+ * 
+*/
+float get_band_levels(band_level_analyzer* analyzer, float* levels){
+    double samples = analyzer->accumulatedSamples ? (double) analyzer->accumulatedSamples : 1.0;
+    for(unsigned b = 0; b < analyzer->numberOfBands; b++){
+        levels[b] = (float)(10.0 * log10(analyzer->bandEnergy[b] / samples + BAND_LEVELS_MIN_ENERGY));
+        analyzer->bandEnergy[b] = 0.0;
+    }
+    float broadbandLevel = (float)(10.0 * log10(analyzer->broadbandEnergy / samples + BAND_LEVELS_MIN_ENERGY));
+    analyzer->broadbandEnergy = 0.0;
+    analyzer->accumulatedSamples = 0;
+    return broadbandLevel;
+}
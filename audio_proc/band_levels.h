@@ -0,0 +1,66 @@
+/*
+--------------------------------------------------------------------------
+* Acoustic monitoring tool for Raspberry Pi based on miniaudio framework *
+*                                                                        *
+* Kaue Werner, 2024                                                      *
+--------------------------------------------------------------------------
+*/
+/**
+ * @file band_levels.h
+ * @author Kaue Werner
+ * @date 10 Mar 2024
+ * @brief Header with the fractional-octave band level (Leq) analyzer used in AMT
+ * @version 0.1.0
+*/
+#ifndef BAND_LEVELS_H
+#define BAND_LEVELS_H
+#include "../config_defines.h"
+#include "sos_filter.h"
+
+#define BAND_LEVELS_PROTOTYPE_ORDER 3
+
+/**
+ * @brief Fractional-octave band level analyzer data struct
+ * Each band is a 6th order Butterworth bandpass (3 biquad stages) between 
+ * the base-10 band edges of IEC 61260, energies are accumulated until the 
+ * levels are read.
+*/
+typedef struct {
+    unsigned bandsPerOctave;
+    unsigned numberOfBands;
+    double* centerFrequencies;
+    sos_filter* bandFilters;
+    double* bandEnergy;
+    double broadbandEnergy;
+    unsigned long long accumulatedSamples;
+    float* scratch;
+    unsigned maxBlockSize;
+} band_level_analyzer;
+
+/**
+ * @brief initialize band level analyzer (band_level_analyzer) with 1/bandsPerOctave 
+ * octave bands (1 or 3) between 25 Hz and the Nyquist frequency, returns 0 on success
+ * 
+*/
+int init_band_level_analyzer(band_level_analyzer* analyzer, unsigned bandsPerOctave, double sampleRate, unsigned maxBlockSize);
+
+/**
+ * @brief free band level analyzer (band_level_analyzer)
+ * 
+*/
+void free_band_level_analyzer(band_level_analyzer* analyzer);
+
+/**
+ * @brief filter samples through all bands and accumulate band energies
+ * 
+*/
+void process_band_levels(band_level_analyzer* analyzer, const float* input, unsigned numberOfSamples);
+
+/**
+ * @brief get Leq in dBFS of every band (levels) and broadband (return value) 
+ * since last call, then restart energy accumulation
+ * 
+*/
+float get_band_levels(band_level_analyzer* analyzer, float* levels);
+
+#endif // BAND_LEVELS_H
@@ -0,0 +1,160 @@
+/*
+--------------------------------------------------------------------------
+* Acoustic monitoring tool for Raspberry Pi based on miniaudio framework *
+*                                                                        *
+* Kaue Werner, 2024                                                      *
+--------------------------------------------------------------------------
+*/
+/**
+ * @file band_trigger.c
+ * @author Kaue Werner
+ * @date 10 Mar 2024
+ * @brief Definition of the band-limited spectral energy trigger used in AMT
+ * @version 0.1.0
+*/
+#include "band_trigger.h"
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#define BAND_TRIGGER_MIN_ENERGY 1e-20f
+
+/**
+ * @brief initialize band trigger (band_trigger), returns 0 on success
+ * Must not be called from the audio thread (creates an FFT plan).
+*/
+int init_band_trigger(band_trigger* trigger, const band_trigger_config* config, double sampleRate, unsigned fftSize){
+    trigger->numberOfBands = config->numberOfBands;
+    trigger->thresholdIndB = config->thresholdIndB;
+    trigger->ratioIndB = config->ratioIndB;
+    trigger->combination = config->combination;
+    trigger->timeConstantInSamples = (float)(config->timeConstant * sampleRate);
+    trigger->history = calloc(fftSize, sizeof(float));
+    trigger->powerSpectrum = malloc((fftSize / 2 + 1) * sizeof(float));
+    trigger->firstBin = malloc(config->numberOfBands * sizeof(unsigned));
+    trigger->lastBin = malloc(config->numberOfBands * sizeof(unsigned));
+    trigger->bandPower = calloc(config->numberOfBands, sizeof(float));
+    trigger->backgroundPower = 0.0f;
+    if(!trigger->history || !trigger->powerSpectrum || !trigger->firstBin || !trigger->lastBin || !trigger->bandPower ||
+       init_fft_context(&trigger->fft, fftSize, FFT_WINDOW_HANN)){
+        free(trigger->history);
+        free(trigger->powerSpectrum);
+        free(trigger->firstBin);
+        free(trigger->lastBin);
+        free(trigger->bandPower);
+        return -1;
+    }
+
+    // one-sided power to mean square of the input, corrected for the window power
+    double windowPower = 0.0;
+    for(unsigned n = 0; n < fftSize; n++){
+        windowPower += (double) trigger->fft.window[n] * trigger->fft.window[n];
+    }
+    trigger->powerScale = (float)(2.0 / (fftSize * windowPower));
+
+    // band edges to bins, every band gets at least one bin
+    const double binWidth = sampleRate / fftSize;
+    const unsigned lastBin = trigger->fft.numberOfBins - 1;
+    unsigned char* inBand = calloc(trigger->fft.numberOfBins, 1);
+    for(unsigned b = 0; b < config->numberOfBands; b++){
+        double first = ceil(config->lowerFrequencies[b] / binWidth);
+        double last = floor(config->upperFrequencies[b] / binWidth);
+        trigger->firstBin[b] = (first < 1.0) ? 1 : ((first > lastBin) ? lastBin : (unsigned) first);
+        trigger->lastBin[b] = (last > lastBin) ? lastBin : ((last < trigger->firstBin[b]) ? trigger->firstBin[b] : (unsigned) last);
+        for(unsigned k = trigger->firstBin[b]; k <= trigger->lastBin[b]; k++){
+            inBand[k] = 1;
+        }
+    }
+    // background excludes DC and all trigger bands
+    trigger->numberOfBackgroundBins = 0;
+    for(unsigned k = 1; k <= lastBin; k++){
+        trigger->numberOfBackgroundBins += !inBand[k];
+    }
+    free(inBand);
+    return 0;
+}
+
+/**
+ * @brief free band trigger (band_trigger)
+ * 
+*/
+void free_band_trigger(band_trigger* trigger){
+    free_fft_context(&trigger->fft);
+    free(trigger->history);
+    free(trigger->powerSpectrum);
+    free(trigger->firstBin);
+    free(trigger->lastBin);
+    free(trigger->bandPower);
+}
+
+/**
+ * @brief clear sample history and band power averages
+ * 
+*/
+void reset_band_trigger(band_trigger* trigger){
+    memset(trigger->history, 0, trigger->fft.size * sizeof(float));
+    memset(trigger->bandPower, 0, trigger->numberOfBands * sizeof(float));
+    trigger->backgroundPower = 0.0f;
+}
+
+/**
+ * @brief update the band trigger with a block of samples, returns 1 if the trigger 
+ * rule is met and the highest band level in dBFS in levelIndB
+ * 
+*/
+unsigned process_band_trigger(band_trigger* trigger, const float* input, unsigned numberOfSamples, float* levelIndB){
+    const unsigned size = trigger->fft.size;
+    // slide the analysis window by the new samples
+    if(numberOfSamples >= size){
+        memcpy(trigger->history, input + numberOfSamples - size, size * sizeof(float));
+    }
+    else {
+        memmove(trigger->history, trigger->history + numberOfSamples, (size - numberOfSamples) * sizeof(float));
+        memcpy(trigger->history + size - numberOfSamples, input, numberOfSamples * sizeof(float));
+    }
+    execute_fft(&trigger->fft, trigger->history);
+    get_fft_power_spectrum(&trigger->fft, trigger->powerSpectrum);
+
+    // exponential averaging over blocks, decay^N with N the block length
+    float decay = (trigger->timeConstantInSamples > 0.0f) ? expf(-(float) numberOfSamples / trigger->timeConstantInSamples) : 0.0f;
+
+    // band powers, the background is everything else but DC
+    float totalPower = 0.0f;
+    for(unsigned k = 1; k < trigger->fft.numberOfBins; k++){
+        totalPower += trigger->powerSpectrum[k];
+    }
+    float bandsPower = 0.0f;
+    for(unsigned b = 0; b < trigger->numberOfBands; b++){
+        float power = 0.0f;
+        for(unsigned k = trigger->firstBin[b]; k <= trigger->lastBin[b]; k++){
+            power += trigger->powerSpectrum[k];
+        }
+        bandsPower += power;
+        trigger->bandPower[b] = decay * trigger->bandPower[b] + (1.0f - decay) * power * trigger->powerScale;
+    }
+    // overlapping bands may count bins twice, the background never goes negative
+    float backgroundPower = (totalPower > bandsPower) ? totalPower - bandsPower : 0.0f;
+    trigger->backgroundPower = decay * trigger->backgroundPower + (1.0f - decay) * backgroundPower * trigger->powerScale;
+    float backgroundDensity = trigger->backgroundPower / (float)(trigger->numberOfBackgroundBins ? trigger->numberOfBackgroundBins : 1);
+
+    unsigned numberOfFiringBands = 0;
+    float maxLevel = -INFINITY;
+    for(unsigned b = 0; b < trigger->numberOfBands; b++){
+        float level = 10.0f * log10f(trigger->bandPower[b] + BAND_TRIGGER_MIN_ENERGY);
+        if(level > maxLevel){
+            maxLevel = level;
+        }
+        // power per bin of the band over power per bin of the background
+        float bandDensity = trigger->bandPower[b] / (float)(trigger->lastBin[b] - trigger->firstBin[b] + 1);
+        float ratio = 10.0f * log10f((bandDensity + BAND_TRIGGER_MIN_ENERGY) / (backgroundDensity + BAND_TRIGGER_MIN_ENERGY));
+        if(level >= trigger->thresholdIndB && ratio >= trigger->ratioIndB){
+            numberOfFiringBands++;
+        }
+    }
+
+    *levelIndB = maxLevel;
+    if(trigger->combination == BAND_TRIGGER_ALL){
+        return trigger->numberOfBands && numberOfFiringBands == trigger->numberOfBands;
+    }
+    return numberOfFiringBands > 0;
+}
@@ -0,0 +1,91 @@
+/*
+--------------------------------------------------------------------------
+* Acoustic monitoring tool for Raspberry Pi based on miniaudio framework *
+*                                                                        *
+* Kaue Werner, 2024                                                      *
+--------------------------------------------------------------------------
+*/
+/**
+ * @file band_trigger.h
+ * @author Kaue Werner
+ * @date 10 Mar 2024
+ * @brief Header with the band-limited spectral energy trigger used in AMT
+ * @version 0.1.0
+*/
+#ifndef BAND_TRIGGER_H
+#define BAND_TRIGGER_H
+#include "../config_defines.h"
+#include "fft_engine.h"
+
+/**
+ * @brief Current available rules to combine the trigger bands
+ *
+*/
+typedef enum {
+    BAND_TRIGGER_ANY,
+    BAND_TRIGGER_ALL
+} band_trigger_combination;
+
+/**
+ * @brief Band trigger settings data struct
+ * A band fires when its level reaches thresholdIndB and its power per Hz 
+ * exceeds the background (all bins outside the trigger bands) by ratioIndB.
+*/
+typedef struct {
+    unsigned numberOfBands;
+    const float* lowerFrequencies;
+    const float* upperFrequencies;
+    float thresholdIndB;
+    float ratioIndB;
+    unsigned combination;
+    float timeConstant;
+} band_trigger_config;
+
+/**
+ * @brief Band trigger data struct
+ * Band powers come from a Hann windowed FFT over the last fft.size samples, 
+ * updated every processed block and optionally averaged with timeConstant.
+*/
+typedef struct {
+    fft_context fft;
+    float* history;
+    float* powerSpectrum;
+    unsigned numberOfBands;
+    unsigned* firstBin;
+    unsigned* lastBin;
+    float* bandPower;
+    float backgroundPower;
+    unsigned numberOfBackgroundBins;
+    float powerScale;
+    float thresholdIndB;
+    float ratioIndB;
+    unsigned combination;
+    float timeConstantInSamples;
+} band_trigger;
+
+/**
+ * @brief initialize band trigger (band_trigger), returns 0 on success
+ * Must not be called from the audio thread (creates an FFT plan).
+*/
+int init_band_trigger(band_trigger* trigger, const band_trigger_config* config, double sampleRate, unsigned fftSize);
+
+/**
+ * @brief free band trigger (band_trigger)
+ * 
+*/
+void free_band_trigger(band_trigger* trigger);
+
+/**
+ * @brief clear sample history and band power averages
+ * 
+*/
+void reset_band_trigger(band_trigger* trigger);
+
+/**
+ * @brief update the band trigger with a block of samples, returns 1 if the trigger 
+ * rule is met and the highest band level in dBFS in levelIndB
+ * 
+*/
+unsigned process_band_trigger(band_trigger* trigger, const float* input, unsigned numberOfSamples, float* levelIndB);
+
+#endif // BAND_TRIGGER_H
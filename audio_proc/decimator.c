@@ -0,0 +1,186 @@
+/*
+--------------------------------------------------------------------------
+* Acoustic monitoring tool for Raspberry Pi based on miniaudio framework *
+*                                                                        *
+* Kaue Werner, 2024                                                      *
+--------------------------------------------------------------------------
+*/
+/**
+ * @file decimator.c
+ * @author Kaue Werner
+ * @date 10 Mar 2024
+ * @brief Definition of the polyphase FIR decimator used in AMT
+ * 
+ * The anti-aliasing lowpass is a Kaiser windowed sinc (80 dB stopband) with 
+ * its -6 dB point at the output Nyquist frequency, passband flat up to about 
+ * 0.84 of the output Nyquist. Aliases only fall into the transition band. 
+ * Group delay is (numberOfTaps - 1) / 2 input samples.
+ * @version 0.1.0
+*/
+#include "decimator.h"
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#if defined(__SSE__) || defined(__x86_64__) || defined(_M_X64)
+# define DECIMATOR_HAVE_SSE
+# include <immintrin.h>
+#endif
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+# define DECIMATOR_HAVE_NEON
+# include <arm_neon.h>
+#endif
+
+#ifndef PI
+# define PI	3.14159265358979323846264338327950288
+#endif
+
+// Kaiser window shape for 80 dB stopband attenuation
+#define DECIMATOR_KAISER_BETA 7.857
+
+/**
+ * @brief zeroth order modified Bessel function of the first kind
+ * 
+*/
+static double bessel_i0(double x){
+    double sum = 1.0, term = 1.0;
+    for(unsigned k = 1; k < 50 && term > 1e-12 * sum; k++){
+        term *= (x / (2.0 * k)) * (x / (2.0 * k));
+        sum += term;
+    }
+    return sum;
+}
+
+/**
+ * @brief dot product of numberOfTaps (multiple of 4) coefficients and samples
+ * 
+*/
+static inline float dot_product(const float* coeffs, const float* samples, unsigned numberOfTaps){
+#if defined(DECIMATOR_HAVE_SSE)
+    __m128 sum0 = _mm_setzero_ps(), sum1 = _mm_setzero_ps();
+    unsigned k = 0;
+    for(; k + 8 <= numberOfTaps; k += 8){
+        sum0 = _mm_add_ps(sum0, _mm_mul_ps(_mm_loadu_ps(coeffs + k), _mm_loadu_ps(samples + k)));
+        sum1 = _mm_add_ps(sum1, _mm_mul_ps(_mm_loadu_ps(coeffs + k + 4), _mm_loadu_ps(samples + k + 4)));
+    }
+    for(; k < numberOfTaps; k += 4){
+        sum0 = _mm_add_ps(sum0, _mm_mul_ps(_mm_loadu_ps(coeffs + k), _mm_loadu_ps(samples + k)));
+    }
+    sum0 = _mm_add_ps(sum0, sum1);
+    sum0 = _mm_add_ps(sum0, _mm_movehl_ps(sum0, sum0));
+    sum0 = _mm_add_ss(sum0, _mm_shuffle_ps(sum0, sum0, 1));
+    return _mm_cvtss_f32(sum0);
+#elif defined(DECIMATOR_HAVE_NEON)
+    float32x4_t sum0 = vdupq_n_f32(0.0f), sum1 = vdupq_n_f32(0.0f);
+    unsigned k = 0;
+    for(; k + 8 <= numberOfTaps; k += 8){
+        sum0 = vmlaq_f32(sum0, vld1q_f32(coeffs + k), vld1q_f32(samples + k));
+        sum1 = vmlaq_f32(sum1, vld1q_f32(coeffs + k + 4), vld1q_f32(samples + k + 4));
+    }
+    for(; k < numberOfTaps; k += 4){
+        sum0 = vmlaq_f32(sum0, vld1q_f32(coeffs + k), vld1q_f32(samples + k));
+    }
+    sum0 = vaddq_f32(sum0, sum1);
+    float32x2_t half = vadd_f32(vget_low_f32(sum0), vget_high_f32(sum0));
+    return vget_lane_f32(vpadd_f32(half, half), 0);
+#else
+    float sum = 0.0f;
+    for(unsigned k = 0; k < numberOfTaps; k++){
+        sum += coeffs[k] * samples[k];
+    }
+    return sum;
+#endif
+}
+
+/**
+ * @brief check if a decimation factor is supported
+ * 
+*/
+unsigned is_valid_decimation_factor(unsigned factor){
+    return factor == 2 || factor == 3 || factor == 4 || factor == 6;
+}
+
+/**
+ * @brief initialize decimator (decimator) by factor (2, 3, 4 or 6) for blocks of 
+ * up to maxBlockSize input samples, returns 0 on success
+ * 
+*/
+int init_decimator(decimator* dec, unsigned factor, unsigned maxBlockSize){
+    if(!is_valid_decimation_factor(factor)){
+        return -1;
+    }
+    dec->factor = factor;
+    dec->numberOfTaps = DECIMATOR_TAPS_PER_PHASE * factor;
+    dec->maxBlockSize = maxBlockSize;
+    dec->coeffs = malloc(dec->numberOfTaps * sizeof(float));
+    dec->history = malloc((dec->numberOfTaps - 1 + maxBlockSize) * sizeof(float));
+    if(!dec->coeffs || !dec->history){
+        free(dec->coeffs);
+        free(dec->history);
+        return -1;
+    }
+
+    // Kaiser windowed sinc with cutoff at the output Nyquist frequency, unity gain at DC
+    double center = (dec->numberOfTaps - 1) / 2.0;
+    double cutoff = 0.5 / factor;
+    double sum = 0.0;
+    double* taps = malloc(dec->numberOfTaps * sizeof(double));
+    for(unsigned k = 0; k < dec->numberOfTaps; k++){
+        double t = k - center;
+        double sinc = (t == 0.0) ? 2.0 * cutoff : sin(2.0 * PI * cutoff * t) / (PI * t);
+        double ratio = t / center;
+        taps[k] = sinc * bessel_i0(DECIMATOR_KAISER_BETA * sqrt(1.0 - ratio * ratio)) / bessel_i0(DECIMATOR_KAISER_BETA);
+        sum += taps[k];
+    }
+    // time reversed so each output is a dot product with consecutive history samples
+    for(unsigned k = 0; k < dec->numberOfTaps; k++){
+        dec->coeffs[k] = (float)(taps[dec->numberOfTaps - 1 - k] / sum);
+    }
+    free(taps);
+    reset_decimator(dec);
+    return 0;
+}
+
+/**
+ * @brief free decimator (decimator)
+ * 
+*/
+void free_decimator(decimator* dec){
+    free(dec->coeffs);
+    free(dec->history);
+    dec->coeffs = NULL;
+    dec->history = NULL;
+}
+
+/**
+ * @brief clear decimator history
+ * 
+*/
+void reset_decimator(decimator* dec){
+    memset(dec->history, 0, (dec->numberOfTaps - 1 + dec->maxBlockSize) * sizeof(float));
+    dec->phase = 0;
+}
+
+/**
+ * @brief decimate a block of input samples into output (may be the input buffer), 
+ * returns the number of output samples. Blocks need not be multiples of the factor
+ * 
+*/
+unsigned process_decimator(decimator* dec, const float* input, float* output, unsigned numberOfInputSamples){
+    const unsigned historyLength = dec->numberOfTaps - 1;
+    unsigned numberOfOutputSamples = 0;
+    while(numberOfInputSamples){
+        unsigned blockSize = (numberOfInputSamples < dec->maxBlockSize) ? numberOfInputSamples : dec->maxBlockSize;
+        memcpy(dec->history + historyLength, input, blockSize * sizeof(float));
+        // output n uses input samples up to index phase + n * factor of this block
+        unsigned n = dec->phase;
+        for(; n < blockSize; n += dec->factor){
+            output[numberOfOutputSamples++] = dot_product(dec->coeffs, dec->history + n, dec->numberOfTaps);
+        }
+        dec->phase = n - blockSize;
+        memmove(dec->history, dec->history + blockSize, historyLength * sizeof(float));
+        input += blockSize;
+        numberOfInputSamples -= blockSize;
+    }
+    return numberOfOutputSamples;
+}
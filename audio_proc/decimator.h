@@ -0,0 +1,69 @@
+/*
+--------------------------------------------------------------------------
+* Acoustic monitoring tool for Raspberry Pi based on miniaudio framework *
+*                                                                        *
+* Kaue Werner, 2024                                                      *
+--------------------------------------------------------------------------
+*/
+/**
+ * @file decimator.h
+ * @author Kaue Werner
+ * @date 10 Mar 2024
+ * @brief Header with the polyphase FIR decimator used in AMT
+ * @version 0.1.0
+*/
+#ifndef DECIMATOR_H
+#define DECIMATOR_H
+#include "../config_defines.h"
+
+#define DECIMATOR_TAPS_PER_PHASE 32
+
+/**
+ * @brief Polyphase FIR decimator data struct
+ * Only every factor-th output of the anti-aliasing lowpass is computed, so 
+ * each input sample costs DECIMATOR_TAPS_PER_PHASE multiply-adds whatever 
+ * the factor. Coefficients are stored time reversed, history holds the last 
+ * numberOfTaps - 1 input samples followed by the current block.
+*/
+typedef struct {
+    unsigned factor;
+    unsigned numberOfTaps;
+    float* coeffs;
+    float* history;
+    unsigned maxBlockSize;
+    unsigned phase;
+} decimator;
+
+/**
+ * @brief initialize decimator (decimator) by factor (2, 3, 4 or 6) for blocks of 
+ * up to maxBlockSize input samples, returns 0 on success
+ * 
+*/
+int init_decimator(decimator* dec, unsigned factor, unsigned maxBlockSize);
+
+/**
+ * @brief free decimator (decimator)
+ * 
+*/
+void free_decimator(decimator* dec);
+
+/**
+ * @brief clear decimator history
+ * 
+*/
+void reset_decimator(decimator* dec);
+
+/**
+ * @brief decimate a block of input samples into output (may be the input buffer), 
+ * returns the number of output samples. Blocks need not be multiples of the factor
+ * 
+*/
+unsigned process_decimator(decimator* dec, const float* input, float* output, unsigned numberOfInputSamples);
+
+/**
+ * @brief check if a decimation factor is supported
+ * 
+*/
+unsigned is_valid_decimation_factor(unsigned factor);
+
+#endif // DECIMATOR_H
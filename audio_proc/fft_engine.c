@@ -0,0 +1,123 @@
+/*
+--------------------------------------------------------------------------
+* Acoustic monitoring tool for Raspberry Pi based on miniaudio framework *
+*                                                                        *
+* Kaue Werner, 2024                                                      *
+--------------------------------------------------------------------------
+*/
+/**
+ * @file fft_engine.c
+ * @author Kaue Werner
+ * @date 10 Mar 2024
+ * @brief Definition of the plan-cached single-precision FFT engine used in AMT
+ * @version 0.1.0
+*/
+#include "fft_engine.h"
+#include <stdlib.h>
+#include <math.h>
+
+#ifndef PI
+# define PI	3.14159265358979323846264338327950288
+#endif
+
+/**
+ * @brief load FFTW wisdom from file, returns 1 if wisdom was imported
+ * 
+*/
+int load_fft_wisdom(const char* fileName){
+    return fftwf_import_wisdom_from_filename(fileName);
+}
+
+/**
+ * @brief save accumulated FFTW wisdom to file, returns 1 on success
+ * 
+*/
+int save_fft_wisdom(const char* fileName){
+    return fftwf_export_wisdom_to_filename(fileName);
+}
+
+/**
+ * @brief initialize FFT context (fft_context) buffers, window and plan, returns 0 on success
+ * Must not be called from the audio thread (FFTW planning is neither real-time nor thread safe).
+*/
+int init_fft_context(fft_context* fft, unsigned size, unsigned windowType){
+    fft->size = size;
+    fft->numberOfBins = size / 2 + 1;
+    fft->windowType = windowType;
+    fft->plan = NULL;
+    fft->input = fftwf_alloc_real(size);
+    fft->output = fftwf_alloc_complex(fft->numberOfBins);
+    fft->window = malloc(size * sizeof(float));
+    if(!fft->input || !fft->output || !fft->window){
+        free_fft_context(fft);
+        return -1;
+    }
+
+    // window with FFT normalization included
+    for(unsigned n = 0; n < size; n++){
+        double phase = 2.0 * PI * n / size;
+        double w;
+        switch(windowType){
+            case FFT_WINDOW_HANN:
+                w = 0.5 - 0.5 * cos(phase);
+            break;
+            case FFT_WINDOW_BLACKMAN:
+                w = 0.42 - 0.5 * cos(phase) + 0.08 * cos(2.0 * phase);
+            break;
+            case FFT_WINDOW_RECTANGULAR:
+            default:
+                w = 1.0;
+            break;
+        }
+        fft->window[n] = (float)(w / size);
+    }
+
+    // use wisdom (measured plan) if available, otherwise estimate
+    fft->plan = fftwf_plan_dft_r2c_1d((int) size, fft->input, fft->output, FFTW_MEASURE | FFTW_WISDOM_ONLY);
+    if(!fft->plan){
+        fft->plan = fftwf_plan_dft_r2c_1d((int) size, fft->input, fft->output, FFTW_ESTIMATE);
+    }
+    if(!fft->plan){
+        free_fft_context(fft);
+        return -1;
+    }
+    return 0;
+}
+
+/**
+ * @brief free FFT context (fft_context)
+ * 
+*/
+void free_fft_context(fft_context* fft){
+    if(fft->plan){
+        fftwf_destroy_plan(fft->plan);
+    }
+    fftwf_free(fft->input);
+    fftwf_free(fft->output);
+    free(fft->window);
+    fft->plan = NULL;
+    fft->input = NULL;
+    fft->output = NULL;
+    fft->window = NULL;
+}
+
+/**
+ * @brief compute normalized and windowed FFT of size samples of input into fft->output
+ * 
+*/
+void execute_fft(fft_context* fft, const float* input){
+    for(unsigned n = 0; n < fft->size; n++){
+        fft->input[n] = input[n] * fft->window[n];
+    }
+    fftwf_execute(fft->plan);
+}
+
+/**
+ * @brief squared magnitude of the numberOfBins bins of the last executed FFT
+ * 
+*/
+void get_fft_power_spectrum(fft_context* fft, float* powerSpectrum){
+    for(unsigned k = 0; k < fft->numberOfBins; k++){
+        powerSpectrum[k] = fft->output[k][0] * fft->output[k][0] + fft->output[k][1] * fft->output[k][1];
+    }
+}
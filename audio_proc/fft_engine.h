@@ -0,0 +1,81 @@
+/*
+--------------------------------------------------------------------------
+* Acoustic monitoring tool for Raspberry Pi based on miniaudio framework *
+*                                                                        *
+* Kaue Werner, 2024                                                      *
+--------------------------------------------------------------------------
+*/
+/**
+ * @file fft_engine.h
+ * @author Kaue Werner
+ * @date 10 Mar 2024
+ * @brief Header with the plan-cached single-precision FFT engine used in AMT
+ * @version 0.1.0
+*/
+#ifndef FFT_ENGINE_H
+#define FFT_ENGINE_H
+#include "../config_defines.h"
+#include <fftw3.h>
+
+/**
+ * @brief Current available FFT analysis windows
+ *
+*/
+typedef enum {
+    FFT_WINDOW_RECTANGULAR,
+    FFT_WINDOW_HANN,
+    FFT_WINDOW_BLACKMAN
+} fft_window_type;
+
+/**
+ * @brief FFT context data struct, created once per FFT size
+ * The window already includes the 1/size normalization, so it is applied 
+ * together with the input copy. Only the size/2+1 non-redundant bins are kept.
+*/
+typedef struct {
+    unsigned size;
+    unsigned numberOfBins;
+    unsigned windowType;
+    float* window;
+    float* input;
+    fftwf_complex* output;
+    fftwf_plan plan;
+} fft_context;
+
+/**
+ * @brief load FFTW wisdom from file, returns 1 if wisdom was imported
+ * 
+*/
+int load_fft_wisdom(const char* fileName);
+
+/**
+ * @brief save accumulated FFTW wisdom to file, returns 1 on success
+ * 
+*/
+int save_fft_wisdom(const char* fileName);
+
+/**
+ * @brief initialize FFT context (fft_context) buffers, window and plan, returns 0 on success
+ * Must not be called from the audio thread (FFTW planning is neither real-time nor thread safe).
+*/
+int init_fft_context(fft_context* fft, unsigned size, unsigned windowType);
+
+/**
+ * @brief free FFT context (fft_context)
+ * 
+*/
+void free_fft_context(fft_context* fft);
+
+/**
+ * @brief compute normalized and windowed FFT of size samples of input into fft->output
+ * 
+*/
+void execute_fft(fft_context* fft, const float* input);
+
+/**
+ * @brief squared magnitude of the numberOfBins bins of the last executed FFT
+ * 
+*/
+void get_fft_power_spectrum(fft_context* fft, float* powerSpectrum);
+
+#endif // FFT_ENGINE_H
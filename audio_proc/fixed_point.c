@@ -0,0 +1,179 @@
+/*
+--------------------------------------------------------------------------
+* Acoustic monitoring tool for Raspberry Pi based on miniaudio framework *
+*                                                                        *
+* Kaue Werner, 2024                                                      *
+--------------------------------------------------------------------------
+*/
+/**
+ * @file fixed_point.c
+ * @author Kaue Werner
+ * @date 10 Mar 2024
+ * @brief Definition of the fixed-point (Q31) processing kernels used in AMT
+ * 
+ * The kernels only use 32x32->64 bits multiply-accumulates, shifts and 
+ * compares (single instructions on ARMv6), so the 32-bit I2S samples are 
+ * processed without going through the VFP.
+ * @version 0.1.0
+*/
+#include "fixed_point.h"
+#include <stdlib.h>
+#include <math.h>
+
+// squares are taken of samples reduced to 23 bits, 2^46 per sample leaves room for 2^17 samples per call
+#define FIXED_POINT_RMS_SHIFT 8
+#define FIXED_POINT_RMS_MIN_ENERGY 1e-20f
+
+/**
+ * @brief saturate a 64 bits value to Q31
+ * 
+*/
+static inline int32_t saturate_q31(int64_t value){
+    if(value > INT32_MAX){
+        return INT32_MAX;
+    }
+    if(value < INT32_MIN){
+        return INT32_MIN;
+    }
+    return (int32_t) value;
+}
+
+/**
+ * @brief initialize Q31 SOS filter (sos_filter_q31) with identity stages, returns 0 on success
+ * 
+*/
+int init_sos_filter_q31(sos_filter_q31* sos, unsigned numberOfStages){
+    sos->numberOfStages = numberOfStages;
+    sos->coeffs = calloc(numberOfStages * NUMBER_OF_BIQUAD_COEFFICIENTS, sizeof(int32_t));
+    sos->state = calloc(numberOfStages * 4, sizeof(int32_t));
+    sos->error = calloc(numberOfStages, sizeof(int64_t));
+    if(!sos->coeffs || !sos->state || !sos->error){
+        free_sos_filter_q31(sos);
+        return -1;
+    }
+    for(unsigned stage = 0; stage < numberOfStages; stage++){
+        sos->coeffs[stage * NUMBER_OF_BIQUAD_COEFFICIENTS] = 1 << FIXED_POINT_COEFF_BITS;
+    }
+    return 0;
+}
+
+/**
+ * @brief free Q31 SOS filter (sos_filter_q31)
+ * 
+*/
+void free_sos_filter_q31(sos_filter_q31* sos){
+    free(sos->coeffs);
+    free(sos->state);
+    free(sos->error);
+    sos->coeffs = NULL;
+    sos->state = NULL;
+    sos->error = NULL;
+}
+
+/**
+ * @brief set coefficients of one Q31 SOS stage from biquad coefficients 
+ * as computed by compute_biquad_filter_coeffs ([b2, b1, b0, a2, a1])
+ * 
+*/
+void set_sos_filter_q31_stage(sos_filter_q31* sos, unsigned stage, const double* coeffs){
+    if(stage >= sos->numberOfStages){
+        return;
+    }
+    const double scale = (double)(1 << FIXED_POINT_COEFF_BITS);
+    int32_t* c = sos->coeffs + stage * NUMBER_OF_BIQUAD_COEFFICIENTS;
+    c[0] = (int32_t) lrint(coeffs[2] * scale);
+    c[1] = (int32_t) lrint(coeffs[1] * scale);
+    c[2] = (int32_t) lrint(coeffs[0] * scale);
+    c[3] = (int32_t) lrint(coeffs[4] * scale);
+    c[4] = (int32_t) lrint(coeffs[3] * scale);
+}
+
+/**
+ * @brief clear Q31 SOS filter states and error feedback
+ * 
+*/
+void reset_sos_filter_q31(sos_filter_q31* sos){
+    for(unsigned n = 0; n < sos->numberOfStages * 4; n++){
+        sos->state[n] = 0;
+    }
+    for(unsigned n = 0; n < sos->numberOfStages; n++){
+        sos->error[n] = 0;
+    }
+}
+
+/**
+ * @brief process Q31 buffer in place through all SOS stages, outputs saturate at full scale
+ * 
+*/
+void process_sos_filter_q31(sos_filter_q31* sos, int32_t* buffer, unsigned numberOfSamples){
+    for(unsigned stage = 0; stage < sos->numberOfStages; stage++){
+        const int32_t* c = sos->coeffs + stage * NUMBER_OF_BIQUAD_COEFFICIENTS;
+        const int64_t b0 = c[0], b1 = c[1], b2 = c[2], a1 = c[3], a2 = c[4];
+        int32_t* s = sos->state + stage * 4;
+        int32_t x1 = s[0], x2 = s[1], y1 = s[2], y2 = s[3];
+        int64_t error = sos->error[stage];
+        for(unsigned n = 0; n < numberOfSamples; n++){
+            const int32_t x = buffer[n];
+            int64_t accumulator = error + b0 * x + b1 * x1 + b2 * x2 - a1 * y1 - a2 * y2;
+            int64_t y = accumulator >> FIXED_POINT_COEFF_BITS;
+            error = accumulator - (y << FIXED_POINT_COEFF_BITS);
+            x2 = x1;
+            x1 = x;
+            y2 = y1;
+            y1 = saturate_q31(y);
+            buffer[n] = y1;
+        }
+        s[0] = x1;
+        s[1] = x2;
+        s[2] = y1;
+        s[3] = y2;
+        sos->error[stage] = error;
+    }
+}
+
+/**
+ * @brief gain factor in Q7.24 (saturated to the largest representable gain)
+ * 
+*/
+int32_t compute_gain_q24(float gainFactor){
+    double gain = gainFactor * (double)(1 << FIXED_POINT_GAIN_BITS);
+    return (gain >= (double) INT32_MAX) ? INT32_MAX : (int32_t) lrint(gain);
+}
+
+/**
+ * @brief multiply Q31 samples by a Q7.24 gain with saturation
+ * 
+*/
+void apply_gain_q31(const int32_t* input, int32_t* output, unsigned numberOfSamples, int32_t gain){
+    for(unsigned n = 0; n < numberOfSamples; n++){
+        output[n] = saturate_q31(((int64_t) input[n] * gain) >> FIXED_POINT_GAIN_BITS);
+    }
+}
+
+/**
+ * @brief RMS of Q31 samples in dBFS, squares are accumulated in 64 bits
+ * 
+*/
+float compute_rms_q31(const int32_t* input, unsigned numberOfSamples){
+    if(!numberOfSamples){
+        return 10.0f * log10f(FIXED_POINT_RMS_MIN_ENERGY);
+    }
+    uint64_t sum = 0;
+    for(unsigned n = 0; n < numberOfSamples; n++){
+        int64_t sample = input[n] >> FIXED_POINT_RMS_SHIFT;
+        sum += (uint64_t)(sample * sample);
+    }
+    const double fullScale = (double)(1ULL << (62 - 2 * FIXED_POINT_RMS_SHIFT));
+    return 10.0f * log10f((float)(sum / (fullScale * numberOfSamples)) + FIXED_POINT_RMS_MIN_ENERGY);
+}
+
+/**
+ * @brief convert Q31 samples to float in [-1, 1] (full scale rounds to 1.0)
+ * 
+*/
+void convert_q31_to_float(const int32_t* input, float* output, unsigned numberOfSamples){
+    const float scale = 1.0f / 2147483648.0f;
+    for(unsigned n = 0; n < numberOfSamples; n++){
+        output[n] = (float) input[n] * scale;
+    }
+}
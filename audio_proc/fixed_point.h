@@ -0,0 +1,94 @@
+/*
+--------------------------------------------------------------------------
+* Acoustic monitoring tool for Raspberry Pi based on miniaudio framework *
+*                                                                        *
+* Kaue Werner, 2024                                                      *
+--------------------------------------------------------------------------
+*/
+/**
+ * @file fixed_point.h
+ * @author Kaue Werner
+ * @date 10 Mar 2024
+ * @brief Header with the fixed-point (Q31) processing kernels used in AMT
+ * @version 0.1.0
+*/
+#ifndef FIXED_POINT_H
+#define FIXED_POINT_H
+#include "../config_defines.h"
+#include <stdint.h>
+
+// fractional bits of the biquad coefficients (Q2.29, |a1| < 2 and headroom for the accumulator)
+#define FIXED_POINT_COEFF_BITS 29
+// fractional bits of the gain factor (Q7.24, up to 42 dB)
+#define FIXED_POINT_GAIN_BITS 24
+
+/**
+ * @brief Cascaded biquad filter in Q31 data struct
+ * Direct form I per stage with coefficients [b0, b1, b2, a1, a2] in Q2.29, 
+ * states [x1, x2, y1, y2] in Q31 and first-order error feedback: the bits 
+ * truncated from the 64 bits accumulator are added to the next sample, so 
+ * the rounding noise is shaped away from DC (where the poles are).
+*/
+typedef struct {
+    unsigned numberOfStages;
+    int32_t* coeffs;
+    int32_t* state;
+    int64_t* error;
+} sos_filter_q31;
+
+/**
+ * @brief initialize Q31 SOS filter (sos_filter_q31) with identity stages, returns 0 on success
+ * 
+*/
+int init_sos_filter_q31(sos_filter_q31* sos, unsigned numberOfStages);
+
+/**
+ * @brief free Q31 SOS filter (sos_filter_q31)
+ * 
+*/
+void free_sos_filter_q31(sos_filter_q31* sos);
+
+/**
+ * @brief set coefficients of one Q31 SOS stage from biquad coefficients 
+ * as computed by compute_biquad_filter_coeffs ([b2, b1, b0, a2, a1])
+ * 
+*/
+void set_sos_filter_q31_stage(sos_filter_q31* sos, unsigned stage, const double* coeffs);
+
+/**
+ * @brief clear Q31 SOS filter states and error feedback
+ * 
+*/
+void reset_sos_filter_q31(sos_filter_q31* sos);
+
+/**
+ * @brief process Q31 buffer in place through all SOS stages, outputs saturate at full scale
+ * 
+*/
+void process_sos_filter_q31(sos_filter_q31* sos, int32_t* buffer, unsigned numberOfSamples);
+
+/**
+ * @brief gain factor in Q7.24 (saturated to the largest representable gain)
+ * 
+*/
+int32_t compute_gain_q24(float gainFactor);
+
+/**
+ * @brief multiply Q31 samples by a Q7.24 gain with saturation
+ * 
+*/
+void apply_gain_q31(const int32_t* input, int32_t* output, unsigned numberOfSamples, int32_t gain);
+
+/**
+ * @brief RMS of Q31 samples in dBFS, squares are accumulated in 64 bits
+ * 
+*/
+float compute_rms_q31(const int32_t* input, unsigned numberOfSamples);
+
+/**
+ * @brief convert Q31 samples to float in [-1, 1] (full scale rounds to 1.0)
+ * 
+*/
+void convert_q31_to_float(const int32_t* input, float* output, unsigned numberOfSamples);
+
+#endif // FIXED_POINT_H
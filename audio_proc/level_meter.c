@@ -0,0 +1,250 @@
+/*
+--------------------------------------------------------------------------
+* Acoustic monitoring tool for Raspberry Pi based on miniaudio framework *
+*                                                                        *
+* Kaue Werner, 2024                                                      *
+--------------------------------------------------------------------------
+*/
+/**
+ * @file level_meter.c
+ * @author Kaue Werner
+ * @date 10 Mar 2024
+ * @brief Definition of the frequency/time weighted sound level meter used in AMT
+ * @version 0.1.0
+*/
+#include "level_meter.h"
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <complex.h>
+
+#ifndef PI
+# define PI	3.14159265358979323846264338327950288
+#endif
+
+// IEC 61672 weighting pole frequencies in Hz
+#define WEIGHTING_POLE_F1 20.598997
+#define WEIGHTING_POLE_F2 107.65265
+#define WEIGHTING_POLE_F3 737.86223
+#define WEIGHTING_POLE_F4 12194.217
+#define WEIGHTING_REFERENCE_FREQUENCY 1000.0
+
+#define FAST_TIME_CONSTANT 0.125
+#define SLOW_TIME_CONSTANT 1.0
+#define LEVEL_METER_MIN_ENERGY 1e-20f
+
+/**
+ * @brief bilinear transform of the analog section (n2*s^2 + n1*s + n0) / (s^2 + d1*s + d0) 
+ * to digital biquad coeffs = [b2, b1, b0, a2, a1]
+ * 
+*/
+static void bilinear_transform_section(double* coeffs, double n2, double n1, double n0, double d1, double d0, double fs){
+    const double t = 2.0 * fs;
+    const double a0 = t * t + d1 * t + d0;
+    coeffs[0] = (n2 * t * t - n1 * t + n0) / a0;    // b2
+    coeffs[1] = (2.0 * n0 - 2.0 * n2 * t * t) / a0; // b1
+    coeffs[2] = (n2 * t * t + n1 * t + n0) / a0;    // b0
+    coeffs[3] = (t * t - d1 * t + d0) / a0;         // a2
+    coeffs[4] = (2.0 * d0 - 2.0 * t * t) / a0;      // a1
+}
+
+/**
+ * @brief pre-warped analog angular frequency of a pole at frequency f
+ * 
+*/
+static double prewarp(double f, double fs){
+    return 2.0 * fs * tan(PI * f / fs);
+}
+
+/**
+ * @brief compute the biquad stages (coeffs = [b2, b1, b0, a2, a1] per stage) of an 
+ * IEC 61672 frequency weighting, returns the number of stages
+ * 
+*/
+unsigned compute_frequency_weighting_coeffs(double* coeffs, unsigned frequencyWeighting, double sampleRate){
+    const double w1 = prewarp(WEIGHTING_POLE_F1, sampleRate);
+    const double w2 = prewarp(WEIGHTING_POLE_F2, sampleRate);
+    const double w3 = prewarp(WEIGHTING_POLE_F3, sampleRate);
+    // the upper pole pair lies close to Nyquist at low sample rates, keep it below
+    const double w4 = prewarp(fmin(WEIGHTING_POLE_F4, 0.45 * sampleRate), sampleRate);
+    unsigned numberOfStages = 0;
+
+    switch(frequencyWeighting){
+        // A weighting: s^4 / ((s + w1)^2 (s + w2)(s + w3)(s + w4)^2)
+        case A_WEIGHTING:
+        {
+            bilinear_transform_section(coeffs, 1.0, 0.0, 0.0, 2.0 * w1, w1 * w1, sampleRate);
+            bilinear_transform_section(coeffs + NUMBER_OF_BIQUAD_COEFFICIENTS, 1.0, 0.0, 0.0, w2 + w3, w2 * w3, sampleRate);
+            bilinear_transform_section(coeffs + 2 * NUMBER_OF_BIQUAD_COEFFICIENTS, 0.0, 0.0, w4 * w4, 2.0 * w4, w4 * w4, sampleRate);
+            numberOfStages = 3;
+        }
+        break;
+        // C weighting: s^2 / ((s + w1)^2 (s + w4)^2)
+        case C_WEIGHTING:
+        {
+            bilinear_transform_section(coeffs, 1.0, 0.0, 0.0, 2.0 * w1, w1 * w1, sampleRate);
+            bilinear_transform_section(coeffs + NUMBER_OF_BIQUAD_COEFFICIENTS, 0.0, 0.0, w4 * w4, 2.0 * w4, w4 * w4, sampleRate);
+            numberOfStages = 2;
+        }
+        break;
+        // Z weighting: flat
+        case Z_WEIGHTING:
+        default:
+        return 0;
+    }
+
+    // normalize cascade to 0 dB at 1 kHz
+    double complex z = cexp(-I * 2.0 * PI * WEIGHTING_REFERENCE_FREQUENCY / sampleRate);
+    double complex response = 1.0;
+    for(unsigned k = 0; k < numberOfStages; k++){
+        const double* c = coeffs + k * NUMBER_OF_BIQUAD_COEFFICIENTS;
+        response *= (c[2] + c[1] * z + c[0] * z * z) / (1.0 + c[4] * z + c[3] * z * z);
+    }
+    double gain = 1.0 / cabs(response);
+    for(unsigned n = 0; n < 3; n++){
+        coeffs[n] *= gain;
+    }
+    return numberOfStages;
+}
+
+/**
+ * @brief initialize sound level meter (level_meter), returns 0 on success
+ * 
+*/
+int init_level_meter(level_meter* meter, unsigned frequencyWeighting, unsigned timeWeighting, double sampleRate, unsigned maxBlockSize){
+    double coeffs[LEVEL_METER_MAX_WEIGHTING_STAGES * NUMBER_OF_BIQUAD_COEFFICIENTS];
+    unsigned numberOfStages = compute_frequency_weighting_coeffs(coeffs, frequencyWeighting, sampleRate);
+
+    meter->frequencyWeighting = numberOfStages ? frequencyWeighting : Z_WEIGHTING;
+    meter->timeWeighting = timeWeighting;
+    meter->maxBlockSize = maxBlockSize;
+    meter->meanSquare = 0.0f;
+    meter->scratch = NULL;
+    meter->weightingFilter.coeffs = NULL;
+    meter->weightingFilter.state = NULL;
+    meter->weightingFilter.numberOfStages = 0;
+
+    // per-sample decay of the exponential average, exp(-1/(tau*fs))
+    switch(timeWeighting){
+        case FAST_TIME_WEIGHTING:
+            meter->decay = (float) exp(-1.0 / (FAST_TIME_CONSTANT * sampleRate));
+        break;
+        case SLOW_TIME_WEIGHTING:
+            meter->decay = (float) exp(-1.0 / (SLOW_TIME_CONSTANT * sampleRate));
+        break;
+        case BLOCK_TIME_WEIGHTING:
+        default:
+            meter->timeWeighting = BLOCK_TIME_WEIGHTING;
+            meter->decay = 0.0f;
+        break;
+    }
+
+    if(numberOfStages){
+        meter->scratch = malloc(maxBlockSize * sizeof(float));
+        if(!meter->scratch){
+            return -1;
+        }
+        init_sos_filter(&meter->weightingFilter, numberOfStages);
+        for(unsigned k = 0; k < numberOfStages; k++){
+            set_sos_filter_stage(&meter->weightingFilter, k, coeffs + k * NUMBER_OF_BIQUAD_COEFFICIENTS);
+        }
+    }
+    return 0;
+}
+
+/**
+ * @brief free sound level meter (level_meter)
+ * 
+*/
+void free_level_meter(level_meter* meter){
+    if(meter->weightingFilter.numberOfStages){
+        free_sos_filter(&meter->weightingFilter);
+        meter->weightingFilter.numberOfStages = 0;
+    }
+    free(meter->scratch);
+    meter->scratch = NULL;
+}
+
+/**
+ * @brief clear weighting filter states and time-weighted mean square
+ * 
+*/
+void reset_level_meter(level_meter* meter){
+    if(meter->weightingFilter.numberOfStages){
+        reset_sos_filter(&meter->weightingFilter);
+    }
+    meter->meanSquare = 0.0f;
+}
+
+/**
+ * @brief update the level meter with a block of samples (input is not modified), 
+ * returns the weighted level in dBFS at the end of the block
+ * 
+*/
+float process_level_meter(level_meter* meter, const float* input, unsigned numberOfSamples){
+    float blockSum = 0.0f;
+    unsigned totalSamples = numberOfSamples;
+    while(numberOfSamples){
+        unsigned blockSize = numberOfSamples;
+        const float* samples = input;
+        if(meter->scratch){
+            blockSize = (numberOfSamples < meter->maxBlockSize) ? numberOfSamples : meter->maxBlockSize;
+            memcpy(meter->scratch, input, blockSize * sizeof(float));
+            process_sos_filter(&meter->weightingFilter, meter->scratch, blockSize);
+            samples = meter->scratch;
+        }
+        if(meter->timeWeighting == BLOCK_TIME_WEIGHTING){
+            for(unsigned n = 0; n < blockSize; n++){
+                blockSum += samples[n] * samples[n];
+            }
+        }
+        else {
+            // exponential average, y[n] = d*y[n-1] + (1 - d)*x[n]^2
+            float meanSquare = meter->meanSquare;
+            const float decay = meter->decay;
+            const float gain = 1.0f - decay;
+            for(unsigned n = 0; n < blockSize; n++){
+                meanSquare = decay * meanSquare + gain * samples[n] * samples[n];
+            }
+            meter->meanSquare = meanSquare;
+        }
+        input += blockSize;
+        numberOfSamples -= blockSize;
+    }
+    if(meter->timeWeighting == BLOCK_TIME_WEIGHTING && totalSamples){
+        meter->meanSquare = blockSum / (float) totalSamples;
+    }
+    return 10.0f * log10f(meter->meanSquare + LEVEL_METER_MIN_ENERGY);
+}
+
+/**
+ * @brief check if the level meter is an unweighted block RMS (Z frequency and BLOCK time weighting), 
+ * which can be updated with update_level_meter_energy instead of a pass over the samples
+ * 
+*/
+unsigned is_level_meter_unweighted(const level_meter* meter){
+    return meter->frequencyWeighting == Z_WEIGHTING && meter->timeWeighting == BLOCK_TIME_WEIGHTING;
+}
+
+/**
+ * @brief update an unweighted block level meter with the sum of squares of a block computed 
+ * elsewhere (e.g. along with the filters), returns the level in dBFS
+ * 
+*/
+float update_level_meter_energy(level_meter* meter, float sumOfSquares, unsigned numberOfSamples){
+    if(numberOfSamples){
+        meter->meanSquare = sumOfSquares / (float) numberOfSamples;
+    }
+    return 10.0f * log10f(meter->meanSquare + LEVEL_METER_MIN_ENERGY);
+}
+
+/**
+ * @brief short name of the level meter metric, e.g. LAF or LCS ("RMS" for Z weighted block levels)
+ * 
+*/
+const char* get_level_meter_name(const level_meter* meter){
+    static const char* names[3][3] = {{"RMS", "LZF", "LZS"}, 
+                                      {"LAeq", "LAF", "LAS"}, 
+                                      {"LCeq", "LCF", "LCS"}};
+    return names[meter->frequencyWeighting % 3][meter->timeWeighting % 3];
+}
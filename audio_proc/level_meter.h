@@ -0,0 +1,110 @@
+/*
+--------------------------------------------------------------------------
+* Acoustic monitoring tool for Raspberry Pi based on miniaudio framework *
+*                                                                        *
+* Kaue Werner, 2024                                                      *
+--------------------------------------------------------------------------
+*/
+/**
+ * @file level_meter.h
+ * @author Kaue Werner
+ * @date 10 Mar 2024
+ * @brief Header with the frequency/time weighted sound level meter used in AMT
+ * @version 0.1.0
+*/
+#ifndef LEVEL_METER_H
+#define LEVEL_METER_H
+#include "../config_defines.h"
+#include "sos_filter.h"
+
+#define LEVEL_METER_MAX_WEIGHTING_STAGES 3
+
+/**
+ * @brief Current available frequency weightings (IEC 61672)
+ *
+*/
+typedef enum {
+    Z_WEIGHTING,
+    A_WEIGHTING,
+    C_WEIGHTING
+} level_frequency_weighting;
+
+/**
+ * @brief Current available time weightings, BLOCK is the mean square of the 
+ * last processed block only (no exponential averaging)
+ *
+*/
+typedef enum {
+    BLOCK_TIME_WEIGHTING,
+    FAST_TIME_WEIGHTING,
+    SLOW_TIME_WEIGHTING
+} level_time_weighting;
+
+/**
+ * @brief Sound level meter data struct
+ * Frequency weighting is a biquad cascade normalized to 0 dB at 1 kHz, time 
+ * weighting an exponential average of the squared weighted signal.
+*/
+typedef struct {
+    unsigned frequencyWeighting;
+    unsigned timeWeighting;
+    sos_filter weightingFilter;
+    float decay;
+    float meanSquare;
+    float* scratch;
+    unsigned maxBlockSize;
+} level_meter;
+
+/**
+ * @brief initialize sound level meter (level_meter), returns 0 on success
+ * 
+*/
+int init_level_meter(level_meter* meter, unsigned frequencyWeighting, unsigned timeWeighting, double sampleRate, unsigned maxBlockSize);
+
+/**
+ * @brief free sound level meter (level_meter)
+ * 
+*/
+void free_level_meter(level_meter* meter);
+
+/**
+ * @brief clear weighting filter states and time-weighted mean square
+ * 
+*/
+void reset_level_meter(level_meter* meter);
+
+/**
+ * @brief update the level meter with a block of samples (input is not modified), 
+ * returns the weighted level in dBFS at the end of the block
+ * 
+*/
+float process_level_meter(level_meter* meter, const float* input, unsigned numberOfSamples);
+
+/**
+ * @brief compute the biquad stages (coeffs = [b2, b1, b0, a2, a1] per stage) of an 
+ * IEC 61672 frequency weighting, returns the number of stages
+ * 
+*/
+unsigned compute_frequency_weighting_coeffs(double* coeffs, unsigned frequencyWeighting, double sampleRate);
+
+/**
+ * @brief check if the level meter is an unweighted block RMS (Z frequency and BLOCK time weighting), 
+ * which can be updated with update_level_meter_energy instead of a pass over the samples
+ * 
+*/
+unsigned is_level_meter_unweighted(const level_meter* meter);
+
+/**
+ * @brief update an unweighted block level meter with the sum of squares of a block computed 
+ * elsewhere (e.g. along with the filters), returns the level in dBFS
+ * 
+*/
+float update_level_meter_energy(level_meter* meter, float sumOfSquares, unsigned numberOfSamples);
+
+/**
+ * @brief short name of the level meter metric, e.g. LAF or LCS ("RMS" for Z weighted block levels)
+ * 
+*/
+const char* get_level_meter_name(const level_meter* meter);
+
+#endif // LEVEL_METER_H
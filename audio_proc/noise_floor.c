@@ -0,0 +1,128 @@
+/*
+--------------------------------------------------------------------------
+* Acoustic monitoring tool for Raspberry Pi based on miniaudio framework *
+*                                                                        *
+* Kaue Werner, 2024                                                      *
+--------------------------------------------------------------------------
+*/
+/**
+ * @file noise_floor.c
+ * @author Kaue Werner
+ * @date 10 Mar 2024
+ * @brief Definition of the background noise floor estimator used in AMT
+ * 
+ * Memory is fixed at init (one histogram and one bin index per interval of 
+ * the window) and the work per block is one exponential, the percentile is 
+ * only searched once per interval, so the estimator can run on the audio thread.
+ * @version 0.1.0
+*/
+#include "noise_floor.h"
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+/**
+ * @brief histogram bin of a level in dBFS, levels out of range are counted in the first or last bin
+ * 
+*/
+static unsigned get_noise_floor_bin(float levelIndB){
+    float position = (levelIndB - NOISE_FLOOR_MIN_LEVEL) / NOISE_FLOOR_BIN_WIDTH;
+    if(!(position > 0.0f)){
+        return 0;
+    }
+    return (position >= NOISE_FLOOR_NUMBER_OF_BINS) ? NOISE_FLOOR_NUMBER_OF_BINS - 1 : (unsigned) position;
+}
+
+/**
+ * @brief level exceeded during percentile % of the intervals in the window (center of its bin)
+ * 
+*/
+static float compute_noise_floor_percentile(const noise_floor* noiseFloor){
+    // the level exceeded N % of the time is the (100 - N) % lowest one
+    unsigned long rank = ((unsigned long) noiseFloor->numberOfIntervals * (100 - noiseFloor->percentile) + 99) / 100;
+    if(!rank){
+        rank = 1;
+    }
+    unsigned long count = 0;
+    unsigned bin = 0;
+    for(; bin < NOISE_FLOOR_NUMBER_OF_BINS - 1; bin++){
+        count += noiseFloor->histogram[bin];
+        if(count >= rank){
+            break;
+        }
+    }
+    return NOISE_FLOOR_MIN_LEVEL + ((float) bin + 0.5f) * NOISE_FLOOR_BIN_WIDTH;
+}
+
+/**
+ * @brief initialize noise floor estimator (noise_floor) for the level exceeded during percentile % 
+ * (1 to 99) of the last windowInSeconds seconds, returns 0 on success
+ * 
+*/
+int init_noise_floor(noise_floor* noiseFloor, unsigned percentile, float windowInSeconds, double sampleRate){
+    memset(noiseFloor, 0, sizeof(noise_floor));
+    if(percentile < 1 || percentile > 99 || sampleRate <= 0.0){
+        return -1;
+    }
+    noiseFloor->percentile = percentile;
+    noiseFloor->windowLength = (windowInSeconds > NOISE_FLOOR_INTERVAL) ? (unsigned)(windowInSeconds / NOISE_FLOOR_INTERVAL + 0.5f) : 1;
+    noiseFloor->framesPerInterval = (unsigned)(sampleRate * NOISE_FLOOR_INTERVAL + 0.5);
+    noiseFloor->intervalBins = malloc(noiseFloor->windowLength * sizeof(unsigned short));
+    if(!noiseFloor->intervalBins){
+        return -1;
+    }
+    reset_noise_floor(noiseFloor);
+    return 0;
+}
+
+/**
+ * @brief free noise floor estimator (noise_floor)
+ * 
+*/
+void free_noise_floor(noise_floor* noiseFloor){
+    free(noiseFloor->intervalBins);
+    noiseFloor->intervalBins = NULL;
+}
+
+/**
+ * @brief forget all levels counted so far
+ * 
+*/
+void reset_noise_floor(noise_floor* noiseFloor){
+    memset(noiseFloor->histogram, 0, sizeof(noiseFloor->histogram));
+    noiseFloor->numberOfIntervals = 0;
+    noiseFloor->nextInterval = 0;
+    noiseFloor->intervalFrames = 0;
+    noiseFloor->intervalEnergy = 0.0;
+    noiseFloor->floorIndB = -INFINITY;
+}
+
+/**
+ * @brief add the level in dBFS of a block of numberOfFrames frames, returns the current noise floor in dBFS
+ * 
+*/
+float update_noise_floor(noise_floor* noiseFloor, float levelIndB, unsigned numberOfFrames){
+    noiseFloor->intervalEnergy += pow(10.0, 0.1 * levelIndB) * numberOfFrames;
+    noiseFloor->intervalFrames += numberOfFrames;
+    if(noiseFloor->intervalFrames < noiseFloor->framesPerInterval){
+        return noiseFloor->floorIndB;
+    }
+
+    // the oldest interval leaves the window once it is full
+    unsigned bin = get_noise_floor_bin((float)(10.0 * log10(noiseFloor->intervalEnergy / noiseFloor->intervalFrames)));
+    if(noiseFloor->numberOfIntervals == noiseFloor->windowLength){
+        noiseFloor->histogram[noiseFloor->intervalBins[noiseFloor->nextInterval]]--;
+    }
+    else {
+        noiseFloor->numberOfIntervals++;
+    }
+    noiseFloor->histogram[bin]++;
+    noiseFloor->intervalBins[noiseFloor->nextInterval] = (unsigned short) bin;
+    noiseFloor->nextInterval = (noiseFloor->nextInterval + 1) % noiseFloor->windowLength;
+    noiseFloor->intervalFrames = 0;
+    noiseFloor->intervalEnergy = 0.0;
+    if(noiseFloor->numberOfIntervals >= NOISE_FLOOR_MIN_INTERVALS || noiseFloor->numberOfIntervals == noiseFloor->windowLength){
+        noiseFloor->floorIndB = compute_noise_floor_percentile(noiseFloor);
+    }
+    return noiseFloor->floorIndB;
+}
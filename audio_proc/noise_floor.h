@@ -0,0 +1,75 @@
+/*
+--------------------------------------------------------------------------
+* Acoustic monitoring tool for Raspberry Pi based on miniaudio framework *
+*                                                                        *
+* Kaue Werner, 2024                                                      *
+--------------------------------------------------------------------------
+*/
+/**
+ * @file noise_floor.h
+ * @author Kaue Werner
+ * @date 10 Mar 2024
+ * @brief Header with the background noise floor estimator used in AMT
+ * @version 0.1.0
+*/
+#ifndef NOISE_FLOOR_H
+#define NOISE_FLOOR_H
+#include "../config_defines.h"
+
+// levels are binned in 0.5 dB steps from -120 dBFS to full scale
+#define NOISE_FLOOR_MIN_LEVEL -120.0f
+#define NOISE_FLOOR_BIN_WIDTH 0.5f
+#define NOISE_FLOOR_NUMBER_OF_BINS 240
+// length of the intervals over which levels are averaged before being counted
+#define NOISE_FLOOR_INTERVAL 1.0f
+// intervals needed before the percentile is considered meaningful
+#define NOISE_FLOOR_MIN_INTERVALS 10
+
+/**
+ * @brief Background noise floor estimator data struct
+ * Trigger levels are averaged (energy) over NOISE_FLOOR_INTERVAL seconds, 
+ * the interval levels of the last windowLength intervals are counted in a 
+ * fixed histogram and kept in a ring to be removed again when they leave the 
+ * window. floorIndB is the level exceeded during percentile % of the window 
+ * (e.g. L90), -INFINITY until NOISE_FLOOR_MIN_INTERVALS intervals (or the 
+ * whole window if shorter) have been counted.
+*/
+typedef struct {
+    unsigned histogram[NOISE_FLOOR_NUMBER_OF_BINS];
+    unsigned short* intervalBins;
+    unsigned windowLength;
+    unsigned numberOfIntervals;
+    unsigned nextInterval;
+    unsigned percentile;
+    unsigned framesPerInterval;
+    unsigned intervalFrames;
+    double intervalEnergy;
+    float floorIndB;
+} noise_floor;
+
+/**
+ * @brief initialize noise floor estimator (noise_floor) for the level exceeded during percentile % 
+ * (1 to 99) of the last windowInSeconds seconds, returns 0 on success
+ * 
+*/
+int init_noise_floor(noise_floor* noiseFloor, unsigned percentile, float windowInSeconds, double sampleRate);
+
+/**
+ * @brief free noise floor estimator (noise_floor)
+ * 
+*/
+void free_noise_floor(noise_floor* noiseFloor);
+
+/**
+ * @brief forget all levels counted so far
+ * 
+*/
+void reset_noise_floor(noise_floor* noiseFloor);
+
+/**
+ * @brief add the level in dBFS of a block of numberOfFrames frames, returns the current noise floor in dBFS
+ * 
+*/
+float update_noise_floor(noise_floor* noiseFloor, float levelIndB, unsigned numberOfFrames);
+
+#endif
@@ -0,0 +1,189 @@
+/*
+--------------------------------------------------------------------------
+* Acoustic monitoring tool for Raspberry Pi based on miniaudio framework *
+*                                                                        *
+* Kaue Werner, 2024                                                      *
+--------------------------------------------------------------------------
+*/
+/**
+ * @file pcm_convert.c
+ * @author Kaue Werner
+ * @date 10 Mar 2024
+ * @brief Definition of float to integer PCM conversion functions used in AMT
+ * 
+ * TPDF dither is the difference of the upper and lower 16 bits of one 
+ * xorshift32 output, scaled to +-1 LSB.
+ * @version 0.1.0
+*/
+#include "pcm_convert.h"
+#include <math.h>
+
+#if defined(__SSE2__) || defined(__x86_64__) || defined(_M_X64)
+# define PCM_HAVE_SSE2
+# include <emmintrin.h>
+#endif
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+# define PCM_HAVE_NEON
+# include <arm_neon.h>
+#endif
+
+#define DITHER_SCALE (1.0f / 65536.0f)
+
+/**
+ * @brief next output of a xorshift32 generator
+ * 
+*/
+static inline uint32_t next_xorshift32(uint32_t* state){
+    uint32_t x = *state;
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    *state = x;
+    return x;
+}
+
+/**
+ * @brief initialize TPDF dither generator (tpdf_dither)
+ * 
+*/
+void init_tpdf_dither(tpdf_dither* dither, uint32_t seed, unsigned enabled){
+    for(unsigned n = 0; n < 4; n++){
+        // xorshift32 state must not be zero
+        dither->state[n] = (seed + 0x9E3779B9u * (n + 1)) | 1u;
+    }
+    dither->nextGenerator = 0;
+    dither->enabled = enabled;
+}
+
+/**
+ * @brief convert samples from firstSample on with scalar code
+ * 
+*/
+static unsigned long convert_scalar(tpdf_dither* dither, const float* input, int32_t* output, size_t firstSample, size_t numberOfSamples, unsigned bitDepth){
+    const float scale = (float)(1 << (bitDepth - 1));
+    const float maxValue = scale - 1.0f;
+    unsigned long clipped = 0;
+    for(size_t n = firstSample; n < numberOfSamples; n++){
+        float value = input[n] * scale;
+        if(dither->enabled){
+            uint32_t r = next_xorshift32(&dither->state[dither->nextGenerator]);
+            dither->nextGenerator = (dither->nextGenerator + 1) & 3;
+            value += ((float)(r >> 16) - (float)(r & 0xFFFF)) * DITHER_SCALE;
+        }
+        if(value > maxValue){
+            value = maxValue;
+            clipped++;
+        }
+        else if(value < -scale){
+            value = -scale;
+            clipped++;
+        }
+        output[n] = (int32_t) rintf(value);
+    }
+    return clipped;
+}
+
+/**
+ * @brief scalar reference of convert_float_to_int32
+ * 
+*/
+unsigned long convert_float_to_int32_reference(tpdf_dither* dither, const float* input, int32_t* output, size_t numberOfSamples, unsigned bitDepth){
+    return convert_scalar(dither, input, output, 0, numberOfSamples, bitDepth);
+}
+
+/**
+ * @brief convert float samples in [-1, 1) to bitDepth bits integers (stored in int32),
+ * with optional TPDF dither of +-1 LSB. Returns the number of clipped samples
+ * 
+*/
+unsigned long convert_float_to_int32(tpdf_dither* dither, const float* input, int32_t* output, size_t numberOfSamples, unsigned bitDepth){
+    // scalar samples up to generator 0, the vector lanes use generators 0 to 3
+    size_t n = dither->enabled ? ((4 - dither->nextGenerator) & 3) : 0;
+    if(n > numberOfSamples){
+        n = numberOfSamples;
+    }
+    unsigned long clipped = convert_scalar(dither, input, output, 0, n, bitDepth);
+    const float scale = (float)(1 << (bitDepth - 1));
+#if defined(PCM_HAVE_SSE2)
+    const __m128 scaleVector = _mm_set1_ps(scale);
+    const __m128 maxVector = _mm_set1_ps(scale - 1.0f);
+    const __m128 minVector = _mm_set1_ps(-scale);
+    const __m128 ditherScale = _mm_set1_ps(dither->enabled ? DITHER_SCALE : 0.0f);
+    const __m128i lowMask = _mm_set1_epi32(0xFFFF);
+    __m128i state = _mm_loadu_si128((const __m128i*) dither->state);
+    for(; n + 4 <= numberOfSamples; n += 4){
+        __m128 value = _mm_mul_ps(_mm_loadu_ps(input + n), scaleVector);
+        if(dither->enabled){
+            state = _mm_xor_si128(state, _mm_slli_epi32(state, 13));
+            state = _mm_xor_si128(state, _mm_srli_epi32(state, 17));
+            state = _mm_xor_si128(state, _mm_slli_epi32(state, 5));
+            __m128 high = _mm_cvtepi32_ps(_mm_srli_epi32(state, 16));
+            __m128 low = _mm_cvtepi32_ps(_mm_and_si128(state, lowMask));
+            value = _mm_add_ps(value, _mm_mul_ps(_mm_sub_ps(high, low), ditherScale));
+        }
+        int clipMask = _mm_movemask_ps(_mm_or_ps(_mm_cmpgt_ps(value, maxVector), _mm_cmplt_ps(value, minVector)));
+        clipped += (unsigned long) __builtin_popcount(clipMask);
+        value = _mm_min_ps(_mm_max_ps(value, minVector), maxVector);
+        _mm_storeu_si128((__m128i*)(output + n), _mm_cvtps_epi32(value));
+    }
+    _mm_storeu_si128((__m128i*) dither->state, state);
+#elif defined(PCM_HAVE_NEON)
+    const float32x4_t scaleVector = vdupq_n_f32(scale);
+    const float32x4_t maxVector = vdupq_n_f32(scale - 1.0f);
+    const float32x4_t minVector = vdupq_n_f32(-scale);
+    const float32x4_t ditherScale = vdupq_n_f32(DITHER_SCALE);
+    const uint32x4_t lowMask = vdupq_n_u32(0xFFFF);
+    uint32x4_t state = vld1q_u32(dither->state);
+    uint32x4_t clipCount = vdupq_n_u32(0);
+    for(; n + 4 <= numberOfSamples; n += 4){
+        float32x4_t value = vmulq_f32(vld1q_f32(input + n), scaleVector);
+        if(dither->enabled){
+            state = veorq_u32(state, vshlq_n_u32(state, 13));
+            state = veorq_u32(state, vshrq_n_u32(state, 17));
+            state = veorq_u32(state, vshlq_n_u32(state, 5));
+            float32x4_t high = vcvtq_f32_u32(vshrq_n_u32(state, 16));
+            float32x4_t low = vcvtq_f32_u32(vandq_u32(state, lowMask));
+            value = vaddq_f32(value, vmulq_f32(vsubq_f32(high, low), ditherScale));
+        }
+        uint32x4_t clipMask = vorrq_u32(vcgtq_f32(value, maxVector), vcltq_f32(value, minVector));
+        clipCount = vsubq_u32(clipCount, clipMask);
+        value = vminq_f32(vmaxq_f32(value, minVector), maxVector);
+    #ifdef __aarch64__
+        vst1q_s32(output + n, vcvtnq_s32_f32(value));
+    #else
+        // ARMv7 conversion truncates, round half to even first like rintf: adding and subtracting 2^23 with 
+        // the sign of the value drops the fraction bits in the current rounding mode (|value| <= 2^23 once clamped)
+        float32x4_t magic = vbslq_f32(vdupq_n_u32(0x80000000u), value, vdupq_n_f32(8388608.0f));
+        vst1q_s32(output + n, vcvtq_s32_f32(vsubq_f32(vaddq_f32(value, magic), magic)));
+    #endif
+    }
+    vst1q_u32(dither->state, state);
+    clipped += vgetq_lane_u32(clipCount, 0) + vgetq_lane_u32(clipCount, 1) + 
+               vgetq_lane_u32(clipCount, 2) + vgetq_lane_u32(clipCount, 3);
+#endif
+    clipped += convert_scalar(dither, input, output, n, numberOfSamples, bitDepth);
+    return clipped;
+}
+
+/**
+ * @brief pack 16 bits integers stored in int32 to s16 samples
+ * 
+*/
+void pack_int32_to_s16(const int32_t* input, int16_t* output, size_t numberOfSamples){
+    for(size_t n = 0; n < numberOfSamples; n++){
+        output[n] = (int16_t) input[n];
+    }
+}
+
+/**
+ * @brief pack 24 bits integers stored in int32 to little-endian packed s24 samples
+ * 
+*/
+void pack_int32_to_s24(const int32_t* input, unsigned char* output, size_t numberOfSamples){
+    for(size_t n = 0; n < numberOfSamples; n++){
+        uint32_t value = (uint32_t) input[n];
+        output[3 * n] = (unsigned char)(value & 0xFF);
+        output[3 * n + 1] = (unsigned char)((value >> 8) & 0xFF);
+        output[3 * n + 2] = (unsigned char)((value >> 16) & 0xFF);
+    }
+}
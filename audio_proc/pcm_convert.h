@@ -0,0 +1,65 @@
+/*
+--------------------------------------------------------------------------
+* Acoustic monitoring tool for Raspberry Pi based on miniaudio framework *
+*                                                                        *
+* Kaue Werner, 2024                                                      *
+--------------------------------------------------------------------------
+*/
+/**
+ * @file pcm_convert.h
+ * @author Kaue Werner
+ * @date 10 Mar 2024
+ * @brief Header with float to integer PCM conversion functions used in AMT
+ * @version 0.1.0
+*/
+#ifndef PCM_CONVERT_H
+#define PCM_CONVERT_H
+#include "../config_defines.h"
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * @brief TPDF dither generator data struct
+ * Four independent xorshift32 generators, sample n of the converted stream uses 
+ * generator n % 4 (nextGenerator carries the position across conversion calls) 
+ * so that SIMD and scalar conversions, and any split of the stream into calls, 
+ * give the same output.
+*/
+typedef struct {
+    uint32_t state[4];
+    unsigned nextGenerator;
+    unsigned enabled:1;
+} tpdf_dither;
+
+/**
+ * @brief initialize TPDF dither generator (tpdf_dither)
+ * 
+*/
+void init_tpdf_dither(tpdf_dither* dither, uint32_t seed, unsigned enabled);
+
+/**
+ * @brief convert float samples in [-1, 1) to bitDepth bits integers (stored in int32),
+ * with optional TPDF dither of +-1 LSB. Returns the number of clipped samples
+ * 
+*/
+unsigned long convert_float_to_int32(tpdf_dither* dither, const float* input, int32_t* output, size_t numberOfSamples, unsigned bitDepth);
+
+/**
+ * @brief scalar reference of convert_float_to_int32
+ * 
+*/
+unsigned long convert_float_to_int32_reference(tpdf_dither* dither, const float* input, int32_t* output, size_t numberOfSamples, unsigned bitDepth);
+
+/**
+ * @brief pack 16 bits integers stored in int32 to s16 samples
+ * 
+*/
+void pack_int32_to_s16(const int32_t* input, int16_t* output, size_t numberOfSamples);
+
+/**
+ * @brief pack 24 bits integers stored in int32 to little-endian packed s24 samples
+ * 
+*/
+void pack_int32_to_s24(const int32_t* input, unsigned char* output, size_t numberOfSamples);
+
+#endif // PCM_CONVERT_H
@@ -0,0 +1,542 @@
+/*
+--------------------------------------------------------------------------
+* Acoustic monitoring tool for Raspberry Pi based on miniaudio framework *
+*                                                                        *
+* Kaue Werner, 2024                                                      *
+--------------------------------------------------------------------------
+*/
+/**
+ * @file sos_filter.c
+ * @author Kaue Werner
+ * @date 10 Mar 2024
+ * @brief Definition of the cascaded biquad (second-order sections) filter engine used in AMT
+ * 
+ * SIMD kernels run the stages of a group in a pipeline, one stage per lane: 
+ * at step t lane k filters sample t-k with the output of lane k-1 from the 
+ * previous step, so a group of L stages costs one vector step per sample. 
+ * The first and last L-1 steps of a block only update the lanes holding a 
+ * valid sample, so no latency is added and states carry across blocks.
+ * @version 0.1.0
+*/
+#include "sos_filter.h"
+#include <stdlib.h>
+#include <math.h>
+
+#if defined(__SSE__) || defined(__x86_64__) || defined(_M_X64)
+# define SOS_HAVE_SSE
+# include <immintrin.h>
+#endif
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+# define SOS_HAVE_NEON
+# include <arm_neon.h>
+#endif
+#if defined(SOS_HAVE_SSE) && defined(__GNUC__)
+# define SOS_HAVE_AVX
+#endif
+
+#ifndef PI
+# define PI	3.14159265358979323846264338327950288
+#endif
+
+// coefficient and state positions inside a group
+#define SOS_B0 0
+#define SOS_B1 1
+#define SOS_B2 2
+#define SOS_A1 3
+#define SOS_A2 4
+#define SOS_S1 0
+#define SOS_S2 1
+// stages of the scalar kernel processed per pass over the buffer (covers the usual HPF + LPF chains)
+#define SOS_SCALAR_STAGES_PER_PASS 8
+
+/**
+ * @brief filter all stages one at a time with scalar transposed direct form II, the first 
+ * stage reads input scaled by gain, the last one accumulates the output energy if requested
+ * 
+*/
+static void process_sos_scalar_reference(sos_filter* sos, const float* input, float* output, unsigned numberOfSamples, 
+                                         float gain, float* sumOfSquares){
+    const unsigned lanes = sos->numberOfLanes;
+    float energy = 0.0f;
+    for(unsigned stage = 0; stage < sos->numberOfStages; stage++){
+        const float* stageInput = stage ? output : input;
+        const float stageGain = stage ? 1.0f : gain;
+        const unsigned lastStage = (stage + 1 == sos->numberOfStages) && sumOfSquares;
+        const float* c = sos->coeffs + (stage / lanes) * NUMBER_OF_BIQUAD_COEFFICIENTS * lanes + (stage % lanes);
+        float* s = sos->state + (stage / lanes) * 2 * lanes + (stage % lanes);
+        const float b0 = c[SOS_B0 * lanes], b1 = c[SOS_B1 * lanes], b2 = c[SOS_B2 * lanes];
+        const float a1 = c[SOS_A1 * lanes], a2 = c[SOS_A2 * lanes];
+        float s1 = s[SOS_S1 * lanes], s2 = s[SOS_S2 * lanes];
+        for(unsigned n = 0; n < numberOfSamples; n++){
+            float x = stageInput[n] * stageGain;
+            float y = b0 * x + s1;
+            s1 = b1 * x - a1 * y + s2;
+            s2 = b2 * x - a2 * y;
+            output[n] = y;
+            if(lastStage){
+                energy += y * y;
+            }
+        }
+        s[SOS_S1 * lanes] = s1;
+        s[SOS_S2 * lanes] = s2;
+    }
+    if(sumOfSquares){
+        *sumOfSquares = energy;
+    }
+}
+
+/**
+ * @brief filter up to SOS_SCALAR_STAGES_PER_PASS stages per pass over the buffer with scalar 
+ * transposed direct form II: each sample goes through the gain, all stages of the pass and 
+ * the energy accumulation before the next one is read, coefficients and states stay in locals.
+ * Longer cascades take one pass per SOS_SCALAR_STAGES_PER_PASS stages
+ * 
+*/
+static void process_sos_scalar(sos_filter* sos, const float* input, float* output, unsigned numberOfSamples, 
+                               float gain, float* sumOfSquares){
+    const unsigned lanes = sos->numberOfLanes;
+    float energy = 0.0f;
+    for(unsigned first = 0; first < sos->numberOfStages; first += SOS_SCALAR_STAGES_PER_PASS){
+        const unsigned stages = (sos->numberOfStages - first < SOS_SCALAR_STAGES_PER_PASS) ? 
+                                sos->numberOfStages - first : SOS_SCALAR_STAGES_PER_PASS;
+        const float* passInput = first ? output : input;
+        const float passGain = first ? 1.0f : gain;
+        const unsigned lastPass = (first + stages == sos->numberOfStages) && sumOfSquares;
+        float b0[SOS_SCALAR_STAGES_PER_PASS], b1[SOS_SCALAR_STAGES_PER_PASS], b2[SOS_SCALAR_STAGES_PER_PASS];
+        float a1[SOS_SCALAR_STAGES_PER_PASS], a2[SOS_SCALAR_STAGES_PER_PASS];
+        float s1[SOS_SCALAR_STAGES_PER_PASS], s2[SOS_SCALAR_STAGES_PER_PASS];
+        for(unsigned k = 0; k < stages; k++){
+            const unsigned stage = first + k;
+            const float* c = sos->coeffs + (stage / lanes) * NUMBER_OF_BIQUAD_COEFFICIENTS * lanes + (stage % lanes);
+            const float* s = sos->state + (stage / lanes) * 2 * lanes + (stage % lanes);
+            b0[k] = c[SOS_B0 * lanes];
+            b1[k] = c[SOS_B1 * lanes];
+            b2[k] = c[SOS_B2 * lanes];
+            a1[k] = c[SOS_A1 * lanes];
+            a2[k] = c[SOS_A2 * lanes];
+            s1[k] = s[SOS_S1 * lanes];
+            s2[k] = s[SOS_S2 * lanes];
+        }
+        for(unsigned n = 0; n < numberOfSamples; n++){
+            float y = passInput[n] * passGain;
+            for(unsigned k = 0; k < stages; k++){
+                const float x = y;
+                y = b0[k] * x + s1[k];
+                s1[k] = b1[k] * x - a1[k] * y + s2[k];
+                s2[k] = b2[k] * x - a2[k] * y;
+            }
+            output[n] = y;
+            if(lastPass){
+                energy += y * y;
+            }
+        }
+        for(unsigned k = 0; k < stages; k++){
+            const unsigned stage = first + k;
+            float* s = sos->state + (stage / lanes) * 2 * lanes + (stage % lanes);
+            s[SOS_S1 * lanes] = s1[k];
+            s[SOS_S2 * lanes] = s2[k];
+        }
+    }
+    if(sumOfSquares){
+        *sumOfSquares = energy;
+    }
+}
+
+#ifdef SOS_HAVE_SSE
+/**
+ * @brief filter one group of 4 stages with SSE
+ * 
+*/
+static void process_sos_group_sse(const float* c, float* s, const float* input, float* output, unsigned numberOfSamples, 
+                                  float gain, float* sumOfSquares){
+    const __m128 b0 = _mm_loadu_ps(c + SOS_B0 * 4), b1 = _mm_loadu_ps(c + SOS_B1 * 4);
+    const __m128 b2 = _mm_loadu_ps(c + SOS_B2 * 4), a1 = _mm_loadu_ps(c + SOS_A1 * 4);
+    const __m128 a2 = _mm_loadu_ps(c + SOS_A2 * 4);
+    const __m128 laneIndex = _mm_set_ps(3.0f, 2.0f, 1.0f, 0.0f);
+    const __m128 zero = _mm_setzero_ps();
+    const __m128 sampleCount = _mm_set1_ps((float) numberOfSamples);
+    __m128 s1 = _mm_loadu_ps(s + SOS_S1 * 4), s2 = _mm_loadu_ps(s + SOS_S2 * 4);
+    __m128 y = zero;
+    float energy = 0.0f;
+    const unsigned lastStep = numberOfSamples + 3;
+
+    for(unsigned t = 0; t < lastStep; t++){
+        float x = (t < numberOfSamples) ? input[t] * gain : 0.0f;
+        // lane 0 takes the new sample, lane k the previous output of lane k-1
+        __m128 in = _mm_move_ss(_mm_castsi128_ps(_mm_slli_si128(_mm_castps_si128(y), 4)), _mm_set_ss(x));
+        y = _mm_add_ps(_mm_mul_ps(b0, in), s1);
+        __m128 nextS1 = _mm_add_ps(_mm_sub_ps(_mm_mul_ps(b1, in), _mm_mul_ps(a1, y)), s2);
+        __m128 nextS2 = _mm_sub_ps(_mm_mul_ps(b2, in), _mm_mul_ps(a2, y));
+        if(t >= 3 && t < numberOfSamples){
+            s1 = nextS1;
+            s2 = nextS2;
+        }
+        else {
+            // pipeline fill/drain, only update lanes holding a valid sample
+            __m128 position = _mm_sub_ps(_mm_set1_ps((float) t), laneIndex);
+            __m128 mask = _mm_and_ps(_mm_cmpge_ps(position, zero), _mm_cmplt_ps(position, sampleCount));
+            s1 = _mm_or_ps(_mm_and_ps(mask, nextS1), _mm_andnot_ps(mask, s1));
+            s2 = _mm_or_ps(_mm_and_ps(mask, nextS2), _mm_andnot_ps(mask, s2));
+        }
+        if(t >= 3){
+            float out = _mm_cvtss_f32(_mm_shuffle_ps(y, y, _MM_SHUFFLE(3, 3, 3, 3)));
+            output[t - 3] = out;
+            energy += out * out;
+        }
+    }
+    if(sumOfSquares){
+        *sumOfSquares = energy;
+    }
+    _mm_storeu_ps(s + SOS_S1 * 4, s1);
+    _mm_storeu_ps(s + SOS_S2 * 4, s2);
+}
+#endif
+
+#ifdef SOS_HAVE_AVX
+/**
+ * @brief filter one group of 8 stages with AVX
+ * 
+*/
+__attribute__((target("avx")))
+static void process_sos_group_avx(const float* c, float* s, const float* input, float* output, unsigned numberOfSamples, 
+                                  float gain, float* sumOfSquares){
+    const __m256 b0 = _mm256_loadu_ps(c + SOS_B0 * 8), b1 = _mm256_loadu_ps(c + SOS_B1 * 8);
+    const __m256 b2 = _mm256_loadu_ps(c + SOS_B2 * 8), a1 = _mm256_loadu_ps(c + SOS_A1 * 8);
+    const __m256 a2 = _mm256_loadu_ps(c + SOS_A2 * 8);
+    const __m256 laneIndex = _mm256_set_ps(7.0f, 6.0f, 5.0f, 4.0f, 3.0f, 2.0f, 1.0f, 0.0f);
+    const __m256 zero = _mm256_setzero_ps();
+    const __m256 sampleCount = _mm256_set1_ps((float) numberOfSamples);
+    __m256 s1 = _mm256_loadu_ps(s + SOS_S1 * 8), s2 = _mm256_loadu_ps(s + SOS_S2 * 8);
+    __m256 y = zero;
+    float energy = 0.0f;
+    const unsigned lastStep = numberOfSamples + 7;
+
+    for(unsigned t = 0; t < lastStep; t++){
+        float x = (t < numberOfSamples) ? input[t] * gain : 0.0f;
+        // shift lanes up by one across the 128-bit halves, then insert the new sample in lane 0
+        __m256 rotated = _mm256_permute_ps(y, _MM_SHUFFLE(2, 1, 0, 3));
+        __m256 carry = _mm256_permute2f128_ps(rotated, rotated, 0x08);
+        __m256 in = _mm256_blend_ps(rotated, carry, 0x11);
+        in = _mm256_blend_ps(in, _mm256_set1_ps(x), 0x01);
+        y = _mm256_add_ps(_mm256_mul_ps(b0, in), s1);
+        __m256 nextS1 = _mm256_add_ps(_mm256_sub_ps(_mm256_mul_ps(b1, in), _mm256_mul_ps(a1, y)), s2);
+        __m256 nextS2 = _mm256_sub_ps(_mm256_mul_ps(b2, in), _mm256_mul_ps(a2, y));
+        if(t >= 7 && t < numberOfSamples){
+            s1 = nextS1;
+            s2 = nextS2;
+        }
+        else {
+            // pipeline fill/drain, only update lanes holding a valid sample
+            __m256 position = _mm256_sub_ps(_mm256_set1_ps((float) t), laneIndex);
+            __m256 mask = _mm256_and_ps(_mm256_cmp_ps(position, zero, _CMP_GE_OQ), _mm256_cmp_ps(position, sampleCount, _CMP_LT_OQ));
+            s1 = _mm256_blendv_ps(s1, nextS1, mask);
+            s2 = _mm256_blendv_ps(s2, nextS2, mask);
+        }
+        if(t >= 7){
+            __m128 high = _mm256_extractf128_ps(y, 1);
+            float out = _mm_cvtss_f32(_mm_shuffle_ps(high, high, _MM_SHUFFLE(3, 3, 3, 3)));
+            output[t - 7] = out;
+            energy += out * out;
+        }
+    }
+    if(sumOfSquares){
+        *sumOfSquares = energy;
+    }
+    _mm256_storeu_ps(s + SOS_S1 * 8, s1);
+    _mm256_storeu_ps(s + SOS_S2 * 8, s2);
+}
+#endif
+
+#ifdef SOS_HAVE_NEON
+/**
+ * @brief filter one group of 4 stages with NEON
+ * 
+*/
+static void process_sos_group_neon(const float* c, float* s, const float* input, float* output, unsigned numberOfSamples, 
+                                   float gain, float* sumOfSquares){
+    const float32x4_t b0 = vld1q_f32(c + SOS_B0 * 4), b1 = vld1q_f32(c + SOS_B1 * 4);
+    const float32x4_t b2 = vld1q_f32(c + SOS_B2 * 4), a1 = vld1q_f32(c + SOS_A1 * 4);
+    const float32x4_t a2 = vld1q_f32(c + SOS_A2 * 4);
+    const float laneIndexValues[4] = {0.0f, 1.0f, 2.0f, 3.0f};
+    const float32x4_t laneIndex = vld1q_f32(laneIndexValues);
+    const float32x4_t zero = vdupq_n_f32(0.0f);
+    const float32x4_t sampleCount = vdupq_n_f32((float) numberOfSamples);
+    float32x4_t s1 = vld1q_f32(s + SOS_S1 * 4), s2 = vld1q_f32(s + SOS_S2 * 4);
+    float32x4_t y = zero;
+    float energy = 0.0f;
+    const unsigned lastStep = numberOfSamples + 3;
+
+    for(unsigned t = 0; t < lastStep; t++){
+        float x = (t < numberOfSamples) ? input[t] * gain : 0.0f;
+        // lane 0 takes the new sample, lane k the previous output of lane k-1
+        float32x4_t in = vextq_f32(vdupq_n_f32(x), y, 3);
+        y = vaddq_f32(vmulq_f32(b0, in), s1);
+        float32x4_t nextS1 = vaddq_f32(vsubq_f32(vmulq_f32(b1, in), vmulq_f32(a1, y)), s2);
+        float32x4_t nextS2 = vsubq_f32(vmulq_f32(b2, in), vmulq_f32(a2, y));
+        if(t >= 3 && t < numberOfSamples){
+            s1 = nextS1;
+            s2 = nextS2;
+        }
+        else {
+            // pipeline fill/drain, only update lanes holding a valid sample
+            float32x4_t position = vsubq_f32(vdupq_n_f32((float) t), laneIndex);
+            uint32x4_t mask = vandq_u32(vcgeq_f32(position, zero), vcltq_f32(position, sampleCount));
+            s1 = vbslq_f32(mask, nextS1, s1);
+            s2 = vbslq_f32(mask, nextS2, s2);
+        }
+        if(t >= 3){
+            float out = vgetq_lane_f32(y, 3);
+            output[t - 3] = out;
+            energy += out * out;
+        }
+    }
+    if(sumOfSquares){
+        *sumOfSquares = energy;
+    }
+    vst1q_f32(s + SOS_S1 * 4, s1);
+    vst1q_f32(s + SOS_S2 * 4, s2);
+}
+#endif
+
+/**
+ * @brief lane count used by a processing kernel
+ * 
+*/
+static unsigned get_sos_kernel_lanes(unsigned kernel){
+    switch(kernel){
+        case SOS_KERNEL_AVX:
+            return 8;
+        case SOS_KERNEL_SSE:
+        case SOS_KERNEL_NEON:
+            return 4;
+        case SOS_KERNEL_SCALAR:
+        default:
+            return 1;
+    }
+}
+
+/**
+ * @brief select the fastest available kernel for a number of stages
+ * SIMD groups only pay off when most of their lanes hold real stages.
+*/
+static sos_kernel select_sos_kernel(unsigned numberOfStages){
+#ifdef SOS_HAVE_AVX
+    __builtin_cpu_init();
+    if(numberOfStages > 4 && __builtin_cpu_supports("avx")){
+        return SOS_KERNEL_AVX;
+    }
+#endif
+#ifdef SOS_HAVE_SSE
+    if(numberOfStages >= 3){
+        return SOS_KERNEL_SSE;
+    }
+#endif
+#ifdef SOS_HAVE_NEON
+    if(numberOfStages >= 3){
+        return SOS_KERNEL_NEON;
+    }
+#endif
+    (void) numberOfStages;
+    return SOS_KERNEL_SCALAR;
+}
+
+/**
+ * @brief 1 if a processing kernel is compiled in and supported by the CPU
+ * 
+*/
+unsigned is_sos_kernel_available(sos_kernel kernel){
+    switch(kernel){
+    #ifdef SOS_HAVE_AVX
+        case SOS_KERNEL_AVX:
+            __builtin_cpu_init();
+            return __builtin_cpu_supports("avx") ? 1 : 0;
+    #endif
+    #ifdef SOS_HAVE_SSE
+        case SOS_KERNEL_SSE:
+            return 1;
+    #endif
+    #ifdef SOS_HAVE_NEON
+        case SOS_KERNEL_NEON:
+            return 1;
+    #endif
+        case SOS_KERNEL_SCALAR:
+            return 1;
+        default:
+            return 0;
+    }
+}
+
+/**
+ * @brief initialize SOS filter (sos_filter) forcing a given processing kernel, returns 0 on success
+ * and -1 if the kernel is not available
+ * 
+*/
+int init_sos_filter_with_kernel(sos_filter* sos, unsigned numberOfStages, sos_kernel kernel){
+    if(!is_sos_kernel_available(kernel)){
+        sos->coeffs = NULL;
+        sos->state = NULL;
+        return -1;
+    }
+    sos->numberOfStages = numberOfStages;
+    sos->kernel = kernel;
+    sos->numberOfLanes = get_sos_kernel_lanes(kernel);
+    sos->numberOfGroups = (numberOfStages + sos->numberOfLanes - 1) / sos->numberOfLanes;
+    sos->coeffs = calloc(sos->numberOfGroups * NUMBER_OF_BIQUAD_COEFFICIENTS * sos->numberOfLanes, sizeof(float));
+    sos->state = calloc(sos->numberOfGroups * 2 * sos->numberOfLanes, sizeof(float));
+    if((!sos->coeffs || !sos->state) && sos->numberOfGroups){
+        free_sos_filter(sos);
+        return -1;
+    }
+    // identity stages: y = x
+    for(unsigned g = 0; g < sos->numberOfGroups; g++){
+        for(unsigned lane = 0; lane < sos->numberOfLanes; lane++){
+            sos->coeffs[(g * NUMBER_OF_BIQUAD_COEFFICIENTS + SOS_B0) * sos->numberOfLanes + lane] = 1.0f;
+        }
+    }
+    return 0;
+}
+
+/**
+ * @brief initialize SOS filter (sos_filter) with identity stages, the processing 
+ * kernel is selected from the stage count and the CPU features. Returns 0 on success
+ * 
+*/
+int init_sos_filter(sos_filter* sos, unsigned numberOfStages){
+    return init_sos_filter_with_kernel(sos, numberOfStages, select_sos_kernel(numberOfStages));
+}
+
+/**
+ * @brief free SOS filter (sos_filter)
+ * 
+*/
+void free_sos_filter(sos_filter* sos){
+    free(sos->coeffs);
+    free(sos->state);
+    sos->coeffs = NULL;
+    sos->state = NULL;
+}
+
+/**
+ * @brief set coefficients of one SOS stage from biquad coefficients 
+ * as computed by compute_biquad_filter_coeffs ([b2, b1, b0, a2, a1])
+ * 
+*/
+void set_sos_filter_stage(sos_filter* sos, unsigned stage, const double* coeffs){
+    if(stage >= sos->numberOfStages){
+        return;
+    }
+    const unsigned lanes = sos->numberOfLanes;
+    float* c = sos->coeffs + (stage / lanes) * NUMBER_OF_BIQUAD_COEFFICIENTS * lanes + (stage % lanes);
+    c[SOS_B0 * lanes] = (float) coeffs[2];
+    c[SOS_B1 * lanes] = (float) coeffs[1];
+    c[SOS_B2 * lanes] = (float) coeffs[0];
+    c[SOS_A1 * lanes] = (float) coeffs[4];
+    c[SOS_A2 * lanes] = (float) coeffs[3];
+}
+
+/**
+ * @brief clear SOS filter states
+ * 
+*/
+void reset_sos_filter(sos_filter* sos){
+    for(unsigned n = 0; n < sos->numberOfGroups * 2 * sos->numberOfLanes; n++){
+        sos->state[n] = 0.0f;
+    }
+}
+
+/**
+ * @brief filter input scaled by gain into output through all SOS stages with the selected 
+ * kernel, groups after the first one run in place. sumOfSquares may be NULL
+ * 
+*/
+static void process_sos(sos_filter* sos, const float* input, float* output, unsigned numberOfSamples, 
+                        float gain, float* sumOfSquares){
+    const unsigned coeffsPerGroup = NUMBER_OF_BIQUAD_COEFFICIENTS * sos->numberOfLanes;
+    const unsigned statesPerGroup = 2 * sos->numberOfLanes;
+    const unsigned lastGroup = sos->numberOfGroups - 1;
+    switch(sos->kernel){
+    #ifdef SOS_HAVE_SSE
+        case SOS_KERNEL_SSE:
+            for(unsigned g = 0; g < sos->numberOfGroups; g++){
+                process_sos_group_sse(sos->coeffs + g * coeffsPerGroup, sos->state + g * statesPerGroup, g ? output : input, 
+                                      output, numberOfSamples, g ? 1.0f : gain, (g == lastGroup) ? sumOfSquares : NULL);
+            }
+        break;
+    #endif
+    #ifdef SOS_HAVE_AVX
+        case SOS_KERNEL_AVX:
+            for(unsigned g = 0; g < sos->numberOfGroups; g++){
+                process_sos_group_avx(sos->coeffs + g * coeffsPerGroup, sos->state + g * statesPerGroup, g ? output : input, 
+                                      output, numberOfSamples, g ? 1.0f : gain, (g == lastGroup) ? sumOfSquares : NULL);
+            }
+        break;
+    #endif
+    #ifdef SOS_HAVE_NEON
+        case SOS_KERNEL_NEON:
+            for(unsigned g = 0; g < sos->numberOfGroups; g++){
+                process_sos_group_neon(sos->coeffs + g * coeffsPerGroup, sos->state + g * statesPerGroup, g ? output : input, 
+                                       output, numberOfSamples, g ? 1.0f : gain, (g == lastGroup) ? sumOfSquares : NULL);
+            }
+        break;
+    #endif
+        case SOS_KERNEL_SCALAR:
+        default:
+            process_sos_scalar(sos, input, output, numberOfSamples, gain, sumOfSquares);
+        break;
+    }
+}
+
+/**
+ * @brief process buffer in place through all SOS stages with the selected kernel
+ * 
+*/
+void process_sos_filter(sos_filter* sos, float* buffer, unsigned numberOfSamplesToBeProcessed){
+    process_sos(sos, buffer, buffer, numberOfSamplesToBeProcessed, 1.0f, NULL);
+}
+
+/**
+ * @brief filter input scaled by gain into output (may be the input buffer) in a single pass with 
+ * the selected kernel, returns the sum of squares of the output samples
+ * 
+*/
+float process_sos_filter_gain(sos_filter* sos, const float* input, float* output, unsigned numberOfSamplesToBeProcessed, float gain){
+    float sumOfSquares = 0.0f;
+    process_sos(sos, input, output, numberOfSamplesToBeProcessed, gain, &sumOfSquares);
+    return sumOfSquares;
+}
+
+/**
+ * @brief process buffer in place through all SOS stages with the scalar reference kernel
+ * 
+*/
+void process_sos_filter_reference(sos_filter* sos, float* buffer, unsigned numberOfSamplesToBeProcessed){
+    process_sos_scalar_reference(sos, buffer, buffer, numberOfSamplesToBeProcessed, 1.0f, NULL);
+}
+
+/**
+ * @brief Butterworth Q factors of the biquads of an order 2*numberOfStages filter
+ * 
+*/
+void compute_butterworth_q_factors(double* qFactors, unsigned numberOfStages){
+    for(unsigned k = 0; k < numberOfStages; k++){
+        qFactors[k] = 1.0 / (2.0 * cos(PI * (2.0 * k + 1.0) / (4.0 * numberOfStages)));
+    }
+}
+
+/**
+ * @brief name of SOS processing kernel
+ * 
+*/
+const char* get_sos_kernel_name(unsigned kernel){
+    switch(kernel){
+        case SOS_KERNEL_SSE:
+            return "sse";
+        case SOS_KERNEL_AVX:
+            return "avx";
+        case SOS_KERNEL_NEON:
+            return "neon";
+        case SOS_KERNEL_SCALAR:
+        default:
+            return "scalar";
+    }
+}
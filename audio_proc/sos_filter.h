@@ -0,0 +1,115 @@
+/*
+--------------------------------------------------------------------------
+* Acoustic monitoring tool for Raspberry Pi based on miniaudio framework *
+*                                                                        *
+* Kaue Werner, 2024                                                      *
+--------------------------------------------------------------------------
+*/
+/**
+ * @file sos_filter.h
+ * @author Kaue Werner
+ * @date 10 Mar 2024
+ * @brief Header with the cascaded biquad (second-order sections) filter engine used in AMT
+ * @version 0.1.0
+*/
+#ifndef SOS_FILTER_H
+#define SOS_FILTER_H
+#include "../config_defines.h"
+
+/**
+ * @brief Current available SOS processing kernels
+ *
+*/
+typedef enum {
+    SOS_KERNEL_SCALAR,
+    SOS_KERNEL_SSE,
+    SOS_KERNEL_AVX,
+    SOS_KERNEL_NEON
+} sos_kernel;
+
+/**
+ * @brief Cascaded biquad filter data struct
+ * Stages are stored in groups of numberOfLanes (SIMD width of the selected 
+ * kernel), with coefficients [b0, b1, b2, a1, a2] laid out lane by lane and 
+ * transposed direct form II states [s1, s2]. Padding stages are identity.
+*/
+typedef struct {
+    unsigned numberOfStages;
+    unsigned numberOfLanes;
+    unsigned numberOfGroups;
+    unsigned kernel;
+    float* coeffs;
+    float* state;
+} sos_filter;
+
+/**
+ * @brief initialize SOS filter (sos_filter) with identity stages, the processing 
+ * kernel is selected from the stage count and the CPU features. Returns 0 on success
+ * 
+*/
+int init_sos_filter(sos_filter* sos, unsigned numberOfStages);
+
+/**
+ * @brief initialize SOS filter (sos_filter) forcing a given processing kernel, returns 0 on success
+ * and -1 if the kernel is not available
+ * 
+*/
+int init_sos_filter_with_kernel(sos_filter* sos, unsigned numberOfStages, sos_kernel kernel);
+
+/**
+ * @brief 1 if a processing kernel is compiled in and supported by the CPU
+ * 
+*/
+unsigned is_sos_kernel_available(sos_kernel kernel);
+
+/**
+ * @brief free SOS filter (sos_filter)
+ * 
+*/
+void free_sos_filter(sos_filter* sos);
+
+/**
+ * @brief set coefficients of one SOS stage from biquad coefficients 
+ * as computed by compute_biquad_filter_coeffs ([b2, b1, b0, a2, a1])
+ * 
+*/
+void set_sos_filter_stage(sos_filter* sos, unsigned stage, const double* coeffs);
+
+/**
+ * @brief clear SOS filter states
+ * 
+*/
+void reset_sos_filter(sos_filter* sos);
+
+/**
+ * @brief process buffer in place through all SOS stages with the selected kernel
+ * 
+*/
+void process_sos_filter(sos_filter* sos, float* buffer, unsigned numberOfSamplesToBeProcessed);
+
+/**
+ * @brief filter input scaled by gain into output (may be the input buffer) in a single pass with 
+ * the selected kernel, returns the sum of squares of the output samples
+ * 
+*/
+float process_sos_filter_gain(sos_filter* sos, const float* input, float* output, unsigned numberOfSamplesToBeProcessed, float gain);
+
+/**
+ * @brief process buffer in place through all SOS stages with the scalar reference kernel
+ * 
+*/
+void process_sos_filter_reference(sos_filter* sos, float* buffer, unsigned numberOfSamplesToBeProcessed);
+
+/**
+ * @brief Butterworth Q factors of the biquads of an order 2*numberOfStages filter
+ * 
+*/
+void compute_butterworth_q_factors(double* qFactors, unsigned numberOfStages);
+
+/**
+ * @brief name of SOS processing kernel
+ * 
+*/
+const char* get_sos_kernel_name(unsigned kernel);
+
+#endif // SOS_FILTER_H
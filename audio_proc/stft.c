@@ -0,0 +1,94 @@
+/*
+--------------------------------------------------------------------------
+* Acoustic monitoring tool for Raspberry Pi based on miniaudio framework *
+*                                                                        *
+* Kaue Werner, 2024                                                      *
+--------------------------------------------------------------------------
+*/
+/**
+ * @file stft.c
+ * @author Kaue Werner
+ * @date 10 Mar 2024
+ * @brief Definition of the streaming short-time Fourier transform used in AMT
+ * @version 0.1.0
+*/
+#include "stft.h"
+#include <stdlib.h>
+#include <string.h>
+
+/**
+ * @brief initialize streaming STFT (stft) of size samples (power of 2 preferred) advancing by hopSize 
+ * (1 to size) samples, returns 0 on success. Must not be called from the audio thread (creates an FFT plan).
+ * 
+*/
+int init_stft(stft* transform, unsigned size, unsigned hopSize, unsigned windowType, double sampleRate){
+    memset(transform, 0, sizeof(stft));
+    if(!size || !hopSize || hopSize > size){
+        return -1;
+    }
+    if(init_fft_context(&transform->fft, size, windowType)){
+        return -1;
+    }
+    transform->hopSize = hopSize;
+    transform->frame = malloc(size * sizeof(float));
+    transform->powerSpectrum = malloc(transform->fft.numberOfBins * sizeof(float));
+    if(!transform->frame || !transform->powerSpectrum){
+        free_stft(transform);
+        return -1;
+    }
+    // one-sided spectrum (x2) corrected for the window power, the window already holds 1/size
+    double windowPower = 0.0;
+    for(unsigned n = 0; n < size; n++){
+        windowPower += (double) transform->fft.window[n] * transform->fft.window[n];
+    }
+    transform->powerScale = (float)(2.0 / (size * windowPower));
+    transform->binWidth = sampleRate / size;
+    return 0;
+}
+
+/**
+ * @brief free streaming STFT (stft)
+ * 
+*/
+void free_stft(stft* transform){
+    free_fft_context(&transform->fft);
+    free(transform->frame);
+    free(transform->powerSpectrum);
+    transform->frame = NULL;
+    transform->powerSpectrum = NULL;
+}
+
+/**
+ * @brief drop the samples of the incomplete frame
+ * 
+*/
+void reset_stft(stft* transform){
+    transform->frameFill = 0;
+}
+
+/**
+ * @brief add up to numberOfSamples input samples, stopping at the first complete frame, in which case 
+ * frameReady is set and powerSpectrum holds its spectrum. Returns the number of samples consumed
+ * 
+*/
+unsigned process_stft(stft* transform, const float* input, unsigned numberOfSamples, unsigned* frameReady){
+    const unsigned size = transform->fft.size;
+    unsigned count = size - transform->frameFill;
+    if(count > numberOfSamples){
+        count = numberOfSamples;
+    }
+    memcpy(transform->frame + transform->frameFill, input, count * sizeof(float));
+    transform->frameFill += count;
+    *frameReady = transform->frameFill == size;
+    if(*frameReady){
+        execute_fft(&transform->fft, transform->frame);
+        get_fft_power_spectrum(&transform->fft, transform->powerSpectrum);
+        for(unsigned k = 0; k < transform->fft.numberOfBins; k++){
+            transform->powerSpectrum[k] *= transform->powerScale;
+        }
+        // keep the overlap for the next frame
+        memmove(transform->frame, transform->frame + transform->hopSize, (size - transform->hopSize) * sizeof(float));
+        transform->frameFill = size - transform->hopSize;
+    }
+    return count;
+}
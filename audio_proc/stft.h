@@ -0,0 +1,63 @@
+/*
+--------------------------------------------------------------------------
+* Acoustic monitoring tool for Raspberry Pi based on miniaudio framework *
+*                                                                        *
+* Kaue Werner, 2024                                                      *
+--------------------------------------------------------------------------
+*/
+/**
+ * @file stft.h
+ * @author Kaue Werner
+ * @date 10 Mar 2024
+ * @brief Header with the streaming short-time Fourier transform used in AMT
+ * @version 0.1.0
+*/
+#ifndef STFT_H
+#define STFT_H
+#include "../config_defines.h"
+#include "fft_engine.h"
+
+/**
+ * @brief Streaming STFT data struct
+ * Samples of any block size are gathered into frames of fft.size samples 
+ * advancing by hopSize. powerSpectrum holds the one-sided power of each bin 
+ * of the last frame, scaled so that the bins add up to the mean square of 
+ * the frame.
+*/
+typedef struct {
+    fft_context fft;
+    unsigned hopSize;
+    float* frame;
+    unsigned frameFill;
+    float* powerSpectrum;
+    float powerScale;
+    double binWidth;
+} stft;
+
+/**
+ * @brief initialize streaming STFT (stft) of size samples (power of 2 preferred) advancing by hopSize 
+ * (1 to size) samples, returns 0 on success. Must not be called from the audio thread (creates an FFT plan).
+ * 
+*/
+int init_stft(stft* transform, unsigned size, unsigned hopSize, unsigned windowType, double sampleRate);
+
+/**
+ * @brief free streaming STFT (stft)
+ * 
+*/
+void free_stft(stft* transform);
+
+/**
+ * @brief drop the samples of the incomplete frame
+ * 
+*/
+void reset_stft(stft* transform);
+
+/**
+ * @brief add up to numberOfSamples input samples, stopping at the first complete frame, in which case 
+ * frameReady is set and powerSpectrum holds its spectrum. Returns the number of samples consumed
+ * 
+*/
+unsigned process_stft(stft* transform, const float* input, unsigned numberOfSamples, unsigned* frameReady);
+
+#endif // STFT_H
@@ -0,0 +1,430 @@
+/*
+--------------------------------------------------------------------------
+* Acoustic monitoring tool for Raspberry Pi based on miniaudio framework *
+*                                                                        *
+* Kaue Werner, 2024                                                      *
+--------------------------------------------------------------------------
+*/
+/**
+ * @file bench.c
+ * @author Kaue Werner
+ * @date 10 Mar 2024
+ * @brief Micro-benchmarks of the AMT audio processing kernels
+ * 
+ * Every kernel is timed over a grid of buffer sizes and sample rates and one
+ * CSV line is printed per combination:
+ * kernel,buffer_size,sample_rate,ns_per_sample,cycles_per_sample,allocs_per_call
+ * Cycles come from the perf cycle counter (TSC on x86 as fallback, -1 if none
+ * is available), allocations are counted by interposing the glibc allocator.
+ * @version 0.1.0
+*/
+#define _GNU_SOURCE
+#include "../config_defines.h"
+#include "../audio_proc/audio_proc.h"
+#include "../audio_proc/sos_filter.h"
+#include "../audio_proc/fft_engine.h"
+#include "../audio_proc/pcm_convert.h"
+#include "../audio_proc/band_levels.h"
+#include "../audio_proc/acoustic_indices.h"
+#include "../audio_proc/level_meter.h"
+#include "../audio_proc/decimator.h"
+#include "../audio_proc/fixed_point.h"
+#include "../ring_buffer/ring_buffer.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#endif
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+#define BENCH_REPETITIONS 5
+#define BENCH_DEFAULT_MIN_TIME_MS 20
+
+/**
+ * @brief Benchmark state shared by the kernels
+ *
+*/
+typedef struct {
+    float* input;
+    float* buffer;
+    unsigned size;
+    double sampleRate;
+    biquad_filter_data filter;
+    sos_filter sos;
+    sos_filter scalarSos;
+    sos_filter_q31 fixedSos;
+    int32_t* fixedBuffer;
+    fft_context fft;
+    tpdf_dither dither;
+    int32_t* pcm;
+    preroll_buffer preroll;
+    band_level_analyzer bandLevels;
+    acoustic_indices acousticIndices;
+    level_meter levelMeter;
+    decimator dec;
+    volatile float sink;
+} bench_data;
+
+typedef void (*bench_kernel)(bench_data* data);
+
+/* ------------------------------------------------------------------------ */
+/* allocation counting                                                       */
+/* ------------------------------------------------------------------------ */
+static unsigned long allocationCount = 0;
+static int countAllocations = 0;
+
+#ifdef __GLIBC__
+#define BENCH_HAVE_ALLOCATION_COUNT
+extern void* __libc_malloc(size_t size);
+extern void* __libc_calloc(size_t count, size_t size);
+extern void* __libc_realloc(void* ptr, size_t size);
+extern void* __libc_memalign(size_t alignment, size_t size);
+extern void __libc_free(void* ptr);
+
+void* malloc(size_t size){
+    allocationCount += countAllocations;
+    return __libc_malloc(size);
+}
+
+void* calloc(size_t count, size_t size){
+    allocationCount += countAllocations;
+    return __libc_calloc(count, size);
+}
+
+void* realloc(void* ptr, size_t size){
+    allocationCount += countAllocations;
+    return __libc_realloc(ptr, size);
+}
+
+int posix_memalign(void** ptr, size_t alignment, size_t size){
+    allocationCount += countAllocations;
+    *ptr = __libc_memalign(alignment, size);
+    return *ptr ? 0 : 12;
+}
+
+void* aligned_alloc(size_t alignment, size_t size){
+    allocationCount += countAllocations;
+    return __libc_memalign(alignment, size);
+}
+
+void* memalign(size_t alignment, size_t size){
+    allocationCount += countAllocations;
+    return __libc_memalign(alignment, size);
+}
+
+void free(void* ptr){
+    __libc_free(ptr);
+}
+#endif
+
+/* ------------------------------------------------------------------------ */
+/* cycle counter                                                             */
+/* ------------------------------------------------------------------------ */
+static int cycleCounterFd = -1;
+
+/**
+ * @brief open the hardware cycle counter of the current thread
+ * 
+*/
+static void open_cycle_counter(){
+#ifdef __linux__
+    struct perf_event_attr attr;
+    memset(&attr, 0, sizeof(attr));
+    attr.type = PERF_TYPE_HARDWARE;
+    attr.size = sizeof(attr);
+    attr.config = PERF_COUNT_HW_CPU_CYCLES;
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    cycleCounterFd = (int) syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+    if(cycleCounterFd >= 0){
+        ioctl(cycleCounterFd, PERF_EVENT_IOC_ENABLE, 0);
+    }
+#endif
+}
+
+/**
+ * @brief read the cycle counter, returns -1 if no counter is available
+ * 
+*/
+static long long read_cycle_counter(){
+#ifdef __linux__
+    if(cycleCounterFd >= 0){
+        long long cycles;
+        if(read(cycleCounterFd, &cycles, sizeof(cycles)) == sizeof(cycles)){
+            return cycles;
+        }
+    }
+#endif
+#if defined(__x86_64__) || defined(__i386__)
+    return (long long) __rdtsc();
+#else
+    return -1;
+#endif
+}
+
+/**
+ * @brief monotonic time in nanoseconds
+ * 
+*/
+static double get_time_ns(){
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+/* ------------------------------------------------------------------------ */
+/* kernels                                                                   */
+/* ------------------------------------------------------------------------ */
+static void bench_process_filter(bench_data* data){
+    process_filter(data->buffer, data->size, data->filter.previousInput, data->filter.previousOutput, data->filter.coeffs);
+}
+
+static void bench_sos_filter(bench_data* data){
+    process_sos_filter(&data->sos, data->buffer, data->size);
+}
+
+static void bench_sos_filter_gain(bench_data* data){
+    data->sink = process_sos_filter_gain(&data->sos, data->input, data->buffer, data->size, 0.5f);
+}
+
+static void bench_sos_filter_scalar(bench_data* data){
+    process_sos_filter(&data->scalarSos, data->buffer, data->size);
+}
+
+static void bench_sos_filter_q31(bench_data* data){
+    process_sos_filter_q31(&data->fixedSos, data->fixedBuffer, data->size);
+}
+
+static void bench_compute_rms_q31(bench_data* data){
+    data->sink = compute_rms_q31(data->fixedBuffer, data->size);
+}
+
+static void bench_sos_filter_reference(bench_data* data){
+    process_sos_filter_reference(&data->sos, data->buffer, data->size);
+}
+
+static void bench_compute_rms(bench_data* data){
+    data->sink = compute_rms(data->input, data->size, 1);
+}
+
+static void bench_execute_fft(bench_data* data){
+    execute_fft(&data->fft, data->input);
+}
+
+static void bench_convert_s16_dither(bench_data* data){
+    convert_float_to_int32(&data->dither, data->input, data->pcm, data->size, 16);
+}
+
+static void bench_convert_s16_dither_reference(bench_data* data){
+    convert_float_to_int32_reference(&data->dither, data->input, data->pcm, data->size, 16);
+}
+
+static void bench_preroll_update(bench_data* data){
+    preroll_buffer_write(&data->preroll, data->input, data->size);
+}
+
+static void bench_level_meter(bench_data* data){
+    data->sink = process_level_meter(&data->levelMeter, data->input, data->size);
+}
+
+static void bench_band_levels(bench_data* data){
+    process_band_levels(&data->bandLevels, data->input, data->size);
+}
+
+static void bench_acoustic_indices(bench_data* data){
+    process_acoustic_indices(&data->acousticIndices, data->input, data->size);
+}
+
+static void bench_decimator(bench_data* data){
+    process_decimator(&data->dec, data->input, data->buffer, data->size);
+}
+
+/**
+ * @brief Benchmark table entry
+ *
+*/
+typedef struct {
+    const char* name;
+    bench_kernel kernel;
+    unsigned sosStages;
+} bench_entry;
+
+static const bench_entry benchEntries[] = {
+    {"process_filter", bench_process_filter, 0},
+    {"sos_filter_2", bench_sos_filter, 2},
+    {"sos_filter_4", bench_sos_filter, 4},
+    {"sos_filter_8", bench_sos_filter, 8},
+    {"sos_filter_4_gain_rms", bench_sos_filter_gain, 4},
+    {"sos_filter_4_scalar", bench_sos_filter_scalar, 4},
+    {"sos_filter_8_scalar", bench_sos_filter_scalar, 8},
+    {"sos_filter_8_reference", bench_sos_filter_reference, 8},
+    {"sos_filter_q31_2", bench_sos_filter_q31, 2},
+    {"sos_filter_q31_4", bench_sos_filter_q31, 4},
+    {"compute_rms", bench_compute_rms, 0},
+    {"compute_rms_q31", bench_compute_rms_q31, 0},
+    {"execute_fft_hann", bench_execute_fft, 0},
+    {"convert_s16_dither", bench_convert_s16_dither, 0},
+    {"convert_s16_dither_reference", bench_convert_s16_dither_reference, 0},
+    {"preroll_update_1s", bench_preroll_update, 0},
+    {"level_meter_a_fast", bench_level_meter, 0},
+    {"band_levels_third_octave", bench_band_levels, 0},
+    {"acoustic_indices", bench_acoustic_indices, 0},
+    {"decimator_4", bench_decimator, 0}
+};
+
+static const unsigned benchBufferSizes[] = {64, 128, 256, 512, 1024, 2048, 4096, 8192};
+static const double benchSampleRates[] = {16000.0, 48000.0, 96000.0, 192000.0, 384000.0};
+
+/**
+ * @brief prepare benchmark state for a kernel, buffer size and sample rate
+ * 
+*/
+static void init_bench_data(bench_data* data, const bench_entry* entry, unsigned size, double sampleRate){
+    data->size = size;
+    data->sampleRate = sampleRate;
+    data->input = malloc(size * sizeof(float));
+    data->buffer = malloc(size * sizeof(float));
+    srand(1);
+    for(unsigned n = 0; n < size; n++){
+        data->input[n] = (float) rand() / (float) RAND_MAX - 0.5f;
+        data->buffer[n] = data->input[n];
+    }
+
+    data->filter.filterType = HPF;
+    data->filter.qFactor = 0.7071;
+    data->filter.gain = 0.0;
+    data->filter.cutoffFrequency = 250.0;
+    data->filter.sampleRate = sampleRate;
+    init_filter(&data->filter);
+
+    unsigned stages = entry->sosStages ? entry->sosStages : 1;
+    init_sos_filter(&data->sos, stages);
+    init_sos_filter_with_kernel(&data->scalarSos, stages, SOS_KERNEL_SCALAR);
+    for(unsigned n = 0; n < stages; n++){
+        set_sos_filter_stage(&data->sos, n, data->filter.coeffs);
+        set_sos_filter_stage(&data->scalarSos, n, data->filter.coeffs);
+    }
+    init_sos_filter_q31(&data->fixedSos, stages);
+    for(unsigned n = 0; n < stages; n++){
+        set_sos_filter_q31_stage(&data->fixedSos, n, data->filter.coeffs);
+    }
+    data->fixedBuffer = malloc(size * sizeof(int32_t));
+    for(unsigned n = 0; n < size; n++){
+        data->fixedBuffer[n] = (int32_t)(data->input[n] * 2147483648.0f);
+    }
+
+    init_fft_context(&data->fft, size, FFT_WINDOW_HANN);
+    init_tpdf_dither(&data->dither, 1, 1);
+    data->pcm = malloc(size * sizeof(int32_t));
+    init_preroll_buffer(&data->preroll, (size_t) sampleRate, sizeof(float));
+    init_band_level_analyzer(&data->bandLevels, 3, sampleRate, size);
+    init_acoustic_indices(&data->acousticIndices, sampleRate, ACOUSTIC_INDEX_FFT_SIZE, -50.0f);
+    init_level_meter(&data->levelMeter, A_WEIGHTING, FAST_TIME_WEIGHTING, sampleRate, size);
+    init_decimator(&data->dec, 4, size);
+}
+
+/**
+ * @brief free benchmark state
+ * 
+*/
+static void free_bench_data(bench_data* data){
+    free(data->input);
+    free(data->buffer);
+    free_filter(&data->filter);
+    free_sos_filter(&data->sos);
+    free_sos_filter(&data->scalarSos);
+    free_sos_filter_q31(&data->fixedSos);
+    free(data->fixedBuffer);
+    free_fft_context(&data->fft);
+    free(data->pcm);
+    free_preroll_buffer(&data->preroll);
+    free_band_level_analyzer(&data->bandLevels);
+    free_acoustic_indices(&data->acousticIndices);
+    free_level_meter(&data->levelMeter);
+    free_decimator(&data->dec);
+}
+
+/**
+ * @brief time one kernel configuration and print its CSV line
+ * 
+*/
+static void run_bench(const bench_entry* entry, unsigned size, double sampleRate, double minTimeNs){
+    bench_data data;
+    init_bench_data(&data, entry, size, sampleRate);
+
+    // calibrate the number of calls per repetition
+    unsigned long calls = 1;
+    while(1){
+        double start = get_time_ns();
+        for(unsigned long n = 0; n < calls; n++){
+            entry->kernel(&data);
+        }
+        if(get_time_ns() - start >= minTimeNs || calls >= (1UL << 30)){
+            break;
+        }
+        calls *= 2;
+    }
+
+    // best of repetitions
+    double bestNs = -1.0;
+    long long bestCycles = -1;
+    unsigned long allocations = 0;
+    for(unsigned r = 0; r < BENCH_REPETITIONS; r++){
+        allocationCount = 0;
+        countAllocations = 1;
+        long long startCycles = read_cycle_counter();
+        double start = get_time_ns();
+        for(unsigned long n = 0; n < calls; n++){
+            entry->kernel(&data);
+        }
+        double elapsed = get_time_ns() - start;
+        long long cycles = read_cycle_counter() - startCycles;
+        countAllocations = 0;
+        allocations = allocationCount;
+        if(bestNs < 0.0 || elapsed < bestNs){
+            bestNs = elapsed;
+            bestCycles = (startCycles < 0) ? -1 : cycles;
+        }
+    }
+
+    double samples = (double) calls * size;
+#ifdef BENCH_HAVE_ALLOCATION_COUNT
+    double allocsPerCall = (double) allocations / calls;
+#else
+    double allocsPerCall = -1.0;
+    (void) allocations;
+#endif
+    printf("%s,%u,%.0f,%.3f,%.3f,%.2f\n", entry->name, size, sampleRate, bestNs / samples, 
+           (bestCycles < 0) ? -1.0 : bestCycles / samples, allocsPerCall);
+    fflush(stdout);
+    free_bench_data(&data);
+}
+
+int main(int argc, char** argv){
+    // optional arguments: minimum time per repetition in ms and kernel name filter
+    double minTimeNs = ((argc > 1) ? atof(argv[1]) : BENCH_DEFAULT_MIN_TIME_MS) * 1e6;
+    const char* filter = (argc > 2) ? argv[2] : NULL;
+
+    load_fft_wisdom(FFT_WISDOM_FILE_PATH);
+
+    open_cycle_counter();
+    printf("kernel,buffer_size,sample_rate,ns_per_sample,cycles_per_sample,allocs_per_call\n");
+    for(unsigned k = 0; k < sizeof(benchEntries) / sizeof(benchEntries[0]); k++){
+        if(filter && !strstr(benchEntries[k].name, filter)){
+            continue;
+        }
+        for(unsigned r = 0; r < sizeof(benchSampleRates) / sizeof(benchSampleRates[0]); r++){
+            for(unsigned b = 0; b < sizeof(benchBufferSizes) / sizeof(benchBufferSizes[0]); b++){
+                run_bench(&benchEntries[k], benchBufferSizes[b], benchSampleRates[r], minTimeNs);
+            }
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,458 @@
+/*
+--------------------------------------------------------------------------
+* Acoustic monitoring tool for Raspberry Pi based on miniaudio framework *
+*                                                                        *
+* Kaue Werner, 2024                                                      *
+--------------------------------------------------------------------------
+*/
+/**
+ * @file kernel_test.c
+ * @author Kaue Werner
+ * @date 10 Mar 2024
+ * @brief Validation of the AMT audio processing kernels against their references
+ * and of the recording schedule over month and year boundaries
+ *
+ * Each check prints one line (ok or FAIL with the measured value), the
+ * exit status is 1 if any check failed. The SIMD filter kernels must
+ * match the scalar reference exactly, so build without floating point
+ * contraction (-ffp-contract=off), fused multiply-adds round differently.
+ * @version 0.1.0
+*/
+#include "../config_defines.h"
+#include "../audio_proc/audio_proc.h"
+#include "../audio_proc/sos_filter.h"
+#include "../audio_proc/fixed_point.h"
+#include "../audio_proc/pcm_convert.h"
+#include "../scheduler/scheduler.h"
+#include <stdint.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define TEST_SAMPLE_RATE 48000.0
+#define TEST_HPF_CUTOFF 50.0
+#define TEST_LPF_CUTOFF 10000.0
+#define TEST_MAX_STAGES 16
+#define TEST_BLOCKS_PER_CHECK 4
+#define TEST_Q31_BLOCKS 200
+// Q31 filter chain error against the float cascade relative to the output level (dominated by the float
+// coefficients near the HPF poles), rounding error RMS in dBFS against a double precision cascade with the
+// same Q2.29 coefficients, and block RMS level tolerance
+#define TEST_Q31_MIN_FLOAT_SNR_DB 70.0
+#define TEST_Q31_MAX_ROUNDING_ERROR_DB -160.0
+#define TEST_Q31_RMS_TOLERANCE_DB 0.001
+
+static unsigned failedChecks = 0;
+
+// block sizes not multiple of the SIMD widths, the pipeline fill/drain steps cover the whole block for the short ones
+static const unsigned testBlockSizes[] = {1, 3, 5, 7, 9, 15, 17, 255, 257, 1023};
+// filter kernels checked when compiled in and supported by the CPU
+static const sos_kernel testKernels[] = {SOS_KERNEL_SCALAR, SOS_KERNEL_SSE, SOS_KERNEL_AVX, SOS_KERNEL_NEON};
+
+/**
+ * @brief print the result of one check and count the failures
+ *
+*/
+static void report_check(const char* name, unsigned passed, double difference){
+    printf("%s %s (measured %g)\n", passed ? "ok  " : "FAIL", name, difference);
+    failedChecks += !passed;
+}
+
+/**
+ * @brief deterministic test signal in [-0.5, 0.5)
+ *
+*/
+static void fill_test_signal(float* buffer, unsigned size){
+    for(unsigned n = 0; n < size; n++){
+        buffer[n] = (float) rand() / (float) RAND_MAX - 0.5f;
+    }
+}
+
+/**
+ * @brief coefficients of a Butterworth HPF followed by a Butterworth LPF, as the capture 
+ * filter chain, NUMBER_OF_BIQUAD_COEFFICIENTS per stage
+ *
+*/
+static void compute_test_filter_coeffs(double* coeffs, unsigned numberOfStages){
+    double qFactors[TEST_MAX_STAGES];
+    unsigned hpfStages = numberOfStages / 2;
+    unsigned lpfStages = numberOfStages - hpfStages;
+    compute_butterworth_q_factors(qFactors, hpfStages);
+    for(unsigned n = 0; n < hpfStages; n++){
+        compute_biquad_filter_coeffs(coeffs + n * NUMBER_OF_BIQUAD_COEFFICIENTS, HPF, TEST_HPF_CUTOFF, qFactors[n], 0.0, TEST_SAMPLE_RATE);
+    }
+    compute_butterworth_q_factors(qFactors, lpfStages);
+    for(unsigned n = 0; n < lpfStages; n++){
+        compute_biquad_filter_coeffs(coeffs + (hpfStages + n) * NUMBER_OF_BIQUAD_COEFFICIENTS, LPF, TEST_LPF_CUTOFF, 
+                                     qFactors[n], 0.0, TEST_SAMPLE_RATE);
+    }
+}
+
+/**
+ * @brief initialize a SOS filter with the test filter chain and a given kernel
+ *
+*/
+static void init_test_sos_filter(sos_filter* sos, unsigned numberOfStages, sos_kernel kernel){
+    double coeffs[TEST_MAX_STAGES * NUMBER_OF_BIQUAD_COEFFICIENTS];
+    compute_test_filter_coeffs(coeffs, numberOfStages);
+    init_sos_filter_with_kernel(sos, numberOfStages, kernel);
+    for(unsigned n = 0; n < numberOfStages; n++){
+        set_sos_filter_stage(sos, n, coeffs + n * NUMBER_OF_BIQUAD_COEFFICIENTS);
+    }
+}
+
+/**
+ * @brief SOS kernel, in place and with gain and energy, against the scalar reference over 
+ * consecutive blocks so the states carried across blocks are checked too
+ *
+*/
+static void test_sos_filter(unsigned numberOfStages, unsigned blockSize, sos_kernel kernel){
+    // filters of the kernel under test and of the reference (scalar layout), in place and with gain
+    sos_filter sos[4];
+    for(unsigned k = 0; k < 4; k++){
+        init_test_sos_filter(&sos[k], numberOfStages, (k % 2 == 0) ? kernel : SOS_KERNEL_SCALAR);
+    }
+    float* input = malloc(blockSize * sizeof(float));
+    float* output = malloc(blockSize * sizeof(float));
+    float* expected = malloc(blockSize * sizeof(float));
+    const float gain = 1.5f;
+    double difference = 0.0, gainDifference = 0.0, energyDifference = 0.0;
+    for(unsigned block = 0; block < TEST_BLOCKS_PER_CHECK; block++){
+        fill_test_signal(input, blockSize);
+        memcpy(output, input, blockSize * sizeof(float));
+        memcpy(expected, input, blockSize * sizeof(float));
+        process_sos_filter(&sos[0], output, blockSize);
+        process_sos_filter_reference(&sos[1], expected, blockSize);
+        for(unsigned n = 0; n < blockSize; n++){
+            difference = fmax(difference, fabs((double) output[n] - expected[n]));
+        }
+
+        // the first stage scales its input before filtering, as the reference on the scaled input
+        float energy = process_sos_filter_gain(&sos[2], input, output, blockSize, gain);
+        apply_gain(input, expected, blockSize, gain);
+        process_sos_filter_reference(&sos[3], expected, blockSize);
+        float expectedEnergy = 0.0f;
+        for(unsigned n = 0; n < blockSize; n++){
+            gainDifference = fmax(gainDifference, fabs((double) output[n] - expected[n]));
+            expectedEnergy += expected[n] * expected[n];
+        }
+        energyDifference = fmax(energyDifference, fabs((double) energy - expectedEnergy));
+    }
+
+    char name[MAX_CHAR_LENGTH];
+    const char* kernelName = get_sos_kernel_name(kernel);
+    snprintf(name, MAX_CHAR_LENGTH, "sos_filter_%u %s block %u equals reference", numberOfStages, kernelName, blockSize);
+    report_check(name, difference == 0.0, difference);
+    snprintf(name, MAX_CHAR_LENGTH, "sos_filter_%u_gain %s block %u equals reference", numberOfStages, kernelName, blockSize);
+    report_check(name, gainDifference == 0.0, gainDifference);
+    snprintf(name, MAX_CHAR_LENGTH, "sos_filter_%u_gain %s block %u energy equals reference", numberOfStages, kernelName, blockSize);
+    report_check(name, energyDifference == 0.0, energyDifference);
+
+    free(input);
+    free(output);
+    free(expected);
+    for(unsigned k = 0; k < 4; k++){
+        free_sos_filter(&sos[k]);
+    }
+}
+
+/**
+ * @brief deterministic Q31 test signal, white noise and a 1 kHz tone at levelIndBFS each
+ *
+*/
+static void fill_test_signal_q31(int32_t* buffer, unsigned size, unsigned offset, double levelIndBFS){
+    const double amplitude = pow(10.0, levelIndBFS / 20.0);
+    for(unsigned n = 0; n < size; n++){
+        double noise = ((double) rand() / RAND_MAX - 0.5) * sqrt(12.0);
+        double tone = sqrt(2.0) * sin(2.0 * M_PI * 1000.0 * (offset + n) / TEST_SAMPLE_RATE);
+        buffer[n] = (int32_t) lrint(amplitude * (noise + tone) * 2147483648.0 * 0.5);
+    }
+}
+
+/**
+ * @brief Q31 gain saturates at full scale and is exact for power of two gains, other gains 
+ * are within the Q7.24 quantization of the gain factor (plus 1 LSB of truncation)
+ *
+*/
+static void test_gain_q31(){
+    const int32_t values[] = {INT32_MIN, INT32_MIN + 1, -1073741825, -1073741824, -3, -1, 0, 1, 3, 
+                              1073741823, 1073741824, INT32_MAX - 1, INT32_MAX};
+    const unsigned numberOfValues = sizeof(values) / sizeof(values[0]);
+    const float gains[] = {0.25f, 0.5f, 1.0f, 2.0f, 4.0f, 64.0f};
+    int32_t output[sizeof(values) / sizeof(values[0])];
+    double difference = 0.0;
+    for(unsigned g = 0; g < sizeof(gains) / sizeof(gains[0]); g++){
+        apply_gain_q31(values, output, numberOfValues, compute_gain_q24(gains[g]));
+        for(unsigned n = 0; n < numberOfValues; n++){
+            // exact in double for power of two gains, then saturated as the float path clips
+            double expected = fmin(fmax(floor((double) values[n] * gains[g]), (double) INT32_MIN), (double) INT32_MAX);
+            difference = fmax(difference, fabs(output[n] - expected));
+        }
+    }
+    report_check("apply_gain_q31 power of two gains saturate and equal exact products", difference == 0.0, difference);
+
+    // 13 dB gain, not exact in Q7.24
+    const float gainFactor = powf(10.0f, 13.0f / 20.0f);
+    const int32_t gain = compute_gain_q24(gainFactor);
+    const double gainError = fabs((double) gain / (1 << FIXED_POINT_GAIN_BITS) - gainFactor);
+    unsigned withinBound = 1;
+    difference = 0.0;
+    apply_gain_q31(values, output, numberOfValues, gain);
+    for(unsigned n = 0; n < numberOfValues; n++){
+        double expected = fmin(fmax((double) values[n] * gainFactor, (double) INT32_MIN), (double) INT32_MAX);
+        double error = fabs(output[n] - expected);
+        withinBound &= error <= fabs((double) values[n]) * gainError + 1.0;
+        difference = fmax(difference, error);
+    }
+    report_check("apply_gain_q31 13 dB gain within gain quantization", withinBound, difference);
+}
+
+/**
+ * @brief Q31 to float conversion is exact (the scaling by 2^-31 only rounds the 32 bits value to 24 bits)
+ *
+*/
+static void test_convert_q31_to_float(){
+    int32_t input[1024];
+    float output[1024];
+    const int32_t edges[] = {INT32_MIN, INT32_MIN + 1, -16777217, -1, 0, 1, 16777217, INT32_MAX - 64, INT32_MAX};
+    const unsigned numberOfEdges = sizeof(edges) / sizeof(edges[0]);
+    for(unsigned n = 0; n < 1024; n++){
+        input[n] = (n < numberOfEdges) ? edges[n] : (int32_t)(((uint32_t) rand() << 16) ^ (uint32_t) rand());
+    }
+    convert_q31_to_float(input, output, 1024);
+    double difference = 0.0;
+    for(unsigned n = 0; n < 1024; n++){
+        difference = fmax(difference, fabs((double) output[n] - (double)(float)((double) input[n] / 2147483648.0)));
+    }
+    report_check("convert_q31_to_float equals exact scaling", difference == 0.0, difference);
+}
+
+/**
+ * @brief Q31 RMS against the float RMS of the same samples
+ *
+*/
+static void test_rms_q31(double levelIndBFS){
+    int32_t input[NUMBER_OF_CALLBACK_SAMPLES];
+    float floatInput[NUMBER_OF_CALLBACK_SAMPLES];
+    fill_test_signal_q31(input, NUMBER_OF_CALLBACK_SAMPLES, 0, levelIndBFS);
+    convert_q31_to_float(input, floatInput, NUMBER_OF_CALLBACK_SAMPLES);
+    double difference = fabs(compute_rms_q31(input, NUMBER_OF_CALLBACK_SAMPLES) - compute_rms(floatInput, NUMBER_OF_CALLBACK_SAMPLES, 1));
+    char name[MAX_CHAR_LENGTH];
+    snprintf(name, MAX_CHAR_LENGTH, "compute_rms_q31 at %.0f dBFS equals float RMS within %g dB", levelIndBFS, TEST_Q31_RMS_TOLERANCE_DB);
+    report_check(name, difference <= TEST_Q31_RMS_TOLERANCE_DB, difference);
+}
+
+/**
+ * @brief double precision direct form I cascade, states (x1, x2, y1, y2 per stage) carry across calls
+ *
+*/
+static void process_double_cascade(const double* coeffs, double* state, unsigned numberOfStages, double* buffer, unsigned size){
+    for(unsigned stage = 0; stage < numberOfStages; stage++){
+        const double* c = coeffs + stage * NUMBER_OF_BIQUAD_COEFFICIENTS;
+        double* s = state + stage * 4;
+        for(unsigned n = 0; n < size; n++){
+            double y = c[2] * buffer[n] + c[1] * s[0] + c[0] * s[1] - c[4] * s[2] - c[3] * s[3];
+            s[1] = s[0];
+            s[0] = buffer[n];
+            s[3] = s[2];
+            s[2] = y;
+            buffer[n] = y;
+        }
+    }
+}
+
+/**
+ * @brief fixed-point front end (Q31 gain and filter chain) against the float path (float gain folded 
+ * into the SOS cascade) on identical s32 input, block by block as in the capture callback
+ *
+*/
+static void test_sos_filter_q31(unsigned numberOfStages, double levelIndBFS){
+    double coeffs[TEST_MAX_STAGES * NUMBER_OF_BIQUAD_COEFFICIENTS];
+    compute_test_filter_coeffs(coeffs, numberOfStages);
+    sos_filter sos;
+    sos_filter_q31 fixedSos;
+    init_sos_filter(&sos, numberOfStages);
+    init_sos_filter_q31(&fixedSos, numberOfStages);
+    for(unsigned n = 0; n < numberOfStages; n++){
+        set_sos_filter_stage(&sos, n, coeffs + n * NUMBER_OF_BIQUAD_COEFFICIENTS);
+        set_sos_filter_q31_stage(&fixedSos, n, coeffs + n * NUMBER_OF_BIQUAD_COEFFICIENTS);
+    }
+    // the double reference uses the coefficients rounded as in the Q31 filter
+    for(unsigned n = 0; n < numberOfStages * NUMBER_OF_BIQUAD_COEFFICIENTS; n++){
+        coeffs[n] = ldexp(nearbyint(ldexp(coeffs[n], FIXED_POINT_COEFF_BITS)), -FIXED_POINT_COEFF_BITS);
+    }
+    const float gainFactor = 2.0f;
+    int32_t input[NUMBER_OF_CALLBACK_SAMPLES], fixedOutput[NUMBER_OF_CALLBACK_SAMPLES];
+    float floatInput[NUMBER_OF_CALLBACK_SAMPLES], floatOutput[NUMBER_OF_CALLBACK_SAMPLES];
+    double reference[NUMBER_OF_CALLBACK_SAMPLES], referenceState[TEST_MAX_STAGES * 4] = {0};
+    double signalEnergy = 0.0, floatErrorEnergy = 0.0, doubleErrorEnergy = 0.0, levelDifference = 0.0;
+    for(unsigned block = 0; block < TEST_Q31_BLOCKS; block++){
+        fill_test_signal_q31(input, NUMBER_OF_CALLBACK_SAMPLES, block * NUMBER_OF_CALLBACK_SAMPLES, levelIndBFS);
+        convert_q31_to_float(input, floatInput, NUMBER_OF_CALLBACK_SAMPLES);
+        float sumOfSquares = process_sos_filter_gain(&sos, floatInput, floatOutput, NUMBER_OF_CALLBACK_SAMPLES, gainFactor);
+
+        apply_gain_q31(input, fixedOutput, NUMBER_OF_CALLBACK_SAMPLES, compute_gain_q24(gainFactor));
+        process_sos_filter_q31(&fixedSos, fixedOutput, NUMBER_OF_CALLBACK_SAMPLES);
+        for(unsigned n = 0; n < NUMBER_OF_CALLBACK_SAMPLES; n++){
+            reference[n] = input[n] * (double) gainFactor / 2147483648.0;
+        }
+        process_double_cascade(coeffs, referenceState, numberOfStages, reference, NUMBER_OF_CALLBACK_SAMPLES);
+        for(unsigned n = 0; n < NUMBER_OF_CALLBACK_SAMPLES; n++){
+            // Q31 output compared before the conversion to float
+            double fixedValue = fixedOutput[n] / 2147483648.0;
+            signalEnergy += reference[n] * reference[n];
+            floatErrorEnergy += (fixedValue - floatOutput[n]) * (fixedValue - floatOutput[n]);
+            doubleErrorEnergy += (fixedValue - reference[n]) * (fixedValue - reference[n]);
+        }
+        // block levels as used by the trigger: 64 bits accumulation on Q31 against the energy of the float pass
+        double floatLevel = 10.0 * log10(sumOfSquares / NUMBER_OF_CALLBACK_SAMPLES);
+        levelDifference = fmax(levelDifference, fabs(compute_rms_q31(fixedOutput, NUMBER_OF_CALLBACK_SAMPLES) - floatLevel));
+    }
+    double floatSnr = 10.0 * log10(signalEnergy / (floatErrorEnergy + 1e-30));
+    double roundingError = 10.0 * log10(doubleErrorEnergy / (TEST_Q31_BLOCKS * NUMBER_OF_CALLBACK_SAMPLES) + 1e-30);
+
+    char name[MAX_CHAR_LENGTH];
+    snprintf(name, MAX_CHAR_LENGTH, "sos_filter_q31_%u at %.0f dBFS matches float cascade, SNR above %.0f dB", numberOfStages, 
+             levelIndBFS, TEST_Q31_MIN_FLOAT_SNR_DB);
+    report_check(name, floatSnr >= TEST_Q31_MIN_FLOAT_SNR_DB, floatSnr);
+    snprintf(name, MAX_CHAR_LENGTH, "sos_filter_q31_%u at %.0f dBFS rounding error against double cascade below %.0f dBFS", 
+             numberOfStages, levelIndBFS, TEST_Q31_MAX_ROUNDING_ERROR_DB);
+    report_check(name, roundingError <= TEST_Q31_MAX_ROUNDING_ERROR_DB, roundingError);
+    snprintf(name, MAX_CHAR_LENGTH, "sos_filter_q31_%u at %.0f dBFS block RMS equals float within %g dB", numberOfStages, 
+             levelIndBFS, TEST_Q31_RMS_TOLERANCE_DB);
+    report_check(name, levelDifference <= TEST_Q31_RMS_TOLERANCE_DB, levelDifference);
+
+    free_sos_filter(&sos);
+    free_sos_filter_q31(&fixedSos);
+}
+
+/**
+ * @brief dithered conversion split into calls of blockSize samples against the scalar reference in one call
+ *
+*/
+static void test_convert_float_to_int32(unsigned blockSize){
+    const unsigned size = 1023;
+    float input[1023];
+    int32_t output[1023], referenceOutput[1023];
+    tpdf_dither dither, referenceDither;
+    fill_test_signal(input, size);
+    init_tpdf_dither(&dither, 1, 1);
+    init_tpdf_dither(&referenceDither, 1, 1);
+    for(unsigned n = 0; n < size; n += blockSize){
+        convert_float_to_int32(&dither, input + n, output + n, (n + blockSize < size) ? blockSize : size - n, 16);
+    }
+    convert_float_to_int32_reference(&referenceDither, input, referenceOutput, size, 16);
+    unsigned differences = 0;
+    for(unsigned n = 0; n < size; n++){
+        differences += output[n] != referenceOutput[n];
+    }
+    char name[MAX_CHAR_LENGTH];
+    snprintf(name, MAX_CHAR_LENGTH, "convert_float_to_int32 dithered in blocks of %u equals reference", blockSize);
+    report_check(name, differences == 0, differences);
+}
+
+/**
+ * @brief conversion without dither of values halfway between two integers, around zero and near both ends
+ * of the range: the SIMD paths must round half to even like rintf in the scalar path
+ *
+*/
+static void test_convert_float_to_int32_ties(unsigned bitDepth){
+    const unsigned size = 1023;
+    const int32_t scale = 1 << (bitDepth - 1);
+    float input[1023];
+    int32_t output[1023];
+    double ties[1023];
+    tpdf_dither dither;
+    init_tpdf_dither(&dither, 1, 0);
+    for(unsigned n = 0; n < size; n++){
+        int32_t lower = (n < 341) ? (int32_t) n - 170 : ((n < 682) ? scale - 2 - (int32_t)(n - 341) : -scale + (int32_t)(n - 682));
+        ties[n] = lower + 0.5;
+        input[n] = (float)(ties[n] / scale);
+    }
+    convert_float_to_int32(&dither, input, output, size, bitDepth);
+    unsigned differences = 0;
+    for(unsigned n = 0; n < size; n++){
+        differences += output[n] != (int32_t) rint(ties[n]);
+    }
+    char name[MAX_CHAR_LENGTH];
+    snprintf(name, MAX_CHAR_LENGTH, "convert_float_to_int32 %u bits rounds ties to even", bitDepth);
+    report_check(name, differences == 0, differences);
+}
+
+/**
+ * @brief drive the schedule over the virtual clock from its first to its last date, sleeping from 
+ * each recording window start to the window end, and compare the window starts (local time) with the expected ones
+ *
+*/
+static void test_schedule(const char* firstDate, const char* lastDate, const unsigned* recordingHours, unsigned numberOfRecordingHours,
+                          const char* const* expectedStarts, unsigned numberOfExpectedStarts){
+    char name[MAX_CHAR_LENGTH];
+    snprintf(name, MAX_CHAR_LENGTH, "schedule from %s to %s starts the expected recording windows", firstDate, lastDate);
+    amt_schedule schedule;
+    if(init_schedule(&schedule, firstDate, lastDate, recordingHours, numberOfRecordingHours)){
+        report_check(name, 0, -1);
+        return;
+    }
+    enable_virtual_clock(schedule.startTime);
+    unsigned numberOfStarts = 0, differences = 0;
+    time_t start;
+    while((start = get_next_recording_start(&schedule, get_current_time())) != SCHEDULE_FINISHED){
+        sleep_until_time(start);
+        struct tm info;
+        char label[MAX_CHAR_LENGTH];
+        localtime_r(&start, &info);
+        strftime(label, MAX_CHAR_LENGTH, "%Y-%m-%d %H:%M", &info);
+        differences += (numberOfStarts >= numberOfExpectedStarts) || strcmp(label, expectedStarts[numberOfStarts]);
+        numberOfStarts++;
+        sleep_until_time(get_recording_window_end(&schedule, start));
+    }
+    differences += (numberOfStarts < numberOfExpectedStarts) ? numberOfExpectedStarts - numberOfStarts : 0;
+    report_check(name, differences == 0, differences);
+}
+
+int main(){
+    srand(1);
+    // every available kernel for all stage counts, whatever the selection: several SIMD groups 
+    // with partly filled last groups, and scalar passes of up to 8 stages
+    for(unsigned k = 0; k < sizeof(testKernels) / sizeof(testKernels[0]); k++){
+        if(!is_sos_kernel_available(testKernels[k])){
+            printf("skip %s kernel not available\n", get_sos_kernel_name(testKernels[k]));
+            continue;
+        }
+        for(unsigned stages = 1; stages <= TEST_MAX_STAGES; stages++){
+            for(unsigned b = 0; b < sizeof(testBlockSizes) / sizeof(testBlockSizes[0]); b++){
+                test_sos_filter(stages, testBlockSizes[b], testKernels[k]);
+            }
+        }
+    }
+    test_gain_q31();
+    test_convert_q31_to_float();
+    test_rms_q31(-6.0);
+    test_rms_q31(-40.0);
+    test_rms_q31(-80.0);
+    for(unsigned stages = 2; stages <= 4; stages += 2){
+        test_sos_filter_q31(stages, -20.0);
+        test_sos_filter_q31(stages, -60.0);
+    }
+    for(unsigned b = 0; b < sizeof(testBlockSizes) / sizeof(testBlockSizes[0]); b++){
+        test_convert_float_to_int32(testBlockSizes[b]);
+    }
+    test_convert_float_to_int32_ties(16);
+    test_convert_float_to_int32_ties(24);
+    // the late evening and the midnight hour form one window across the date change
+    const unsigned recordingHours[] = {0, 23};
+    const char* const monthStarts[] = {"2024-01-30 00:00", "2024-01-30 23:00", "2024-01-31 23:00", "2024-02-01 23:00"};
+    test_schedule("2024-01-30", "2024-02-01", recordingHours, 2, monthStarts, 4);
+    const char* const leapDayStarts[] = {"2024-02-28 00:00", "2024-02-28 23:00", "2024-02-29 23:00", "2024-03-01 23:00"};
+    test_schedule("2024-02-28", "2024-03-01", recordingHours, 2, leapDayStarts, 4);
+    const char* const yearStarts[] = {"2023-12-30 00:00", "2023-12-30 23:00", "2023-12-31 23:00", "2024-01-01 23:00"};
+    test_schedule("2023-12-30", "2024-01-01", recordingHours, 2, yearStarts, 4);
+    // separate windows on both sides of the year change
+    const unsigned separateHours[] = {5, 18};
+    const char* const separateStarts[] = {"2023-12-31 05:00", "2023-12-31 18:00", "2024-01-01 05:00", "2024-01-01 18:00"};
+    test_schedule("2023-12-31", "2024-01-01", separateHours, 2, separateStarts, 4);
+    printf("%u failed checks\n", failedChecks);
+    return failedChecks ? 1 : 0;
+}
@@ -24,24 +24,45 @@
 #define LOG_FILE_PATH "./recording_log_"
 #define OUTPUT_WAV_FILE_DIR "./recs/"
 #define REC_DIR "./recs"
+#define FFT_WISDOM_FILE_PATH "./fftw_wisdom"
+#define BAND_LEVEL_FILE_PATH "./band_levels_"
+#define ACOUSTIC_INDEX_FILE_PATH "./acoustic_indices_"
+#define TELEMETRY_FILE_PATH "./amt_stats.txt"
+#define STORAGE_INDEX_FILE_PATH "./storage_index.txt"
+#define SIMULATION_DIR "./sim/"
 #else
 #define CONFIG_FILE_PATH "/home/pi/amt/amt.config"
 #define LOG_FILE_PATH "/home/pi/amt/recording_log_"
 #define OUTPUT_WAV_FILE_DIR "/home/pi/amt/recs/"
 #define REC_DIR "/home/pi/amt/recs"
+#define FFT_WISDOM_FILE_PATH "/home/pi/amt/fftw_wisdom"
+#define BAND_LEVEL_FILE_PATH "/home/pi/amt/band_levels_"
+#define ACOUSTIC_INDEX_FILE_PATH "/home/pi/amt/acoustic_indices_"
+#define TELEMETRY_FILE_PATH "/home/pi/amt/amt_stats.txt"
+#define STORAGE_INDEX_FILE_PATH "/home/pi/amt/storage_index.txt"
+#define SIMULATION_DIR "/home/pi/amt/sim/"
 #endif
 
+#define RECOVER_OPTION "--recover"
+#define REPLAY_OPTION "--replay"
+#define SIMULATE_OPTION "--simulate"
 #define OUTPUT_WAV_FILE_SUFFIX "_%Y-%m-%d_%H-%M-%S-"
+#define REC_SUMMARY_FILE_EXTENSION ".sum"
+#define ACOUSTIC_INDEX_FFT_SIZE 512
+#define ANALYSIS_BLOCK_SIZE 1024
+#define BAND_TRIGGER_FFT_SIZE 1024
 #define DATE_ARRAY_SIZE 10
-#define DATE_CHECK_TIME_IN_MINUTES 1
 #define DATE_DAY_FIRST_DIGIT_INDEX 8
 #define DATE_MONTH_FIRST_DIGIT_INDEX 5
 #define DATE_LABEL "%Y-%m-%d"
-#define HPF_Q_FACTOR 0.707
 #define MAX_CHAR_LENGTH 100
 #define NUMBER_OF_BIQUAD_COEFFICIENTS 5
 #define NUMBER_OF_CALLBACK_SAMPLES 256
 #define NUMBER_OF_INPUT_CHANNELS 1
+#define SCHEDULE_RECORDING_TIMEOUT_IN_SECONDS 60
+#define WRITER_CONVERSION_BLOCK_SIZE 1024
+#define WRITER_EVENT_QUEUE_SIZE 64
+#define WRITER_POLL_PERIOD_MS 10
 #define ZERO_CHAR_AS_INT 48
 
 #endif
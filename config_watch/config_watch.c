@@ -0,0 +1,307 @@
+/*
+--------------------------------------------------------------------------
+* Acoustic monitoring tool for Raspberry Pi based on miniaudio framework *
+*                                                                        *
+* Kaue Werner, 2024                                                      *
+--------------------------------------------------------------------------
+*/
+/**
+ * @file config_watch.c
+ * @author Kaue Werner
+ * @date 10 Mar 2024
+ * @brief Definition of the amt.config watcher (hot reload of processing parameters) used in AMT
+ * @version 0.1.0
+*/
+#include "config_watch.h"
+#include "../audio_proc/audio_proc.h"
+#include "../audio_proc/sos_filter.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#ifndef PC_TEST
+#include <poll.h>
+#include <sys/inotify.h>
+#endif
+
+#define CONFIG_WATCH_POLL_PERIOD_MS 500
+// editors write a file in several steps, wait for them to settle before reading it
+#define CONFIG_WATCH_SETTLE_TIME_MS 100
+
+/**
+ * @brief build processing parameters from a configuration, filters are designed at 
+ * sampleRate unless keepFilters is set. Returns NULL on allocation failure
+ * 
+*/
+dsp_params* build_dsp_params(const amt_config* config, double sampleRate, unsigned keepFilters){
+    dsp_params* params = malloc(sizeof(dsp_params));
+    if(!params){
+        return NULL;
+    }
+    params->generation = 0;
+    params->micGainFactor = config->micGainFactor;
+    params->recordingThresholddBFS = config->recordingThresholddBFS;
+    params->recordingReleasedBFS = config->recordingReleasedBFS;
+    params->noiseFloorMargin = config->noiseFloorMargin;
+    params->triggerBandRatio = config->triggerBandRatio;
+    params->numberOfFilterStages = 0;
+    params->filterCoeffs = NULL;
+    params->nextRetired = NULL;
+    if(keepFilters){
+        return params;
+    }
+
+    // same Butterworth HPF and LPF cascade as built at startup
+    unsigned numberOfHpfStages = config->enableHighpassFilter ? config->highpassFilterStages : 0;
+    unsigned numberOfLpfStages = config->enableLowpasssFilter ? config->lowpassFilterStages : 0;
+    params->numberOfFilterStages = numberOfHpfStages + numberOfLpfStages;
+    if(!params->numberOfFilterStages){
+        return params;
+    }
+    params->filterCoeffs = malloc(params->numberOfFilterStages * NUMBER_OF_BIQUAD_COEFFICIENTS * sizeof(double));
+    double* qFactors = malloc(params->numberOfFilterStages * sizeof(double));
+    if(!params->filterCoeffs || !qFactors){
+        free(qFactors);
+        free_dsp_params(params);
+        return NULL;
+    }
+    compute_butterworth_q_factors(qFactors, numberOfHpfStages);
+    for(unsigned n = 0; n < numberOfHpfStages; n++){
+        compute_biquad_filter_coeffs(params->filterCoeffs + n * NUMBER_OF_BIQUAD_COEFFICIENTS, HPF, 
+                                     config->highpassFilterCutoff, qFactors[n], 0.0, sampleRate);
+    }
+    compute_butterworth_q_factors(qFactors, numberOfLpfStages);
+    for(unsigned n = 0; n < numberOfLpfStages; n++){
+        compute_biquad_filter_coeffs(params->filterCoeffs + (numberOfHpfStages + n) * NUMBER_OF_BIQUAD_COEFFICIENTS, LPF, 
+                                     config->lowpassFilterCutoff, qFactors[n], 0.0, sampleRate);
+    }
+    free(qFactors);
+    return params;
+}
+
+/**
+ * @brief free processing parameters (dsp_params)
+ * 
+*/
+void free_dsp_params(dsp_params* params){
+    if(params){
+        free(params->filterCoeffs);
+        free(params);
+    }
+}
+
+/**
+ * @brief free retired parameters the audio thread is not using anymore (watcher thread side)
+ * 
+*/
+static void reclaim_retired_params(config_watcher* watcher){
+    dsp_params* hazard = atomic_load(&watcher->hazardParams);
+    dsp_params** link = &watcher->retiredParams;
+    while(*link){
+        dsp_params* params = *link;
+        if(params != hazard){
+            *link = params->nextRetired;
+            free_dsp_params(params);
+        }
+        else {
+            link = &params->nextRetired;
+        }
+    }
+}
+
+/**
+ * @brief read the config file again and publish its processing parameters (watcher thread side)
+ * 
+*/
+static void reload_config(config_watcher* watcher){
+    const amt_config* active = watcher->activeConfig;
+    amt_config config;
+    if(set_config(watcher->configFileName, &config)){
+        printf("Failed to reload %s.\n", watcher->configFileName);
+        return;
+    }
+    config.micGainFactor = powf(10.0f, config.microphoneGain / 20.0f);
+
+    // filters are only redesigned when the structure of the running cascade does not change
+    unsigned keepFilters = config.enableHighpassFilter != active->enableHighpassFilter ||
+                           config.enableLowpasssFilter != active->enableLowpasssFilter ||
+                           (active->enableHighpassFilter && config.highpassFilterStages != active->highpassFilterStages) ||
+                           (active->enableLowpasssFilter && config.lowpassFilterStages != active->lowpassFilterStages);
+    if(keepFilters){
+        printf("Filter enable/stage changes need a restart, filter cutoffs were not reloaded.\n");
+    }
+    dsp_params* params = build_dsp_params(&config, active->processingSampleRate, keepFilters);
+    free_config(&config);
+    if(!params){
+        return;
+    }
+
+    params->generation = ++watcher->generation;
+    dsp_params* previous = atomic_exchange(&watcher->currentParams, params);
+    previous->nextRetired = watcher->retiredParams;
+    watcher->retiredParams = previous;
+#ifdef DEBUG
+    printf("-> Config reloaded: gain %.2f, threshold %.1f dBFS, release %.1f dBFS, noise floor margin %.1f dB, band ratio %.1f dB\n", 
+           params->micGainFactor, params->recordingThresholddBFS, params->recordingReleasedBFS, params->noiseFloorMargin, 
+           params->triggerBandRatio);
+#endif
+}
+
+#ifdef PC_TEST
+/**
+ * @brief watcher thread main loop, polls the modification time of the config file
+ * 
+*/
+static void* config_watch_thread(void* arg){
+    config_watcher* watcher = (config_watcher*) arg;
+    struct stat fileInfo;
+    time_t lastModified = stat(watcher->configFileName, &fileInfo) ? 0 : fileInfo.st_mtime;
+    while(!atomic_load(&watcher->stopRequested)){
+        usleep(CONFIG_WATCH_POLL_PERIOD_MS * 1000);
+        if(!stat(watcher->configFileName, &fileInfo) && fileInfo.st_mtime != lastModified){
+            lastModified = fileInfo.st_mtime;
+            usleep(CONFIG_WATCH_SETTLE_TIME_MS * 1000);
+            reload_config(watcher);
+        }
+        reclaim_retired_params(watcher);
+    }
+    return NULL;
+}
+#else
+/**
+ * @brief watcher thread main loop, waits for inotify events on the config file directory 
+ * (editors often save by renaming a new file over the old one)
+ * 
+*/
+static void* config_watch_thread(void* arg){
+    config_watcher* watcher = (config_watcher*) arg;
+    const char* separator = strrchr(watcher->configFileName, '/');
+    const char* name = separator ? separator + 1 : watcher->configFileName;
+    char buffer[4096] __attribute__((aligned(__alignof__(struct inotify_event))));
+    struct pollfd notification = {watcher->notifyFd, POLLIN, 0};
+    while(!atomic_load(&watcher->stopRequested)){
+        if(poll(&notification, 1, CONFIG_WATCH_POLL_PERIOD_MS) > 0){
+            unsigned changed = 0;
+            ssize_t length = read(watcher->notifyFd, buffer, sizeof(buffer));
+            for(char* event = buffer; length > 0 && event < buffer + length; ){
+                const struct inotify_event* notifyEvent = (const struct inotify_event*) event;
+                changed |= notifyEvent->len && !strcmp(notifyEvent->name, name);
+                event += sizeof(struct inotify_event) + notifyEvent->len;
+            }
+            if(changed){
+                usleep(CONFIG_WATCH_SETTLE_TIME_MS * 1000);
+                // events of the same save are covered by this reload
+                while(poll(&notification, 1, 0) > 0 && read(watcher->notifyFd, buffer, sizeof(buffer)) > 0);
+                reload_config(watcher);
+            }
+        }
+        reclaim_retired_params(watcher);
+    }
+    return NULL;
+}
+#endif
+
+/**
+ * @brief initialize config watcher (config_watcher) holding initialParams, no file is watched yet
+ * 
+*/
+void init_config_watcher(config_watcher* watcher, dsp_params* initialParams){
+    atomic_init(&watcher->currentParams, initialParams);
+    atomic_init(&watcher->hazardParams, NULL);
+    atomic_init(&watcher->stopRequested, 0);
+    watcher->retiredParams = NULL;
+    watcher->generation = initialParams->generation;
+    watcher->activeConfig = NULL;
+    watcher->configFileName[0] = '\0';
+    watcher->notifyFd = -1;
+    watcher->threadStarted = 0;
+}
+
+/**
+ * @brief start watching configFileName for changes, activeConfig holds the settings 
+ * the running instance was started with. Returns 0 on success
+ * 
+*/
+int start_config_watcher(config_watcher* watcher, const char* configFileName, const amt_config* activeConfig){
+    watcher->activeConfig = activeConfig;
+    strncpy(watcher->configFileName, configFileName, MAX_CHAR_LENGTH - 1);
+    watcher->configFileName[MAX_CHAR_LENGTH - 1] = '\0';
+#ifndef PC_TEST
+    char directory[MAX_CHAR_LENGTH] = ".";
+    const char* separator = strrchr(watcher->configFileName, '/');
+    if(separator){
+        size_t length = (size_t)(separator - watcher->configFileName);
+        memcpy(directory, watcher->configFileName, length ? length : 1);
+        directory[length ? length : 1] = '\0';
+    }
+    watcher->notifyFd = inotify_init1(IN_CLOEXEC);
+    if(watcher->notifyFd < 0){
+        return -1;
+    }
+    if(inotify_add_watch(watcher->notifyFd, directory, IN_CLOSE_WRITE | IN_MOVED_TO) < 0){
+        close(watcher->notifyFd);
+        watcher->notifyFd = -1;
+        return -1;
+    }
+#endif
+    if(pthread_create(&watcher->thread, NULL, config_watch_thread, watcher)){
+    #ifndef PC_TEST
+        close(watcher->notifyFd);
+        watcher->notifyFd = -1;
+    #endif
+        return -1;
+    }
+    watcher->threadStarted = 1;
+    return 0;
+}
+
+/**
+ * @brief stop watching and free config watcher (config_watcher), the audio thread must be stopped
+ * 
+*/
+void fini_config_watcher(config_watcher* watcher){
+    if(watcher->threadStarted){
+        atomic_store(&watcher->stopRequested, 1);
+        pthread_join(watcher->thread, NULL);
+        watcher->threadStarted = 0;
+    }
+#ifndef PC_TEST
+    if(watcher->notifyFd >= 0){
+        close(watcher->notifyFd);
+        watcher->notifyFd = -1;
+    }
+#endif
+    while(watcher->retiredParams){
+        dsp_params* params = watcher->retiredParams;
+        watcher->retiredParams = params->nextRetired;
+        free_dsp_params(params);
+    }
+    free_dsp_params(atomic_exchange(&watcher->currentParams, NULL));
+}
+
+/**
+ * @brief get the current processing parameters (audio thread side), valid until release_dsp_params
+ * 
+*/
+const dsp_params* acquire_dsp_params(config_watcher* watcher){
+    dsp_params* params = atomic_load(&watcher->currentParams);
+    // the watcher may retire params between the load and the hazard store, check again
+    while(1){
+        atomic_store(&watcher->hazardParams, params);
+        dsp_params* current = atomic_load(&watcher->currentParams);
+        if(current == params){
+            return params;
+        }
+        params = current;
+    }
+}
+
+/**
+ * @brief end the use of the parameters returned by acquire_dsp_params (audio thread side)
+ * 
+*/
+void release_dsp_params(config_watcher* watcher){
+    atomic_store(&watcher->hazardParams, NULL);
+}
@@ -0,0 +1,104 @@
+/*
+--------------------------------------------------------------------------
+* Acoustic monitoring tool for Raspberry Pi based on miniaudio framework *
+*                                                                        *
+* Kaue Werner, 2024                                                      *
+--------------------------------------------------------------------------
+*/
+/**
+ * @file config_watch.h
+ * @author Kaue Werner
+ * @date 10 Mar 2024
+ * @brief Header with the amt.config watcher (hot reload of processing parameters) used in AMT
+ * @version 0.1.0
+*/
+#ifndef CONFIG_WATCH_H
+#define CONFIG_WATCH_H
+#include "../config_defines.h"
+#include "../tools/tools.h"
+#include <stdatomic.h>
+#include <pthread.h>
+
+/**
+ * @brief Processing parameters that can be changed while the device is running
+ * Built off the audio thread and never modified after being published. 
+ * filterCoeffs holds NUMBER_OF_BIQUAD_COEFFICIENTS per stage (HPF stages 
+ * first), NULL when the filters of the running chain are kept.
+*/
+typedef struct dsp_params {
+    unsigned long generation;
+    float micGainFactor;
+    float recordingThresholddBFS;
+    float recordingReleasedBFS;
+    float noiseFloorMargin;
+    float triggerBandRatio;
+    unsigned numberOfFilterStages;
+    double* filterCoeffs;
+    struct dsp_params* nextRetired;
+} dsp_params;
+
+/**
+ * @brief amt.config watcher data struct
+ * The audio thread reads currentParams through acquire/release_dsp_params, 
+ * which publish the pointer in use as a hazard pointer. The watcher thread 
+ * swaps in new parameters and frees retired ones once they are no longer 
+ * the hazard pointer, so the audio thread never waits nor frees memory.
+*/
+typedef struct {
+    _Atomic(dsp_params*) currentParams;
+    _Atomic(dsp_params*) hazardParams;
+    dsp_params* retiredParams;
+    unsigned long generation;
+    const amt_config* activeConfig;
+    char configFileName[MAX_CHAR_LENGTH];
+    int notifyFd;
+    pthread_t thread;
+    atomic_int stopRequested;
+    unsigned threadStarted:1;
+} config_watcher;
+
+/**
+ * @brief build processing parameters from a configuration, filters are designed at 
+ * sampleRate unless keepFilters is set. Returns NULL on allocation failure
+ * 
+*/
+dsp_params* build_dsp_params(const amt_config* config, double sampleRate, unsigned keepFilters);
+
+/**
+ * @brief free processing parameters (dsp_params)
+ * 
+*/
+void free_dsp_params(dsp_params* params);
+
+/**
+ * @brief initialize config watcher (config_watcher) holding initialParams, no file is watched yet
+ * 
+*/
+void init_config_watcher(config_watcher* watcher, dsp_params* initialParams);
+
+/**
+ * @brief start watching configFileName for changes, activeConfig holds the settings 
+ * the running instance was started with. Returns 0 on success
+ * 
+*/
+int start_config_watcher(config_watcher* watcher, const char* configFileName, const amt_config* activeConfig);
+
+/**
+ * @brief stop watching and free config watcher (config_watcher), the audio thread must be stopped
+ * 
+*/
+void fini_config_watcher(config_watcher* watcher);
+
+/**
+ * @brief get the current processing parameters (audio thread side), valid until release_dsp_params
+ * 
+*/
+const dsp_params* acquire_dsp_params(config_watcher* watcher);
+
+/**
+ * @brief end the use of the parameters returned by acquire_dsp_params (audio thread side)
+ * 
+*/
+void release_dsp_params(config_watcher* watcher);
+
+#endif // CONFIG_WATCH_H
@@ -15,7 +15,7 @@ apt-get -y update
 apt-get -y upgrade
 
 # # install packages
-apt install -y vim alsa-utils cpufrequtils libfftw3-dev python3-pip
+apt install -y vim alsa-utils cpufrequtils libfftw3-dev libfftw3-bin libflac-dev python3-pip
 
 # # copy sound configuration file to /etc/
 scp asound.conf /etc/
@@ -17,9 +17,27 @@
 #include "config_defines.h"
 #include "tools/tools.h"
 #include "audio_proc/audio_proc.h"
+#include "audio_proc/sos_filter.h"
+#include "audio_proc/fft_engine.h"
+#include "audio_proc/level_meter.h"
+#include "audio_proc/band_trigger.h"
+#include "audio_proc/decimator.h"
+#include "audio_proc/fixed_point.h"
+#include "audio_proc/noise_floor.h"
+#include "rec_writer/rec_writer.h"
+#include "rec_writer/wav_recovery.h"
+#include "rec_trigger/rec_trigger.h"
+#include "scheduler/scheduler.h"
+#include "analysis/analysis.h"
+#include "telemetry/telemetry.h"
+#include "config_watch/config_watch.h"
+#include "storage/storage.h"
+#include "simulation/sim_source.h"
 #include <sys/types.h>
 #include <sys/stat.h>
 #include <unistd.h>
+#include <time.h>
+#include <math.h>
 
 // struct used to create rec dir if non existent
 struct stat st = {0};
@@ -29,25 +47,47 @@ ma_result result;
 ma_device_config deviceConfig;
 ma_device device;
 ma_encoder_config encoderConfig;
-ma_encoder encoder;
 
 // path to input configuration file where parameters are read
 const char * configFileName = CONFIG_FILE_PATH;
 
-// temp output file name to be updated for each recording
-char tmpOutputFileName[MAX_CHAR_LENGTH];
+// output paths of recordings, logs and analysis files, a simulation writes them below its own root directory
+char recordingDir[MAX_CHAR_LENGTH] = OUTPUT_WAV_FILE_DIR;
+char logFilePath[MAX_CHAR_LENGTH] = LOG_FILE_PATH;
+char bandLevelFilePath[MAX_CHAR_LENGTH] = BAND_LEVEL_FILE_PATH;
+char acousticIndexFilePath[MAX_CHAR_LENGTH] = ACOUSTIC_INDEX_FILE_PATH;
+char simulationConfigFileName[MAX_CHAR_LENGTH];
 
 // current date to be updated while running
 char currentDate[MAX_CHAR_LENGTH];
 
-// log file to write recording log
-FILE *logFile;
+// background writer owning the encoder and log file (file I/O is kept off the audio thread)
+rec_writer* recWriter;
+
+// background analysis worker computing continuous levels of every processed frame
+analysis_worker* analysisWorker;
+// recordings index, quota and free space management
+storage_manager* storage;
+
+// processing parameters reloaded from amt.config while running, and the generation applied by the audio thread
+config_watcher* configWatcher;
+unsigned long appliedParamsGeneration = 0;
+
+// callback timing and buffer statistics, NULL when telemetry is disabled
+amt_telemetry* telemetry;
+
+// synthetic source replacing the capture device in a simulation (amt --simulate), NULL otherwise
+sim_source* simulationSource;
+// end of the simulated period, number of simulated capture frames and of frames skipped in quiet spans
+time_t simulationEnd;
+ma_uint64 simulatedFrameCount = 0;
+ma_uint64 skippedFrameCount = 0;
+// capture frames skipped in quiet spans that do not add up to one decimated frame yet
+ma_uint64 skippedFrameRemainder = 0;
 
 // structure with recording flags used to recording start/stop management
 typedef struct {
-    unsigned initialized:1;
     unsigned ongoing:1;
-    unsigned filledDataBeforeThreshold:1;
 } recording_flags;
 
 // structure with flags used for audio IO management
@@ -55,21 +95,44 @@ typedef struct {
     unsigned initialized:1;
     unsigned ongoing:1;
     unsigned finished:1;
+    unsigned replay:1;
+    unsigned continuous:1;
 } audio_io_flags;
 
 // global recording flag struct pointer
 recording_flags *recFlags;
 
 // global recording frame counter
-unsigned recCounter = 0;
+ma_uint64 recCounter = 0;
+// frames left in the pause between recordings when the device keeps running
+ma_uint64 pauseCounter = 0;
 
-// recording buffer to store samples before starting threshold is reached
-float* recordingBufferBeforeThreshold;
+// stream clock (start time and number of processed frames) used to timestamp recordings
+struct timeval streamStartTime;
+ma_uint64 processedFrameCount = 0;
 
-// pointer to High Pass Filter
+// circular recording buffer to store samples before starting threshold is reached
+preroll_buffer* recordingBufferBeforeThreshold;
+
+// threshold recording state machine (attack/release, hold time and maximum file length)
+rec_trigger* recTrigger;
+
+// decimator from the capture to the processing sample rate, NULL when the input is not decimated
+decimator* inputDecimator;
+// pointer to High Pass Filter stages
 biquad_filter_data* hpf; 
-// pointer to Low Pass Filter
+// pointer to Low Pass Filter stages
 biquad_filter_data* lpf; 
+// cascade of all filter stages processed in the callback
+sos_filter* filterChain;
+// same cascade in Q31, used instead of filterChain by the fixed-point path
+sos_filter_q31* fixedFilterChain;
+// frequency/time weighted level used by the threshold trigger
+level_meter* triggerLevelMeter;
+// band-limited spectral energy trigger, used instead of the level meter when enabled
+band_trigger* bandTrigger;
+// background level (e.g. L90) the trigger thresholds follow when the adaptive threshold is enabled
+noise_floor* triggerNoiseFloor;
 
 // global audio IO flag struct pointer
 audio_io_flags* audioIoFlags;
@@ -77,148 +140,395 @@ audio_io_flags* audioIoFlags;
 // global configuration struct
 amt_config* amtConfig;
 
-// Specific callback function format to be used with miniaudio as default IO framework
-void data_callback(ma_device* pDevice, void* pOutput, const void* pInput, ma_uint32 frameCount)
+// Timestamp of frame frameOffset of the current buffer from the stream position (sample accurate between files),
+// negative offsets reach back into earlier buffers (e.g. the pre-roll)
+void get_stream_timestamp(struct timeval* timestamp, ma_int64 frameOffset){
+    ma_int64 elapsedMicroseconds = (ma_int64)floor(((double)processedFrameCount + (double)frameOffset) * 1e6 / amtConfig->processingSampleRate) + streamStartTime.tv_usec;
+    ma_int64 elapsedSeconds = (elapsedMicroseconds >= 0) ? elapsedMicroseconds / 1000000 : -((999999 - elapsedMicroseconds) / 1000000);
+    timestamp->tv_sec = streamStartTime.tv_sec + (time_t)elapsedSeconds;
+    timestamp->tv_usec = (long)(elapsedMicroseconds - elapsedSeconds * 1000000);
+}
+
+// Apply reloaded parameters to the processing state owned by the audio thread, filter states are kept
+void apply_dsp_params(const dsp_params* params){
+    if(filterChain && params->filterCoeffs && params->numberOfFilterStages == filterChain->numberOfStages){
+        for(unsigned n = 0; n < params->numberOfFilterStages; n++){
+            set_sos_filter_stage(filterChain, n, params->filterCoeffs + n * NUMBER_OF_BIQUAD_COEFFICIENTS);
+        }
+    }
+    if(fixedFilterChain && params->filterCoeffs && params->numberOfFilterStages == fixedFilterChain->numberOfStages){
+        for(unsigned n = 0; n < params->numberOfFilterStages; n++){
+            set_sos_filter_q31_stage(fixedFilterChain, n, params->filterCoeffs + n * NUMBER_OF_BIQUAD_COEFFICIENTS);
+        }
+    }
+    if(bandTrigger){
+        bandTrigger->thresholdIndB = params->recordingThresholddBFS;
+        bandTrigger->ratioIndB = params->triggerBandRatio;
+    }
+    appliedParamsGeneration = params->generation;
+}
+
+// Gain, filtering, threshold and recording of one chunk of at most NUMBER_OF_CALLBACK_SAMPLES frames,
+// the time spent in each stage is added to stageNanoseconds unless it is NULL
+void process_input_chunk(const void* input, ma_uint32 frameCount, const dsp_params* params, unsigned long long* stageNanoseconds)
 {
-    // copy input to filter buffer and apply mic gain
+    struct timeval timestamp;
+    unsigned long long stageStart = stageNanoseconds ? get_telemetry_time() : 0;
+
+    // mic gain, decimation and HPF/LPF cascade, the float path reads the capture buffer directly and 
+    // accumulates the energy of the filtered samples on the way out for the block RMS trigger
     float filteredInput[NUMBER_OF_CALLBACK_SAMPLES];
-    for(unsigned n = 0; n < NUMBER_OF_CALLBACK_SAMPLES; n++){  	    
-        filteredInput[n] = ((float *) pInput)[n];
-        filteredInput[n] *= amtConfig->micGainFactor;
+    int32_t fixedInput[NUMBER_OF_CALLBACK_SAMPLES];
+    float sumOfSquares = 0.0f;
+    if(amtConfig->enableFixedPointProcessing){
+        apply_gain_q31((const int32_t*) input, fixedInput, frameCount, compute_gain_q24(params->micGainFactor));
+        add_telemetry_stage_time(stageNanoseconds, TELEMETRY_STAGE_GAIN, &stageStart);
+        if(fixedFilterChain){
+            process_sos_filter_q31(fixedFilterChain, fixedInput, (unsigned) frameCount);
+        }
+        // trigger levels (other than block RMS), analysis and recording work on float samples
+        convert_q31_to_float(fixedInput, filteredInput, (unsigned) frameCount);
     }
-    // apply HPF to buffer data
-    if(hpf){
-        process_filter(filteredInput, (unsigned) frameCount, 
-                     hpf->previousInput, hpf->previousOutput, hpf->coeffs);
+    else if(inputDecimator){
+        apply_gain((const float*) input, filteredInput, (unsigned) frameCount, params->micGainFactor);
+        add_telemetry_stage_time(stageNanoseconds, TELEMETRY_STAGE_GAIN, &stageStart);
+        // decimate to the processing sample rate, everything downstream runs on fewer frames
+        frameCount = process_decimator(inputDecimator, filteredInput, filteredInput, frameCount);
+        add_telemetry_stage_time(stageNanoseconds, TELEMETRY_STAGE_DECIMATION, &stageStart);
+        sumOfSquares = filterChain ? process_sos_filter_gain(filterChain, filteredInput, filteredInput, (unsigned) frameCount, 1.0f) : 
+                                     apply_gain(filteredInput, filteredInput, (unsigned) frameCount, 1.0f);
     }
-    // apply LPF to buffer data
-    if(lpf){
-        process_filter(filteredInput, (unsigned) frameCount, 
-                     lpf->previousInput, lpf->previousOutput, lpf->coeffs);
+    else if(filterChain){
+        // gain is folded into the first stage (timed as filtering)
+        sumOfSquares = process_sos_filter_gain(filterChain, (const float*) input, filteredInput, (unsigned) frameCount, params->micGainFactor);
+    }
+    else {
+        sumOfSquares = apply_gain((const float*) input, filteredInput, (unsigned) frameCount, params->micGainFactor);
+        add_telemetry_stage_time(stageNanoseconds, TELEMETRY_STAGE_GAIN, &stageStart);
     }
+    add_telemetry_stage_time(stageNanoseconds, TELEMETRY_STAGE_FILTER, &stageStart);
+    // continuous analysis runs whether a recording is ongoing or not
+    if(analysisWorker){
+        analysis_push_frames(analysisWorker, filteredInput, frameCount);
+    }
+    add_telemetry_stage_time(stageNanoseconds, TELEMETRY_STAGE_ANALYSIS, &stageStart);
 
     // check if threshold-based recording is enabled, if not got to rec hours method
     if(amtConfig->enableThresholdRecording){
-        unsigned recTimeInSamplesBeforeThreshold = (unsigned)(amtConfig->recordedTimeBeforeThreshold * amtConfig->sampleRate);
         if(!recFlags->ongoing){
-        // update recording buffer before reaching threshold
-        for(unsigned n = 0; n < recTimeInSamplesBeforeThreshold; n++){
-            if(n < (recTimeInSamplesBeforeThreshold - NUMBER_OF_CALLBACK_SAMPLES)){
-                recordingBufferBeforeThreshold[n] = recordingBufferBeforeThreshold[n + NUMBER_OF_CALLBACK_SAMPLES];
+            // update recording buffer before reaching threshold
+            preroll_buffer_write(recordingBufferBeforeThreshold, filteredInput, frameCount);
+        }
+        // thresholds follow the noise floor, the configured ones are the lower bound (hysteresis is kept)
+        float attackThreshold = params->recordingThresholddBFS;
+        float releaseThreshold = params->recordingReleasedBFS;
+        if(triggerNoiseFloor && triggerNoiseFloor->floorIndB + params->noiseFloorMargin > attackThreshold){
+            releaseThreshold += triggerNoiseFloor->floorIndB + params->noiseFloorMargin - attackThreshold;
+            attackThreshold = triggerNoiseFloor->floorIndB + params->noiseFloorMargin;
+        }
+        // update band trigger or weighted level (e.g. LAF) with the current buffer
+        float currentLevel;
+        unsigned attackReached, releaseReached;
+        if(bandTrigger){
+            bandTrigger->thresholdIndB = attackThreshold;
+            attackReached = process_band_trigger(bandTrigger, filteredInput, frameCount, &currentLevel);
+            releaseReached = attackReached || currentLevel >= releaseThreshold;
+        }
+        else {
+            // the unweighted block RMS comes from the energy of the filter pass (accumulated in 64 bits 
+            // on the Q31 samples in the fixed-point path), weighted levels need their own pass
+            if(!is_level_meter_unweighted(triggerLevelMeter)){
+                currentLevel = process_level_meter(triggerLevelMeter, filteredInput, frameCount);
+            }
+            else if(amtConfig->enableFixedPointProcessing){
+                currentLevel = compute_rms_q31(fixedInput, frameCount);
             }
             else {
-                recordingBufferBeforeThreshold[n] = filteredInput[n - (recTimeInSamplesBeforeThreshold - NUMBER_OF_CALLBACK_SAMPLES)];
-            } 
+                currentLevel = update_level_meter_energy(triggerLevelMeter, sumOfSquares, frameCount);
+            }
+            attackReached = currentLevel >= attackThreshold;
+            releaseReached = currentLevel >= releaseThreshold;
         }
+        if(triggerNoiseFloor){
+            update_noise_floor(triggerNoiseFloor, currentLevel, frameCount);
         }
-        // compute dB RMS of the current buffer
-        float currentRMS = compute_rms(filteredInput, frameCount, 1);
 
-        if(currentRMS >= amtConfig->recordingThresholddBFS && !recFlags->ongoing){
-            recFlags->initialized = 1;
+        // pre-roll from oldest to newest sample, it already holds the current buffer
+        void *firstSpan = NULL, *secondSpan = NULL;
+        size_t firstSpanFrames = 0, secondSpanFrames = 0;
+        size_t prerollFrames = 0;
+        if(!recFlags->ongoing){
+            preroll_buffer_get_spans(recordingBufferBeforeThreshold, &firstSpan, &firstSpanFrames, &secondSpan, &secondSpanFrames);
+            prerollFrames = (firstSpanFrames + secondSpanFrames > frameCount) ? firstSpanFrames + secondSpanFrames - frameCount : 0;
         }
 
-        if(recFlags->initialized){
-            update_output_file_name(tmpOutputFileName, MAX_CHAR_LENGTH);
-
-            if (ma_encoder_init_file(tmpOutputFileName, &encoderConfig, &encoder) != MA_SUCCESS) {
-                printf("Failed to initialize output file.\n");
-            }
-
-            recFlags->initialized = 0;
-            recFlags->ongoing = 1;
-            // open log file
-            char logFileName[MAX_CHAR_LENGTH] = LOG_FILE_PATH;
-            logFile = fopen(strcat(strcat(logFileName, currentDate), ".txt"), "a");
-        #ifdef DEBUG
-            printf("New recording started due to RMS level = %.2f...\n",currentRMS);
-        #endif
-            fprintf(logFile, "RMS level = %.2fdBFS\t", currentRMS);
-            fprintf(logFile, "%s", get_current_date_time());
-            
-        }
-
-        if(recFlags->ongoing){
-            if(!recFlags->filledDataBeforeThreshold){
-                ma_encoder_write_pcm_frames(&encoder, recordingBufferBeforeThreshold, recTimeInSamplesBeforeThreshold, NULL);
-                recFlags->filledDataBeforeThreshold = 1;
-            } else {
-                if(recCounter < ((int)(amtConfig->sampleRate * amtConfig->recordDuration * 60) - recTimeInSamplesBeforeThreshold)){
-                    ma_encoder_write_pcm_frames(&encoder, filteredInput, frameCount, NULL);
-                    recCounter += frameCount;
+        switch(update_rec_trigger(recTrigger, attackReached, releaseReached, frameCount, prerollFrames)){
+            case REC_TRIGGER_START:
+                recFlags->ongoing = 1;
+                // the file starts with the pre-roll, not with the triggering buffer
+                get_stream_timestamp(&timestamp, -(ma_int64)prerollFrames);
+                if(recWriter){
+                    rec_writer_open_file(recWriter, &timestamp, currentLevel, 1);
+                    if(firstSpanFrames + secondSpanFrames < frameCount){
+                        // pre-roll shorter than one buffer, the file starts with the whole triggering buffer
+                        rec_writer_push_frames(recWriter, filteredInput, frameCount);
+                    }
+                    else {
+                        rec_writer_push_frames(recWriter, firstSpan, firstSpanFrames);
+                        rec_writer_push_frames(recWriter, secondSpan, secondSpanFrames);
+                    }
                 }
-                else {
-                    recCounter = 0;
-                    recFlags->ongoing = 0;
-                    recFlags->filledDataBeforeThreshold = 0;
-                #ifdef DEBUG
-                    printf("...recording finished!\n");
-                #endif
-                    fclose(logFile);
-                    ma_encoder_uninit(&encoder);
+            #ifdef DEBUG
+                printf("New recording started due to %s level = %.2f (threshold %.2f)...\n", bandTrigger ? "Band" : get_level_meter_name(triggerLevelMeter), 
+                       currentLevel, attackThreshold);
+            #endif
+            break;
+            case REC_TRIGGER_SPLIT:
+                // maximum file length reached during an event, the next file starts exactly at this buffer
+                get_stream_timestamp(&timestamp, 0);
+                if(recWriter){
+                    rec_writer_open_file(recWriter, &timestamp, currentLevel, 1);
+                    rec_writer_push_frames(recWriter, filteredInput, frameCount);
                 }
-            }
+            #ifdef DEBUG
+                printf("...recording continued in a new file...\n");
+            #endif
+            break;
+            case REC_TRIGGER_STOP:
+                if(recWriter){
+                    rec_writer_push_frames(recWriter, filteredInput, frameCount);
+                    rec_writer_close_file(recWriter);
+                }
+                recFlags->ongoing = 0;
+                // pre-roll of the next recording must not reach back into this one
+                reset_preroll_buffer(recordingBufferBeforeThreshold);
+            #ifdef DEBUG
+                printf("...recording finished!\n");
+            #endif
+            break;
+            case REC_TRIGGER_NONE:
+            default:
+                if(recFlags->ongoing && recWriter){
+                    rec_writer_push_frames(recWriter, filteredInput, frameCount);
+                }
+            break;
         }
     } 
     else {
-        if(!recFlags->ongoing && !audioIoFlags->finished){
-            update_output_file_name(tmpOutputFileName, MAX_CHAR_LENGTH);
-        #ifdef DEBUG
-            printf("-> Updated rec output file name: %s\n", tmpOutputFileName);
-        #endif
-            if (ma_encoder_init_file(tmpOutputFileName, &encoderConfig, &encoder) != MA_SUCCESS) {
-                printf("Failed to initialize output file.\n");
+        // fixed length recordings, cut on exact frame boundaries so consecutive files are gapless
+        ma_uint64 recordingFrames = (ma_uint64)(amtConfig->processingSampleRate * amtConfig->recordDuration * 60);
+        ma_uint32 frameOffset = 0;
+        while(frameOffset < frameCount && recordingFrames && !audioIoFlags->finished){
+            if(!recFlags->ongoing){
+                // short pauses are counted here while the device keeps running
+                if(pauseCounter){
+                    ma_uint32 pauseFrames = (pauseCounter < frameCount - frameOffset) ? (ma_uint32) pauseCounter : frameCount - frameOffset;
+                    pauseCounter -= pauseFrames;
+                    frameOffset += pauseFrames;
+                    continue;
+                }
+                get_stream_timestamp(&timestamp, frameOffset);
+                if(recWriter){
+                    rec_writer_open_file(recWriter, &timestamp, 0.0f, 0);
+                }
+                recFlags->ongoing = 1;
+                recCounter = 0;
+            #ifdef DEBUG
+                printf("New recording started...\n");
+                printf("-> Rec duration: %.2f min\n", amtConfig->recordDuration);
+            #endif
             }
-            recFlags->ongoing = 1;
-            // open log file
-            char logFileName[MAX_CHAR_LENGTH] = LOG_FILE_PATH;
-            logFile = fopen(strcat(strcat(logFileName, currentDate), ".txt"), "a");
-        #ifdef DEBUG
-            printf("New recording started...\n");
-            printf("-> Rec duration: %.2f min\n", amtConfig->recordDuration);
-        #endif
-            fprintf(logFile, "Rec initialized at ");
-            fprintf(logFile, "%s", get_current_date_time());
-        }
 
-        if(recFlags->ongoing){
-            if(recCounter < (int)(amtConfig->sampleRate * amtConfig->recordDuration * 60)){
-                ma_encoder_write_pcm_frames(&encoder, filteredInput, frameCount, NULL);
-                recCounter += frameCount;
+            ma_uint32 recFrames = (recordingFrames - recCounter < frameCount - frameOffset) ? 
+                                  (ma_uint32)(recordingFrames - recCounter) : frameCount - frameOffset;
+            if(recWriter){
+                rec_writer_push_frames(recWriter, filteredInput + frameOffset, recFrames);
             }
-            else {
+            recCounter += recFrames;
+            frameOffset += recFrames;
+
+            if(recCounter >= recordingFrames){
                 recCounter = 0;
                 recFlags->ongoing = 0;
             #ifdef DEBUG
                 printf("...recording finished!\n");
             #endif
-                fclose(logFile);
-                ma_encoder_uninit(&encoder);
-                audioIoFlags->finished = 1;
+                if(recWriter){
+                    rec_writer_close_file(recWriter);
+                }
+                // replayed files are recorded back to back, without pause
+                if(!audioIoFlags->replay){
+                    if(audioIoFlags->continuous){
+                        pauseCounter = (ma_uint64)(amtConfig->processingSampleRate * amtConfig->sleepDuration * 60);
+                    }
+                    else {
+                        audioIoFlags->finished = 1;
+                    }
+                }
             }
         }
     }
+    processedFrameCount += frameCount;
+    add_telemetry_stage_time(stageNanoseconds, TELEMETRY_STAGE_RECORDING, &stageStart);
+}
+
+// Processing path shared by the audio callback and the file replay, any number of frames is handled in 
+// chunks of at most NUMBER_OF_CALLBACK_SAMPLES, input holds f32 samples, or s32 samples when fixed-point 
+// processing is enabled (4 bytes per sample either way)
+void process_input_frames(const void* input, ma_uint32 frameCount)
+{
+    // time spent in each telemetry stage over all chunks of the callback (replay is not timed)
+    unsigned long long stageNanoseconds[NUMBER_OF_TELEMETRY_STAGES] = {0};
+    unsigned timed = telemetry && !audioIoFlags->replay;
+    unsigned long long callbackStart = timed ? get_telemetry_time() : 0;
+
+    // pick up parameters published by the config watcher since the last buffer
+    const dsp_params* params = acquire_dsp_params(configWatcher);
+    if(params->generation != appliedParamsGeneration){
+        apply_dsp_params(params);
+    }
+    const unsigned char* frames = (const unsigned char*) input;
+    for(ma_uint32 offset = 0; offset < frameCount; offset += NUMBER_OF_CALLBACK_SAMPLES){
+        ma_uint32 chunkFrameCount = (frameCount - offset < NUMBER_OF_CALLBACK_SAMPLES) ? frameCount - offset : NUMBER_OF_CALLBACK_SAMPLES;
+        process_input_chunk(frames + (size_t) offset * NUMBER_OF_INPUT_CHANNELS * sizeof(float), chunkFrameCount, params, 
+                            timed ? stageNanoseconds : NULL);
+    }
+    release_dsp_params(configWatcher);
+    if(timed){
+        record_callback_telemetry(telemetry, callbackStart, stageNanoseconds, frameCount);
+    }
+}
+
+// Specific callback function format to be used with miniaudio as default IO framework
+void data_callback(ma_device* pDevice, void* pOutput, const void* pInput, ma_uint32 frameCount)
+{
+    process_input_frames(pInput, frameCount);
     (void)pOutput;
 }
 
-void init_audio_io(){
+// Init Butterworth filter of order 2*numberOfStages as an array of biquad stages
+biquad_filter_data* init_butterworth_filter_stages(unsigned filterType, double cutoffFrequency, unsigned numberOfStages){
+    biquad_filter_data* filter = malloc(numberOfStages * sizeof(biquad_filter_data));
+    double* qFactors = malloc(numberOfStages * sizeof(double));
+    compute_butterworth_q_factors(qFactors, numberOfStages);
+    for(unsigned n = 0; n < numberOfStages; n++){
+        filter[n].filterType = filterType;
+        filter[n].qFactor = qFactors[n];
+        filter[n].gain = 0.0;
+        filter[n].cutoffFrequency = cutoffFrequency;
+        filter[n].sampleRate = amtConfig->processingSampleRate;
+        init_filter(&filter[n]);
+    }
+    free(qFactors);
+    return filter;
+}
+
+void init_recording(){
     // init recording flags as zero
     recFlags = malloc(sizeof(recording_flags));
-    recFlags->initialized = 0;
     recFlags->ongoing = 0;
-    recFlags->filledDataBeforeThreshold = 0;
+    recCounter = 0;
+    pauseCounter = 0;
 
     if(amtConfig->enableThresholdRecording){
+        // init trigger state machine, files of long events are split after recordDuration
+        recTrigger = malloc(sizeof(rec_trigger));
+        init_rec_trigger(recTrigger, (size_t)(amtConfig->recordingHoldTime * amtConfig->processingSampleRate), 
+                         (size_t)(amtConfig->recordDuration * 60 * amtConfig->processingSampleRate));
+
         // init past samples recording buffer
-        recordingBufferBeforeThreshold = calloc((int)(amtConfig->recordedTimeBeforeThreshold * amtConfig->sampleRate), sizeof(float));
+        recordingBufferBeforeThreshold = malloc(sizeof(preroll_buffer));
+        if(init_preroll_buffer(recordingBufferBeforeThreshold, (size_t)(amtConfig->recordedTimeBeforeThreshold * amtConfig->processingSampleRate), 
+                               NUMBER_OF_INPUT_CHANNELS * sizeof(float))){
+            printf("Failed to initialize pre-threshold recording buffer.\n");
+        }
+    }
+
+    // init miniaudio encoder config, integer formats are converted (and dithered) by the writer
+    ma_format outputFormat = (amtConfig->outputBitDepth == 16) ? ma_format_s16 : 
+                             ((amtConfig->outputBitDepth == 24) ? ma_format_s24 : ma_format_f32);
+    encoderConfig = ma_encoder_config_init(ma_encoding_format_wav, outputFormat, NUMBER_OF_INPUT_CHANNELS, (ma_uint32) amtConfig->processingSampleRate);
+
+    // init background writer, its buffer must hold at least the pre-threshold samples plus one callback
+    size_t writerCapacityInFrames = (size_t)(amtConfig->writerBufferCapacity * amtConfig->processingSampleRate);
+    if(amtConfig->enableThresholdRecording){
+        size_t minCapacityInFrames = (size_t)(amtConfig->recordedTimeBeforeThreshold * amtConfig->processingSampleRate) + 2 * NUMBER_OF_CALLBACK_SAMPLES;
+        if(writerCapacityInFrames < minCapacityInFrames){
+            writerCapacityInFrames = minCapacityInFrames;
+        }
+    }
+    if(amtConfig->enableAudioRecording){
+        rec_output_config outputConfig;
+        outputConfig.fileFormat = amtConfig->outputFileFormat;
+        outputConfig.bitDepth = amtConfig->outputBitDepth;
+        outputConfig.compressionLevel = amtConfig->flacCompressionLevel;
+        outputConfig.enableDither = amtConfig->enableDither;
+        outputConfig.levelName = bandTrigger ? "Band" : (triggerLevelMeter ? get_level_meter_name(triggerLevelMeter) : "RMS");
+        outputConfig.storage = storage;
+        outputConfig.enableSummary = amtConfig->enableRecordingSummary;
+        outputConfig.syncInterval = amtConfig->recordingSyncInterval;
+        outputConfig.outputDirectory = recordingDir;
+        outputConfig.logFilePath = logFilePath;
+        // the virtual clock in a simulation, so simulated recordings are repeatable
+        outputConfig.ditherSeed = (uint32_t) get_current_time();
+        recWriter = malloc(sizeof(rec_writer));
+        if(init_rec_writer(recWriter, &encoderConfig, &outputConfig, writerCapacityInFrames, 
+                           (size_t)(writerCapacityInFrames * amtConfig->writerBufferHighWaterMark / 100.0f))){
+            printf("Failed to initialize recording writer.\n");
+            free(recWriter);
+            recWriter = NULL;
+        }
+    }
+
+    // init background analysis worker, timestamps follow the stream clock from its first frame
+    if(amtConfig->bandLevelResolution || amtConfig->acousticIndexPeriod > 0.0f){
+        analysis_config analysisConfig;
+        analysisConfig.bandLevelResolution = amtConfig->bandLevelResolution;
+        analysisConfig.bandLevelPeriod = amtConfig->bandLevelPeriod;
+        analysisConfig.acousticIndexPeriod = amtConfig->acousticIndexPeriod;
+        analysisConfig.adiThresholddBFS = amtConfig->adiThresholddBFS;
+        analysisConfig.bandLevelFilePath = bandLevelFilePath;
+        analysisConfig.acousticIndexFilePath = acousticIndexFilePath;
+        size_t analysisCapacityInFrames = (size_t)(amtConfig->writerBufferCapacity * amtConfig->processingSampleRate);
+        struct timeval startTime;
+        get_stream_timestamp(&startTime, 0);
+        analysisWorker = malloc(sizeof(analysis_worker));
+        if(init_analysis_worker(analysisWorker, &analysisConfig, amtConfig->processingSampleRate, &startTime, analysisCapacityInFrames,
+                                (size_t)(analysisCapacityInFrames * amtConfig->writerBufferHighWaterMark / 100.0f))){
+            printf("Failed to initialize analysis worker.\n");
+            free(analysisWorker);
+            analysisWorker = NULL;
+        }
+    }
+
+    // report the buffers of this recording session in the stats file
+    if(telemetry){
+        set_telemetry_sources(telemetry, recWriter ? &recWriter->frames : NULL, analysisWorker ? &analysisWorker->frames : NULL,
+                              recWriter ? &recWriter->totalEncodeNanoseconds : NULL);
+    }
+}
+
+void init_audio_io(){
+    // restart the stream clock, timestamps of later frames follow from the frame count
+    get_current_timeval(&streamStartTime);
+    processedFrameCount = 0;
+    skippedFrameRemainder = 0;
+    // the gap to the last callback of a previous device session is not an xrun
+    if(telemetry){
+        telemetry->lastCallbackStart = 0;
     }
 
-    // init miniaudio encoder config
-    encoderConfig = ma_encoder_config_init(ma_encoding_format_wav, ma_format_f32, NUMBER_OF_INPUT_CHANNELS, (ma_uint32) amtConfig->sampleRate);
+    // init recording flags, buffers and writer
+    init_recording();
+
+    // a simulation feeds the processing path itself (run_simulated_capture)
+    if(simulationSource){
+        return;
+    }
 
     // init miniaudio device config
     deviceConfig = ma_device_config_init(ma_device_type_capture);
-    deviceConfig.capture.format   = ma_format_f32;   
+    deviceConfig.capture.format   = amtConfig->enableFixedPointProcessing ? ma_format_s32 : ma_format_f32;
     deviceConfig.capture.channels = NUMBER_OF_INPUT_CHANNELS;
     deviceConfig.sampleRate       = (ma_uint32) amtConfig->sampleRate;
     deviceConfig.periodSizeInFrames = NUMBER_OF_CALLBACK_SAMPLES;
@@ -239,15 +549,342 @@ void init_audio_io(){
 
 }
 
-void fini_audio_io(){
-    // uninit miniaudio device
-    ma_device_uninit(&device);
+void fini_recording(){
+    // stop reporting buffers that are about to be freed
+    if(telemetry){
+        set_telemetry_sources(telemetry, NULL, NULL, NULL);
+    }
+
+    // write pending frames and stop background writer
+    if(recWriter){
+        fini_rec_writer(recWriter);
+        free(recWriter);
+        recWriter = NULL;
+    }
+
+    // analyze pending frames and stop background analysis
+    if(analysisWorker){
+        fini_analysis_worker(analysisWorker);
+        free(analysisWorker);
+        analysisWorker = NULL;
+    }
 
     // free recording flags
     free(recFlags);
 
+    // free trigger state machine
+    if(recTrigger){
+        free(recTrigger);
+        recTrigger = NULL;
+    }
+
     // free past samples buffer
-    free(recordingBufferBeforeThreshold);
+    if(recordingBufferBeforeThreshold){
+        free_preroll_buffer(recordingBufferBeforeThreshold);
+        free(recordingBufferBeforeThreshold);
+        recordingBufferBeforeThreshold = NULL;
+    }
+}
+
+void fini_audio_io(){
+    // uninit miniaudio device
+    if(!simulationSource){
+        ma_device_uninit(&device);
+    }
+
+    // write pending frames and free recording flags and buffers
+    fini_recording();
+}
+
+// End the ongoing recording and clear filter, trigger and pre-roll states, the next frame is processed as a new stream
+void reset_processing(){
+    if(recFlags->ongoing && recWriter){
+        rec_writer_close_file(recWriter);
+    }
+    recFlags->ongoing = 0;
+    recCounter = 0;
+    if(recTrigger){
+        reset_rec_trigger(recTrigger);
+    }
+    if(inputDecimator){
+        reset_decimator(inputDecimator);
+    }
+    if(filterChain){
+        reset_sos_filter(filterChain);
+    }
+    if(fixedFilterChain){
+        reset_sos_filter_q31(fixedFilterChain);
+    }
+    if(recordingBufferBeforeThreshold){
+        reset_preroll_buffer(recordingBufferBeforeThreshold);
+    }
+    if(triggerLevelMeter){
+        reset_level_meter(triggerLevelMeter);
+    }
+    if(bandTrigger){
+        reset_band_trigger(bandTrigger);
+    }
+    if(triggerNoiseFloor){
+        reset_noise_floor(triggerNoiseFloor);
+    }
+}
+
+// Offline replay: decode WAV files and feed them through the capture processing path as fast as possible
+void run_file_replay(unsigned numberOfFiles, char** fileNames){
+    ma_decoder decoder;
+    ma_decoder_config decoderConfig = ma_decoder_config_init(amtConfig->enableFixedPointProcessing ? ma_format_s32 : ma_format_f32, 
+                                                             NUMBER_OF_INPUT_CHANNELS, (ma_uint32) amtConfig->sampleRate);
+    // f32 or s32 samples, both 4 bytes wide
+    float inputBuffer[NUMBER_OF_CALLBACK_SAMPLES * NUMBER_OF_INPUT_CHANNELS];
+    size_t recTimeInSamplesBeforeThreshold = amtConfig->enableThresholdRecording ? 
+                                             (size_t)(amtConfig->recordedTimeBeforeThreshold * amtConfig->processingSampleRate) : 0;
+    struct timespec replayStart, fileStart, now;
+    ma_uint64 totalFrameCount = 0;
+
+    audioIoFlags->replay = 1;
+    gettimeofday(&streamStartTime, NULL);
+    processedFrameCount = 0;
+    init_recording();
+    clock_gettime(CLOCK_MONOTONIC, &replayStart);
+
+    for(unsigned f = 0; f < numberOfFiles; f++){
+        if(ma_decoder_init_file(fileNames[f], &decoderConfig, &decoder) != MA_SUCCESS){
+            printf("Failed to open replay file %s.\n", fileNames[f]);
+            continue;
+        }
+        clock_gettime(CLOCK_MONOTONIC, &fileStart);
+        ma_uint64 fileFrameCount = 0;
+        ma_uint64 framesRead;
+        while(ma_decoder_read_pcm_frames(&decoder, inputBuffer, NUMBER_OF_CALLBACK_SAMPLES, &framesRead) == MA_SUCCESS && framesRead > 0){
+            // the writer can not keep up with an unthrottled producer, wait instead of dropping frames
+            if(recWriter){
+                rec_writer_wait_for_space(recWriter, recTimeInSamplesBeforeThreshold + framesRead);
+            }
+            if(analysisWorker){
+                analysis_wait_for_space(analysisWorker, framesRead);
+            }
+            process_input_frames(inputBuffer, (ma_uint32) framesRead);
+            fileFrameCount += framesRead;
+        }
+        ma_decoder_uninit(&decoder);
+
+        // each replayed file ends its ongoing recording and starts from clean filter states
+        reset_processing();
+
+        clock_gettime(CLOCK_MONOTONIC, &now);
+        double fileSeconds = (now.tv_sec - fileStart.tv_sec) + (now.tv_nsec - fileStart.tv_nsec) * 1e-9;
+        printf("%s: %llu samples in %.3f s (%.0f samples/s, realtime factor %.1f)\n", fileNames[f], 
+               (unsigned long long) fileFrameCount, fileSeconds, fileFrameCount / fileSeconds, 
+               (fileFrameCount / amtConfig->sampleRate) / fileSeconds);
+        totalFrameCount += fileFrameCount;
+    }
+
+    // wait for the writer and analysis to finish before measuring the total throughput
+    fini_recording();
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    double totalSeconds = (now.tv_sec - replayStart.tv_sec) + (now.tv_nsec - replayStart.tv_nsec) * 1e-9;
+    printf("Replay total: %llu samples in %.3f s (%.0f samples/s, realtime factor %.1f)\n", 
+           (unsigned long long) totalFrameCount, totalSeconds, totalFrameCount / totalSeconds, 
+           (totalFrameCount / amtConfig->sampleRate) / totalSeconds);
+    audioIoFlags->replay = 0;
+}
+
+// Simulation: synthetic frames are fed through the capture processing path until the virtual clock reaches 
+// deadline, or until a duty cycle recording is finished and the device would be stopped
+void run_simulated_capture(const struct timeval* deadline){
+    // f32 or s32 samples, both 4 bytes wide
+    float inputBuffer[NUMBER_OF_CALLBACK_SAMPLES * NUMBER_OF_INPUT_CHANNELS];
+    size_t recTimeInSamplesBeforeThreshold = amtConfig->enableThresholdRecording ? 
+                                             (size_t)(amtConfig->recordedTimeBeforeThreshold * amtConfig->processingSampleRate) : 0;
+    // most decimated frames one buffer can give, the count varies with the decimator phase
+    size_t processedFramesPerBuffer = (NUMBER_OF_CALLBACK_SAMPLES + amtConfig->decimationFactor - 1) / amtConfig->decimationFactor;
+    // quiet spans can only be skipped when no output depends on them: no analysis and no noise floor history
+    unsigned skipQuietSpans = recTrigger && !analysisWorker && !triggerNoiseFloor;
+    struct timeval now;
+    get_current_timeval(&now);
+    while(timercmp(&now, deadline, <) && !audioIoFlags->finished){
+        // nothing scripted and the trigger idle: jump to SIM_SKIP_SETTLE_TIME plus the pre-roll before the next
+        // scripted signal (or the deadline) and restart from clean states, as the silent frames would not trigger
+        if(skipQuietSpans && recTrigger->state == REC_TRIGGER_IDLE){
+            double quietTime = get_sim_source_quiet_time(simulationSource, &now) - SIM_SKIP_SETTLE_TIME - amtConfig->recordedTimeBeforeThreshold;
+            double timeToDeadline = (double)(deadline->tv_sec - now.tv_sec) + (deadline->tv_usec - now.tv_usec) * 1e-6;
+            if(quietTime > timeToDeadline){
+                quietTime = timeToDeadline;
+            }
+            ma_uint64 skippedBuffers = (quietTime > 0.0) ? (ma_uint64)(quietTime * amtConfig->sampleRate / NUMBER_OF_CALLBACK_SAMPLES) : 0;
+            if(skippedBuffers){
+                // the stream clock counts decimated frames, the decimator output reaches phase capture frames ahead:
+                // the skipped capture frames are divided together with the frames short of one decimated frame, 
+                // the remainder is carried to the next skip so the clock does not drift
+                ma_uint64 captureFrames = processedFrameCount * amtConfig->decimationFactor + skippedFrameRemainder - 
+                                          (inputDecimator ? inputDecimator->phase : 0) + skippedBuffers * NUMBER_OF_CALLBACK_SAMPLES;
+                processedFrameCount = captureFrames / amtConfig->decimationFactor;
+                skippedFrameRemainder = captureFrames % amtConfig->decimationFactor;
+                skippedFrameCount += skippedBuffers * NUMBER_OF_CALLBACK_SAMPLES;
+                reset_processing();
+                get_stream_timestamp(&now, 0);
+                set_virtual_time(&now);
+                continue;
+            }
+        }
+        // no frame is dropped, the writer and analysis set the pace like in the file replay
+        if(recWriter){
+            rec_writer_wait_for_space(recWriter, recTimeInSamplesBeforeThreshold + processedFramesPerBuffer);
+        }
+        if(analysisWorker){
+            analysis_wait_for_space(analysisWorker, processedFramesPerBuffer);
+        }
+        generate_sim_source(simulationSource, &now, inputBuffer, NUMBER_OF_CALLBACK_SAMPLES);
+        if(amtConfig->enableFixedPointProcessing){
+            int32_t* fixedBuffer = (int32_t*) inputBuffer;
+            for(unsigned n = 0; n < NUMBER_OF_CALLBACK_SAMPLES * NUMBER_OF_INPUT_CHANNELS; n++){
+                double sample = (inputBuffer[n] < -1.0f) ? -1.0 : ((inputBuffer[n] > 1.0f) ? 1.0 : inputBuffer[n]);
+                fixedBuffer[n] = (int32_t) lrint(sample * 2147483647.0);
+            }
+        }
+        process_input_frames(inputBuffer, NUMBER_OF_CALLBACK_SAMPLES);
+        simulatedFrameCount += NUMBER_OF_CALLBACK_SAMPLES;
+        // the virtual clock follows the stream clock while capturing
+        get_stream_timestamp(&now, 0);
+        set_virtual_time(&now);
+    }
+}
+
+// Wait for a wall clock deadline, a simulation generates the frames of a running device instead of sleeping
+void wait_until_time(time_t deadline){
+    if(simulationSource && audioIoFlags->initialized){
+        struct timeval t = {deadline, 0};
+        run_simulated_capture(&t);
+    }
+    sleep_until_time(deadline);
+}
+
+// Poll period of the main loop while the device runs, a simulation generates the frames of the period instead
+void wait_for_poll_period(){
+    if(simulationSource){
+        struct timeval t;
+        get_current_timeval(&t);
+        struct timeval period = {0, WRITER_POLL_PERIOD_MS * 1000};
+        timeradd(&t, &period, &t);
+        run_simulated_capture(&t);
+        set_virtual_time(&t);
+        return;
+    }
+#ifdef PC_TEST
+    Sleep(WRITER_POLL_PERIOD_MS);
+#else
+    usleep(WRITER_POLL_PERIOD_MS * 1000);
+#endif
+}
+
+// Create a directory if non-existent
+void make_directory(const char* path){
+    if (stat(path, &st) == -1) {
+    #ifdef PC_TEST
+        mkdir(path);
+    #else
+        mkdir(path, 0777);
+    #endif
+    }
+}
+
+// Simulation output root: recordings, logs and analysis files are written below rootDir instead of the live paths,
+// amt.config is read from rootDir if present. Returns 0 on success
+int set_simulation_paths(const char* rootDir){
+    size_t length = strlen(rootDir);
+    // room for the file names appended to the root
+    if(!length || length > MAX_CHAR_LENGTH / 2){
+        return -1;
+    }
+    char root[MAX_CHAR_LENGTH];
+    snprintf(root, MAX_CHAR_LENGTH, "%s%s", rootDir, (rootDir[length - 1] == '/') ? "" : "/");
+    make_directory(root);
+    snprintf(recordingDir, MAX_CHAR_LENGTH, "%srecs/", root);
+    snprintf(logFilePath, MAX_CHAR_LENGTH, "%srecording_log_", root);
+    snprintf(bandLevelFilePath, MAX_CHAR_LENGTH, "%sband_levels_", root);
+    snprintf(acousticIndexFilePath, MAX_CHAR_LENGTH, "%sacoustic_indices_", root);
+    snprintf(simulationConfigFileName, MAX_CHAR_LENGTH, "%samt.config", root);
+    if(stat(simulationConfigFileName, &st) == 0){
+        configFileName = simulationConfigFileName;
+    }
+    return 0;
+}
+
+// Recovery: repair WAV headers left open by a power loss, the given files or all recordings in REC_DIR
+void run_recovery(unsigned numberOfFiles, char** fileNames){
+    if(!numberOfFiles){
+        printf("%u recording(s) recovered\n", recover_wav_files(REC_DIR, NULL, NULL));
+        return;
+    }
+    for(unsigned n = 0; n < numberOfFiles; n++){
+        int result = recover_wav_file(fileNames[n]);
+        printf("%s: %s\n", fileNames[n], (result > 0) ? "recovered" : (result ? "not a readable WAV file" : "consistent"));
+    }
+}
+
+// Add a recording recovered at startup to the storage index, it was never closed by the writer
+void index_recovered_file(const char* path, void* userData){
+    if(userData){
+        storage_add_file((storage_manager*) userData, path, STORAGE_PRIORITY_SCHEDULED);
+    }
+}
+
+// Free filters and configuration
+void fini_amt(){
+    if(configWatcher){
+        fini_config_watcher(configWatcher);
+        free(configWatcher);
+    }
+    if(inputDecimator){
+        free_decimator(inputDecimator);
+        free(inputDecimator);
+    }
+    if(telemetry){
+        fini_telemetry(telemetry);
+        free(telemetry);
+    }
+    if(storage){
+        fini_storage_manager(storage);
+        free(storage);
+    }
+    if(hpf){
+        for(unsigned n = 0; n < amtConfig->highpassFilterStages; n++){
+            free_filter(&hpf[n]);
+        }
+        free(hpf);
+    }
+    if(lpf){
+        for(unsigned n = 0; n < amtConfig->lowpassFilterStages; n++){
+            free_filter(&lpf[n]);
+        }
+        free(lpf);
+    }
+    if(filterChain){
+        free_sos_filter(filterChain);
+        free(filterChain);
+    }
+    if(fixedFilterChain){
+        free_sos_filter_q31(fixedFilterChain);
+        free(fixedFilterChain);
+    }
+    if(triggerLevelMeter){
+        free_level_meter(triggerLevelMeter);
+        free(triggerLevelMeter);
+    }
+    if(bandTrigger){
+        free_band_trigger(bandTrigger);
+        free(bandTrigger);
+    }
+    if(triggerNoiseFloor){
+        free_noise_floor(triggerNoiseFloor);
+        free(triggerNoiseFloor);
+    }
+    if(simulationSource){
+        free(simulationSource);
+    }
+    free_config(amtConfig);
+    free(amtConfig);
+    free(audioIoFlags);
 }
 
 
@@ -258,14 +895,27 @@ int main(int argc, char** argv)
     audioIoFlags->initialized = 0;
     audioIoFlags->ongoing = 0;
     audioIoFlags->finished = 0;
+    audioIoFlags->replay = 0;
+    audioIoFlags->continuous = 0;
+
+    // Simulation of the recording schedule with a virtual clock and a synthetic source 
+    // (amt --simulate [days] [script|-] [output directory]), written below its own output directory
+    unsigned simulation = argc > 1 && !strcmp(argv[1], SIMULATE_OPTION);
+    const char* simulationDir = (argc > 4) ? argv[4] : SIMULATION_DIR;
+    if(simulation && set_simulation_paths(simulationDir)){
+        printf("Invalid simulation output directory %s.\n", simulationDir);
+        free(audioIoFlags);
+        return 1;
+    }
 
     // Create a recording dir if non-existent
-    if (stat(REC_DIR, &st) == -1) {
-    #ifdef PC_TEST
-        mkdir(REC_DIR);
-    #else
-        mkdir(REC_DIR, 0777);
-    #endif
+    make_directory(recordingDir);
+
+    // Recovery of recordings interrupted by a power loss (amt --recover [file1.wav file2.wav ...]), no capture involved
+    if(argc > 1 && !strcmp(argv[1], RECOVER_OPTION)){
+        run_recovery((unsigned)(argc - 2), &argv[2]);
+        free(audioIoFlags);
+        return 0;
     }
 
     // Get current date
@@ -276,23 +926,52 @@ int main(int argc, char** argv)
 
     // Set main configuration settings
     amtConfig = malloc(sizeof(amt_config));
-    set_config(configFileName, amtConfig);
+    if(set_config(configFileName, amtConfig)){
+        printf("Failed to read %s.\n", configFileName);
+        free(amtConfig);
+        free(audioIoFlags);
+        return 1;
+    }
 
     // Compute mic gain factor
     amtConfig->micGainFactor = powf(10.0f, amtConfig->microphoneGain / 20.0f);
 
+    // Init decimator, the capture keeps running at sampleRate while processing and storage run at processingSampleRate
+    amtConfig->processingSampleRate = amtConfig->sampleRate;
+    if(amtConfig->decimationFactor > 1){
+        inputDecimator = malloc(sizeof(decimator));
+        if(init_decimator(inputDecimator, amtConfig->decimationFactor, NUMBER_OF_CALLBACK_SAMPLES)){
+            printf("Unsupported decimation factor %u (2, 3, 4 or 6), input is not decimated.\n", amtConfig->decimationFactor);
+            free(inputDecimator);
+            inputDecimator = NULL;
+        }
+        else {
+            amtConfig->processingSampleRate = amtConfig->sampleRate / amtConfig->decimationFactor;
+        }
+    #ifdef DEBUG
+        printf("-> Processing sample rate: %.0f Hz\n", amtConfig->processingSampleRate);
+    #endif
+    }
+
+    // The fixed-point path processes the s32 capture directly, it does not include the (float) decimator
+    if(amtConfig->enableFixedPointProcessing && inputDecimator){
+        printf("Fixed-point processing is not available with decimation, using float processing.\n");
+        amtConfig->enableFixedPointProcessing = 0;
+    }
+
+    // Load FFTW wisdom (optional) before any FFT plan is created
+    if(load_fft_wisdom(FFT_WISDOM_FILE_PATH)){
+    #ifdef DEBUG
+        printf("FFTW wisdom loaded!\n");
+    #endif
+    }
+
     // Init HPF
     if(amtConfig->enableHighpassFilter){
     #ifdef DEBUG
         printf("HPF enabled!\n");
     #endif
-        hpf = malloc(sizeof(biquad_filter_data));
-        hpf->filterType = HPF;
-        hpf->qFactor = HPF_Q_FACTOR;
-        hpf->gain = 0.0;
-        hpf->cutoffFrequency = amtConfig->highpassFilterCutoff;
-        hpf->sampleRate = amtConfig->sampleRate;
-        init_filter(hpf);
+        hpf = init_butterworth_filter_stages(HPF, amtConfig->highpassFilterCutoff, amtConfig->highpassFilterStages);
     }
 
     // Init LPF
@@ -300,170 +979,237 @@ int main(int argc, char** argv)
     #ifdef DEBUG
         printf("LPF enabled!\n");
     #endif
-        lpf = malloc(sizeof(biquad_filter_data));
-        lpf->filterType = LPF;
-        lpf->qFactor = HPF_Q_FACTOR;
-        lpf->gain = 0.0;
-        lpf->cutoffFrequency = amtConfig->lowpassFilterCutoff;
-        lpf->sampleRate = amtConfig->sampleRate;
-        init_filter(lpf);
-    }
-
-    // First check current date, if not in the firstRecordingDate, sleep until there
-    unsigned runningFlag = 0;
-    unsigned currentDay, currentMonth;
-    unsigned firstRecordingDay = extract_info_from_date(amtConfig->firstRecordingDate, DAY);
-    unsigned lastRecordingDay = extract_info_from_date(amtConfig->lastRecordingDate, DAY);
-    unsigned firstRecordingMonth = extract_info_from_date(amtConfig->firstRecordingDate, MONTH);
-    unsigned lastRecordingMonth = extract_info_from_date(amtConfig->lastRecordingDate, MONTH);
-    while(!runningFlag){
-        // Get day and month of current date
-        currentDay = extract_info_from_date(currentDate, DAY);
-        currentMonth = extract_info_from_date(currentDate, MONTH);
+        lpf = init_butterworth_filter_stages(LPF, amtConfig->lowpassFilterCutoff, amtConfig->lowpassFilterStages);
+    }
+
+    // Init cascade of HPF and LPF stages
+    unsigned numberOfHpfStages = hpf ? amtConfig->highpassFilterStages : 0;
+    unsigned numberOfLpfStages = lpf ? amtConfig->lowpassFilterStages : 0;
+    if(numberOfHpfStages + numberOfLpfStages && amtConfig->enableFixedPointProcessing){
+        fixedFilterChain = malloc(sizeof(sos_filter_q31));
+        init_sos_filter_q31(fixedFilterChain, numberOfHpfStages + numberOfLpfStages);
+        for(unsigned n = 0; n < numberOfHpfStages; n++){
+            set_sos_filter_q31_stage(fixedFilterChain, n, hpf[n].coeffs);
+        }
+        for(unsigned n = 0; n < numberOfLpfStages; n++){
+            set_sos_filter_q31_stage(fixedFilterChain, numberOfHpfStages + n, lpf[n].coeffs);
+        }
     #ifdef DEBUG
-        printf("Current day: %d\n", currentDay);
-        printf("Current month: %d\n", currentMonth);
-        printf("First recording day: %d\n", firstRecordingDay);
+        printf("-> Filter chain: %d stage(s), Q31 kernel\n", fixedFilterChain->numberOfStages);
     #endif
-        if(currentMonth >= firstRecordingMonth){
-            if(currentDay >= firstRecordingDay || firstRecordingMonth < currentMonth){
-            #ifdef DEBUG
-                printf("Today is the starting day!\n");
-            #endif
-                runningFlag = 1;
-            } 
-            else {
-            #ifdef DEBUG
-                printf("Today is not the starting day! Checking again after %d minute(s)...\n", DATE_CHECK_TIME_IN_MINUTES);
-            #endif
-            #ifdef PC_TEST
-                Sleep((int)(DATE_CHECK_TIME_IN_MINUTES * 60 * 1000));
-            #else
-                sleep((int)(DATE_CHECK_TIME_IN_MINUTES * 60));
-            #endif
-            }
+    }
+    else if(numberOfHpfStages + numberOfLpfStages){
+        filterChain = malloc(sizeof(sos_filter));
+        init_sos_filter(filterChain, numberOfHpfStages + numberOfLpfStages);
+        for(unsigned n = 0; n < numberOfHpfStages; n++){
+            set_sos_filter_stage(filterChain, n, hpf[n].coeffs);
+        }
+        for(unsigned n = 0; n < numberOfLpfStages; n++){
+            set_sos_filter_stage(filterChain, numberOfHpfStages + n, lpf[n].coeffs);
+        }
+    #ifdef DEBUG
+        printf("-> Filter chain: %d stage(s), %s kernel\n", filterChain->numberOfStages, get_sos_kernel_name(filterChain->kernel));
+    #endif
+    }
+
+    // Init band trigger, band powers are averaged with the configured time weighting
+    if(amtConfig->enableThresholdRecording && amtConfig->enableBandTrigger && amtConfig->numberOfTriggerBands){
+        band_trigger_config bandTriggerConfig;
+        bandTriggerConfig.numberOfBands = amtConfig->numberOfTriggerBands;
+        bandTriggerConfig.lowerFrequencies = amtConfig->triggerBandLowerFrequencies;
+        bandTriggerConfig.upperFrequencies = amtConfig->triggerBandUpperFrequencies;
+        bandTriggerConfig.thresholdIndB = amtConfig->recordingThresholddBFS;
+        bandTriggerConfig.ratioIndB = amtConfig->triggerBandRatio;
+        bandTriggerConfig.combination = amtConfig->triggerBandCombination;
+        bandTriggerConfig.timeConstant = (amtConfig->levelTimeWeighting == SLOW_TIME_WEIGHTING) ? 1.0f : 
+                                         ((amtConfig->levelTimeWeighting == FAST_TIME_WEIGHTING) ? 0.125f : 0.0f);
+        bandTrigger = malloc(sizeof(band_trigger));
+        if(init_band_trigger(bandTrigger, &bandTriggerConfig, amtConfig->processingSampleRate, BAND_TRIGGER_FFT_SIZE)){
+            printf("Failed to initialize band trigger.\n");
+            free(bandTrigger);
+            bandTrigger = NULL;
         }
+    #ifdef DEBUG
         else {
-            #ifdef DEBUG
-                printf("Today is not the starting month! Checking again after 1 day...\n");
-            #endif
-            #ifdef PC_TEST
-                Sleep((int)(DATE_CHECK_TIME_IN_MINUTES * 60 * 60 * 24 * 1000));
-            #else
-                sleep((int)(DATE_CHECK_TIME_IN_MINUTES * 60 * 60 * 24));
-            #endif
-        } 
+            printf("-> Band trigger: %u band(s), %.1f dB over background\n", bandTrigger->numberOfBands, bandTrigger->ratioIndB);
+        }
+    #endif
     }
-    
-    // If threshold-based rec mode is not enabled, start recs without threshold mode
-    if(!amtConfig->enableThresholdRecording){
-        while(runningFlag) {   
-            if(!audioIoFlags->initialized){
-                if(check_recording_hours(get_current_hour(),amtConfig->recordingHours,amtConfig->numberOfRecordingHours)){
-                #ifdef DEBUG
-                    printf("Current hour where recording starts: %d\n", get_current_hour());
-                #endif
-                    audioIoFlags->initialized = 1;
-                    // initialize miniaudio
-                    init_audio_io();
-                } 
-                else {
-                    // if not recording hour, sleep and check again in 1 minute
-                #ifdef DEBUG
-                    printf("Current hour is not a recording hour! Checking again in 1min...");
-                #endif
-                #ifdef PC_TEST
-                    Sleep((int)(60 * 1000));
-                #else
-                    sleep((int)(60));
-                #endif
-                }
-            } else {
-                if(audioIoFlags->finished)
-                {
-                    // finilize miniaudio
-                    fini_audio_io();
-                    audioIoFlags->finished = 0;
-                    audioIoFlags->initialized = 0;
-                #ifdef DEBUG
-                    printf("Calling sleep function...\n");
-                    printf("-> Sleep duration: %.2f min\n", amtConfig->sleepDuration);
-                #endif
-                #ifdef PC_TEST
-                    Sleep((int)(amtConfig->sleepDuration * 60 * 1000));
-                #else
-                    sleep((int)(amtConfig->sleepDuration * 60));
-                #endif
-                #ifdef DEBUG
-                    printf("...Sleep function finished\n");
-                #endif
-
-                    // check if current date is not later than last recording date
-                    update_date(currentDate, MAX_CHAR_LENGTH);
-                    currentMonth = extract_info_from_date(currentDate, MONTH);
-                    if(currentMonth > lastRecordingMonth){
-                        runningFlag = 0;
-                    #ifdef DEBUG
-                        printf("Stoping AMT since the last recording month is earlier than the current month...");
-                    #endif
-                    }
-                    else{
-                        if(currentMonth == lastRecordingMonth){
-                            currentDay = extract_info_from_date(currentDate, DAY);
-                            if(currentDay > lastRecordingDay){
-                                runningFlag = 0;
-                            #ifdef DEBUG
-                                printf("Stoping AMT since the last recording day is earlier than the current day...");
-                            #endif
-                            }
-                        }
-                    }
-                }
-            }
-        };
-    } 
-    else
-    {
-        // initialize miniaudio
-        init_audio_io();
-        while(runningFlag) {
-            if(check_recording_hours(get_current_hour(),amtConfig->recordingHours,amtConfig->numberOfRecordingHours)){
-                audioIoFlags->initialized = 1;
-            } 
-            else {
-                #ifdef PC_TEST
-                    Sleep((int)(60 * 1000));
-                #else
-                    sleep((int)(60));
-                #endif
-            }
 
-            // check if current date is not later than last recording date
-            update_date(currentDate, MAX_CHAR_LENGTH);
-            currentMonth = extract_info_from_date(currentDate, MONTH);
-            if(currentMonth > lastRecordingMonth){
-                runningFlag = 0;
+    // Init trigger level meter (frequency and time weighting)
+    if(amtConfig->enableThresholdRecording && !bandTrigger){
+        triggerLevelMeter = malloc(sizeof(level_meter));
+        init_level_meter(triggerLevelMeter, amtConfig->levelFrequencyWeighting, amtConfig->levelTimeWeighting, 
+                         amtConfig->processingSampleRate, NUMBER_OF_CALLBACK_SAMPLES);
+    #ifdef DEBUG
+        printf("-> Trigger level: %s\n", get_level_meter_name(triggerLevelMeter));
+    #endif
+    }
+
+    // Init noise floor of the trigger level (band or level meter), estimated over the last noiseFloorWindow seconds
+    if(amtConfig->enableThresholdRecording && amtConfig->enableAdaptiveThreshold){
+        triggerNoiseFloor = malloc(sizeof(noise_floor));
+        if(init_noise_floor(triggerNoiseFloor, amtConfig->noiseFloorPercentile, amtConfig->noiseFloorWindow, amtConfig->processingSampleRate)){
+            printf("Failed to initialize noise floor, using fixed thresholds.\n");
+            free(triggerNoiseFloor);
+            triggerNoiseFloor = NULL;
+        }
+    #ifdef DEBUG
+        else {
+            printf("-> Adaptive threshold: L%u over %.0f s + %.1f dB\n", amtConfig->noiseFloorPercentile, amtConfig->noiseFloorWindow, 
+                   amtConfig->noiseFloorMargin);
+        }
+    #endif
+    }
+
+    // Init processing parameters (gain, filter coefficients and thresholds) that can be reloaded while running
+    configWatcher = malloc(sizeof(config_watcher));
+    init_config_watcher(configWatcher, build_dsp_params(amtConfig, amtConfig->processingSampleRate, 1));
+
+    // Init storage manager, old recordings are evicted (or downgraded) before the card or the quota is full,
+    // a simulation does not evict (its clock is virtual)
+    if(amtConfig->enableAudioRecording && !simulation){
+        storage_config storageConfig;
+        storageConfig.quotaInBytes = (unsigned long long)(amtConfig->storageQuota * 1048576.0);
+        storageConfig.minFreeBytes = (unsigned long long)(amtConfig->minFreeSpace * 1048576.0);
+        storageConfig.enableDowngrade = amtConfig->enableStorageDowngrade;
+        storageConfig.flacCompressionLevel = amtConfig->flacCompressionLevel;
+        storage = malloc(sizeof(storage_manager));
+        if(init_storage_manager(storage, &storageConfig)){
+            printf("Failed to initialize storage manager, free space is not managed.\n");
+            free(storage);
+            storage = NULL;
+        }
+    }
+
+    // Repair recordings left open by a power loss before they are read, replayed or evicted (not the ones of a simulation)
+    if(!simulation){
+        recover_wav_files(REC_DIR, index_recovered_file, storage);
+    }
+
+    // Offline replay of input files (amt --replay file1.wav file2.wav ...), no recording schedule involved
+    if(argc > 2 && !strcmp(argv[1], REPLAY_OPTION)){
+        run_file_replay((unsigned)(argc - 2), &argv[2]);
+        fini_amt();
+        return 0;
+    }
+
+    // Watch amt.config, gain, filter cutoffs and thresholds are applied without restarting the device
+    if(amtConfig->enableConfigReload && !simulation && start_config_watcher(configWatcher, configFileName, amtConfig)){
+        printf("Failed to watch %s, configuration changes need a restart.\n", configFileName);
+    }
+
+    // Init telemetry, a stats snapshot is written every telemetryPeriod seconds
+    if(amtConfig->enableTelemetry && !simulation){
+        telemetry = malloc(sizeof(amt_telemetry));
+        if(init_telemetry(telemetry, amtConfig->sampleRate, (unsigned) amtConfig->telemetryPeriod, TELEMETRY_FILE_PATH)){
+            printf("Failed to initialize telemetry.\n");
+            free(telemetry);
+            telemetry = NULL;
+        }
+        else if(storage){
+            set_telemetry_storage(telemetry, storage);
+        }
+    }
+
+    // Recording schedule (date range including year, recording hours) driven by absolute deadlines
+    amt_schedule schedule;
+    if(init_schedule(&schedule, amtConfig->firstRecordingDate, amtConfig->lastRecordingDate, 
+                     amtConfig->recordingHours, amtConfig->numberOfRecordingHours)){
+        printf("Invalid recording dates (expected YYYY-MM-DD).\n");
+        fini_amt();
+        return 1;
+    }
+
+    // the simulated deployment starts at local midnight of the first recording date and lasts days (default: all dates)
+    struct timespec simulationStart = {0, 0};
+    if(simulation){
+        double days = (argc > 2) ? atof(argv[2]) : 0.0;
+        simulationEnd = (days > 0.0) ? schedule.startTime + (time_t)(days * 86400) : schedule.endTime;
+        simulationSource = malloc(sizeof(sim_source));
+        const char* scriptFileName = (argc > 3 && strcmp(argv[3], "-")) ? argv[3] : NULL;
+        if(init_sim_source(simulationSource, scriptFileName, schedule.startTime, amtConfig->sampleRate)){
+            printf("Failed to read simulation script %s.\n", argv[3]);
+            fini_amt();
+            return 1;
+        }
+        enable_virtual_clock(schedule.startTime);
+        clock_gettime(CLOCK_MONOTONIC, &simulationStart);
+    }
+
+    time_t notBefore = get_current_time();
+    while(1){
+        // recompute from the current time, the wall clock may have been adjusted while sleeping
+        time_t now = get_current_time();
+        if(now > notBefore){
+            notBefore = now;
+        }
+        time_t nextStart = get_next_recording_start(&schedule, notBefore);
+        if(nextStart == SCHEDULE_FINISHED || (simulationSource && nextStart >= simulationEnd)){
+        #ifdef DEBUG
+            printf("Stopping AMT since the last recording date has passed...\n");
+        #endif
+            break;
+        }
+        if(nextStart > now){
+        #ifdef DEBUG
+            printf("Sleeping until next recording start: %s", ctime(&nextStart));
+        #endif
+            wait_until_time(nextStart);
+            continue;
+        }
+
+        // the device is only stopped for pauses of at least minSleepToStopDevice, shorter ones are kept in the callback
+        audioIoFlags->continuous = amtConfig->sleepDuration < amtConfig->minSleepToStopDevice;
+        if(!amtConfig->enableThresholdRecording && !audioIoFlags->continuous){
+            // duty cycle: the callback finishes the recording after recordDuration, then sleep for sleepDuration
+        #ifdef DEBUG
+            printf("Current hour where recording starts: %d\n", localtime(&now)->tm_hour);
+        #endif
+            audioIoFlags->initialized = 1;
+            init_audio_io();
+            time_t recordingEnd = now + (time_t)(amtConfig->recordDuration * 60);
+            wait_until_time(recordingEnd);
+            while(!audioIoFlags->finished && get_current_time() < recordingEnd + SCHEDULE_RECORDING_TIMEOUT_IN_SECONDS){
+                wait_for_poll_period();
             }
-            currentDay = extract_info_from_date(currentDate, DAY);
-            if(currentDay > lastRecordingDay){
-                runningFlag = 0;
+            fini_audio_io();
+            audioIoFlags->finished = 0;
+            audioIoFlags->initialized = 0;
+            notBefore = get_current_time() + (time_t)(amtConfig->sleepDuration * 60);
+        #ifdef DEBUG
+            printf("-> Sleep duration: %.2f min\n", amtConfig->sleepDuration);
+        #endif
+        }
+        else {
+            // threshold and continuous modes: capture device runs through the whole run of recording hours
+            time_t windowEnd = get_recording_window_end(&schedule, now);
+            if(simulationSource && windowEnd > simulationEnd){
+                windowEnd = simulationEnd;
             }
-        };
-        // finilize miniaudio
-        fini_audio_io();
+        #ifdef DEBUG
+            printf("Capture device running until %s", ctime(&windowEnd));
+        #endif
+            audioIoFlags->initialized = 1;
+            init_audio_io();
+            wait_until_time(windowEnd);
+            fini_audio_io();
+            audioIoFlags->initialized = 0;
+            notBefore = windowEnd;
+        }
     }
 
-    // free all memory allocation
-    if(hpf){
-        free_filter(hpf);
+    if(simulationSource){
+        struct timespec simulationStop;
+        clock_gettime(CLOCK_MONOTONIC, &simulationStop);
+        double seconds = (simulationStop.tv_sec - simulationStart.tv_sec) + (simulationStop.tv_nsec - simulationStart.tv_nsec) * 1e-9;
+        printf("Simulated %.2f days (%.2f h of capture processed, %.2f h of quiet capture skipped) in %.3f s\n", 
+               (get_current_time() - schedule.startTime) / 86400.0, simulatedFrameCount / amtConfig->sampleRate / 3600.0, 
+               skippedFrameCount / amtConfig->sampleRate / 3600.0, seconds);
     }
-    if(lpf){
-        free_filter(lpf);
-    }
-    free(amtConfig->recordingHours);
-    free(amtConfig->firstRecordingDate);
-    free(amtConfig->lastRecordingDate);
-    free(amtConfig);
+
+    // free all memory allocation
+    fini_amt();
     
     return 0;
 }
@@ -0,0 +1,79 @@
+/*
+--------------------------------------------------------------------------
+* Acoustic monitoring tool for Raspberry Pi based on miniaudio framework *
+*                                                                        *
+* Kaue Werner, 2024                                                      *
+--------------------------------------------------------------------------
+*/
+/**
+ * @file rec_trigger.c
+ * @author Kaue Werner
+ * @date 10 Mar 2024
+ * @brief Definition of the threshold recording trigger state machine used in AMT
+ * @version 0.1.0
+*/
+#include "rec_trigger.h"
+
+/**
+ * @brief initialize recording trigger (rec_trigger)
+ * 
+*/
+void init_rec_trigger(rec_trigger* trigger, size_t holdTimeInFrames, size_t maxFileLengthInFrames){
+    trigger->holdTimeInFrames = holdTimeInFrames;
+    trigger->maxFileLengthInFrames = maxFileLengthInFrames;
+    reset_rec_trigger(trigger);
+}
+
+/**
+ * @brief go back to idle state
+ * 
+*/
+void reset_rec_trigger(rec_trigger* trigger){
+    trigger->state = REC_TRIGGER_IDLE;
+    trigger->holdFramesLeft = 0;
+    trigger->fileFrames = 0;
+}
+
+/**
+ * @brief update trigger state with one block of frameCount frames, attackReached/releaseReached 
+ * tell if the block level reached the attack/release threshold, prerollFrames are the frames 
+ * written before the block when a file starts, returns a rec_trigger_action
+ * 
+*/
+unsigned update_rec_trigger(rec_trigger* trigger, unsigned attackReached, unsigned releaseReached, size_t frameCount, size_t prerollFrames){
+    switch(trigger->state){
+        case REC_TRIGGER_IDLE:
+            if(!attackReached){
+                return REC_TRIGGER_NONE;
+            }
+            trigger->state = REC_TRIGGER_ACTIVE;
+            trigger->holdFramesLeft = trigger->holdTimeInFrames;
+            trigger->fileFrames = prerollFrames + frameCount;
+        return REC_TRIGGER_START;
+
+        case REC_TRIGGER_ACTIVE:
+        case REC_TRIGGER_HOLD:
+        default:
+            if(releaseReached || attackReached){
+                // still loud or retriggered, restart the hold time
+                trigger->state = REC_TRIGGER_ACTIVE;
+                trigger->holdFramesLeft = trigger->holdTimeInFrames;
+            }
+            else {
+                trigger->state = REC_TRIGGER_HOLD;
+                if(trigger->holdFramesLeft <= frameCount){
+                    // the block is still written to the file, then the file is closed
+                    reset_rec_trigger(trigger);
+                    return REC_TRIGGER_STOP;
+                }
+                trigger->holdFramesLeft -= frameCount;
+            }
+            if(trigger->maxFileLengthInFrames && trigger->fileFrames + frameCount > trigger->maxFileLengthInFrames){
+                // the block starts the next file of the same event
+                trigger->fileFrames = frameCount;
+                return REC_TRIGGER_SPLIT;
+            }
+            trigger->fileFrames += frameCount;
+        return REC_TRIGGER_NONE;
+    }
+}
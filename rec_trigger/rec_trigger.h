@@ -0,0 +1,77 @@
+/*
+--------------------------------------------------------------------------
+* Acoustic monitoring tool for Raspberry Pi based on miniaudio framework *
+*                                                                        *
+* Kaue Werner, 2024                                                      *
+--------------------------------------------------------------------------
+*/
+/**
+ * @file rec_trigger.h
+ * @author Kaue Werner
+ * @date 10 Mar 2024
+ * @brief Header with the threshold recording trigger state machine used in AMT
+ * @version 0.1.0
+*/
+#ifndef REC_TRIGGER_H
+#define REC_TRIGGER_H
+#include "../config_defines.h"
+#include <stddef.h>
+
+/**
+ * @brief Current available trigger states
+ *
+*/
+typedef enum {
+    REC_TRIGGER_IDLE,
+    REC_TRIGGER_ACTIVE,
+    REC_TRIGGER_HOLD
+} rec_trigger_state;
+
+/**
+ * @brief Current available trigger actions, returned once per processed block
+ *
+*/
+typedef enum {
+    REC_TRIGGER_NONE,
+    REC_TRIGGER_START,
+    REC_TRIGGER_SPLIT,
+    REC_TRIGGER_STOP
+} rec_trigger_action;
+
+/**
+ * @brief Recording trigger data struct
+ * IDLE -> ACTIVE when the attack threshold is reached, ACTIVE -> HOLD when 
+ * the level falls below the release threshold, HOLD -> ACTIVE again if the 
+ * release threshold is reached before the hold time ends (retrigger extends 
+ * the current file), HOLD -> IDLE when the hold time ends. Files longer than 
+ * the maximum length are split without losing frames.
+*/
+typedef struct {
+    unsigned state;
+    size_t holdTimeInFrames;
+    size_t maxFileLengthInFrames;
+    size_t holdFramesLeft;
+    size_t fileFrames;
+} rec_trigger;
+
+/**
+ * @brief initialize recording trigger (rec_trigger)
+ * 
+*/
+void init_rec_trigger(rec_trigger* trigger, size_t holdTimeInFrames, size_t maxFileLengthInFrames);
+
+/**
+ * @brief go back to idle state
+ * 
+*/
+void reset_rec_trigger(rec_trigger* trigger);
+
+/**
+ * @brief update trigger state with one block of frameCount frames, attackReached/releaseReached 
+ * tell if the block level reached the attack/release threshold, prerollFrames are the frames 
+ * written before the block when a file starts, returns a rec_trigger_action
+ * 
+*/
+unsigned update_rec_trigger(rec_trigger* trigger, unsigned attackReached, unsigned releaseReached, size_t frameCount, size_t prerollFrames);
+
+#endif // REC_TRIGGER_H
@@ -0,0 +1,251 @@
+/*
+--------------------------------------------------------------------------
+* Acoustic monitoring tool for Raspberry Pi based on miniaudio framework *
+*                                                                        *
+* Kaue Werner, 2024                                                      *
+--------------------------------------------------------------------------
+*/
+/**
+ * @file rec_summary.c
+ * @author Kaue Werner
+ * @date 10 Mar 2024
+ * @brief Definition of the per-recording summary sidecar used in AMT
+ * @version 0.1.0
+*/
+#include "rec_summary.h"
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+/**
+ * @brief reset the current level 0 block
+ *
+*/
+static void reset_rec_summary_block(rec_summary* summary){
+    summary->blockFrames = 0;
+    summary->blockSamples = 0;
+    summary->blockEnergy = 0.0;
+    summary->block.peak = 0.0f;
+    summary->block.min = INFINITY;
+    summary->block.max = -INFINITY;
+    summary->block.clippedSamples = 0;
+}
+
+/**
+ * @brief append an entry to the in-memory pyramid, returns 0 on success
+ *
+*/
+static int push_rec_summary_range(rec_summary* summary, const rec_summary_range* entry){
+    if(summary->pyramidSize == summary->pyramidCapacity){
+        size_t capacity = summary->pyramidCapacity ? 2 * summary->pyramidCapacity : 1024;
+        rec_summary_range* pyramid = realloc(summary->pyramid, capacity * sizeof(rec_summary_range));
+        if(!pyramid){
+            return -1;
+        }
+        summary->pyramid = pyramid;
+        summary->pyramidCapacity = capacity;
+    }
+    summary->pyramid[summary->pyramidSize++] = *entry;
+    return 0;
+}
+
+/**
+ * @brief write the current level 0 block and fold it into level 1
+ *
+*/
+static void flush_rec_summary_block(rec_summary* summary){
+    rec_summary_block* block = &summary->block;
+    block->rms = (float) sqrt(summary->blockEnergy / summary->blockSamples);
+    fwrite(block, sizeof(rec_summary_block), 1, summary->file);
+    summary->header.levelCount[0]++;
+
+    if(!summary->levelOneBlocks){
+        summary->levelOneEntry.min = block->min;
+        summary->levelOneEntry.max = block->max;
+    }
+    else {
+        summary->levelOneEntry.min = fminf(summary->levelOneEntry.min, block->min);
+        summary->levelOneEntry.max = fmaxf(summary->levelOneEntry.max, block->max);
+    }
+    if(++summary->levelOneBlocks == REC_SUMMARY_PYRAMID_FACTOR){
+        push_rec_summary_range(summary, &summary->levelOneEntry);
+        summary->levelOneBlocks = 0;
+    }
+    reset_rec_summary_block(summary);
+}
+
+/**
+ * @brief initialize recording summary (rec_summary)
+ *
+*/
+void init_rec_summary(rec_summary* summary){
+    summary->file = NULL;
+    summary->pyramid = NULL;
+    summary->pyramidSize = 0;
+    summary->pyramidCapacity = 0;
+}
+
+/**
+ * @brief free recording summary (rec_summary), closing its file if still open
+ *
+*/
+void free_rec_summary(rec_summary* summary){
+    close_rec_summary(summary);
+    free(summary->pyramid);
+    summary->pyramid = NULL;
+    summary->pyramidCapacity = 0;
+}
+
+/**
+ * @brief summary file name of a recording, its name with REC_SUMMARY_FILE_EXTENSION
+ * instead of the audio file extension
+ *
+*/
+void get_rec_summary_file_name(const char* recordingFileName, char* summaryFileName, unsigned size){
+    const char* extension = strrchr(recordingFileName, '.');
+    const char* fileName = strrchr(recordingFileName, '/');
+    int length = (extension && (!fileName || extension > fileName)) ? (int)(extension - recordingFileName) : (int) strlen(recordingFileName);
+    snprintf(summaryFileName, size, "%.*s%s", length, recordingFileName, REC_SUMMARY_FILE_EXTENSION);
+}
+
+/**
+ * @brief open the summary file of a recording, returns 0 on success
+ *
+*/
+int open_rec_summary(rec_summary* summary, const char* recordingFileName, unsigned channels,
+                     unsigned sampleRate, const struct timeval* timestamp){
+    char summaryFileName[MAX_CHAR_LENGTH];
+    get_rec_summary_file_name(recordingFileName, summaryFileName, MAX_CHAR_LENGTH);
+    close_rec_summary(summary);
+    summary->file = fopen(summaryFileName, "wb");
+    if(!summary->file){
+        return -1;
+    }
+    rec_summary_header* header = &summary->header;
+    memset(header, 0, sizeof(rec_summary_header));
+    memcpy(header->magic, REC_SUMMARY_MAGIC, sizeof(header->magic));
+    header->version = REC_SUMMARY_VERSION;
+    header->channels = channels;
+    header->sampleRate = sampleRate;
+    header->blockSize = REC_SUMMARY_BLOCK_SIZE;
+    header->pyramidFactor = REC_SUMMARY_PYRAMID_FACTOR;
+    header->numberOfLevels = 1;
+    header->startTime = timestamp->tv_sec;
+    header->startMicroseconds = (uint32_t) timestamp->tv_usec;
+    header->levelOffset[0] = sizeof(rec_summary_header);
+    // the header is completed on close, a reader of an incomplete file only relies on level 0
+    fwrite(header, sizeof(rec_summary_header), 1, summary->file);
+
+    summary->pyramidSize = 0;
+    summary->levelOneBlocks = 0;
+    reset_rec_summary_block(summary);
+    return 0;
+}
+
+/**
+ * @brief add interleaved float frames to the summary
+ *
+*/
+void update_rec_summary(rec_summary* summary, const float* frames, size_t frameCount){
+    if(!summary->file){
+        return;
+    }
+    const unsigned channels = summary->header.channels;
+    summary->header.numberOfFrames += frameCount;
+    while(frameCount){
+        size_t blockFrames = REC_SUMMARY_BLOCK_SIZE - summary->blockFrames;
+        blockFrames = (frameCount < blockFrames) ? frameCount : blockFrames;
+        size_t blockSamples = blockFrames * channels;
+        float energy = 0.0f;
+        float min = summary->block.min;
+        float max = summary->block.max;
+        unsigned clippedSamples = 0;
+        for(size_t n = 0; n < blockSamples; n++){
+            float sample = frames[n];
+            energy += sample * sample;
+            min = (sample < min) ? sample : min;
+            max = (sample > max) ? sample : max;
+            clippedSamples += fabsf(sample) >= 1.0f;
+        }
+        summary->blockEnergy += energy;
+        summary->block.min = min;
+        summary->block.max = max;
+        summary->block.peak = fmaxf(-min, max);
+        summary->block.clippedSamples += clippedSamples;
+        summary->blockFrames += (unsigned) blockFrames;
+        summary->blockSamples += (unsigned) blockSamples;
+        if(summary->blockFrames == REC_SUMMARY_BLOCK_SIZE){
+            flush_rec_summary_block(summary);
+        }
+        frames += blockSamples;
+        frameCount -= blockFrames;
+    }
+}
+
+/**
+ * @brief flush the level 0 blocks written so far to the storage device
+ *
+*/
+void sync_rec_summary(rec_summary* summary){
+    if(summary->file){
+        fflush(summary->file);
+        fdatasync(fileno(summary->file));
+    }
+}
+
+/**
+ * @brief write the last block and the pyramid, complete the header and close the summary file
+ *
+*/
+void close_rec_summary(rec_summary* summary){
+    if(!summary->file){
+        return;
+    }
+    rec_summary_header* header = &summary->header;
+    if(summary->blockFrames){
+        flush_rec_summary_block(summary);
+    }
+    if(summary->levelOneBlocks){
+        push_rec_summary_range(summary, &summary->levelOneEntry);
+        summary->levelOneBlocks = 0;
+    }
+
+    // level 1 is in memory, each upper level is reduced from the one below and appended to it
+    size_t levelStart = 0;
+    size_t levelCount = summary->pyramidSize;
+    uint64_t offset = header->levelOffset[0] + header->levelCount[0] * sizeof(rec_summary_block);
+    for(unsigned level = 1; level < REC_SUMMARY_MAX_LEVELS && header->levelCount[level - 1] > 1; level++){
+        if(level > 1){
+            size_t nextStart = summary->pyramidSize;
+            for(size_t n = 0; n < levelCount; n += REC_SUMMARY_PYRAMID_FACTOR){
+                rec_summary_range entry = summary->pyramid[levelStart + n];
+                size_t last = (n + REC_SUMMARY_PYRAMID_FACTOR < levelCount) ? n + REC_SUMMARY_PYRAMID_FACTOR : levelCount;
+                for(size_t k = n + 1; k < last; k++){
+                    entry.min = fminf(entry.min, summary->pyramid[levelStart + k].min);
+                    entry.max = fmaxf(entry.max, summary->pyramid[levelStart + k].max);
+                }
+                if(push_rec_summary_range(summary, &entry)){
+                    break;
+                }
+            }
+            levelStart = nextStart;
+            levelCount = summary->pyramidSize - nextStart;
+        }
+        // an allocation failure leaves a level short, only the complete levels below it are kept
+        if(levelCount != (header->levelCount[level - 1] + REC_SUMMARY_PYRAMID_FACTOR - 1) / REC_SUMMARY_PYRAMID_FACTOR){
+            break;
+        }
+        fwrite(&summary->pyramid[levelStart], sizeof(rec_summary_range), levelCount, summary->file);
+        header->levelOffset[level] = offset;
+        header->levelCount[level] = levelCount;
+        header->numberOfLevels = level + 1;
+        offset += levelCount * sizeof(rec_summary_range);
+    }
+
+    header->complete = 1;
+    fseek(summary->file, 0, SEEK_SET);
+    fwrite(header, sizeof(rec_summary_header), 1, summary->file);
+    fclose(summary->file);
+    summary->file = NULL;
+}
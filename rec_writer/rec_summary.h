@@ -0,0 +1,140 @@
+/*
+--------------------------------------------------------------------------
+* Acoustic monitoring tool for Raspberry Pi based on miniaudio framework *
+*                                                                        *
+* Kaue Werner, 2024                                                      *
+--------------------------------------------------------------------------
+*/
+/**
+ * @file rec_summary.h
+ * @author Kaue Werner
+ * @date 10 Mar 2024
+ * @brief Header with the per-recording summary sidecar used in AMT
+ * @version 0.1.0
+*/
+#ifndef REC_SUMMARY_H
+#define REC_SUMMARY_H
+#include "../config_defines.h"
+#include <stdint.h>
+#include <stdio.h>
+#include <sys/time.h>
+
+#define REC_SUMMARY_MAGIC "AMTSUM\0\0"
+#define REC_SUMMARY_VERSION 1
+#define REC_SUMMARY_BLOCK_SIZE 1024
+#define REC_SUMMARY_PYRAMID_FACTOR 4
+#define REC_SUMMARY_MAX_LEVELS 16
+
+/**
+ * @brief Summary file header, written at offset 0 in the native (little-endian)
+ * byte order without padding. levelOffset/levelCount give the byte offset and
+ * number of entries of each pyramid level, level 0 holds one rec_summary_block
+ * per block of blockSize frames (the last one may be shorter), the upper levels
+ * one rec_summary_range per pyramidFactor entries of the level below.
+ * complete is 0 while recording, a file left incomplete holds its level 0 blocks
+ * up to the end of the file
+*/
+typedef struct {
+    char magic[8];
+    uint32_t version;
+    uint32_t channels;
+    uint32_t sampleRate;
+    uint32_t blockSize;
+    uint32_t pyramidFactor;
+    uint32_t numberOfLevels;
+    int64_t startTime;
+    uint32_t startMicroseconds;
+    uint32_t complete;
+    uint64_t numberOfFrames;
+    uint64_t levelOffset[REC_SUMMARY_MAX_LEVELS];
+    uint64_t levelCount[REC_SUMMARY_MAX_LEVELS];
+} rec_summary_header;
+
+/**
+ * @brief Level 0 entry, RMS, absolute peak, minimum and maximum sample
+ * (full scale = 1.0) and number of samples at or above full scale, all channels
+ *
+*/
+typedef struct {
+    float rms;
+    float peak;
+    float min;
+    float max;
+    uint32_t clippedSamples;
+} rec_summary_block;
+
+/**
+ * @brief Upper pyramid level entry, minimum and maximum sample
+ *
+*/
+typedef struct {
+    float min;
+    float max;
+} rec_summary_range;
+
+/**
+ * @brief Recording summary data struct (writer thread side)
+ * Level 0 blocks are appended to the file while recording, level 1 is kept
+ * in memory and the upper levels are computed from it when the file is closed.
+*/
+typedef struct {
+    FILE* file;
+    rec_summary_header header;
+    /* current level 0 block */
+    unsigned blockFrames;
+    unsigned blockSamples;
+    double blockEnergy;
+    rec_summary_block block;
+    /* upper levels, level 1 entries first */
+    rec_summary_range* pyramid;
+    size_t pyramidSize;
+    size_t pyramidCapacity;
+    rec_summary_range levelOneEntry;
+    unsigned levelOneBlocks;
+} rec_summary;
+
+/**
+ * @brief initialize recording summary (rec_summary)
+ *
+*/
+void init_rec_summary(rec_summary* summary);
+
+/**
+ * @brief free recording summary (rec_summary), closing its file if still open
+ *
+*/
+void free_rec_summary(rec_summary* summary);
+
+/**
+ * @brief summary file name of a recording, its name with REC_SUMMARY_FILE_EXTENSION
+ * instead of the audio file extension
+ *
+*/
+void get_rec_summary_file_name(const char* recordingFileName, char* summaryFileName, unsigned size);
+
+/**
+ * @brief open the summary file of a recording, returns 0 on success
+ *
+*/
+int open_rec_summary(rec_summary* summary, const char* recordingFileName, unsigned channels,
+                     unsigned sampleRate, const struct timeval* timestamp);
+
+/**
+ * @brief add interleaved float frames to the summary
+ *
+*/
+void update_rec_summary(rec_summary* summary, const float* frames, size_t frameCount);
+
+/**
+ * @brief flush the level 0 blocks written so far to the storage device
+ *
+*/
+void sync_rec_summary(rec_summary* summary);
+
+/**
+ * @brief write the last block and the pyramid, complete the header and close the summary file
+ *
+*/
+void close_rec_summary(rec_summary* summary);
+
+#endif // REC_SUMMARY_H
@@ -0,0 +1,548 @@
+/*
+--------------------------------------------------------------------------
+* Acoustic monitoring tool for Raspberry Pi based on miniaudio framework *
+*                                                                        *
+* Kaue Werner, 2024                                                      *
+--------------------------------------------------------------------------
+*/
+/**
+ * @file rec_writer.c
+ * @author Kaue Werner
+ * @date 10 Mar 2024
+ * @brief Definition of the background recording writer used in AMT
+ * @version 0.1.0
+*/
+#include "rec_writer.h"
+#include "../tools/tools.h"
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+/**
+ * @brief push event to the writer event queue (audio callback side)
+ * 
+*/
+static void push_event(rec_writer* writer, unsigned type, const struct timeval* timestamp, float levelIndBFS, unsigned thresholdTriggered){
+    rec_writer_event event;
+    event.type = type;
+    event.framePosition = atomic_load_explicit(&writer->frames.writeIndex, memory_order_relaxed);
+    if(timestamp){
+        event.timestamp = *timestamp;
+    }
+    else {
+        gettimeofday(&event.timestamp, NULL);
+    }
+    event.levelIndBFS = levelIndBFS;
+    event.thresholdTriggered = thresholdTriggered;
+    if(!ring_buffer_write(&writer->events, &event, 1)){
+        atomic_fetch_add_explicit(&writer->eventOverflowCount, 1, memory_order_relaxed);
+    }
+}
+
+/**
+ * @brief thread CPU time in seconds
+ * 
+*/
+static double get_thread_cpu_time(){
+    struct timespec ts;
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+/**
+ * @brief WAV encoder write callback on the writer output file (writer thread side)
+ * 
+*/
+static ma_result write_wav_output(ma_encoder* encoder, const void* buffer, size_t bytesToWrite, size_t* bytesWritten){
+    rec_writer* writer = (rec_writer*) encoder->pUserData;
+    size_t written = fwrite(buffer, 1, bytesToWrite, writer->outputFile);
+    if(bytesWritten){
+        *bytesWritten = written;
+    }
+    return (written == bytesToWrite) ? MA_SUCCESS : MA_ERROR;
+}
+
+/**
+ * @brief WAV encoder seek callback on the writer output file (writer thread side)
+ * 
+*/
+static ma_result seek_wav_output(ma_encoder* encoder, ma_int64 offset, ma_seek_origin origin){
+    rec_writer* writer = (rec_writer*) encoder->pUserData;
+    int whence = (origin == ma_seek_origin_start) ? SEEK_SET : ((origin == ma_seek_origin_end) ? SEEK_END : SEEK_CUR);
+    return fseeko(writer->outputFile, (off_t) offset, whence) ? MA_ERROR : MA_SUCCESS;
+}
+
+/**
+ * @brief open WAV encoder on the output file, returns 0 on success (writer thread side)
+ * 
+*/
+static int open_wav_encoder(rec_writer* writer){
+    // read back by the checkpoints to find the data chunk
+    writer->outputFile = fopen(writer->outputFileName, "w+b");
+    if(!writer->outputFile){
+        return -1;
+    }
+    if(ma_encoder_init(write_wav_output, seek_wav_output, writer, &writer->encoderConfig, &writer->encoder) != MA_SUCCESS){
+        fclose(writer->outputFile);
+        writer->outputFile = NULL;
+        return -1;
+    }
+    return 0;
+}
+
+/**
+ * @brief FLAC encoder write callback on the writer output file (writer thread side)
+ * 
+*/
+static FLAC__StreamEncoderWriteStatus write_flac_output(const FLAC__StreamEncoder* encoder, const FLAC__byte buffer[], size_t bytes, 
+                                                        unsigned samples, unsigned currentFrame, void* clientData){
+    rec_writer* writer = (rec_writer*) clientData;
+    return (fwrite(buffer, 1, bytes, writer->outputFile) == bytes) ? FLAC__STREAM_ENCODER_WRITE_STATUS_OK : FLAC__STREAM_ENCODER_WRITE_STATUS_FATAL_ERROR;
+}
+
+/**
+ * @brief FLAC encoder seek callback on the writer output file, used to rewrite STREAMINFO (writer thread side)
+ * 
+*/
+static FLAC__StreamEncoderSeekStatus seek_flac_output(const FLAC__StreamEncoder* encoder, FLAC__uint64 absoluteByteOffset, void* clientData){
+    rec_writer* writer = (rec_writer*) clientData;
+    return fseeko(writer->outputFile, (off_t) absoluteByteOffset, SEEK_SET) ? FLAC__STREAM_ENCODER_SEEK_STATUS_ERROR : FLAC__STREAM_ENCODER_SEEK_STATUS_OK;
+}
+
+/**
+ * @brief FLAC encoder tell callback on the writer output file (writer thread side)
+ * 
+*/
+static FLAC__StreamEncoderTellStatus tell_flac_output(const FLAC__StreamEncoder* encoder, FLAC__uint64* absoluteByteOffset, void* clientData){
+    rec_writer* writer = (rec_writer*) clientData;
+    off_t position = ftello(writer->outputFile);
+    if(position < 0){
+        return FLAC__STREAM_ENCODER_TELL_STATUS_ERROR;
+    }
+    *absoluteByteOffset = (FLAC__uint64) position;
+    return FLAC__STREAM_ENCODER_TELL_STATUS_OK;
+}
+
+/**
+ * @brief open FLAC stream encoder on the output file, returns 0 on success (writer thread side)
+ * 
+*/
+static int open_flac_encoder(rec_writer* writer){
+    writer->flacEncoder = FLAC__stream_encoder_new();
+    if(!writer->flacEncoder){
+        return -1;
+    }
+    // opened and closed by the writer, with FLAC__stream_encoder_init_FILE a failed init may or may not close it depending on the libFLAC version
+    writer->outputFile = fopen(writer->outputFileName, "w+b");
+    if(!writer->outputFile){
+        FLAC__stream_encoder_delete(writer->flacEncoder);
+        writer->flacEncoder = NULL;
+        return -1;
+    }
+    FLAC__stream_encoder_set_channels(writer->flacEncoder, writer->encoderConfig.channels);
+    FLAC__stream_encoder_set_bits_per_sample(writer->flacEncoder, writer->outputConfig.bitDepth);
+    FLAC__stream_encoder_set_sample_rate(writer->flacEncoder, writer->encoderConfig.sampleRate);
+    FLAC__stream_encoder_set_compression_level(writer->flacEncoder, writer->outputConfig.compressionLevel);
+    if(FLAC__stream_encoder_init_stream(writer->flacEncoder, write_flac_output, seek_flac_output, tell_flac_output, 
+                                        NULL, writer) != FLAC__STREAM_ENCODER_INIT_STATUS_OK){
+        FLAC__stream_encoder_delete(writer->flacEncoder);
+        writer->flacEncoder = NULL;
+        fclose(writer->outputFile);
+        writer->outputFile = NULL;
+        return -1;
+    }
+    return 0;
+}
+
+/**
+ * @brief make the data written so far durable: patch the WAV header sizes up to the 
+ * last complete frame and fdatasync the output and summary files (writer thread side)
+ * 
+*/
+static void checkpoint_output_file(rec_writer* writer){
+    clock_gettime(CLOCK_MONOTONIC, &writer->lastCheckpoint);
+    if(!writer->outputFile){
+        return;
+    }
+    fflush(writer->outputFile);
+    int fd = fileno(writer->outputFile);
+    // a FLAC stream is decodable up to its last complete frame without the final STREAMINFO, WAV sizes are patched
+    if(writer->outputConfig.fileFormat != FLAC_FORMAT){
+        if(!writer->outputLayoutValid && !read_wav_layout(fd, &writer->outputLayout)){
+            writer->outputLayoutValid = 1;
+        }
+        struct stat fileInfo;
+        unsigned long long dataStart = writer->outputLayout.dataChunkOffset + 8;
+        if(writer->outputLayoutValid && !fstat(fd, &fileInfo) && (unsigned long long) fileInfo.st_size >= dataStart){
+            unsigned long long dataBytes = (unsigned long long) fileInfo.st_size - dataStart;
+            write_wav_sizes(fd, &writer->outputLayout, dataBytes - dataBytes % writer->outputLayout.blockAlign);
+        }
+    }
+    fdatasync(fd);
+    sync_rec_summary(&writer->summary);
+}
+
+/**
+ * @brief write float frames to the output file (writer thread side)
+ * 
+*/
+static void write_output_frames(rec_writer* writer, const float* frames, size_t frameCount){
+    double cpuTimeStart = get_thread_cpu_time();
+    // raw PCM size, an upper bound for FLAC until the file is closed
+    if(writer->outputConfig.storage){
+        storage_account_bytes(writer->outputConfig.storage, 
+                              (unsigned long long) frameCount * writer->encoderConfig.channels * (writer->outputConfig.bitDepth / 8));
+    }
+    if(writer->conversionBuffer){
+        // integer output: dithered conversion in blocks, then FLAC encoding or packing for the WAV encoder
+        const unsigned channels = writer->encoderConfig.channels;
+        while(frameCount){
+            size_t blockFrames = (frameCount < WRITER_CONVERSION_BLOCK_SIZE) ? frameCount : WRITER_CONVERSION_BLOCK_SIZE;
+            size_t blockSamples = blockFrames * channels;
+            writer->clippedSamples += convert_float_to_int32(&writer->dither, frames, writer->conversionBuffer, 
+                                                             blockSamples, writer->outputConfig.bitDepth);
+            if(writer->outputConfig.fileFormat == FLAC_FORMAT){
+                FLAC__stream_encoder_process_interleaved(writer->flacEncoder, writer->conversionBuffer, (unsigned) blockFrames);
+            }
+            else {
+                if(writer->outputConfig.bitDepth == 16){
+                    pack_int32_to_s16(writer->conversionBuffer, (int16_t*) writer->packBuffer, blockSamples);
+                }
+                else {
+                    pack_int32_to_s24(writer->conversionBuffer, writer->packBuffer, blockSamples);
+                }
+                ma_encoder_write_pcm_frames(&writer->encoder, writer->packBuffer, blockFrames, NULL);
+            }
+            frames += blockSamples;
+            frameCount -= blockFrames;
+            writer->framesWritten += blockFrames;
+        }
+    }
+    else {
+        ma_encoder_write_pcm_frames(&writer->encoder, frames, frameCount, NULL);
+        writer->framesWritten += frameCount;
+    }
+    double encodeTime = get_thread_cpu_time() - cpuTimeStart;
+    writer->encodeCpuTime += encodeTime;
+    atomic_fetch_add(&writer->totalEncodeNanoseconds, (unsigned long long)(encodeTime * 1e9));
+}
+
+/**
+ * @brief open output and log files (writer thread side)
+ * 
+*/
+static void open_output_file(rec_writer* writer, rec_writer_event* event){
+    unsigned flacOutput = writer->outputConfig.fileFormat == FLAC_FORMAT;
+    update_output_file_name(writer->outputFileName, MAX_CHAR_LENGTH, writer->outputConfig.outputDirectory, &event->timestamp, flacOutput ? ".flac" : ".wav");
+#ifdef DEBUG
+    printf("-> Updated rec output file name: %s\n", writer->outputFileName);
+#endif
+    // no room left even after eviction, the recording is skipped but still logged
+    unsigned storageFull = writer->outputConfig.storage && !storage_has_room(writer->outputConfig.storage);
+    if(storageFull){
+        atomic_fetch_add(&writer->outputConfig.storage->skippedRecordings, 1);
+        writer->fileOpen = 0;
+    }
+    else if((flacOutput && open_flac_encoder(writer)) || (!flacOutput && open_wav_encoder(writer))){
+        printf("Failed to initialize output file.\n");
+        writer->fileOpen = 0;
+    }
+    else {
+        writer->fileOpen = 1;
+        if(writer->outputConfig.enableSummary && 
+           open_rec_summary(&writer->summary, writer->outputFileName, writer->encoderConfig.channels, 
+                            writer->encoderConfig.sampleRate, &event->timestamp)){
+            printf("Failed to open recording summary file.\n");
+        }
+        writer->outputLayoutValid = 0;
+        clock_gettime(CLOCK_MONOTONIC, &writer->lastCheckpoint);
+    }
+    writer->filePriority = event->thresholdTriggered ? STORAGE_PRIORITY_TRIGGERED : STORAGE_PRIORITY_SCHEDULED;
+    writer->framesWritten = 0;
+    writer->clippedSamples = 0;
+    writer->encodeCpuTime = 0.0;
+    writer->droppedFramesAtOpen = atomic_load(&writer->frames.droppedFrames);
+    writer->highWaterMarkCountAtOpen = atomic_load(&writer->frames.highWaterMarkCount);
+
+    // open log file named after the date the recording started
+    char logFileName[MAX_CHAR_LENGTH];
+    char date[MAX_CHAR_LENGTH];
+    strcpy(logFileName, writer->outputConfig.logFilePath);
+    time_t startTime = event->timestamp.tv_sec;
+    // reentrant variants, the capture and analysis threads format times concurrently
+    struct tm startInfo;
+    localtime_r(&startTime, &startInfo);
+    strftime(date, MAX_CHAR_LENGTH, DATE_LABEL, &startInfo);
+    writer->logFile = fopen(strcat(strcat(logFileName, date), ".txt"), "a");
+    if(writer->logFile){
+        if(event->thresholdTriggered){
+            fprintf(writer->logFile, "%s level = %.2fdBFS\t", writer->outputConfig.levelName, event->levelIndBFS);
+        }
+        else {
+            fprintf(writer->logFile, "Rec initialized at ");
+        }
+        char startTimeLabel[MAX_CHAR_LENGTH];
+        fprintf(writer->logFile, "%s", ctime_r(&startTime, startTimeLabel));
+        if(storageFull){
+            fprintf(writer->logFile, "Recording skipped, storage full\n");
+        }
+    }
+}
+
+/**
+ * @brief close output and log files (writer thread side)
+ * 
+*/
+static void close_output_file(rec_writer* writer){
+    unsigned long droppedFrames = atomic_load(&writer->frames.droppedFrames) - writer->droppedFramesAtOpen;
+    unsigned long highWaterMarkCount = atomic_load(&writer->frames.highWaterMarkCount) - writer->highWaterMarkCountAtOpen;
+#ifdef DEBUG
+    printf("-> Writer buffer max fill: %zu of %zu frames, high-water mark reached %lu time(s)\n",
+           atomic_load(&writer->frames.maxFillInFrames), writer->frames.capacityInFrames, highWaterMarkCount);
+#endif
+    if(writer->fileOpen){
+        double cpuTimeStart = get_thread_cpu_time();
+        if(writer->outputConfig.fileFormat == FLAC_FORMAT){
+            FLAC__stream_encoder_finish(writer->flacEncoder);
+            FLAC__stream_encoder_delete(writer->flacEncoder);
+            writer->flacEncoder = NULL;
+        }
+        else {
+            ma_encoder_uninit(&writer->encoder);
+        }
+        if(writer->outputConfig.syncInterval > 0.0f){
+            fflush(writer->outputFile);
+            fdatasync(fileno(writer->outputFile));
+        }
+        fclose(writer->outputFile);
+        writer->outputFile = NULL;
+        double encodeTime = get_thread_cpu_time() - cpuTimeStart;
+        writer->encodeCpuTime += encodeTime;
+        atomic_fetch_add(&writer->totalEncodeNanoseconds, (unsigned long long)(encodeTime * 1e9));
+        writer->fileOpen = 0;
+        close_rec_summary(&writer->summary);
+        if(writer->outputConfig.storage){
+            storage_add_file(writer->outputConfig.storage, writer->outputFileName, writer->filePriority);
+        }
+
+        // compression ratio with respect to raw PCM of the same bit depth
+        struct stat fileInfo;
+        if(writer->outputConfig.fileFormat == FLAC_FORMAT && writer->logFile && 
+           !stat(writer->outputFileName, &fileInfo) && fileInfo.st_size > 0){
+            double rawBytes = (double) writer->framesWritten * writer->encoderConfig.channels * (writer->outputConfig.bitDepth / 8);
+            fprintf(writer->logFile, "FLAC compression ratio = %.2f\tencode CPU time = %.3fs\n", 
+                    rawBytes / (double) fileInfo.st_size, writer->encodeCpuTime);
+        }
+    }
+    if(writer->logFile){
+        if(writer->conversionBuffer){
+            fprintf(writer->logFile, "Clipped samples = %lu\n", writer->clippedSamples);
+        }
+        if(droppedFrames || highWaterMarkCount){
+            fprintf(writer->logFile, "Writer buffer dropped frames = %lu\thigh-water mark count = %lu\n", 
+                    droppedFrames, highWaterMarkCount);
+        }
+        fclose(writer->logFile);
+        writer->logFile = NULL;
+    }
+}
+
+/**
+ * @brief write frames available up to the next event and apply it, returns 
+ * the number of frames written plus events applied (writer thread side)
+ * 
+*/
+static size_t process_pending_data(rec_writer* writer){
+    size_t processed = 0;
+    rec_writer_event* event = NULL;
+    void* ptr;
+
+    if(ring_buffer_peek(&writer->events, &ptr)){
+        event = (rec_writer_event*) ptr;
+    }
+
+    size_t readIndex = atomic_load_explicit(&writer->frames.readIndex, memory_order_relaxed);
+    size_t frameCount = ring_buffer_peek(&writer->frames, &ptr);
+    if(event && frameCount > event->framePosition - readIndex){
+        frameCount = event->framePosition - readIndex;
+    }
+    // the file system ran out of room during the recording, keep what was written as a valid file
+    if(writer->fileOpen && writer->outputConfig.storage && !storage_has_room(writer->outputConfig.storage)){
+        if(writer->logFile){
+            fprintf(writer->logFile, "Recording stopped, storage full\n");
+        }
+        close_output_file(writer);
+    }
+    if(frameCount){
+        if(writer->fileOpen){
+            write_output_frames(writer, (const float*) ptr, frameCount);
+            update_rec_summary(&writer->summary, (const float*) ptr, frameCount);
+        }
+        ring_buffer_consume(&writer->frames, frameCount);
+        readIndex += frameCount;
+        processed += frameCount;
+    }
+    if(writer->fileOpen && writer->outputConfig.syncInterval > 0.0f){
+        struct timespec now;
+        clock_gettime(CLOCK_MONOTONIC, &now);
+        if((now.tv_sec - writer->lastCheckpoint.tv_sec) + (now.tv_nsec - writer->lastCheckpoint.tv_nsec) * 1e-9 >= writer->outputConfig.syncInterval){
+            checkpoint_output_file(writer);
+        }
+    }
+
+    if(event && readIndex == event->framePosition){
+        switch(event->type){
+            case REC_WRITER_OPEN_FILE:
+                if(writer->fileOpen || writer->logFile){
+                    close_output_file(writer);
+                }
+                open_output_file(writer, event);
+            break;
+            case REC_WRITER_CLOSE_FILE:
+            default:
+                close_output_file(writer);
+            break;
+        }
+        ring_buffer_consume(&writer->events, 1);
+        processed++;
+    }
+    return processed;
+}
+
+/**
+ * @brief writer thread main loop
+ * 
+*/
+static void* writer_thread(void* arg){
+    rec_writer* writer = (rec_writer*) arg;
+    while(1){
+        if(process_pending_data(writer)){
+            continue;
+        }
+        if(atomic_load(&writer->stopRequested)){
+            break;
+        }
+        usleep(WRITER_POLL_PERIOD_MS * 1000);
+    }
+    if(writer->fileOpen || writer->logFile){
+        close_output_file(writer);
+    }
+    return NULL;
+}
+
+/**
+ * @brief initialize recording writer (rec_writer) and start its thread, returns 0 on success
+ * 
+*/
+int init_rec_writer(rec_writer* writer, const ma_encoder_config* encoderConfig, const rec_output_config* outputConfig, 
+                    size_t capacityInFrames, size_t highWaterMarkInFrames){
+    writer->encoderConfig = *encoderConfig;
+    writer->outputConfig = *outputConfig;
+    writer->logFile = NULL;
+    writer->fileOpen = 0;
+    writer->flacEncoder = NULL;
+    writer->outputFile = NULL;
+    writer->conversionBuffer = NULL;
+    writer->packBuffer = NULL;
+    init_tpdf_dither(&writer->dither, outputConfig->ditherSeed, outputConfig->enableDither);
+    init_rec_summary(&writer->summary);
+
+    // FLAC only handles integer samples, float input is stored with 24 bits
+    if(writer->outputConfig.fileFormat == FLAC_FORMAT && writer->outputConfig.bitDepth != 16){
+        writer->outputConfig.bitDepth = 24;
+    }
+    if(writer->outputConfig.bitDepth != 32){
+        writer->conversionBuffer = malloc(WRITER_CONVERSION_BLOCK_SIZE * encoderConfig->channels * sizeof(int32_t));
+        writer->packBuffer = malloc(WRITER_CONVERSION_BLOCK_SIZE * encoderConfig->channels * 3);
+        if(!writer->conversionBuffer || !writer->packBuffer){
+            free(writer->conversionBuffer);
+            free(writer->packBuffer);
+            return -1;
+        }
+    }
+    atomic_init(&writer->stopRequested, 0);
+    atomic_init(&writer->eventOverflowCount, 0);
+    atomic_init(&writer->totalEncodeNanoseconds, 0);
+
+    size_t bytesPerFrame = encoderConfig->channels * sizeof(float);
+    if(init_ring_buffer(&writer->frames, capacityInFrames, bytesPerFrame, highWaterMarkInFrames)){
+        free(writer->conversionBuffer);
+        free(writer->packBuffer);
+        return -1;
+    }
+    if(init_ring_buffer(&writer->events, WRITER_EVENT_QUEUE_SIZE, sizeof(rec_writer_event), WRITER_EVENT_QUEUE_SIZE)){
+        free_ring_buffer(&writer->frames);
+        free(writer->conversionBuffer);
+        free(writer->packBuffer);
+        return -1;
+    }
+    if(pthread_create(&writer->thread, NULL, writer_thread, writer)){
+        free_ring_buffer(&writer->frames);
+        free_ring_buffer(&writer->events);
+        free(writer->conversionBuffer);
+        free(writer->packBuffer);
+        return -1;
+    }
+#ifdef DEBUG
+    printf("-> Writer buffer capacity: %zu frames\n", writer->frames.capacityInFrames);
+#endif
+    return 0;
+}
+
+/**
+ * @brief write all pending frames/events, stop the writer thread and free recording writer (rec_writer)
+ * 
+*/
+void fini_rec_writer(rec_writer* writer){
+    atomic_store(&writer->stopRequested, 1);
+    pthread_join(writer->thread, NULL);
+#ifdef DEBUG
+    printf("-> Writer overflows: %lu (%lu dropped frames), event overflows: %lu\n",
+           atomic_load(&writer->frames.overflowCount), atomic_load(&writer->frames.droppedFrames),
+           atomic_load(&writer->eventOverflowCount));
+#endif
+    free_ring_buffer(&writer->frames);
+    free_ring_buffer(&writer->events);
+    free(writer->conversionBuffer);
+    free(writer->packBuffer);
+    free_rec_summary(&writer->summary);
+}
+
+/**
+ * @brief push processed frames to the writer (audio callback side)
+ * 
+*/
+size_t rec_writer_push_frames(rec_writer* writer, const void* frames, size_t frameCount){
+    return ring_buffer_write(&writer->frames, frames, frameCount);
+}
+
+/**
+ * @brief request a new output file starting at the next pushed frame (audio callback side)
+ * 
+*/
+void rec_writer_open_file(rec_writer* writer, const struct timeval* timestamp, float levelIndBFS, unsigned thresholdTriggered){
+    push_event(writer, REC_WRITER_OPEN_FILE, timestamp, levelIndBFS, thresholdTriggered);
+}
+
+/**
+ * @brief request closing of the current output file after the last pushed frame (audio callback side)
+ * 
+*/
+void rec_writer_close_file(rec_writer* writer){
+    push_event(writer, REC_WRITER_CLOSE_FILE, NULL, 0.0f, 0);
+}
+
+/**
+ * @brief block until the writer buffer has room for frameCount frames and two events 
+ * (producer side, used when the producer is not real-time, e.g. file replay)
+ * 
+*/
+void rec_writer_wait_for_space(rec_writer* writer, size_t frameCount){
+    while(writer->frames.capacityInFrames - ring_buffer_fill(&writer->frames) < frameCount ||
+          writer->events.capacityInFrames - ring_buffer_fill(&writer->events) < 2){
+        usleep(WRITER_POLL_PERIOD_MS * 100);
+    }
+}
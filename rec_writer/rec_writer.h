@@ -0,0 +1,153 @@
+/*
+--------------------------------------------------------------------------
+* Acoustic monitoring tool for Raspberry Pi based on miniaudio framework *
+*                                                                        *
+* Kaue Werner, 2024                                                      *
+--------------------------------------------------------------------------
+*/
+/**
+ * @file rec_writer.h
+ * @author Kaue Werner
+ * @date 10 Mar 2024
+ * @brief Header with the background recording writer used in AMT
+ * @version 0.1.0
+*/
+#ifndef REC_WRITER_H
+#define REC_WRITER_H
+#include "../../miniaudio/miniaudio.h"
+#include "../config_defines.h"
+#include "../ring_buffer/ring_buffer.h"
+#include "../audio_proc/pcm_convert.h"
+#include "rec_summary.h"
+#include "wav_recovery.h"
+#include "../storage/storage.h"
+#include <FLAC/stream_encoder.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <sys/time.h>
+#include <time.h>
+
+/**
+ * @brief Current available types of writer event
+ *
+*/
+typedef enum {
+    REC_WRITER_OPEN_FILE,
+    REC_WRITER_CLOSE_FILE
+} rec_writer_event_type;
+
+/**
+ * @brief Writer event data struct, applied by the writer thread once all
+ * frames pushed before the event have been written
+ *
+*/
+typedef struct {
+    unsigned type;
+    size_t framePosition;
+    struct timeval timestamp;
+    float levelIndBFS;
+    unsigned thresholdTriggered:1;
+} rec_writer_event;
+
+/**
+ * @brief Recording output settings data struct
+ * fileFormat is an amt_output_format, bitDepth is 16 or 24 (integer PCM, 
+ * optionally with TPDF dither) or 32 (float, WAV only, FLAC falls back to 24), 
+ * levelName is the trigger level metric written to the log (e.g. LAF), 
+ * storage the storage manager the recordings are accounted to (NULL: none), 
+ * enableSummary writes a rec_summary sidecar next to each recording, 
+ * syncInterval is the period in seconds of the size checkpoints and fdatasync 
+ * of the open recording (0: only on close, as the encoder does), 
+ * outputDirectory and logFilePath are the recording directory and the prefix 
+ * of the daily log files, ditherSeed the seed of the dither noise
+*/
+typedef struct {
+    unsigned fileFormat;
+    unsigned bitDepth;
+    unsigned compressionLevel;
+    unsigned enableDither:1;
+    const char* levelName;
+    storage_manager* storage;
+    unsigned enableSummary:1;
+    float syncInterval;
+    const char* outputDirectory;
+    const char* logFilePath;
+    uint32_t ditherSeed;
+} rec_output_config;
+
+/**
+ * @brief Recording writer data struct
+ * The audio callback is the single producer of frames and events, the writer 
+ * thread is the single consumer and owns the encoder and log file lifetimes.
+*/
+typedef struct {
+    ring_buffer frames;
+    ring_buffer events;
+    ma_encoder_config encoderConfig;
+    ma_encoder encoder;
+    rec_output_config outputConfig;
+    FLAC__StreamEncoder* flacEncoder;
+    FILE* outputFile;
+    wav_layout outputLayout;
+    unsigned outputLayoutValid:1;
+    struct timespec lastCheckpoint;
+    tpdf_dither dither;
+    rec_summary summary;
+    int32_t* conversionBuffer;
+    unsigned char* packBuffer;
+    FILE* logFile;
+    pthread_t thread;
+    atomic_int stopRequested;
+    atomic_ulong eventOverflowCount;
+    atomic_ullong totalEncodeNanoseconds;
+    unsigned fileOpen:1;
+    unsigned filePriority;
+    char outputFileName[MAX_CHAR_LENGTH];
+    /* overflow counters when the current file was opened */
+    unsigned long droppedFramesAtOpen;
+    unsigned long highWaterMarkCountAtOpen;
+    /* statistics of the current file */
+    unsigned long long framesWritten;
+    unsigned long clippedSamples;
+    double encodeCpuTime;
+} rec_writer;
+
+/**
+ * @brief initialize recording writer (rec_writer) and start its thread, returns 0 on success
+ * 
+*/
+int init_rec_writer(rec_writer* writer, const ma_encoder_config* encoderConfig, const rec_output_config* outputConfig, 
+                    size_t capacityInFrames, size_t highWaterMarkInFrames);
+
+/**
+ * @brief write all pending frames/events, stop the writer thread and free recording writer (rec_writer)
+ * 
+*/
+void fini_rec_writer(rec_writer* writer);
+
+/**
+ * @brief push processed frames to the writer (audio callback side)
+ * 
+*/
+size_t rec_writer_push_frames(rec_writer* writer, const void* frames, size_t frameCount);
+
+/**
+ * @brief request a new output file starting at the next pushed frame (audio callback side)
+ * 
+*/
+void rec_writer_open_file(rec_writer* writer, const struct timeval* timestamp, float levelIndBFS, unsigned thresholdTriggered);
+
+/**
+ * @brief request closing of the current output file after the last pushed frame (audio callback side)
+ * 
+*/
+void rec_writer_close_file(rec_writer* writer);
+
+/**
+ * @brief block until the writer buffer has room for frameCount frames and two events 
+ * (producer side, used when the producer is not real-time, e.g. file replay)
+ * 
+*/
+void rec_writer_wait_for_space(rec_writer* writer, size_t frameCount);
+
+#endif // REC_WRITER_H
@@ -0,0 +1,170 @@
+/*
+--------------------------------------------------------------------------
+* Acoustic monitoring tool for Raspberry Pi based on miniaudio framework *
+*                                                                        *
+* Kaue Werner, 2024                                                      *
+--------------------------------------------------------------------------
+*/
+/**
+ * @file wav_recovery.c
+ * @author Kaue Werner
+ * @date 10 Mar 2024
+ * @brief Definition of the WAV size checkpoints and power loss recovery used in AMT
+ *
+ * The RIFF and data chunk sizes are only written by the encoder when a file
+ * is closed. The writer patches them in place at each checkpoint, and after a
+ * power loss recover_wav_file extends them to the last complete frame on disk.
+ * @version 0.1.0
+*/
+#include "wav_recovery.h"
+#include "../config_defines.h"
+#include <dirent.h>
+#include <fcntl.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#define WAV_MAX_CHUNKS 32
+#define WAV_MAX_SIZE 0xFFFFFFFFULL
+
+/**
+ * @brief little-endian 32-bit value
+ *
+*/
+static uint32_t read_le32(const unsigned char* bytes){
+    return (uint32_t) bytes[0] | ((uint32_t) bytes[1] << 8) | ((uint32_t) bytes[2] << 16) | ((uint32_t) bytes[3] << 24);
+}
+
+/**
+ * @brief write little-endian 32-bit value at offset, returns 0 on success
+ *
+*/
+static int write_le32(int fd, unsigned long long offset, uint32_t value){
+    unsigned char bytes[4] = {value & 0xFF, (value >> 8) & 0xFF, (value >> 16) & 0xFF, (value >> 24) & 0xFF};
+    return (pwrite(fd, bytes, 4, (off_t) offset) == 4) ? 0 : -1;
+}
+
+/**
+ * @brief find the fmt block alignment and the data chunk of an open WAV file, returns 0 on success
+ *
+*/
+int read_wav_layout(int fd, wav_layout* layout){
+    unsigned char header[16];
+    if(pread(fd, header, 12, 0) != 12 || memcmp(header, "RIFF", 4) || memcmp(header + 8, "WAVE", 4)){
+        return -1;
+    }
+    layout->blockAlign = 0;
+    unsigned long long offset = 12;
+    for(unsigned n = 0; n < WAV_MAX_CHUNKS; n++){
+        if(pread(fd, header, 8, (off_t) offset) != 8){
+            return -1;
+        }
+        uint32_t chunkSize = read_le32(header + 4);
+        if(!memcmp(header, "data", 4)){
+            layout->dataChunkOffset = offset;
+            return layout->blockAlign ? 0 : -1;
+        }
+        if(!memcmp(header, "fmt ", 4)){
+            if(pread(fd, header, 16, (off_t)(offset + 8)) != 16){
+                return -1;
+            }
+            layout->blockAlign = (unsigned) header[12] | ((unsigned) header[13] << 8);
+        }
+        offset += 8 + (unsigned long long) chunkSize + (chunkSize & 1);
+    }
+    return -1;
+}
+
+/**
+ * @brief write the RIFF and data chunk sizes of a WAV file whose data chunk holds
+ * dataBytes bytes and is the last chunk, returns 0 on success
+ *
+*/
+int write_wav_sizes(int fd, const wav_layout* layout, unsigned long long dataBytes){
+    // RIFF sizes count the pad byte of an odd-sized chunk
+    unsigned long long riffSize = layout->dataChunkOffset + 8 + dataBytes + (dataBytes & 1) - 8;
+    if(riffSize > WAV_MAX_SIZE){
+        return -1;
+    }
+    if(write_le32(fd, layout->dataChunkOffset + 4, (uint32_t) dataBytes) || write_le32(fd, 4, (uint32_t) riffSize)){
+        return -1;
+    }
+    return 0;
+}
+
+/**
+ * @brief repair the header sizes of a WAV file left open by a power loss, the data chunk
+ * is extended to the last complete frame on disk. Returns 1 if the file was repaired,
+ * 0 if its header was consistent and -1 if it is not a readable WAV file
+ *
+*/
+int recover_wav_file(const char* path){
+    int fd = open(path, O_RDWR);
+    if(fd < 0){
+        return -1;
+    }
+    wav_layout layout;
+    struct stat fileInfo;
+    unsigned char sizes[4];
+    if(read_wav_layout(fd, &layout) || fstat(fd, &fileInfo) || pread(fd, sizes, 4, 4) != 4){
+        close(fd);
+        return -1;
+    }
+    unsigned long long fileSize = (unsigned long long) fileInfo.st_size;
+    unsigned long long dataStart = layout.dataChunkOffset + 8;
+    unsigned long long riffSize = read_le32(sizes);
+    if(pread(fd, sizes, 4, (off_t)(layout.dataChunkOffset + 4)) != 4){
+        close(fd);
+        return -1;
+    }
+    unsigned long long dataSize = read_le32(sizes);
+    if(riffSize + 8 == fileSize && dataStart + dataSize <= fileSize){
+        close(fd);
+        return 0;
+    }
+
+    // keep the complete frames, a partial last frame is cut so the file stays consistent
+    unsigned long long dataBytes = (fileSize > dataStart) ? fileSize - dataStart : 0;
+    dataBytes -= dataBytes % layout.blockAlign;
+    if(dataStart + dataBytes + 1 - 8 > WAV_MAX_SIZE){
+        close(fd);
+        return -1;
+    }
+    int result = (ftruncate(fd, (off_t)(dataStart + dataBytes + (dataBytes & 1))) ||
+                  write_wav_sizes(fd, &layout, dataBytes) || fsync(fd)) ? -1 : 1;
+    close(fd);
+    return result;
+}
+
+/**
+ * @brief repair all WAV files in a directory, onRecovered (optional) is called for each 
+ * repaired file, returns the number of repaired files
+ *
+*/
+unsigned recover_wav_files(const char* directory, wav_recovery_callback onRecovered, void* userData){
+    unsigned repairedFiles = 0;
+    DIR* dir = opendir(directory);
+    if(!dir){
+        return 0;
+    }
+    struct dirent* entry;
+    while((entry = readdir(dir))){
+        size_t length = strlen(entry->d_name);
+        if(length < 4 || strcmp(entry->d_name + length - 4, ".wav")){
+            continue;
+        }
+        char path[MAX_CHAR_LENGTH];
+        snprintf(path, MAX_CHAR_LENGTH, "%s/%s", directory, entry->d_name);
+        if(recover_wav_file(path) == 1){
+            printf("Recovered %s\n", path);
+            if(onRecovered){
+                onRecovered(path, userData);
+            }
+            repairedFiles++;
+        }
+    }
+    closedir(dir);
+    return repairedFiles;
+}
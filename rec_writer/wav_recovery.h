@@ -0,0 +1,61 @@
+/*
+--------------------------------------------------------------------------
+* Acoustic monitoring tool for Raspberry Pi based on miniaudio framework *
+*                                                                        *
+* Kaue Werner, 2024                                                      *
+--------------------------------------------------------------------------
+*/
+/**
+ * @file wav_recovery.h
+ * @author Kaue Werner
+ * @date 10 Mar 2024
+ * @brief Header with the WAV size checkpoints and power loss recovery used in AMT
+ * @version 0.1.0
+*/
+#ifndef WAV_RECOVERY_H
+#define WAV_RECOVERY_H
+
+/**
+ * @brief WAV file layout data struct
+ * dataChunkOffset is the offset of the "data" chunk id, the samples start 8 bytes later
+*/
+typedef struct {
+    unsigned long long dataChunkOffset;
+    unsigned blockAlign;
+} wav_layout;
+
+/**
+ * @brief callback receiving the path of each file repaired by recover_wav_files
+ *
+*/
+typedef void (*wav_recovery_callback)(const char* path, void* userData);
+
+/**
+ * @brief find the fmt block alignment and the data chunk of an open WAV file, returns 0 on success
+ *
+*/
+int read_wav_layout(int fd, wav_layout* layout);
+
+/**
+ * @brief write the RIFF and data chunk sizes of a WAV file whose data chunk holds
+ * dataBytes bytes and is the last chunk, returns 0 on success
+ *
+*/
+int write_wav_sizes(int fd, const wav_layout* layout, unsigned long long dataBytes);
+
+/**
+ * @brief repair the header sizes of a WAV file left open by a power loss, the data chunk
+ * is extended to the last complete frame on disk. Returns 1 if the file was repaired,
+ * 0 if its header was consistent and -1 if it is not a readable WAV file
+ *
+*/
+int recover_wav_file(const char* path);
+
+/**
+ * @brief repair all WAV files in a directory, onRecovered (optional) is called for each 
+ * repaired file, returns the number of repaired files
+ *
+*/
+unsigned recover_wav_files(const char* directory, wav_recovery_callback onRecovered, void* userData);
+
+#endif // WAV_RECOVERY_H
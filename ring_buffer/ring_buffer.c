@@ -0,0 +1,207 @@
+/*
+--------------------------------------------------------------------------
+* Acoustic monitoring tool for Raspberry Pi based on miniaudio framework *
+*                                                                        *
+* Kaue Werner, 2024                                                      *
+--------------------------------------------------------------------------
+*/
+/**
+ * @file ring_buffer.c
+ * @author Kaue Werner
+ * @date 10 Mar 2024
+ * @brief Definition of the lock-free single-producer/single-consumer ring buffer used in AMT
+ * @version 0.1.0
+*/
+#include "ring_buffer.h"
+#include <stdlib.h>
+#include <string.h>
+
+/**
+ * @brief initialize ring buffer (ring_buffer), returns 0 on success
+ * 
+*/
+int init_ring_buffer(ring_buffer* rb, size_t capacityInFrames, size_t bytesPerFrame, size_t highWaterMarkInFrames){
+    // round capacity up to a power of two
+    size_t capacity = 1;
+    while(capacity < capacityInFrames){
+        capacity <<= 1;
+    }
+    rb->data = malloc(capacity * bytesPerFrame);
+    if(!rb->data){
+        return -1;
+    }
+    rb->capacityInFrames = capacity;
+    rb->bytesPerFrame = bytesPerFrame;
+    rb->highWaterMarkInFrames = (highWaterMarkInFrames < capacity) ? highWaterMarkInFrames : capacity;
+    atomic_init(&rb->writeIndex, 0);
+    atomic_init(&rb->readIndex, 0);
+    atomic_init(&rb->overflowCount, 0);
+    atomic_init(&rb->droppedFrames, 0);
+    atomic_init(&rb->highWaterMarkCount, 0);
+    atomic_init(&rb->maxFillInFrames, 0);
+    return 0;
+}
+
+/**
+ * @brief free ring buffer (ring_buffer)
+ * 
+*/
+void free_ring_buffer(ring_buffer* rb){
+    free(rb->data);
+    rb->data = NULL;
+}
+
+/**
+ * @brief number of frames currently stored in the ring buffer
+ * 
+*/
+size_t ring_buffer_fill(ring_buffer* rb){
+    size_t writeIndex = atomic_load_explicit(&rb->writeIndex, memory_order_acquire);
+    size_t readIndex = atomic_load_explicit(&rb->readIndex, memory_order_acquire);
+    return writeIndex - readIndex;
+}
+
+/**
+ * @brief write frames into the ring buffer (producer side only)
+ * The write is all-or-nothing: if there is no room for all frames, nothing
+ * is written, the overflow counters are updated and 0 is returned.
+*/
+size_t ring_buffer_write(ring_buffer* rb, const void* frames, size_t frameCount){
+    size_t writeIndex = atomic_load_explicit(&rb->writeIndex, memory_order_relaxed);
+    size_t readIndex = atomic_load_explicit(&rb->readIndex, memory_order_acquire);
+    size_t fill = writeIndex - readIndex;
+
+    if(frameCount > rb->capacityInFrames - fill){
+        atomic_fetch_add_explicit(&rb->overflowCount, 1, memory_order_relaxed);
+        atomic_fetch_add_explicit(&rb->droppedFrames, frameCount, memory_order_relaxed);
+        return 0;
+    }
+
+    // copy in (at most) two contiguous spans
+    size_t offset = writeIndex & (rb->capacityInFrames - 1);
+    size_t firstSpan = rb->capacityInFrames - offset;
+    if(firstSpan > frameCount){
+        firstSpan = frameCount;
+    }
+    memcpy(rb->data + offset * rb->bytesPerFrame, frames, firstSpan * rb->bytesPerFrame);
+    if(frameCount > firstSpan){
+        memcpy(rb->data, (const unsigned char*) frames + firstSpan * rb->bytesPerFrame, 
+               (frameCount - firstSpan) * rb->bytesPerFrame);
+    }
+    atomic_store_explicit(&rb->writeIndex, writeIndex + frameCount, memory_order_release);
+
+    // update fill statistics
+    fill += frameCount;
+    if(fill > atomic_load_explicit(&rb->maxFillInFrames, memory_order_relaxed)){
+        atomic_store_explicit(&rb->maxFillInFrames, fill, memory_order_relaxed);
+    }
+    if(fill >= rb->highWaterMarkInFrames){
+        atomic_fetch_add_explicit(&rb->highWaterMarkCount, 1, memory_order_relaxed);
+    }
+    return frameCount;
+}
+
+/**
+ * @brief get pointer to the contiguous readable frames (consumer side only)
+ * Returns the number of contiguous frames available at *frames.
+*/
+size_t ring_buffer_peek(ring_buffer* rb, void** frames){
+    size_t readIndex = atomic_load_explicit(&rb->readIndex, memory_order_relaxed);
+    size_t writeIndex = atomic_load_explicit(&rb->writeIndex, memory_order_acquire);
+    size_t fill = writeIndex - readIndex;
+    size_t offset = readIndex & (rb->capacityInFrames - 1);
+    size_t contiguous = rb->capacityInFrames - offset;
+
+    *frames = rb->data + offset * rb->bytesPerFrame;
+    return (fill < contiguous) ? fill : contiguous;
+}
+
+/**
+ * @brief release frames previously obtained with ring_buffer_peek (consumer side only)
+ * 
+*/
+void ring_buffer_consume(ring_buffer* rb, size_t frameCount){
+    size_t readIndex = atomic_load_explicit(&rb->readIndex, memory_order_relaxed);
+    atomic_store_explicit(&rb->readIndex, readIndex + frameCount, memory_order_release);
+}
+
+/**
+ * @brief initialize empty pre-roll buffer (preroll_buffer), returns 0 on success
+ * 
+*/
+int init_preroll_buffer(preroll_buffer* pb, size_t capacityInFrames, size_t bytesPerFrame){
+    pb->data = calloc(capacityInFrames, bytesPerFrame);
+    if(!pb->data && capacityInFrames){
+        return -1;
+    }
+    pb->capacityInFrames = capacityInFrames;
+    pb->bytesPerFrame = bytesPerFrame;
+    pb->writeCursor = 0;
+    pb->fillInFrames = 0;
+    return 0;
+}
+
+/**
+ * @brief free pre-roll buffer (preroll_buffer)
+ * 
+*/
+void free_preroll_buffer(preroll_buffer* pb){
+    free(pb->data);
+    pb->data = NULL;
+}
+
+/**
+ * @brief empty pre-roll buffer (preroll_buffer), frames written before are not returned anymore
+ * 
+*/
+void reset_preroll_buffer(preroll_buffer* pb){
+    pb->writeCursor = 0;
+    pb->fillInFrames = 0;
+}
+
+/**
+ * @brief overwrite the oldest frames of the pre-roll buffer with new frames
+ * 
+*/
+void preroll_buffer_write(preroll_buffer* pb, const void* frames, size_t frameCount){
+    if(!pb->capacityInFrames){
+        return;
+    }
+    const unsigned char* src = (const unsigned char*) frames;
+    // only the latest capacityInFrames frames can be kept
+    if(frameCount > pb->capacityInFrames){
+        src += (frameCount - pb->capacityInFrames) * pb->bytesPerFrame;
+        frameCount = pb->capacityInFrames;
+    }
+    size_t firstSpan = pb->capacityInFrames - pb->writeCursor;
+    if(firstSpan > frameCount){
+        firstSpan = frameCount;
+    }
+    memcpy(pb->data + pb->writeCursor * pb->bytesPerFrame, src, firstSpan * pb->bytesPerFrame);
+    if(frameCount > firstSpan){
+        memcpy(pb->data, src + firstSpan * pb->bytesPerFrame, (frameCount - firstSpan) * pb->bytesPerFrame);
+    }
+    pb->writeCursor += frameCount;
+    if(pb->writeCursor >= pb->capacityInFrames){
+        pb->writeCursor -= pb->capacityInFrames;
+    }
+    pb->fillInFrames += frameCount;
+    if(pb->fillInFrames > pb->capacityInFrames){
+        pb->fillInFrames = pb->capacityInFrames;
+    }
+}
+
+/**
+ * @brief get the frames written since the last reset (at most capacityInFrames) from 
+ * oldest to newest frame as two contiguous spans
+ * 
+*/
+void preroll_buffer_get_spans(preroll_buffer* pb, void** firstSpan, size_t* firstSpanFrames, void** secondSpan, size_t* secondSpanFrames){
+    // oldest written frame, the span wraps at the end of the buffer
+    size_t oldest = (pb->writeCursor >= pb->fillInFrames) ? pb->writeCursor - pb->fillInFrames : 
+                    pb->writeCursor + pb->capacityInFrames - pb->fillInFrames;
+    *firstSpan = pb->data + oldest * pb->bytesPerFrame;
+    *firstSpanFrames = (oldest + pb->fillInFrames > pb->capacityInFrames) ? pb->capacityInFrames - oldest : pb->fillInFrames;
+    *secondSpan = pb->data;
+    *secondSpanFrames = pb->fillInFrames - *firstSpanFrames;
+}
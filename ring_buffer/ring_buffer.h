@@ -0,0 +1,121 @@
+/*
+--------------------------------------------------------------------------
+* Acoustic monitoring tool for Raspberry Pi based on miniaudio framework *
+*                                                                        *
+* Kaue Werner, 2024                                                      *
+--------------------------------------------------------------------------
+*/
+/**
+ * @file ring_buffer.h
+ * @author Kaue Werner
+ * @date 10 Mar 2024
+ * @brief Header with the lock-free single-producer/single-consumer ring buffer used in AMT
+ * @version 0.1.0
+*/
+#ifndef RING_BUFFER_H
+#define RING_BUFFER_H
+#include "../config_defines.h"
+#include <stddef.h>
+#include <stdatomic.h>
+
+/**
+ * @brief Lock-free single-producer/single-consumer ring buffer data struct
+ * Read and write indexes are free-running frame counters, the capacity is 
+ * always rounded up to a power of two so that index wrap-around is harmless.
+*/
+typedef struct {
+    unsigned char* data;
+    size_t capacityInFrames;
+    size_t bytesPerFrame;
+    size_t highWaterMarkInFrames;
+    atomic_size_t writeIndex;
+    atomic_size_t readIndex;
+    /* statistics updated by the producer */
+    atomic_ulong overflowCount;
+    atomic_ulong droppedFrames;
+    atomic_ulong highWaterMarkCount;
+    atomic_size_t maxFillInFrames;
+} ring_buffer;
+
+/**
+ * @brief Circular pre-roll buffer data struct
+ * Holds the latest fillInFrames (at most capacityInFrames) frames written 
+ * since the last reset, the newest frame is just before writeCursor.
+*/
+typedef struct {
+    unsigned char* data;
+    size_t capacityInFrames;
+    size_t bytesPerFrame;
+    size_t writeCursor;
+    size_t fillInFrames;
+} preroll_buffer;
+
+/**
+ * @brief initialize ring buffer (ring_buffer), returns 0 on success
+ * 
+*/
+int init_ring_buffer(ring_buffer* rb, size_t capacityInFrames, size_t bytesPerFrame, size_t highWaterMarkInFrames);
+
+/**
+ * @brief free ring buffer (ring_buffer)
+ * 
+*/
+void free_ring_buffer(ring_buffer* rb);
+
+/**
+ * @brief number of frames currently stored in the ring buffer
+ * 
+*/
+size_t ring_buffer_fill(ring_buffer* rb);
+
+/**
+ * @brief write frames into the ring buffer (producer side only)
+ * The write is all-or-nothing: if there is no room for all frames, nothing
+ * is written, the overflow counters are updated and 0 is returned.
+*/
+size_t ring_buffer_write(ring_buffer* rb, const void* frames, size_t frameCount);
+
+/**
+ * @brief get pointer to the contiguous readable frames (consumer side only)
+ * Returns the number of contiguous frames available at *frames.
+*/
+size_t ring_buffer_peek(ring_buffer* rb, void** frames);
+
+/**
+ * @brief release frames previously obtained with ring_buffer_peek (consumer side only)
+ * 
+*/
+void ring_buffer_consume(ring_buffer* rb, size_t frameCount);
+
+/**
+ * @brief initialize empty pre-roll buffer (preroll_buffer), returns 0 on success
+ * 
+*/
+int init_preroll_buffer(preroll_buffer* pb, size_t capacityInFrames, size_t bytesPerFrame);
+
+/**
+ * @brief free pre-roll buffer (preroll_buffer)
+ * 
+*/
+void free_preroll_buffer(preroll_buffer* pb);
+
+/**
+ * @brief empty pre-roll buffer (preroll_buffer), frames written before are not returned anymore
+ * 
+*/
+void reset_preroll_buffer(preroll_buffer* pb);
+
+/**
+ * @brief overwrite the oldest frames of the pre-roll buffer with new frames
+ * 
+*/
+void preroll_buffer_write(preroll_buffer* pb, const void* frames, size_t frameCount);
+
+/**
+ * @brief get the frames written since the last reset (at most capacityInFrames) from 
+ * oldest to newest frame as two contiguous spans
+ * 
+*/
+void preroll_buffer_get_spans(preroll_buffer* pb, void** firstSpan, size_t* firstSpanFrames, void** secondSpan, size_t* secondSpanFrames);
+
+#endif // RING_BUFFER_H
@@ -0,0 +1,194 @@
+/*
+--------------------------------------------------------------------------
+* Acoustic monitoring tool for Raspberry Pi based on miniaudio framework *
+*                                                                        *
+* Kaue Werner, 2024                                                      *
+--------------------------------------------------------------------------
+*/
+/**
+ * @file scheduler.c
+ * @author Kaue Werner
+ * @date 10 Mar 2024
+ * @brief Definition of the recording scheduler used in AMT
+ * @version 0.1.0
+*/
+#include "scheduler.h"
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#ifdef PC_TEST
+#include <windows.h>
+#endif
+
+// virtual clock used instead of the wall clock when virtualClockEnabled is set (simulation)
+static unsigned virtualClockEnabled = 0;
+static struct timeval virtualTime;
+
+/**
+ * @brief local midnight of a YYYY-MM-DD date plus dayOffset days, SCHEDULE_FINISHED if invalid
+ * 
+*/
+static time_t get_date_midnight(const char* date, int dayOffset){
+    struct tm info;
+    int year, month, day;
+    // field widths, the configured dates are DATE_ARRAY_SIZE characters without terminator
+    if(!date || sscanf(date, "%4d-%2d-%2d", &year, &month, &day) != 3){
+        return SCHEDULE_FINISHED;
+    }
+    memset(&info, 0, sizeof(info));
+    info.tm_year = year - 1900;
+    info.tm_mon = month - 1;
+    info.tm_mday = day + dayOffset;
+    info.tm_isdst = -1;
+    return mktime(&info);
+}
+
+/**
+ * @brief local hour of the day of time t
+ * 
+*/
+static int get_local_hour(time_t t){
+    struct tm info;
+    localtime_r(&t, &info);
+    return info.tm_hour;
+}
+
+/**
+ * @brief start of the local hour following time t (DST changes included)
+ * 
+*/
+static time_t get_next_hour_start(time_t t){
+    struct tm info;
+    localtime_r(&t, &info);
+    info.tm_min = 0;
+    info.tm_sec = 0;
+    info.tm_hour += 1;
+    info.tm_isdst = -1;
+    time_t next = mktime(&info);
+    // repeated local hour at the end of DST
+    return (next > t) ? next : t + 3600 - (t % 3600);
+}
+
+/**
+ * @brief initialize recording schedule (amt_schedule) from YYYY-MM-DD dates and 
+ * the list of recording hours, returns 0 on success
+ * 
+*/
+int init_schedule(amt_schedule* schedule, const char* firstRecordingDate, const char* lastRecordingDate, 
+                  const unsigned* recordingHours, unsigned numberOfRecordingHours){
+    schedule->startTime = get_date_midnight(firstRecordingDate, 0);
+    schedule->endTime = get_date_midnight(lastRecordingDate, 1);
+    memset(schedule->isRecordingHour, 0, sizeof(schedule->isRecordingHour));
+    for(unsigned n = 0; n < numberOfRecordingHours; n++){
+        if(recordingHours[n] < 24){
+            schedule->isRecordingHour[recordingHours[n]] = 1;
+        }
+    }
+    if(schedule->startTime == SCHEDULE_FINISHED || schedule->endTime == SCHEDULE_FINISHED){
+        return -1;
+    }
+    return 0;
+}
+
+/**
+ * @brief first instant at or after time t when recording is allowed, 
+ * SCHEDULE_FINISHED if there is none left
+ * 
+*/
+time_t get_next_recording_start(const amt_schedule* schedule, time_t t){
+    if(t < schedule->startTime){
+        t = schedule->startTime;
+    }
+    while(t < schedule->endTime){
+        if(schedule->isRecordingHour[get_local_hour(t)]){
+            return t;
+        }
+        t = get_next_hour_start(t);
+    }
+    return SCHEDULE_FINISHED;
+}
+
+/**
+ * @brief end of the run of consecutive recording hours containing time t
+ * 
+*/
+time_t get_recording_window_end(const amt_schedule* schedule, time_t t){
+    while(t < schedule->endTime && schedule->isRecordingHour[get_local_hour(t)]){
+        t = get_next_hour_start(t);
+    }
+    return (t < schedule->endTime) ? t : schedule->endTime;
+}
+
+/**
+ * @brief sleep until the absolute wall clock deadline, wall clock changes 
+ * (e.g. NTP sync after boot) are taken into account while sleeping
+ * 
+*/
+void sleep_until_time(time_t deadline){
+    if(virtualClockEnabled){
+        struct timeval t = {deadline, 0};
+        set_virtual_time(&t);
+        return;
+    }
+#ifdef PC_TEST
+    time_t now;
+    while((now = time(NULL)) < deadline){
+        Sleep((DWORD)((deadline - now) * 1000));
+    }
+#else
+    struct timespec ts;
+    ts.tv_sec = deadline;
+    ts.tv_nsec = 0;
+    while(clock_nanosleep(CLOCK_REALTIME, TIMER_ABSTIME, &ts, NULL) == EINTR);
+#endif
+}
+
+/**
+ * @brief replace the wall clock by a virtual clock starting at startTime (simulation), 
+ * it only moves through set_virtual_time and sleep_until_time
+ * 
+*/
+void enable_virtual_clock(time_t startTime){
+    virtualTime.tv_sec = startTime;
+    virtualTime.tv_usec = 0;
+    virtualClockEnabled = 1;
+}
+
+/**
+ * @brief 1 if the virtual clock replaces the wall clock
+ * 
+*/
+unsigned is_virtual_clock_enabled(){
+    return virtualClockEnabled;
+}
+
+/**
+ * @brief move the virtual clock forward to time t (earlier times are ignored)
+ * 
+*/
+void set_virtual_time(const struct timeval* t){
+    if(t->tv_sec > virtualTime.tv_sec || (t->tv_sec == virtualTime.tv_sec && t->tv_usec > virtualTime.tv_usec)){
+        virtualTime = *t;
+    }
+}
+
+/**
+ * @brief current time of the wall clock or of the virtual clock
+ * 
+*/
+void get_current_timeval(struct timeval* t){
+    if(virtualClockEnabled){
+        *t = virtualTime;
+    }
+    else {
+        gettimeofday(t, NULL);
+    }
+}
+
+/**
+ * @brief current time in seconds of the wall clock or of the virtual clock
+ * 
+*/
+time_t get_current_time(){
+    return virtualClockEnabled ? virtualTime.tv_sec : time(NULL);
+}
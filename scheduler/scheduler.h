@@ -0,0 +1,94 @@
+/*
+--------------------------------------------------------------------------
+* Acoustic monitoring tool for Raspberry Pi based on miniaudio framework *
+*                                                                        *
+* Kaue Werner, 2024                                                      *
+--------------------------------------------------------------------------
+*/
+/**
+ * @file scheduler.h
+ * @author Kaue Werner
+ * @date 10 Mar 2024
+ * @brief Header with the recording scheduler used in AMT
+ * @version 0.1.0
+*/
+#ifndef SCHEDULER_H
+#define SCHEDULER_H
+#include "../config_defines.h"
+#include <time.h>
+#include <sys/time.h>
+
+#define SCHEDULE_FINISHED ((time_t) -1)
+
+/**
+ * @brief Recording schedule data struct
+ * Recordings are allowed from local midnight of the first recording date up 
+ * to local midnight after the last recording date, during recording hours.
+*/
+typedef struct {
+    time_t startTime;
+    time_t endTime;
+    unsigned char isRecordingHour[24];
+} amt_schedule;
+
+/**
+ * @brief initialize recording schedule (amt_schedule) from YYYY-MM-DD dates and 
+ * the list of recording hours, returns 0 on success
+ * 
+*/
+int init_schedule(amt_schedule* schedule, const char* firstRecordingDate, const char* lastRecordingDate, 
+                  const unsigned* recordingHours, unsigned numberOfRecordingHours);
+
+/**
+ * @brief first instant at or after time t when recording is allowed, 
+ * SCHEDULE_FINISHED if there is none left
+ * 
+*/
+time_t get_next_recording_start(const amt_schedule* schedule, time_t t);
+
+/**
+ * @brief end of the run of consecutive recording hours containing time t
+ * 
+*/
+time_t get_recording_window_end(const amt_schedule* schedule, time_t t);
+
+/**
+ * @brief sleep until the absolute wall clock deadline, wall clock changes 
+ * (e.g. NTP sync after boot) are taken into account while sleeping. 
+ * With the virtual clock, the clock jumps to the deadline instead
+ * 
+*/
+void sleep_until_time(time_t deadline);
+
+/**
+ * @brief replace the wall clock by a virtual clock starting at startTime (simulation), 
+ * it only moves through set_virtual_time and sleep_until_time
+ * 
+*/
+void enable_virtual_clock(time_t startTime);
+
+/**
+ * @brief 1 if the virtual clock replaces the wall clock
+ * 
+*/
+unsigned is_virtual_clock_enabled();
+
+/**
+ * @brief move the virtual clock forward to time t (earlier times are ignored)
+ * 
+*/
+void set_virtual_time(const struct timeval* t);
+
+/**
+ * @brief current time of the wall clock or of the virtual clock
+ * 
+*/
+void get_current_timeval(struct timeval* t);
+
+/**
+ * @brief current time in seconds of the wall clock or of the virtual clock
+ * 
+*/
+time_t get_current_time();
+
+#endif // SCHEDULER_H
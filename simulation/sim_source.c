@@ -0,0 +1,267 @@
+/*
+--------------------------------------------------------------------------
+* Acoustic monitoring tool for Raspberry Pi based on miniaudio framework *
+*                                                                        *
+* Kaue Werner, 2024                                                      *
+--------------------------------------------------------------------------
+*/
+/**
+ * @file sim_source.c
+ * @author Kaue Werner
+ * @date 10 Mar 2024
+ * @brief Definition of the scripted synthetic signal source used by the AMT simulation
+ *
+ * Script lines are "type day HH:MM:SS duration levelIndBFS [frequency]",
+ * type is tone, noise or burst, day is a day number from the origin or * for
+ * every day, HH:MM:SS is the local time, duration is in seconds and frequency 
+ * in Hz (default 1000).
+ * Empty lines and lines starting with # are ignored.
+ * @version 0.1.0
+*/
+#include "sim_source.h"
+#include <limits.h>
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+
+#define SECONDS_PER_DAY 86400.0
+
+/**
+ * @brief next uniform sample in [-1, 1) from the xorshift32 noise state
+ *
+*/
+static float next_uniform(sim_source* source){
+    uint32_t x = source->noiseState;
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    source->noiseState = x;
+    return (float)((double) x / 2147483648.0 - 1.0);
+}
+
+/**
+ * @brief parse one script line into an event, returns 0 on success
+ *
+*/
+static int parse_sim_event(const char* line, sim_event* event){
+    char type[MAX_CHAR_LENGTH], day[MAX_CHAR_LENGTH];
+    int hours, minutes, seconds;
+    float level;
+    event->frequency = 1000.0f;
+    int fields = sscanf(line, "%99s %99s %d:%d:%d %lf %f %f", type, day, &hours, &minutes, &seconds,
+                        &event->duration, &level, &event->frequency);
+    if(fields < 7 || event->duration <= 0.0 || event->frequency <= 0.0f){
+        return -1;
+    }
+    if(!strcmp(type, "tone")){
+        event->type = SIM_SIGNAL_TONE;
+    }
+    else if(!strcmp(type, "noise")){
+        event->type = SIM_SIGNAL_NOISE;
+    }
+    else if(!strcmp(type, "burst")){
+        event->type = SIM_SIGNAL_BURST;
+    }
+    else {
+        return -1;
+    }
+    if(!strcmp(day, "*")){
+        event->day = SIM_SOURCE_EVERY_DAY;
+    }
+    else if(sscanf(day, "%d", &event->day) != 1 || event->day < 0){
+        return -1;
+    }
+    event->startTime = hours * 3600.0 + minutes * 60.0 + seconds;
+    event->amplitude = powf(10.0f, level / 20.0f);
+    event->phase = 0.0;
+    event->cachedDays[0] = event->cachedDays[1] = INT_MIN;
+    return 0;
+}
+
+/**
+ * @brief start of the occurrence of an event on day (days from the origin date) in seconds from the origin,
+ * startTime is a local wall clock time
+ *
+*/
+static double get_occurrence_start(const sim_source* source, sim_event* event, int day){
+    unsigned slot = (unsigned) day & 1u;
+    if(event->cachedDays[slot] != day){
+        struct tm info;
+        localtime_r(&source->origin, &info);
+        // wall clock fields, mktime would count seconds past midnight in the UTC offset of midnight
+        int seconds = (int) event->startTime;
+        info.tm_mday += day;
+        info.tm_hour = seconds / 3600;
+        info.tm_min = seconds / 60 % 60;
+        info.tm_sec = seconds % 60;
+        info.tm_isdst = -1;
+        event->cachedDays[slot] = day;
+        event->cachedStarts[slot] = (double)(mktime(&info) - source->origin);
+    }
+    return event->cachedStarts[slot];
+}
+
+/**
+ * @brief day of the occurrence of an every day event that started last at time t (seconds from the origin),
+ * the estimate from 24 h days is off by one around DST changes
+ *
+*/
+static int get_last_occurrence_day(const sim_source* source, sim_event* event, double t){
+    int day = (int) floor((t - event->startTime) / SECONDS_PER_DAY);
+    while(get_occurrence_start(source, event, day) > t){
+        day--;
+    }
+    while(get_occurrence_start(source, event, day + 1) <= t){
+        day++;
+    }
+    return day;
+}
+
+/**
+ * @brief add one occurrence of an event starting at occurrenceStart (seconds from the origin)
+ * to the mono block starting at blockStart
+ *
+*/
+static void add_sim_event(sim_source* source, sim_event* event, double occurrenceStart, double blockStart,
+                          float* output, unsigned frameCount){
+    double first = ceil((occurrenceStart - blockStart) * source->sampleRate);
+    double last = ceil((occurrenceStart + event->duration - blockStart) * source->sampleRate);
+    unsigned firstFrame = (first > 0.0) ? (unsigned) first : 0;
+    unsigned lastFrame = (last < frameCount) ? (unsigned) last : frameCount;
+    if(last <= 0.0 || firstFrame >= lastFrame){
+        return;
+    }
+    const double phaseIncrement = 2.0 * M_PI * event->frequency / source->sampleRate;
+    const float toneAmplitude = event->amplitude * (float) M_SQRT2;
+    const float noiseAmplitude = event->amplitude * sqrtf(3.0f);
+    for(unsigned n = firstFrame; n < lastFrame; n++){
+        switch(event->type){
+            case SIM_SIGNAL_NOISE:
+                output[n] += noiseAmplitude * next_uniform(source);
+            break;
+            case SIM_SIGNAL_BURST:
+                if(fmod(blockStart + n / source->sampleRate - occurrenceStart, SIM_BURST_PERIOD) >= SIM_BURST_LENGTH){
+                    break;
+                }
+                // fall through, tone pip
+            case SIM_SIGNAL_TONE:
+            default:
+                output[n] += toneAmplitude * (float) sin(event->phase);
+                event->phase = fmod(event->phase + phaseIncrement, 2.0 * M_PI);
+            break;
+        }
+    }
+}
+
+/**
+ * @brief seconds from time t (seconds from the origin) until one occurrence of an event is
+ * active, 0 if it is active at t and HUGE_VAL if it starts before t and is over
+ *
+*/
+static double get_occurrence_quiet_time(const sim_event* event, double occurrenceStart, double t){
+    if(t < occurrenceStart){
+        return occurrenceStart - t;
+    }
+    return (t < occurrenceStart + event->duration) ? 0.0 : HUGE_VAL;
+}
+
+/**
+ * @brief initialize synthetic source (sim_source) from a script file (NULL: background noise
+ * at SIM_DEFAULT_NOISE_LEVEL only), event times are counted from origin. Returns 0 on success
+ *
+*/
+int init_sim_source(sim_source* source, const char* scriptFileName, time_t origin, float sampleRate){
+    source->numberOfEvents = 0;
+    source->origin = origin;
+    source->sampleRate = sampleRate;
+    source->noiseState = SIM_SOURCE_SEED;
+
+    if(!scriptFileName){
+        sim_event* event = &source->events[source->numberOfEvents++];
+        // one occurrence from the origin on, local days are not all SECONDS_PER_DAY long
+        event->type = SIM_SIGNAL_NOISE;
+        event->day = 0;
+        event->startTime = 0.0;
+        event->duration = HUGE_VAL;
+        event->amplitude = powf(10.0f, SIM_DEFAULT_NOISE_LEVEL / 20.0f);
+        event->frequency = 1000.0f;
+        event->phase = 0.0;
+        event->cachedDays[0] = event->cachedDays[1] = INT_MIN;
+        return 0;
+    }
+
+    FILE* scriptFile = fopen(scriptFileName, "r");
+    if(!scriptFile){
+        return -1;
+    }
+    char line[MAX_CHAR_LENGTH];
+    int result = 0;
+    while(fgets(line, MAX_CHAR_LENGTH, scriptFile)){
+        char* start = line + strspn(line, " \t");
+        if(*start == '#' || *start == '\n' || *start == '\r' || *start == '\0'){
+            continue;
+        }
+        if(source->numberOfEvents == SIM_SOURCE_MAX_EVENTS || parse_sim_event(start, &source->events[source->numberOfEvents])){
+            printf("Invalid simulation event: %s", start);
+            result = -1;
+            break;
+        }
+        source->numberOfEvents++;
+    }
+    fclose(scriptFile);
+    return result;
+}
+
+/**
+ * @brief generate frameCount interleaved frames of NUMBER_OF_INPUT_CHANNELS channels
+ * starting at time startTime
+ *
+*/
+void generate_sim_source(sim_source* source, const struct timeval* startTime, float* output, unsigned frameCount){
+    double blockStart = (double)(startTime->tv_sec - source->origin) + startTime->tv_usec * 1e-6;
+    memset(output, 0, frameCount * sizeof(float));
+    for(unsigned e = 0; e < source->numberOfEvents; e++){
+        sim_event* event = &source->events[e];
+        if(event->day != SIM_SOURCE_EVERY_DAY){
+            add_sim_event(source, event, get_occurrence_start(source, event, event->day), blockStart, output, frameCount);
+            continue;
+        }
+        // the occurrence that started last, and the next one in case it starts within the block
+        int day = get_last_occurrence_day(source, event, blockStart);
+        add_sim_event(source, event, get_occurrence_start(source, event, day), blockStart, output, frameCount);
+        add_sim_event(source, event, get_occurrence_start(source, event, day + 1), blockStart, output, frameCount);
+    }
+    // same signal on every channel, expanded in place from the last frame
+    for(unsigned n = frameCount; n-- > 0;){
+        for(unsigned c = NUMBER_OF_INPUT_CHANNELS; c-- > 0;){
+            output[n * NUMBER_OF_INPUT_CHANNELS + c] = output[n];
+        }
+    }
+}
+
+/**
+ * @brief seconds from time t until a scripted signal is active (0 if one is active at t,
+ * HUGE_VAL if none is active after t), frames generated before then are silent
+ *
+*/
+double get_sim_source_quiet_time(sim_source* source, const struct timeval* t){
+    double time = (double)(t->tv_sec - source->origin) + t->tv_usec * 1e-6;
+    double quietTime = HUGE_VAL;
+    for(unsigned e = 0; e < source->numberOfEvents; e++){
+        sim_event* event = &source->events[e];
+        double eventQuietTime;
+        if(event->day != SIM_SOURCE_EVERY_DAY){
+            eventQuietTime = get_occurrence_quiet_time(event, get_occurrence_start(source, event, event->day), time);
+        }
+        else {
+            // same occurrences as in generate_sim_source
+            int day = get_last_occurrence_day(source, event, time);
+            eventQuietTime = fmin(get_occurrence_quiet_time(event, get_occurrence_start(source, event, day), time), 
+                                  get_occurrence_quiet_time(event, get_occurrence_start(source, event, day + 1), time));
+        }
+        if(eventQuietTime < quietTime){
+            quietTime = eventQuietTime;
+        }
+    }
+    return quietTime;
+}
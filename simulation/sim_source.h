@@ -0,0 +1,95 @@
+/*
+--------------------------------------------------------------------------
+* Acoustic monitoring tool for Raspberry Pi based on miniaudio framework *
+*                                                                        *
+* Kaue Werner, 2024                                                      *
+--------------------------------------------------------------------------
+*/
+/**
+ * @file sim_source.h
+ * @author Kaue Werner
+ * @date 10 Mar 2024
+ * @brief Header with the scripted synthetic signal source used by the AMT simulation
+ * @version 0.1.0
+*/
+#ifndef SIM_SOURCE_H
+#define SIM_SOURCE_H
+#include "../config_defines.h"
+#include <stdint.h>
+#include <time.h>
+#include <sys/time.h>
+
+#define SIM_SOURCE_MAX_EVENTS 64
+#define SIM_SOURCE_EVERY_DAY -1
+#define SIM_BURST_LENGTH 0.1
+#define SIM_BURST_PERIOD 0.5
+#define SIM_DEFAULT_NOISE_LEVEL -70.0f
+#define SIM_SOURCE_SEED 0x12345678u
+#define SIM_SKIP_SETTLE_TIME 2.0
+
+/**
+ * @brief Current available types of synthetic signal
+ *
+*/
+typedef enum {
+    SIM_SIGNAL_TONE,
+    SIM_SIGNAL_NOISE,
+    SIM_SIGNAL_BURST
+} sim_signal_type;
+
+/**
+ * @brief Scripted event data struct
+ * Active for duration seconds from the local wall clock time startTime (seconds 
+ * after midnight) of day (days from the simulation origin date, SIM_SOURCE_EVERY_DAY: 
+ * every day), days around DST changes are 23 or 25 h long. amplitude is the RMS 
+ * level in full scale units, bursts are tone pips of SIM_BURST_LENGTH seconds 
+ * every SIM_BURST_PERIOD seconds. The starts of the last two days looked up
+ * are cached (seconds from the origin), mktime is too slow to run every block
+*/
+typedef struct {
+    unsigned type;
+    int day;
+    double startTime;
+    double duration;
+    float amplitude;
+    float frequency;
+    double phase;
+    int cachedDays[2];
+    double cachedStarts[2];
+} sim_event;
+
+/**
+ * @brief Synthetic signal source data struct
+ * Samples are a deterministic function of the script, the origin and the
+ * frames generated so far (fixed noise seed), so simulations are repeatable.
+*/
+typedef struct {
+    sim_event events[SIM_SOURCE_MAX_EVENTS];
+    unsigned numberOfEvents;
+    time_t origin;
+    float sampleRate;
+    uint32_t noiseState;
+} sim_source;
+
+/**
+ * @brief initialize synthetic source (sim_source) from a script file (NULL: background noise
+ * at SIM_DEFAULT_NOISE_LEVEL only), event times are counted from origin. Returns 0 on success
+ *
+*/
+int init_sim_source(sim_source* source, const char* scriptFileName, time_t origin, float sampleRate);
+
+/**
+ * @brief generate frameCount interleaved frames of NUMBER_OF_INPUT_CHANNELS channels
+ * starting at time startTime
+ *
+*/
+void generate_sim_source(sim_source* source, const struct timeval* startTime, float* output, unsigned frameCount);
+
+/**
+ * @brief seconds from time t until a scripted signal is active (0 if one is active at t,
+ * HUGE_VAL if none is active after t), frames generated before then are silent
+ *
+*/
+double get_sim_source_quiet_time(sim_source* source, const struct timeval* t);
+
+#endif // SIM_SOURCE_H
@@ -0,0 +1,750 @@
+/*
+--------------------------------------------------------------------------
+* Acoustic monitoring tool for Raspberry Pi based on miniaudio framework *
+*                                                                        *
+* Kaue Werner, 2024                                                      *
+--------------------------------------------------------------------------
+*/
+/**
+ * @file sim_test.c
+ * @author Kaue Werner
+ * @date 10 Mar 2024
+ * @brief Scripted scenario checks of the recording schedule and trigger with amt --simulate
+ *
+ * Each scenario writes an amt.config and a script into its own output
+ * directory, runs the simulation and compares the recordings (count, names,
+ * start times, lengths) and the start rows of the recording logs with the
+ * expected ones. Each check prints one line (ok or FAIL with the measured
+ * value), the exit status is 1 if any check failed.
+ * Usage: amt_sim_test [amt executable] [work directory]
+ * @version 0.1.0
+*/
+#include "../config_defines.h"
+#include "../rec_writer/wav_recovery.h"
+#include <dirent.h>
+#include <fcntl.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+
+#define SIM_TEST_DEFAULT_AMT "./amt"
+#define SIM_TEST_DEFAULT_DIR "./sim_test/"
+#define SIM_TEST_MAX_RECORDINGS 64
+#define SIM_TEST_MAX_LOG_ROWS 256
+#define SIM_TEST_PATH_LENGTH 512
+// sampleRate of SIM_TEST_BASE_CONFIG
+#define SIM_TEST_SAMPLE_RATE 8000.0
+// Central European Time with its DST rules as a POSIX TZ string, no tzdata needed
+#define SIM_TEST_DST_TIME_ZONE "CET-1CEST,M3.5.0,M10.5.0/3"
+// start time and length tolerance in seconds, a few callback blocks at 8 kHz
+#define SIM_TEST_TIME_TOLERANCE 0.1
+// capture hours tolerance, the summary line prints two decimals
+#define SIM_TEST_CAPTURE_HOURS_TOLERANCE 0.01
+// trigger settings shared by the scenarios (SIM_TEST_BASE_CONFIG)
+#define SIM_TEST_PREROLL 1.0
+#define SIM_TEST_HOLD_TIME 1.0
+#define SIM_TEST_RELEASE_DBFS -46.0
+#define SIM_TEST_FAST_TIME_CONSTANT 0.125
+// time the fast level takes to decay from a tone level down to the release threshold
+#define SIM_TEST_RELEASE_TIME(levelIndBFS) (((levelIndBFS) - SIM_TEST_RELEASE_DBFS) / (10.0 * M_LOG10E) * SIM_TEST_FAST_TIME_CONSTANT)
+#define SIM_TEST_EVENT_LENGTH(duration, levelIndBFS) (SIM_TEST_PREROLL + (duration) + SIM_TEST_RELEASE_TIME(levelIndBFS) + SIM_TEST_HOLD_TIME)
+
+#define SIM_TEST_BASE_CONFIG \
+    "microphoneGain  0\n" \
+    "sampleRate  8000\n" \
+    "decimationFactor    1\n" \
+    "enableHighpassFilter    1\n" \
+    "highpassFilterCutoff    250\n" \
+    "highpassFilterStages    1\n" \
+    "enableLowpasssFilter    0\n" \
+    "lowpassFilterCutoff    3000\n" \
+    "lowpassFilterStages    1\n" \
+    "recordingThresholddBFS -40\n" \
+    "recordedTimeBeforeThreshold 1\n" \
+    "recordingReleasedBFS -46\n" \
+    "recordingHoldTime 1\n" \
+    "levelFrequencyWeighting    A\n" \
+    "levelTimeWeighting    fast\n" \
+    "outputFileFormat    wav\n" \
+    "enableConfigReload    0\n"
+
+/**
+ * @brief Expected recording, start as day * 86400 + local time of day in seconds, days counted
+ * from the first recording date (days around DST changes are 23 or 25 h long)
+ *
+*/
+typedef struct {
+    double start;
+    double length;
+} expected_recording;
+
+/**
+ * @brief Scripted scenario, config holds the amt.config lines added to SIM_TEST_BASE_CONFIG
+ * (firstRecordingDate is added from firstDate), timeZone the TZ the simulation runs in (NULL: 
+ * inherited), processingSampleRate the sample rate of the recordings (with decimationFactor in config),
+ * captureHours the processed plus skipped capture hours of the summary line (0: not checked).
+ * thresholdRecording selects the log rows expected, checkRepeatability runs the scenario twice 
+ * and compares the recordings
+ *
+*/
+typedef struct {
+    const char* name;
+    const char* firstDate;
+    const char* config;
+    const char* script;
+    const char* timeZone;
+    double processingSampleRate;
+    double captureHours;
+    double days;
+    expected_recording recordings[SIM_TEST_MAX_RECORDINGS];
+    unsigned numberOfRecordings;
+    unsigned thresholdRecording:1;
+    unsigned checkRepeatability:1;
+} sim_scenario;
+
+/**
+ * @brief Recording found in the output directory of a scenario
+ *
+*/
+typedef struct {
+    char fileName[MAX_CHAR_LENGTH];
+    struct timeval timestamp;
+    double length;
+} found_recording;
+
+static unsigned failedChecks = 0;
+
+/**
+ * @brief print the result of one check and count the failures
+ *
+*/
+static void report_check(const char* name, unsigned passed, double measured){
+    printf("%s %s (measured %g)\n", passed ? "ok  " : "FAIL", name, measured);
+    failedChecks += !passed;
+}
+
+/**
+ * @brief create directory if non-existent and delete the files it holds (subdirectories are kept)
+ *
+*/
+static void clear_directory(const char* path){
+    mkdir(path, 0777);
+    DIR* directory = opendir(path);
+    if(!directory){
+        return;
+    }
+    struct dirent* entry;
+    char filePath[SIM_TEST_PATH_LENGTH];
+    while((entry = readdir(directory))){
+        snprintf(filePath, SIM_TEST_PATH_LENGTH, "%s%s", path, entry->d_name);
+        struct stat info;
+        if(!stat(filePath, &info) && S_ISREG(info.st_mode)){
+            unlink(filePath);
+        }
+    }
+    closedir(directory);
+}
+
+/**
+ * @brief write text to a file, returns 0 on success
+ *
+*/
+static int write_text_file(const char* path, const char* text){
+    FILE* file = fopen(path, "w");
+    if(!file){
+        return -1;
+    }
+    fputs(text, file);
+    fclose(file);
+    return 0;
+}
+
+/**
+ * @brief local midnight of a YYYY-MM-DD date
+ *
+*/
+static time_t get_date_midnight(const char* date){
+    struct tm info = {0};
+    sscanf(date, "%d-%d-%d", &info.tm_year, &info.tm_mon, &info.tm_mday);
+    info.tm_year -= 1900;
+    info.tm_mon -= 1;
+    info.tm_isdst = -1;
+    return mktime(&info);
+}
+
+/**
+ * @brief seconds from local midnight of a YYYY-MM-DD date to day * 86400 + local time of day (dayTime seconds)
+ *
+*/
+static double get_local_time_offset(const char* date, double dayTime){
+    struct tm info = {0};
+    double day = floor(dayTime / 86400.0);
+    double timeOfDay = dayTime - day * 86400.0;
+    sscanf(date, "%d-%d-%d", &info.tm_year, &info.tm_mon, &info.tm_mday);
+    info.tm_year -= 1900;
+    info.tm_mon -= 1;
+    int seconds = (int) floor(timeOfDay);
+    info.tm_mday += (int) day;
+    info.tm_hour = seconds / 3600;
+    info.tm_min = seconds / 60 % 60;
+    info.tm_sec = seconds % 60;
+    info.tm_isdst = -1;
+    return (double)(mktime(&info) - get_date_midnight(date)) + timeOfDay - floor(timeOfDay);
+}
+
+/**
+ * @brief set TZ for the simulation and the checks (NULL: unset), tzset follows the change
+ *
+*/
+static void set_time_zone(const char* timeZone){
+    if(timeZone){
+        setenv("TZ", timeZone, 1);
+    }
+    else {
+        unsetenv("TZ");
+    }
+    tzset();
+}
+
+/**
+ * @brief timestamp of a recording from its file name (<device>_%Y-%m-%d_%H-%M-%S-[usec].wav), the
+ * time fields must be formatted as update_output_file_name does, returns 0 on success
+ *
+*/
+static int parse_recording_name(const char* fileName, struct timeval* timestamp){
+    const char* extension = strrchr(fileName, '.');
+    if(!extension || strcmp(extension, ".wav")){
+        return -1;
+    }
+    for(const char* p = strchr(fileName, '_'); p; p = strchr(p + 1, '_')){
+        struct tm info = {0};
+        int length = 0;
+        if(sscanf(p, "_%4d-%2d-%2d_%2d-%2d-%2d-%n", &info.tm_year, &info.tm_mon, &info.tm_mday,
+                  &info.tm_hour, &info.tm_min, &info.tm_sec, &length) != 6 || !length){
+            continue;
+        }
+        info.tm_year -= 1900;
+        info.tm_mon -= 1;
+        info.tm_isdst = -1;
+        timestamp->tv_sec = mktime(&info);
+        timestamp->tv_usec = 0;
+        // microseconds only in the names of Pi builds
+        if(p + length < extension && sscanf(p + length, "%ld", &timestamp->tv_usec) != 1){
+            return -1;
+        }
+        char label[MAX_CHAR_LENGTH];
+        strftime(label, MAX_CHAR_LENGTH, OUTPUT_WAV_FILE_SUFFIX, localtime(&timestamp->tv_sec));
+        return strncmp(p, label, (size_t) length) ? -1 : 0;
+    }
+    return -1;
+}
+
+/**
+ * @brief recording length in seconds from the data chunk of a WAV file, negative if unreadable
+ *
+*/
+static double get_recording_length(const char* path, double sampleRate){
+    int fd = open(path, O_RDONLY);
+    if(fd < 0){
+        return -1.0;
+    }
+    wav_layout layout;
+    struct stat info;
+    double length = -1.0;
+    if(!read_wav_layout(fd, &layout) && !fstat(fd, &info) && layout.blockAlign){
+        length = (double)((info.st_size - layout.dataChunkOffset) / layout.blockAlign) / sampleRate;
+    }
+    close(fd);
+    return length;
+}
+
+/**
+ * @brief compare recordings by start time
+ *
+*/
+static int compare_recordings(const void* a, const void* b){
+    const found_recording* first = (const found_recording*) a;
+    const found_recording* second = (const found_recording*) b;
+    return timercmp(&first->timestamp, &second->timestamp, <) ? -1 : timercmp(&first->timestamp, &second->timestamp, >);
+}
+
+/**
+ * @brief list the WAV recordings of a recording directory sorted by start time, returns the number of
+ * recordings or -1 if a file name is not a recording name
+ *
+*/
+static int find_recordings(const char* recordingDir, found_recording* recordings, double sampleRate){
+    DIR* directory = opendir(recordingDir);
+    if(!directory){
+        return 0;
+    }
+    int numberOfRecordings = 0;
+    struct dirent* entry;
+    char path[SIM_TEST_PATH_LENGTH];
+    while((entry = readdir(directory)) && numberOfRecordings < SIM_TEST_MAX_RECORDINGS){
+        const char* extension = strrchr(entry->d_name, '.');
+        if(!extension || strcmp(extension, ".wav")){
+            continue;
+        }
+        found_recording* recording = &recordings[numberOfRecordings];
+        if(parse_recording_name(entry->d_name, &recording->timestamp)){
+            printf("Unexpected recording name %s\n", entry->d_name);
+            numberOfRecordings = -1;
+            break;
+        }
+        snprintf(recording->fileName, MAX_CHAR_LENGTH, "%s", entry->d_name);
+        snprintf(path, SIM_TEST_PATH_LENGTH, "%s%s", recordingDir, entry->d_name);
+        recording->length = get_recording_length(path, sampleRate);
+        numberOfRecordings++;
+    }
+    closedir(directory);
+    if(numberOfRecordings > 0){
+        qsort(recordings, (size_t) numberOfRecordings, sizeof(found_recording), compare_recordings);
+    }
+    return numberOfRecordings;
+}
+
+/**
+ * @brief compare two files byte by byte, returns 1 if both are readable and equal
+ *
+*/
+static unsigned files_equal(const char* firstPath, const char* secondPath){
+    FILE* first = fopen(firstPath, "rb");
+    FILE* second = fopen(secondPath, "rb");
+    unsigned equal = first && second;
+    while(equal){
+        int a = fgetc(first);
+        int b = fgetc(second);
+        equal = (a == b);
+        if(a == EOF){
+            break;
+        }
+    }
+    if(first){
+        fclose(first);
+    }
+    if(second){
+        fclose(second);
+    }
+    return equal;
+}
+
+/**
+ * @brief write config and script of a scenario into directory and run the simulation, returns the exit status
+ *
+*/
+static int run_scenario(const char* amt, const sim_scenario* scenario, const char* directory){
+    char path[SIM_TEST_PATH_LENGTH];
+    char recordingDir[SIM_TEST_PATH_LENGTH];
+    char config[4096];
+    snprintf(recordingDir, SIM_TEST_PATH_LENGTH, "%srecs/", directory);
+    clear_directory(directory);
+    clear_directory(recordingDir);
+    snprintf(config, sizeof(config), "%s%sfirstRecordingDate  %s\n", SIM_TEST_BASE_CONFIG, scenario->config, scenario->firstDate);
+    snprintf(path, SIM_TEST_PATH_LENGTH, "%samt.config", directory);
+    if(write_text_file(path, config)){
+        return -1;
+    }
+    snprintf(path, SIM_TEST_PATH_LENGTH, "%sscript.txt", directory);
+    if(write_text_file(path, scenario->script)){
+        return -1;
+    }
+    char command[4 * SIM_TEST_PATH_LENGTH];
+    snprintf(command, sizeof(command), "%s %s %g %s %s > %soutput.txt", amt, SIMULATE_OPTION, scenario->days, path,
+             directory, directory);
+    return system(command);
+}
+
+/**
+ * @brief start rows of the recording logs in date order, the time text after "Rec initialized at " or
+ * after the trigger level, returns the number of rows
+ *
+*/
+static unsigned read_log_rows(const char* directory, char rows[][MAX_CHAR_LENGTH], unsigned thresholdRecording){
+    struct dirent** entries;
+    int numberOfEntries = scandir(directory, &entries, NULL, alphasort);
+    unsigned numberOfRows = 0;
+    char path[SIM_TEST_PATH_LENGTH];
+    char line[MAX_CHAR_LENGTH];
+    for(int e = 0; e < numberOfEntries; e++){
+        if(!strncmp(entries[e]->d_name, "recording_log_", strlen("recording_log_"))){
+            snprintf(path, SIM_TEST_PATH_LENGTH, "%s%s", directory, entries[e]->d_name);
+            FILE* file = fopen(path, "r");
+            while(file && fgets(line, MAX_CHAR_LENGTH, file) && numberOfRows < SIM_TEST_MAX_LOG_ROWS){
+                const char* time = NULL;
+                if(thresholdRecording && strstr(line, " level = ") && strchr(line, '\t')){
+                    time = strchr(line, '\t') + 1;
+                }
+                else if(!thresholdRecording && !strncmp(line, "Rec initialized at ", strlen("Rec initialized at "))){
+                    time = line + strlen("Rec initialized at ");
+                }
+                if(time){
+                    snprintf(rows[numberOfRows++], MAX_CHAR_LENGTH, "%s", time);
+                }
+            }
+            if(file){
+                fclose(file);
+            }
+        }
+        free(entries[e]);
+    }
+    if(numberOfEntries >= 0){
+        free(entries);
+    }
+    return numberOfRows;
+}
+
+/**
+ * @brief processed plus skipped capture hours from the summary line of a simulation output, negative if missing
+ *
+*/
+static double read_capture_hours(const char* directory){
+    char path[SIM_TEST_PATH_LENGTH];
+    char line[MAX_CHAR_LENGTH];
+    double days, processedHours, skippedHours, captureHours = -1.0;
+    snprintf(path, SIM_TEST_PATH_LENGTH, "%soutput.txt", directory);
+    FILE* file = fopen(path, "r");
+    while(file && fgets(line, MAX_CHAR_LENGTH, file)){
+        if(sscanf(line, "Simulated %lf days (%lf h of capture processed, %lf h of quiet capture skipped)", 
+                  &days, &processedHours, &skippedHours) == 3){
+            captureHours = processedHours + skippedHours;
+        }
+    }
+    if(file){
+        fclose(file);
+    }
+    return captureHours;
+}
+
+/**
+ * @brief run a scenario and check its recordings and log rows
+ *
+*/
+static void test_scenario(const char* amt, const char* workDir, const sim_scenario* scenario){
+    char directory[SIM_TEST_PATH_LENGTH];
+    char recordingDir[SIM_TEST_PATH_LENGTH];
+    char name[SIM_TEST_PATH_LENGTH];
+    static found_recording recordings[SIM_TEST_MAX_RECORDINGS];
+    static char rows[SIM_TEST_MAX_LOG_ROWS][MAX_CHAR_LENGTH];
+    snprintf(directory, SIM_TEST_PATH_LENGTH, "%s%s/", workDir, scenario->name);
+    snprintf(recordingDir, SIM_TEST_PATH_LENGTH, "%srecs/", directory);
+
+    int status = run_scenario(amt, scenario, directory);
+    snprintf(name, SIM_TEST_PATH_LENGTH, "%s: simulation exits with status 0", scenario->name);
+    report_check(name, status == 0, status);
+    if(status){
+        return;
+    }
+
+    // skipped quiet spans must add up with the processed frames to the recording windows
+    if(scenario->captureHours > 0.0){
+        double captureHours = read_capture_hours(directory);
+        snprintf(name, SIM_TEST_PATH_LENGTH, "%s: %g h of capture processed or skipped", scenario->name, scenario->captureHours);
+        report_check(name, fabs(captureHours - scenario->captureHours) <= SIM_TEST_CAPTURE_HOURS_TOLERANCE, captureHours);
+    }
+
+    int numberOfRecordings = find_recordings(recordingDir, recordings, scenario->processingSampleRate);
+    snprintf(name, SIM_TEST_PATH_LENGTH, "%s: %u recordings named <device>%s[usec].wav", scenario->name, 
+             scenario->numberOfRecordings, OUTPUT_WAV_FILE_SUFFIX);
+    report_check(name, numberOfRecordings == (int) scenario->numberOfRecordings, numberOfRecordings);
+    if(numberOfRecordings != (int) scenario->numberOfRecordings){
+        return;
+    }
+
+    time_t origin = get_date_midnight(scenario->firstDate);
+    for(unsigned r = 0; r < scenario->numberOfRecordings; r++){
+        const expected_recording* expected = &scenario->recordings[r];
+        double start = (double)(recordings[r].timestamp.tv_sec - origin) + recordings[r].timestamp.tv_usec * 1e-6;
+        double expectedStart = get_local_time_offset(scenario->firstDate, expected->start);
+        snprintf(name, SIM_TEST_PATH_LENGTH, "%s: %s starts at %.3f s within %g s", scenario->name, recordings[r].fileName,
+                 expectedStart, SIM_TEST_TIME_TOLERANCE);
+        report_check(name, fabs(start - expectedStart) <= SIM_TEST_TIME_TOLERANCE, start);
+        snprintf(name, SIM_TEST_PATH_LENGTH, "%s: %s lasts %.3f s within %g s", scenario->name, recordings[r].fileName,
+                 expected->length, SIM_TEST_TIME_TOLERANCE);
+        report_check(name, fabs(recordings[r].length - expected->length) <= SIM_TEST_TIME_TOLERANCE, recordings[r].length);
+    }
+
+    // one start row per recording, in the log of the recording date
+    unsigned numberOfRows = read_log_rows(directory, rows, scenario->thresholdRecording);
+    snprintf(name, SIM_TEST_PATH_LENGTH, "%s: %u recording start rows in the logs", scenario->name, scenario->numberOfRecordings);
+    report_check(name, numberOfRows == scenario->numberOfRecordings, numberOfRows);
+    for(unsigned r = 0; r < scenario->numberOfRecordings && r < numberOfRows; r++){
+        const char* startTime = ctime(&recordings[r].timestamp.tv_sec);
+        snprintf(name, SIM_TEST_PATH_LENGTH, "%s: log row %u at the start of %s", scenario->name, r, recordings[r].fileName);
+        report_check(name, !strcmp(rows[r], startTime), r);
+    }
+
+    // same script and settings, same recordings
+    if(scenario->checkRepeatability){
+        char repeatDir[SIM_TEST_PATH_LENGTH];
+        char path[SIM_TEST_PATH_LENGTH];
+        char repeatPath[SIM_TEST_PATH_LENGTH];
+        snprintf(repeatDir, SIM_TEST_PATH_LENGTH, "%s%s_repeat/", workDir, scenario->name);
+        status = run_scenario(amt, scenario, repeatDir);
+        unsigned numberOfDifferences = 0;
+        for(unsigned r = 0; r < scenario->numberOfRecordings && !status; r++){
+            snprintf(path, SIM_TEST_PATH_LENGTH, "%s%s", recordingDir, recordings[r].fileName);
+            snprintf(repeatPath, SIM_TEST_PATH_LENGTH, "%srecs/%s", repeatDir, recordings[r].fileName);
+            numberOfDifferences += !files_equal(path, repeatPath);
+        }
+        snprintf(name, SIM_TEST_PATH_LENGTH, "%s: second run gives identical recordings", scenario->name);
+        report_check(name, !status && !numberOfDifferences, status ? status : (int) numberOfDifferences);
+    }
+}
+
+/**
+ * @brief threshold recording over 3 days: a tone every day in recording hour 5, a 90 s tone on day 1 in hour 18
+ * split at the 1 min maximum file length, noise outside the recording hours and a tone below the threshold
+ *
+*/
+static void init_threshold_scenario(sim_scenario* scenario){
+    scenario->name = "threshold";
+    scenario->firstDate = "2024-06-01";
+    scenario->config =
+        "recordDuration  1\n"
+        "sleepDuration   0\n"
+        "recordingHours  5,18.\n"
+        "lastRecordingDate  2024-06-30\n"
+        "enableThresholdRecording    1\n"
+        "outputBitDepth  32\n";
+    scenario->script =
+        "tone   *  05:30:00  20  -20\n"
+        "tone   1  18:00:00  90  -26\n"
+        "noise  2  12:00:00  30  -20\n"
+        "tone   0  05:40:00  10  -50\n";
+    scenario->timeZone = NULL;
+    scenario->processingSampleRate = SIM_TEST_SAMPLE_RATE;
+    scenario->captureHours = 0.0;
+    scenario->days = 3.0;
+    scenario->thresholdRecording = 1;
+    scenario->checkRepeatability = 0;
+    scenario->numberOfRecordings = 0;
+    for(unsigned day = 0; day < 3; day++){
+        // files are named after their first frame, the pre-roll
+        scenario->recordings[scenario->numberOfRecordings++] =
+            (expected_recording){day * 86400.0 + 5 * 3600.0 + 30 * 60.0 - SIM_TEST_PREROLL, SIM_TEST_EVENT_LENGTH(20.0, -20.0)};
+        if(day == 1){
+            // the recording hour opens with the tone, so the first file has no pre-roll and
+            // the split file starts where it reaches recordDuration
+            double firstStart = 86400.0 + 18 * 3600.0;
+            double splitStart = firstStart + 60.0;
+            scenario->recordings[scenario->numberOfRecordings++] = (expected_recording){firstStart, 60.0};
+            scenario->recordings[scenario->numberOfRecordings++] =
+                (expected_recording){splitStart, SIM_TEST_EVENT_LENGTH(86400.0 + 18 * 3600.0 + 90.0 - splitStart, -26.0) - SIM_TEST_PREROLL};
+        }
+    }
+}
+
+/**
+ * @brief duty cycle over 2 days: 1 min recordings every 11 min (10 min sleep) in recording hour 10,
+ * 16 bits with dither, run twice to check the recordings are repeatable
+ *
+*/
+static void init_duty_cycle_scenario(sim_scenario* scenario){
+    scenario->name = "duty_cycle";
+    scenario->firstDate = "2024-06-01";
+    scenario->config =
+        "recordDuration  1\n"
+        "sleepDuration   10\n"
+        "minSleepToStopDevice    5\n"
+        "recordingHours  10.\n"
+        "lastRecordingDate  2024-06-30\n"
+        "enableThresholdRecording    0\n"
+        "outputBitDepth  16\n"
+        "enableDither    1\n";
+    scenario->script = "noise  *  00:00:00  86400  -50\n";
+    scenario->timeZone = NULL;
+    scenario->processingSampleRate = SIM_TEST_SAMPLE_RATE;
+    scenario->captureHours = 0.0;
+    scenario->days = 2.0;
+    scenario->thresholdRecording = 0;
+    scenario->checkRepeatability = 1;
+    scenario->numberOfRecordings = 0;
+    for(unsigned day = 0; day < 2; day++){
+        for(double start = 10 * 3600.0; start < 11 * 3600.0; start += 11 * 60.0){
+            scenario->recordings[scenario->numberOfRecordings++] = (expected_recording){day * 86400.0 + start, 60.0};
+        }
+    }
+}
+
+/**
+ * @brief threshold recording over the night of a date change with the capture decimated: one window of
+ * recording hours 23 and 0 spans midnight, a daily tone at 23:30 and a tone recorded across midnight
+ * into the log of the day it started
+ *
+*/
+static void init_date_change_scenario(sim_scenario* scenario, const char* name, const char* firstDate, const char* config){
+    scenario->name = name;
+    scenario->firstDate = firstDate;
+    scenario->config = config;
+    scenario->script =
+        "tone   *  23:30:00  10  -20\n"
+        "tone   0  23:59:40  40  -20\n"
+        "tone   1  00:30:00  10  -20\n";
+    scenario->timeZone = NULL;
+    // hour 0 of both days and hour 23 of both days
+    scenario->captureHours = 4.0;
+    scenario->days = 2.0;
+    scenario->thresholdRecording = 1;
+    scenario->checkRepeatability = 0;
+    scenario->numberOfRecordings = 0;
+    const double starts[] = {23 * 3600.0 + 30 * 60.0, 23 * 3600.0 + 59 * 60.0 + 40.0, 86400.0 + 30 * 60.0, 86400.0 + 23 * 3600.0 + 30 * 60.0};
+    const double durations[] = {10.0, 40.0, 10.0, 10.0};
+    for(unsigned r = 0; r < 4; r++){
+        scenario->recordings[scenario->numberOfRecordings++] = 
+            (expected_recording){starts[r] - SIM_TEST_PREROLL, SIM_TEST_EVENT_LENGTH(durations[r], -20.0)};
+    }
+}
+
+/**
+ * @brief date change scenario from January 31 to February 1, capture at 48 kHz decimated by 3
+ *
+*/
+static void init_month_end_scenario(sim_scenario* scenario){
+    init_date_change_scenario(scenario, "month_end", "2024-01-31", 
+        "recordDuration  1\n"
+        "sleepDuration   0\n"
+        "recordingHours  0,23.\n"
+        "lastRecordingDate  2024-06-30\n"
+        "enableThresholdRecording    1\n"
+        "outputBitDepth  32\n"
+        "sampleRate  48000\n"
+        "decimationFactor    3\n");
+    scenario->processingSampleRate = 16000.0;
+}
+
+/**
+ * @brief date change scenario from December 31 to January 1, capture at 48 kHz decimated by 6
+ *
+*/
+static void init_year_end_scenario(sim_scenario* scenario){
+    init_date_change_scenario(scenario, "year_end", "2023-12-31", 
+        "recordDuration  1\n"
+        "sleepDuration   0\n"
+        "recordingHours  0,23.\n"
+        "lastRecordingDate  2024-06-30\n"
+        "enableThresholdRecording    1\n"
+        "outputBitDepth  32\n"
+        "sampleRate  48000\n"
+        "decimationFactor    6\n");
+    scenario->processingSampleRate = 8000.0;
+}
+
+/**
+ * @brief threshold recording over a DST change in Central Europe (TZ set): daily tones at 01:30 and 05:30 
+ * local time before and after the change, recording hours 1 and 5
+ *
+*/
+static void init_dst_scenario(sim_scenario* scenario, const char* name, const char* firstDate){
+    scenario->name = name;
+    scenario->firstDate = firstDate;
+    scenario->config =
+        "recordDuration  1\n"
+        "sleepDuration   0\n"
+        "recordingHours  1,5.\n"
+        "lastRecordingDate  2024-12-31\n"
+        "enableThresholdRecording    1\n"
+        "outputBitDepth  32\n";
+    scenario->script =
+        "tone   *  01:30:00  10  -20\n"
+        "tone   *  05:30:00  20  -20\n";
+    scenario->timeZone = SIM_TEST_DST_TIME_ZONE;
+    scenario->processingSampleRate = SIM_TEST_SAMPLE_RATE;
+    scenario->captureHours = 4.0;
+    scenario->days = 2.0;
+    scenario->thresholdRecording = 1;
+    scenario->checkRepeatability = 0;
+    scenario->numberOfRecordings = 0;
+    for(unsigned day = 0; day < 2; day++){
+        scenario->recordings[scenario->numberOfRecordings++] =
+            (expected_recording){day * 86400.0 + 1 * 3600.0 + 30 * 60.0 - SIM_TEST_PREROLL, SIM_TEST_EVENT_LENGTH(10.0, -20.0)};
+        scenario->recordings[scenario->numberOfRecordings++] =
+            (expected_recording){day * 86400.0 + 5 * 3600.0 + 30 * 60.0 - SIM_TEST_PREROLL, SIM_TEST_EVENT_LENGTH(20.0, -20.0)};
+    }
+}
+
+/**
+ * @brief DST scenario over the start of summer time (March 31, 23 h day)
+ *
+*/
+static void init_dst_start_scenario(sim_scenario* scenario){
+    init_dst_scenario(scenario, "dst_start", "2024-03-30");
+}
+
+/**
+ * @brief DST scenario over the end of summer time (October 27, 25 h day)
+ *
+*/
+static void init_dst_end_scenario(sim_scenario* scenario){
+    init_dst_scenario(scenario, "dst_end", "2024-10-26");
+}
+
+/**
+ * @brief threshold recording over 30 days, a daily tone in recording hour 5 with the capture at 48 kHz 
+ * decimated by 3: one file per day named after its local start, and the skipped capture frames must
+ * add up to the recording hours (the decimated stream clock must not drift from the capture frames)
+ *
+*/
+static void init_long_run_scenario(sim_scenario* scenario){
+    scenario->name = "long_run";
+    scenario->firstDate = "2024-06-01";
+    scenario->config =
+        "recordDuration  1\n"
+        "sleepDuration   0\n"
+        "recordingHours  5.\n"
+        "lastRecordingDate  2024-06-30\n"
+        "enableThresholdRecording    1\n"
+        "outputBitDepth  32\n"
+        "sampleRate  48000\n"
+        "decimationFactor    3\n";
+    scenario->script = "tone   *  05:30:00  20  -20\n";
+    scenario->timeZone = NULL;
+    scenario->processingSampleRate = 16000.0;
+    scenario->captureHours = 30.0;
+    scenario->days = 30.0;
+    scenario->thresholdRecording = 1;
+    scenario->checkRepeatability = 0;
+    scenario->numberOfRecordings = 0;
+    for(unsigned day = 0; day < 30; day++){
+        scenario->recordings[scenario->numberOfRecordings++] =
+            (expected_recording){day * 86400.0 + 5 * 3600.0 + 30 * 60.0 - SIM_TEST_PREROLL, SIM_TEST_EVENT_LENGTH(20.0, -20.0)};
+    }
+}
+
+int main(int argc, char** argv){
+    const char* amt = (argc > 1) ? argv[1] : SIM_TEST_DEFAULT_AMT;
+    const char* workDir = (argc > 2) ? argv[2] : SIM_TEST_DEFAULT_DIR;
+    char directory[SIM_TEST_PATH_LENGTH];
+    size_t length = strlen(workDir);
+    snprintf(directory, SIM_TEST_PATH_LENGTH, "%s%s", workDir, (length && workDir[length - 1] == '/') ? "" : "/");
+    mkdir(directory, 0777);
+
+    // scenarios with their own TZ restore the inherited one afterwards
+    char inheritedTimeZone[MAX_CHAR_LENGTH];
+    const char* timeZone = getenv("TZ");
+    if(timeZone){
+        snprintf(inheritedTimeZone, MAX_CHAR_LENGTH, "%s", timeZone);
+    }
+    void (*const initScenarios[])(sim_scenario*) = {init_threshold_scenario, init_duty_cycle_scenario, init_month_end_scenario,
+                                                    init_year_end_scenario, init_dst_start_scenario, init_dst_end_scenario,
+                                                    init_long_run_scenario};
+    static sim_scenario scenario;
+    for(unsigned s = 0; s < sizeof(initScenarios) / sizeof(initScenarios[0]); s++){
+        initScenarios[s](&scenario);
+        if(scenario.timeZone){
+            set_time_zone(scenario.timeZone);
+        }
+        test_scenario(amt, directory, &scenario);
+        if(scenario.timeZone){
+            set_time_zone(timeZone ? inheritedTimeZone : NULL);
+        }
+    }
+
+    printf("%u failed checks\n", failedChecks);
+    return failedChecks ? 1 : 0;
+}
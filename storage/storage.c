@@ -0,0 +1,538 @@
+/*
+--------------------------------------------------------------------------
+* Acoustic monitoring tool for Raspberry Pi based on miniaudio framework *
+*                                                                        *
+* Kaue Werner, 2024                                                      *
+--------------------------------------------------------------------------
+*/
+/**
+ * @file storage.c
+ * @author Kaue Werner
+ * @date 10 Mar 2024
+ * @brief Definition of the recording storage manager (quota, eviction and time-to-full forecast) used in AMT
+ * 
+ * The budget left is the smaller of the free space above minFreeBytes and
+ * the quota minus the indexed and open recordings. Files are only evicted
+ * when the budget drops below the bytes written in STORAGE_HEADROOM_SECONDS
+ * at the current rate, lowest priority first and oldest first within a
+ * priority; the recording being written is not indexed and never evicted.
+ * @version 0.1.0
+*/
+#include "storage.h"
+#include "../../miniaudio/miniaudio.h"
+#include "../audio_proc/pcm_convert.h"
+#include "../rec_writer/rec_summary.h"
+#include <FLAC/stream_encoder.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <dirent.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/statvfs.h>
+
+// seconds of recording at the current write rate that must fit in the budget
+#define STORAGE_HEADROOM_SECONDS 600.0
+// budget kept whatever the write rate
+#define STORAGE_MIN_HEADROOM_BYTES (16ULL << 20)
+#define STORAGE_POLL_PERIOD_MS 5000
+#define STORAGE_CONVERSION_BLOCK_SIZE 4096
+
+/**
+ * @brief full path of an indexed file
+ * 
+*/
+static void get_storage_file_path(const char* fileName, char* path){
+    snprintf(path, MAX_CHAR_LENGTH, "%s%s", OUTPUT_WAV_FILE_DIR, fileName);
+}
+
+/**
+ * @brief check if a file name has the given extension
+ * 
+*/
+static unsigned has_extension(const char* fileName, const char* extension){
+    size_t nameLength = strlen(fileName);
+    size_t extensionLength = strlen(extension);
+    return nameLength > extensionLength && !strcmp(fileName + nameLength - extensionLength, extension);
+}
+
+/**
+ * @brief append an entry to the in-memory index, returns 0 on success (lock held)
+ * 
+*/
+static int append_storage_file(storage_manager* storage, const storage_file* file){
+    if(storage->numberOfFiles == storage->capacity){
+        unsigned capacity = storage->capacity ? 2 * storage->capacity : 64;
+        storage_file* files = realloc(storage->files, capacity * sizeof(storage_file));
+        if(!files){
+            return -1;
+        }
+        storage->files = files;
+        storage->capacity = capacity;
+    }
+    storage->files[storage->numberOfFiles++] = *file;
+    storage->indexedBytes += file->sizeInBytes;
+    return 0;
+}
+
+/**
+ * @brief remove entry n from the in-memory index (lock held)
+ * 
+*/
+static void remove_storage_file(storage_manager* storage, unsigned n){
+    storage->indexedBytes -= storage->files[n].sizeInBytes;
+    memmove(&storage->files[n], &storage->files[n + 1], (storage->numberOfFiles - n - 1) * sizeof(storage_file));
+    storage->numberOfFiles--;
+}
+
+/**
+ * @brief index of the entry of a file name, numberOfFiles if it is not indexed (lock held)
+ * 
+*/
+static unsigned find_storage_file(storage_manager* storage, const char* fileName){
+    unsigned n = 0;
+    while(n < storage->numberOfFiles && strcmp(storage->files[n].fileName, fileName)){
+        n++;
+    }
+    return n;
+}
+
+/**
+ * @brief write one index line
+ * 
+*/
+static void write_storage_file_entry(FILE* file, const storage_file* entry){
+    fprintf(file, "%ld\t%llu\t%u\t%s\n", (long) entry->time, entry->sizeInBytes, entry->priority, entry->fileName);
+}
+
+/**
+ * @brief rewrite the index file atomically (through a temporary file) (lock held)
+ * 
+*/
+static void save_storage_index(storage_manager* storage){
+    char tmpFileName[MAX_CHAR_LENGTH + 4];
+    snprintf(tmpFileName, sizeof(tmpFileName), "%s.tmp", STORAGE_INDEX_FILE_PATH);
+    FILE* file = fopen(tmpFileName, "w");
+    if(!file){
+        return;
+    }
+    for(unsigned n = 0; n < storage->numberOfFiles; n++){
+        write_storage_file_entry(file, &storage->files[n]);
+    }
+    fclose(file);
+    rename(tmpFileName, STORAGE_INDEX_FILE_PATH);
+}
+
+/**
+ * @brief order of files in the index, oldest first
+ * 
+*/
+static int compare_storage_files(const void* a, const void* b){
+    time_t timeA = ((const storage_file*) a)->time;
+    time_t timeB = ((const storage_file*) b)->time;
+    return (timeA > timeB) - (timeA < timeB);
+}
+
+/**
+ * @brief build the index from the recordings found in REC_DIR, used when there is no index file yet
+ * 
+*/
+static void scan_storage_directory(storage_manager* storage){
+    DIR* directory = opendir(REC_DIR);
+    if(!directory){
+        return;
+    }
+    struct dirent* entry;
+    while((entry = readdir(directory))){
+        if(!has_extension(entry->d_name, ".wav") && !has_extension(entry->d_name, ".flac")){
+            continue;
+        }
+        storage_file file;
+        char path[MAX_CHAR_LENGTH];
+        struct stat fileInfo;
+        snprintf(file.fileName, MAX_CHAR_LENGTH, "%s", entry->d_name);
+        get_storage_file_path(file.fileName, path);
+        if(stat(path, &fileInfo) || !S_ISREG(fileInfo.st_mode)){
+            continue;
+        }
+        file.sizeInBytes = (unsigned long long) fileInfo.st_size;
+        file.time = fileInfo.st_mtime;
+        // the trigger of older recordings is not known
+        file.priority = STORAGE_PRIORITY_SCHEDULED;
+        append_storage_file(storage, &file);
+    }
+    closedir(directory);
+    qsort(storage->files, storage->numberOfFiles, sizeof(storage_file), compare_storage_files);
+    save_storage_index(storage);
+}
+
+/**
+ * @brief load the index file, entries of files deleted in the meantime are dropped and
+ * sizes refreshed. Returns 0 if the index file exists
+ * 
+*/
+static int load_storage_index(storage_manager* storage){
+    FILE* file = fopen(STORAGE_INDEX_FILE_PATH, "r");
+    if(!file){
+        return -1;
+    }
+    char line[2 * MAX_CHAR_LENGTH];
+    unsigned numberOfStaleEntries = 0;
+    while(fgets(line, sizeof(line), file)){
+        storage_file entry;
+        long timeValue;
+        char path[MAX_CHAR_LENGTH];
+        struct stat fileInfo;
+        if(sscanf(line, "%ld\t%llu\t%u\t%99s", &timeValue, &entry.sizeInBytes, &entry.priority, entry.fileName) != 4){
+            continue;
+        }
+        entry.time = (time_t) timeValue;
+        get_storage_file_path(entry.fileName, path);
+        if(stat(path, &fileInfo)){
+            numberOfStaleEntries++;
+            continue;
+        }
+        entry.sizeInBytes = (unsigned long long) fileInfo.st_size;
+        append_storage_file(storage, &entry);
+    }
+    fclose(file);
+    if(numberOfStaleEntries){
+        save_storage_index(storage);
+    }
+    return 0;
+}
+
+/**
+ * @brief re-encode a WAV recording to 16-bit FLAC next to it, returns 0 on success (storage thread side)
+ * 
+*/
+static int downgrade_storage_file(storage_manager* storage, const char* wavPath, const char* flacPath){
+    ma_decoder_config decoderConfig = ma_decoder_config_init(ma_format_f32, 0, 0);
+    ma_decoder decoder;
+    if(ma_decoder_init_file(wavPath, &decoderConfig, &decoder) != MA_SUCCESS){
+        return -1;
+    }
+    const unsigned channels = decoder.outputChannels;
+    float* input = malloc(STORAGE_CONVERSION_BLOCK_SIZE * channels * sizeof(float));
+    int32_t* output = malloc(STORAGE_CONVERSION_BLOCK_SIZE * channels * sizeof(int32_t));
+    FLAC__StreamEncoder* encoder = FLAC__stream_encoder_new();
+    int result = -1;
+    if(input && output && encoder){
+        FLAC__stream_encoder_set_channels(encoder, channels);
+        FLAC__stream_encoder_set_bits_per_sample(encoder, 16);
+        FLAC__stream_encoder_set_sample_rate(encoder, decoder.outputSampleRate);
+        FLAC__stream_encoder_set_compression_level(encoder, storage->config.flacCompressionLevel);
+        if(FLAC__stream_encoder_init_file(encoder, flacPath, NULL, NULL) == FLAC__STREAM_ENCODER_INIT_STATUS_OK){
+            tpdf_dither dither;
+            init_tpdf_dither(&dither, (uint32_t) time(NULL), 1);
+            ma_uint64 framesRead;
+            unsigned encodeFailed = 0;
+            while(!encodeFailed && !atomic_load(&storage->stopRequested) &&
+                  ma_decoder_read_pcm_frames(&decoder, input, STORAGE_CONVERSION_BLOCK_SIZE, &framesRead) == MA_SUCCESS && framesRead > 0){
+                convert_float_to_int32(&dither, input, output, (size_t) framesRead * channels, 16);
+                encodeFailed = !FLAC__stream_encoder_process_interleaved(encoder, output, (unsigned) framesRead);
+            }
+            // an interrupted conversion is discarded, the WAV file is kept
+            result = (FLAC__stream_encoder_finish(encoder) && !encodeFailed && !atomic_load(&storage->stopRequested)) ? 0 : -1;
+            if(result){
+                unlink(flacPath);
+            }
+        }
+    }
+    if(encoder){
+        FLAC__stream_encoder_delete(encoder);
+    }
+    free(input);
+    free(output);
+    ma_decoder_uninit(&decoder);
+    return result;
+}
+
+/**
+ * @brief budget left in bytes (negative when exceeded) from the last free space poll (lock held)
+ * 
+*/
+static double get_storage_budget(storage_manager* storage){
+    double budget = (double) storage->freeBytes - (double) storage->config.minFreeBytes;
+    if(storage->config.quotaInBytes){
+        double quotaBudget = (double) storage->config.quotaInBytes - (double) storage->indexedBytes -
+                             (double) atomic_load_explicit(&storage->openFileBytes, memory_order_relaxed);
+        budget = (quotaBudget < budget) ? quotaBudget : budget;
+    }
+    return budget;
+}
+
+/**
+ * @brief read the free space and update the write rate and time to full forecast (lock held)
+ * 
+*/
+static void poll_storage(storage_manager* storage){
+    struct statvfs fileSystemInfo;
+    if(!statvfs(REC_DIR, &fileSystemInfo)){
+        storage->freeBytes = (unsigned long long) fileSystemInfo.f_bavail * fileSystemInfo.f_frsize;
+    }
+
+    // write rate averaged over about a minute of polls
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    double elapsed = (now.tv_sec - storage->lastPollTime.tv_sec) + (now.tv_nsec - storage->lastPollTime.tv_nsec) * 1e-9;
+    unsigned long long bytesWritten = atomic_load_explicit(&storage->bytesWritten, memory_order_relaxed);
+    if(elapsed > 0.0){
+        double rate = (double)(bytesWritten - storage->lastPollBytesWritten) / elapsed;
+        double weight = elapsed / (elapsed + 60.0);
+        storage->writeRate += weight * (rate - storage->writeRate);
+    }
+    storage->lastPollBytesWritten = bytesWritten;
+    storage->lastPollTime = now;
+
+    double budget = get_storage_budget(storage);
+    storage->timeToFull = (storage->writeRate > 0.0) ? ((budget > 0.0) ? budget / storage->writeRate : 0.0) : INFINITY;
+}
+
+/**
+ * @brief index of the file to evict or downgrade next (lowest priority, then oldest),
+ * only WAV files when wavOnly is set. Returns numberOfFiles if there is none (lock held)
+ * 
+*/
+static unsigned find_storage_victim(storage_manager* storage, unsigned wavOnly){
+    unsigned victim = storage->numberOfFiles;
+    for(unsigned n = 0; n < storage->numberOfFiles; n++){
+        if(wavOnly && !has_extension(storage->files[n].fileName, ".wav")){
+            continue;
+        }
+        if(victim == storage->numberOfFiles || storage->files[n].priority < storage->files[victim].priority){
+            victim = n;
+        }
+    }
+    return victim;
+}
+
+/**
+ * @brief downgrade or evict files until the budget covers the headroom, then update
+ * the full flag (storage thread side)
+ * 
+*/
+static void enforce_storage_budget(storage_manager* storage){
+    pthread_mutex_lock(&storage->lock);
+    poll_storage(storage);
+    double headroom = storage->writeRate * STORAGE_HEADROOM_SECONDS;
+    headroom = (headroom > (double) STORAGE_MIN_HEADROOM_BYTES) ? headroom : (double) STORAGE_MIN_HEADROOM_BYTES;
+    unsigned wavOnly = storage->config.enableDowngrade;
+    while(get_storage_budget(storage) < headroom && !atomic_load(&storage->stopRequested)){
+        unsigned victim = find_storage_victim(storage, wavOnly);
+        if(victim == storage->numberOfFiles){
+            if(!wavOnly){
+                break;
+            }
+            // nothing left to downgrade
+            wavOnly = 0;
+            continue;
+        }
+        storage_file file = storage->files[victim];
+        char path[MAX_CHAR_LENGTH];
+        get_storage_file_path(file.fileName, path);
+
+        if(wavOnly){
+            char flacPath[MAX_CHAR_LENGTH];
+            snprintf(flacPath, MAX_CHAR_LENGTH, "%.*s.flac", (int)(strlen(path) - 4), path);
+            pthread_mutex_unlock(&storage->lock);
+            int result = downgrade_storage_file(storage, path, flacPath);
+            pthread_mutex_lock(&storage->lock);
+            // the writer and the startup recovery add files while unlocked, replacing an entry of the 
+            // same name and sorting the index moves the victim, so it is looked up again by name
+            victim = find_storage_file(storage, file.fileName);
+            if(victim == storage->numberOfFiles || storage->files[victim].sizeInBytes != file.sizeInBytes){
+                // gone or rewritten (e.g. recovered) during the conversion, the FLAC file may be stale
+                if(!result){
+                    unlink(flacPath);
+                }
+                continue;
+            }
+            struct stat fileInfo;
+            if(!result && !stat(flacPath, &fileInfo)){
+                unlink(path);
+                storage_file* entry = &storage->files[victim];
+                storage->indexedBytes -= entry->sizeInBytes;
+                entry->sizeInBytes = (unsigned long long) fileInfo.st_size;
+                storage->indexedBytes += entry->sizeInBytes;
+                snprintf(entry->fileName, MAX_CHAR_LENGTH, "%.*s.flac", (int)(strlen(file.fileName) - 4), file.fileName);
+                storage->downgradedFiles++;
+            #ifdef DEBUG
+                printf("-> Storage: downgraded %s to 16-bit FLAC\n", file.fileName);
+            #endif
+                save_storage_index(storage);
+                poll_storage(storage);
+                continue;
+            }
+            if(atomic_load(&storage->stopRequested)){
+                break;
+            }
+            // a WAV file that can not be decoded is evicted instead
+        }
+        unlink(path);
+        // the summary sidecar goes with its recording, a downgraded file keeps it
+        char summaryPath[MAX_CHAR_LENGTH];
+        get_rec_summary_file_name(path, summaryPath, MAX_CHAR_LENGTH);
+        unlink(summaryPath);
+        remove_storage_file(storage, victim);
+        storage->evictedFiles++;
+    #ifdef DEBUG
+        printf("-> Storage: evicted %s\n", file.fileName);
+    #endif
+        save_storage_index(storage);
+        poll_storage(storage);
+    }
+
+    int full = get_storage_budget(storage) <= 0.0;
+    if(full != atomic_load(&storage->full)){
+        printf(full ? "Storage full, recordings are skipped.\n" : "Storage available again, recordings resumed.\n");
+    }
+    atomic_store(&storage->full, full);
+    pthread_mutex_unlock(&storage->lock);
+}
+
+/**
+ * @brief storage thread main loop
+ * 
+*/
+static void* storage_thread(void* arg){
+    storage_manager* storage = (storage_manager*) arg;
+    while(!atomic_load(&storage->stopRequested)){
+        for(unsigned n = 0; n < STORAGE_POLL_PERIOD_MS / 100 && !atomic_load(&storage->stopRequested); n++){
+            usleep(100 * 1000);
+        }
+        enforce_storage_budget(storage);
+    }
+    return NULL;
+}
+
+/**
+ * @brief initialize storage manager (storage_manager), load or build the file index and start
+ * its thread, returns 0 on success
+ * 
+*/
+int init_storage_manager(storage_manager* storage, const storage_config* config){
+    storage->config = *config;
+    storage->files = NULL;
+    storage->numberOfFiles = 0;
+    storage->capacity = 0;
+    storage->indexedBytes = 0;
+    storage->freeBytes = 0;
+    storage->writeRate = 0.0;
+    storage->timeToFull = INFINITY;
+    storage->evictedFiles = 0;
+    storage->downgradedFiles = 0;
+    storage->lastPollBytesWritten = 0;
+    clock_gettime(CLOCK_MONOTONIC, &storage->lastPollTime);
+    atomic_init(&storage->bytesWritten, 0);
+    atomic_init(&storage->openFileBytes, 0);
+    atomic_init(&storage->skippedRecordings, 0);
+    atomic_init(&storage->full, 0);
+    atomic_init(&storage->stopRequested, 0);
+    if(pthread_mutex_init(&storage->lock, NULL)){
+        return -1;
+    }
+
+    if(load_storage_index(storage)){
+        scan_storage_directory(storage);
+    }
+    // the full flag must be valid before the first recording
+    enforce_storage_budget(storage);
+#ifdef DEBUG
+    printf("-> Storage: %u indexed file(s), %.1f MB, %.1f MB free\n", storage->numberOfFiles,
+           storage->indexedBytes / 1048576.0, storage->freeBytes / 1048576.0);
+#endif
+
+    if(pthread_create(&storage->thread, NULL, storage_thread, storage)){
+        pthread_mutex_destroy(&storage->lock);
+        free(storage->files);
+        return -1;
+    }
+    return 0;
+}
+
+/**
+ * @brief stop the storage thread and free storage manager (storage_manager)
+ * 
+*/
+void fini_storage_manager(storage_manager* storage){
+    atomic_store(&storage->stopRequested, 1);
+    pthread_join(storage->thread, NULL);
+    pthread_mutex_destroy(&storage->lock);
+    free(storage->files);
+    storage->files = NULL;
+}
+
+/**
+ * @brief add a closed or recovered recording (full path) to the index, an entry 
+ * with the same name is replaced (writer thread side)
+ * 
+*/
+void storage_add_file(storage_manager* storage, const char* path, unsigned priority){
+    struct stat fileInfo;
+    storage_file file;
+    const char* fileName = strrchr(path, '/');
+    snprintf(file.fileName, MAX_CHAR_LENGTH, "%s", fileName ? fileName + 1 : path);
+    if(stat(path, &fileInfo)){
+        file.sizeInBytes = atomic_load(&storage->openFileBytes);
+        file.time = time(NULL);
+    }
+    else {
+        file.sizeInBytes = (unsigned long long) fileInfo.st_size;
+        file.time = fileInfo.st_mtime;
+    }
+    file.priority = priority;
+
+    pthread_mutex_lock(&storage->lock);
+    atomic_store(&storage->openFileBytes, 0);
+    // a file recovered after a power loss may already be indexed by a directory scan
+    unsigned replaced = 0;
+    unsigned indexed = find_storage_file(storage, file.fileName);
+    if(indexed < storage->numberOfFiles){
+        remove_storage_file(storage, indexed);
+        replaced = 1;
+    }
+    if(!append_storage_file(storage, &file)){
+        unsigned n = storage->numberOfFiles;
+        if(n > 1 && storage->files[n - 2].time > storage->files[n - 1].time){
+            qsort(storage->files, n, sizeof(storage_file), compare_storage_files);
+            replaced = 1;
+        }
+        if(replaced){
+            save_storage_index(storage);
+        }
+        else {
+            FILE* indexFile = fopen(STORAGE_INDEX_FILE_PATH, "a");
+            if(indexFile){
+                write_storage_file_entry(indexFile, &file);
+                fclose(indexFile);
+            }
+        }
+    }
+    pthread_mutex_unlock(&storage->lock);
+}
+
+/**
+ * @brief write the storage state (free space, usage, write rate, time to full and counters)
+ * as "name value" lines
+ * 
+*/
+void write_storage_stats(storage_manager* storage, FILE* file){
+    pthread_mutex_lock(&storage->lock);
+    fprintf(file, "storage_free_mb %.1f\n", storage->freeBytes / 1048576.0);
+    fprintf(file, "storage_files %u\n", storage->numberOfFiles);
+    fprintf(file, "storage_used_mb %.1f\n", (storage->indexedBytes + atomic_load(&storage->openFileBytes)) / 1048576.0);
+    fprintf(file, "storage_quota_mb %.1f\n", storage->config.quotaInBytes / 1048576.0);
+    fprintf(file, "storage_write_rate_kb_s %.2f\n", storage->writeRate / 1024.0);
+    if(isinf(storage->timeToFull)){
+        fprintf(file, "storage_time_to_full_h inf\n");
+    }
+    else {
+        fprintf(file, "storage_time_to_full_h %.2f\n", storage->timeToFull / 3600.0);
+    }
+    fprintf(file, "storage_full %d\n", atomic_load(&storage->full));
+    fprintf(file, "storage_evicted_files %lu\n", storage->evictedFiles);
+    fprintf(file, "storage_downgraded_files %lu\n", storage->downgradedFiles);
+    fprintf(file, "storage_skipped_recordings %lu\n", atomic_load(&storage->skippedRecordings));
+    pthread_mutex_unlock(&storage->lock);
+}
@@ -0,0 +1,133 @@
+/*
+--------------------------------------------------------------------------
+* Acoustic monitoring tool for Raspberry Pi based on miniaudio framework *
+*                                                                        *
+* Kaue Werner, 2024                                                      *
+--------------------------------------------------------------------------
+*/
+/**
+ * @file storage.h
+ * @author Kaue Werner
+ * @date 10 Mar 2024
+ * @brief Header with the recording storage manager (quota, eviction and time-to-full forecast) used in AMT
+ * @version 0.1.0
+*/
+#ifndef STORAGE_H
+#define STORAGE_H
+#include "../config_defines.h"
+#include <stdatomic.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <time.h>
+
+/**
+ * @brief Recording priorities, lower priorities are evicted first
+ *
+*/
+typedef enum {
+    STORAGE_PRIORITY_SCHEDULED,
+    STORAGE_PRIORITY_TRIGGERED
+} storage_priority;
+
+/**
+ * @brief Storage settings data struct
+ * quotaInBytes limits the size of the indexed recordings (0: no quota), 
+ * minFreeBytes is kept free on the file system, with enableDowngrade WAV 
+ * recordings are re-encoded to 16-bit FLAC before any file is deleted.
+*/
+typedef struct {
+    unsigned long long quotaInBytes;
+    unsigned long long minFreeBytes;
+    unsigned enableDowngrade:1;
+    unsigned flacCompressionLevel;
+} storage_config;
+
+/**
+ * @brief Indexed recording file, fileName is relative to OUTPUT_WAV_FILE_DIR
+ *
+*/
+typedef struct {
+    char fileName[MAX_CHAR_LENGTH];
+    unsigned long long sizeInBytes;
+    time_t time;
+    unsigned priority;
+} storage_file;
+
+/**
+ * @brief Storage manager data struct
+ * The index of recordings (oldest first) is kept in memory and in 
+ * STORAGE_INDEX_FILE_PATH, so the directory is only scanned when there is no 
+ * index yet. The writer thread reports written bytes and closed files, the 
+ * storage thread polls the free space, forecasts the time until the budget 
+ * is used up, evicts or downgrades files when it runs low and raises full 
+ * when no room is left, which makes the writer skip recordings.
+*/
+typedef struct {
+    storage_config config;
+    pthread_mutex_t lock;
+    storage_file* files;
+    unsigned numberOfFiles;
+    unsigned capacity;
+    unsigned long long indexedBytes;
+    unsigned long long freeBytes;
+    double writeRate;
+    double timeToFull;
+    unsigned long evictedFiles;
+    unsigned long downgradedFiles;
+    /* writer thread side */
+    atomic_ullong bytesWritten;
+    atomic_ullong openFileBytes;
+    atomic_ulong skippedRecordings;
+    atomic_int full;
+    /* storage thread */
+    pthread_t thread;
+    atomic_int stopRequested;
+    unsigned long long lastPollBytesWritten;
+    struct timespec lastPollTime;
+} storage_manager;
+
+/**
+ * @brief initialize storage manager (storage_manager), load or build the file index and start 
+ * its thread, returns 0 on success
+ * 
+*/
+int init_storage_manager(storage_manager* storage, const storage_config* config);
+
+/**
+ * @brief stop the storage thread and free storage manager (storage_manager)
+ * 
+*/
+void fini_storage_manager(storage_manager* storage);
+
+/**
+ * @brief check if a recording can be started or continued (writer thread side)
+ * 
+*/
+static inline unsigned storage_has_room(storage_manager* storage){
+    return !atomic_load_explicit(&storage->full, memory_order_relaxed);
+}
+
+/**
+ * @brief account bytes written to the open recording (writer thread side)
+ * 
+*/
+static inline void storage_account_bytes(storage_manager* storage, unsigned long long bytes){
+    atomic_fetch_add_explicit(&storage->bytesWritten, bytes, memory_order_relaxed);
+    atomic_fetch_add_explicit(&storage->openFileBytes, bytes, memory_order_relaxed);
+}
+
+/**
+ * @brief add a closed or recovered recording (full path) to the index, an entry 
+ * with the same name is replaced (writer thread side)
+ * 
+*/
+void storage_add_file(storage_manager* storage, const char* path, unsigned priority);
+
+/**
+ * @brief write the storage state (free space, usage, write rate, time to full and counters) 
+ * as "name value" lines
+ * 
+*/
+void write_storage_stats(storage_manager* storage, FILE* file);
+
+#endif // STORAGE_H
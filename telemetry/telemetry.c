@@ -0,0 +1,226 @@
+/*
+--------------------------------------------------------------------------
+* Acoustic monitoring tool for Raspberry Pi based on miniaudio framework *
+*                                                                        *
+* Kaue Werner, 2024                                                      *
+--------------------------------------------------------------------------
+*/
+/**
+ * @file telemetry.c
+ * @author Kaue Werner
+ * @date 10 Mar 2024
+ * @brief Definition of the real-time telemetry (callback timing and buffer statistics) used in AMT
+ * @version 0.1.0
+*/
+#include "telemetry.h"
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+
+#define TELEMETRY_POLL_PERIOD_MS 100
+// a gap of more than this many callback periods between callbacks is counted as late (likely xrun)
+#define TELEMETRY_LATE_CALLBACK_PERIODS 2
+
+static const char* stageNames[NUMBER_OF_TELEMETRY_STAGES] = {"gain", "decimation", "filter", "analysis", "recording"};
+
+/**
+ * @brief write buffer statistics of one ring buffer to the stats file
+ * 
+*/
+static void write_ring_buffer_stats(FILE* file, const char* name, const ring_buffer* rb){
+    fprintf(file, "%s_fill_frames %zu\n", name, ring_buffer_fill((ring_buffer*) rb));
+    fprintf(file, "%s_capacity_frames %zu\n", name, rb->capacityInFrames);
+    fprintf(file, "%s_max_fill_frames %zu\n", name, atomic_load(&rb->maxFillInFrames));
+    fprintf(file, "%s_overflows %lu\n", name, atomic_load(&rb->overflowCount));
+    fprintf(file, "%s_dropped_frames %lu\n", name, atomic_load(&rb->droppedFrames));
+    fprintf(file, "%s_high_water_mark_count %lu\n", name, atomic_load(&rb->highWaterMarkCount));
+}
+
+/**
+ * @brief rewrite the stats file with the current counters (snapshot thread side)
+ * 
+*/
+static void write_telemetry_snapshot(amt_telemetry* telemetry){
+    char tmpFileName[MAX_CHAR_LENGTH + 4];
+    snprintf(tmpFileName, sizeof(tmpFileName), "%s.tmp", telemetry->fileName);
+    FILE* file = fopen(tmpFileName, "w");
+    if(!file){
+        return;
+    }
+    unsigned long long now = get_telemetry_time();
+    unsigned long long callbackCount = atomic_load_explicit(&telemetry->callbackCount, memory_order_relaxed);
+    unsigned long long callbackNanoseconds = atomic_load_explicit(&telemetry->callbackNanoseconds, memory_order_relaxed);
+    time_t wallTime = time(NULL);
+    char timeLabel[MAX_CHAR_LENGTH];
+    struct tm wallTimeInfo;
+    localtime_r(&wallTime, &wallTimeInfo);
+    strftime(timeLabel, MAX_CHAR_LENGTH, "%Y-%m-%d %H:%M:%S", &wallTimeInfo);
+
+    fprintf(file, "time %s\n", timeLabel);
+    fprintf(file, "uptime_s %.0f\n", (now - telemetry->startTime) * 1e-9);
+    fprintf(file, "callbacks %llu\n", callbackCount);
+    fprintf(file, "frames %llu\n", atomic_load_explicit(&telemetry->frameCount, memory_order_relaxed));
+    fprintf(file, "late_callbacks %lu\n", atomic_load_explicit(&telemetry->lateCallbackCount, memory_order_relaxed));
+    fprintf(file, "callback_mean_us %.2f\n", callbackCount ? callbackNanoseconds * 1e-3 / callbackCount : 0.0);
+    fprintf(file, "callback_max_us %.2f\n", atomic_load_explicit(&telemetry->maxCallbackNanoseconds, memory_order_relaxed) * 1e-3);
+    // share of wall time spent in the callback since the previous snapshot
+    double interval = (double)(now - telemetry->lastSnapshotTime);
+    fprintf(file, "callback_load_percent %.3f\n", 
+            interval > 0.0 ? 100.0 * (callbackNanoseconds - telemetry->lastSnapshotCallbackNanoseconds) / interval : 0.0);
+    for(unsigned s = 0; s < NUMBER_OF_TELEMETRY_STAGES; s++){
+        unsigned long long stageNanoseconds = atomic_load_explicit(&telemetry->stageNanoseconds[s], memory_order_relaxed);
+        fprintf(file, "stage_%s_mean_us %.2f\n", stageNames[s], callbackCount ? stageNanoseconds * 1e-3 / callbackCount : 0.0);
+    }
+    fprintf(file, "callback_histogram_us");
+    for(unsigned k = 0; k < TELEMETRY_HISTOGRAM_BINS; k++){
+        fprintf(file, " %u:%lu", k ? (1u << k) : 0, atomic_load_explicit(&telemetry->callbackHistogram[k], memory_order_relaxed));
+    }
+    fprintf(file, "\n");
+
+    pthread_mutex_lock(&telemetry->sourceLock);
+    if(telemetry->writerFrames){
+        write_ring_buffer_stats(file, "writer", telemetry->writerFrames);
+    }
+    if(telemetry->encodeNanoseconds){
+        fprintf(file, "writer_encode_s %.3f\n", atomic_load(telemetry->encodeNanoseconds) * 1e-9);
+    }
+    if(telemetry->analysisFrames){
+        write_ring_buffer_stats(file, "analysis", telemetry->analysisFrames);
+    }
+    if(telemetry->storage){
+        write_storage_stats(telemetry->storage, file);
+    }
+    pthread_mutex_unlock(&telemetry->sourceLock);
+
+    fclose(file);
+    rename(tmpFileName, telemetry->fileName);
+    telemetry->lastSnapshotTime = now;
+    telemetry->lastSnapshotCallbackNanoseconds = callbackNanoseconds;
+}
+
+/**
+ * @brief snapshot thread main loop
+ * 
+*/
+static void* telemetry_thread(void* arg){
+    amt_telemetry* telemetry = (amt_telemetry*) arg;
+    unsigned long long periodInNanoseconds = telemetry->periodInSeconds * 1000000000ULL;
+    unsigned long long nextSnapshot = get_telemetry_time() + periodInNanoseconds;
+    while(!atomic_load(&telemetry->stopRequested)){
+        if(get_telemetry_time() >= nextSnapshot){
+            write_telemetry_snapshot(telemetry);
+            nextSnapshot += periodInNanoseconds;
+        }
+        usleep(TELEMETRY_POLL_PERIOD_MS * 1000);
+    }
+    return NULL;
+}
+
+/**
+ * @brief initialize telemetry (amt_telemetry) and start the snapshot thread writing 
+ * fileName every periodInSeconds, returns 0 on success
+ * 
+*/
+int init_telemetry(amt_telemetry* telemetry, double sampleRate, unsigned periodInSeconds, const char* fileName){
+    atomic_init(&telemetry->callbackCount, 0);
+    atomic_init(&telemetry->frameCount, 0);
+    atomic_init(&telemetry->lateCallbackCount, 0);
+    atomic_init(&telemetry->maxCallbackNanoseconds, 0);
+    atomic_init(&telemetry->callbackNanoseconds, 0);
+    for(unsigned k = 0; k < TELEMETRY_HISTOGRAM_BINS; k++){
+        atomic_init(&telemetry->callbackHistogram[k], 0);
+    }
+    for(unsigned s = 0; s < NUMBER_OF_TELEMETRY_STAGES; s++){
+        atomic_init(&telemetry->stageNanoseconds[s], 0);
+    }
+    atomic_init(&telemetry->stopRequested, 0);
+    telemetry->lastCallbackStart = 0;
+    telemetry->sampleRate = sampleRate;
+    telemetry->periodInSeconds = periodInSeconds ? periodInSeconds : 1;
+    strncpy(telemetry->fileName, fileName, MAX_CHAR_LENGTH - 1);
+    telemetry->fileName[MAX_CHAR_LENGTH - 1] = '\0';
+    telemetry->startTime = get_telemetry_time();
+    telemetry->lastSnapshotTime = telemetry->startTime;
+    telemetry->lastSnapshotCallbackNanoseconds = 0;
+    telemetry->writerFrames = NULL;
+    telemetry->analysisFrames = NULL;
+    telemetry->encodeNanoseconds = NULL;
+    telemetry->storage = NULL;
+    if(pthread_mutex_init(&telemetry->sourceLock, NULL)){
+        return -1;
+    }
+    if(pthread_create(&telemetry->thread, NULL, telemetry_thread, telemetry)){
+        pthread_mutex_destroy(&telemetry->sourceLock);
+        return -1;
+    }
+    return 0;
+}
+
+/**
+ * @brief write a last snapshot, stop the snapshot thread and free telemetry (amt_telemetry)
+ * 
+*/
+void fini_telemetry(amt_telemetry* telemetry){
+    atomic_store(&telemetry->stopRequested, 1);
+    pthread_join(telemetry->thread, NULL);
+    write_telemetry_snapshot(telemetry);
+    pthread_mutex_destroy(&telemetry->sourceLock);
+}
+
+/**
+ * @brief record one callback that started at callbackStart (audio thread side), stageNanoseconds 
+ * holds the time spent in each telemetry_stage
+ * 
+*/
+void record_callback_telemetry(amt_telemetry* telemetry, unsigned long long callbackStart, const unsigned long long* stageNanoseconds, 
+                               unsigned frameCount){
+    unsigned long long start = callbackStart;
+    unsigned long long duration = get_telemetry_time() - start;
+
+    // callbacks arriving much later than one period after the previous one point to an xrun
+    if(telemetry->lastCallbackStart){
+        double period = 1e9 * frameCount / telemetry->sampleRate;
+        if((double)(start - telemetry->lastCallbackStart) > TELEMETRY_LATE_CALLBACK_PERIODS * period){
+            atomic_fetch_add_explicit(&telemetry->lateCallbackCount, 1, memory_order_relaxed);
+        }
+    }
+    telemetry->lastCallbackStart = start;
+
+    unsigned bin = 0;
+    for(unsigned long long us = duration / 1000; us > 1 && bin < TELEMETRY_HISTOGRAM_BINS - 1; us >>= 1){
+        bin++;
+    }
+    atomic_fetch_add_explicit(&telemetry->callbackHistogram[bin], 1, memory_order_relaxed);
+    atomic_fetch_add_explicit(&telemetry->callbackCount, 1, memory_order_relaxed);
+    atomic_fetch_add_explicit(&telemetry->frameCount, frameCount, memory_order_relaxed);
+    atomic_fetch_add_explicit(&telemetry->callbackNanoseconds, duration, memory_order_relaxed);
+    for(unsigned s = 0; s < NUMBER_OF_TELEMETRY_STAGES; s++){
+        atomic_fetch_add_explicit(&telemetry->stageNanoseconds[s], stageNanoseconds[s], memory_order_relaxed);
+    }
+    if(duration > atomic_load_explicit(&telemetry->maxCallbackNanoseconds, memory_order_relaxed)){
+        atomic_store_explicit(&telemetry->maxCallbackNanoseconds, duration, memory_order_relaxed);
+    }
+}
+
+/**
+ * @brief set (or clear with NULL) the writer/analysis buffers and encode time reported in snapshots
+ * 
+*/
+void set_telemetry_sources(amt_telemetry* telemetry, const ring_buffer* writerFrames, const ring_buffer* analysisFrames, 
+                           const atomic_ullong* encodeNanoseconds){
+    pthread_mutex_lock(&telemetry->sourceLock);
+    telemetry->writerFrames = writerFrames;
+    telemetry->analysisFrames = analysisFrames;
+    telemetry->encodeNanoseconds = encodeNanoseconds;
+    pthread_mutex_unlock(&telemetry->sourceLock);
+}
+
+/**
+ * @brief set (or clear with NULL) the storage manager reported in snapshots
+ * 
+*/
+void set_telemetry_storage(amt_telemetry* telemetry, storage_manager* storage){
+    pthread_mutex_lock(&telemetry->sourceLock);
+    telemetry->storage = storage;
+    pthread_mutex_unlock(&telemetry->sourceLock);
+}
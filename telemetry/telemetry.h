@@ -0,0 +1,130 @@
+/*
+--------------------------------------------------------------------------
+* Acoustic monitoring tool for Raspberry Pi based on miniaudio framework *
+*                                                                        *
+* Kaue Werner, 2024                                                      *
+--------------------------------------------------------------------------
+*/
+/**
+ * @file telemetry.h
+ * @author Kaue Werner
+ * @date 10 Mar 2024
+ * @brief Header with the real-time telemetry (callback timing and buffer statistics) used in AMT
+ * @version 0.1.0
+*/
+#ifndef TELEMETRY_H
+#define TELEMETRY_H
+#include "../config_defines.h"
+#include "../ring_buffer/ring_buffer.h"
+#include "../storage/storage.h"
+#include <pthread.h>
+#include <time.h>
+
+#define TELEMETRY_HISTOGRAM_BINS 16
+
+/**
+ * @brief Timed stages of the audio callback
+ *
+*/
+typedef enum {
+    TELEMETRY_STAGE_GAIN,
+    TELEMETRY_STAGE_DECIMATION,
+    TELEMETRY_STAGE_FILTER,
+    TELEMETRY_STAGE_ANALYSIS,
+    TELEMETRY_STAGE_RECORDING,
+    NUMBER_OF_TELEMETRY_STAGES
+} telemetry_stage;
+
+/**
+ * @brief Telemetry data struct
+ * The audio callback is the only writer of the callback counters (relaxed 
+ * atomics, no locks), the snapshot thread periodically reads them together 
+ * with the writer/analysis buffer statistics and rewrites the stats file.
+ * Histogram bin k counts callbacks that took [2^k, 2^(k+1)) microseconds.
+ * Counters that can pass 2^32 within a deployment are 64 bits wide (unsigned 
+ * long is 32 bits on ARMv6/ARMv7).
+*/
+typedef struct {
+    atomic_ullong callbackCount;
+    atomic_ullong frameCount;
+    atomic_ulong lateCallbackCount;
+    atomic_ulong callbackHistogram[TELEMETRY_HISTOGRAM_BINS];
+    atomic_ullong maxCallbackNanoseconds;
+    atomic_ullong callbackNanoseconds;
+    atomic_ullong stageNanoseconds[NUMBER_OF_TELEMETRY_STAGES];
+    unsigned long long lastCallbackStart;
+    double sampleRate;
+    /* snapshot thread */
+    pthread_t thread;
+    atomic_int stopRequested;
+    unsigned periodInSeconds;
+    char fileName[MAX_CHAR_LENGTH];
+    unsigned long long startTime;
+    unsigned long long lastSnapshotTime;
+    unsigned long long lastSnapshotCallbackNanoseconds;
+    /* buffers of the current recording, guarded by sourceLock */
+    pthread_mutex_t sourceLock;
+    const ring_buffer* writerFrames;
+    const ring_buffer* analysisFrames;
+    const atomic_ullong* encodeNanoseconds;
+    storage_manager* storage;
+} amt_telemetry;
+
+/**
+ * @brief monotonic time in nanoseconds
+ * 
+*/
+static inline unsigned long long get_telemetry_time(void){
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (unsigned long long) ts.tv_sec * 1000000000ULL + (unsigned long long) ts.tv_nsec;
+}
+
+/**
+ * @brief add the time elapsed since *stageStart to a stage and restart the stage clock 
+ * (no-op when stageNanoseconds is NULL, i.e. telemetry is disabled)
+ * 
+*/
+static inline void add_telemetry_stage_time(unsigned long long* stageNanoseconds, unsigned stage, unsigned long long* stageStart){
+    if(stageNanoseconds){
+        unsigned long long now = get_telemetry_time();
+        stageNanoseconds[stage] += now - *stageStart;
+        *stageStart = now;
+    }
+}
+
+/**
+ * @brief initialize telemetry (amt_telemetry) and start the snapshot thread writing 
+ * fileName every periodInSeconds, returns 0 on success
+ * 
+*/
+int init_telemetry(amt_telemetry* telemetry, double sampleRate, unsigned periodInSeconds, const char* fileName);
+
+/**
+ * @brief write a last snapshot, stop the snapshot thread and free telemetry (amt_telemetry)
+ * 
+*/
+void fini_telemetry(amt_telemetry* telemetry);
+
+/**
+ * @brief record one callback that started at callbackStart (audio thread side), stageNanoseconds 
+ * holds the time spent in each telemetry_stage
+ * 
+*/
+void record_callback_telemetry(amt_telemetry* telemetry, unsigned long long callbackStart, const unsigned long long* stageNanoseconds, 
+                               unsigned frameCount);
+
+/**
+ * @brief set (or clear with NULL) the writer/analysis buffers and encode time reported in snapshots
+ * 
+*/
+void set_telemetry_sources(amt_telemetry* telemetry, const ring_buffer* writerFrames, const ring_buffer* analysisFrames, 
+                           const atomic_ullong* encodeNanoseconds);
+
+/**
+ * @brief set (or clear with NULL) the storage manager reported in snapshots
+ * 
+*/
+void set_telemetry_storage(amt_telemetry* telemetry, storage_manager* storage);
+
+#endif // TELEMETRY_H
@@ -16,6 +16,8 @@
 #include <stdio.h>
 #include <math.h>
 #include "tools.h"
+#include "../audio_proc/level_meter.h"
+#include "../audio_proc/band_trigger.h"
 #include <string.h>
 
 /**
@@ -23,13 +25,60 @@
  * data read from input amt.config
  *
 */
-void set_config(const char* configFile, amt_config* config){
+int set_config(const char* configFile, amt_config* config){
     char line[MAX_CHAR_LENGTH];
     char label[MAX_CHAR_LENGTH];
     char stringValue[MAX_CHAR_LENGTH];
     int numberValue;
     
+    // default values of optional fields
+    config->highpassFilterStages = 1;
+    config->lowpassFilterStages = 1;
+    config->decimationFactor = 1;
+    config->enableFixedPointProcessing = 0;
+    config->recordingHours = NULL;
+    config->numberOfRecordingHours = 0;
+    config->firstRecordingDate = NULL;
+    config->lastRecordingDate = NULL;
+    config->outputFileFormat = WAV_FORMAT;
+    config->outputBitDepth = 32;
+    config->flacCompressionLevel = 5;
+    config->enableDither = 1;
+    config->enableRecordingSummary = 1;
+    config->recordingSyncInterval = 5.0f;
+    config->writerBufferCapacity = 10.0f;
+    config->writerBufferHighWaterMark = 75.0f;
+    config->enableAudioRecording = 1;
+    config->storageQuota = 0.0f;
+    config->minFreeSpace = 200.0f;
+    config->enableStorageDowngrade = 0;
+    config->bandLevelResolution = 0;
+    config->bandLevelPeriod = 60.0f;
+    config->acousticIndexPeriod = 0.0f;
+    config->adiThresholddBFS = -50.0f;
+    config->levelFrequencyWeighting = Z_WEIGHTING;
+    config->levelTimeWeighting = BLOCK_TIME_WEIGHTING;
+    config->enableBandTrigger = 0;
+    config->triggerBandLowerFrequencies = NULL;
+    config->triggerBandUpperFrequencies = NULL;
+    config->numberOfTriggerBands = 0;
+    config->triggerBandRatio = 10.0f;
+    config->triggerBandCombination = BAND_TRIGGER_ANY;
+    config->recordingReleasedBFS = NAN;
+    config->recordingHoldTime = 5.0f;
+    config->enableAdaptiveThreshold = 0;
+    config->noiseFloorPercentile = 90;
+    config->noiseFloorWindow = 600.0f;
+    config->noiseFloorMargin = 10.0f;
+    config->minSleepToStopDevice = 5.0f;
+    config->enableTelemetry = 0;
+    config->enableConfigReload = 1;
+    config->telemetryPeriod = 60.0f;
+
     FILE* file = fopen(configFile, "r");
+    if(!file){
+        return -1;
+    }
     while(!feof(file))
     {
         fgets(line, sizeof(line), file);
@@ -152,6 +201,24 @@ void set_config(const char* configFile, amt_config* config){
             continue;
         }
 
+        if(!strcmp(label, "decimationFactor")){
+            sscanf(line, "%s\t%d\n", label, &numberValue);
+            config->decimationFactor = (unsigned) numberValue;
+        #ifdef DEBUG
+            printf("%s = %d\n", label, config->decimationFactor);
+        #endif
+            continue;
+        }
+
+        if(!strcmp(label, "enableFixedPointProcessing")){
+            sscanf(line, "%s\t%d\n", label, &numberValue);
+            config->enableFixedPointProcessing = (unsigned) numberValue;
+        #ifdef DEBUG
+            printf("%s = %d\n", label, config->enableFixedPointProcessing);
+        #endif
+            continue;
+        }
+
         if(!strcmp(label, "enableHighpassFilter")){
             sscanf(line, "%s\t%d\n", label, &numberValue);
             config->enableHighpassFilter = (unsigned) numberValue;
@@ -170,6 +237,15 @@ void set_config(const char* configFile, amt_config* config){
             continue;
         }
 
+        if(!strcmp(label, "highpassFilterStages")){
+            sscanf(line, "%s\t%d\n", label, &numberValue);
+            config->highpassFilterStages = (numberValue > 0) ? (unsigned) numberValue : 1;
+        #ifdef DEBUG
+            printf("%s = %d\n", label, config->highpassFilterStages);
+        #endif
+            continue;
+        }
+
         if(!strcmp(label, "enableLowpasssFilter")){
             sscanf(line, "%s\t%d\n", label, &numberValue);
             config->enableLowpasssFilter = (unsigned) numberValue;
@@ -188,6 +264,15 @@ void set_config(const char* configFile, amt_config* config){
             continue;
         }
 
+        if(!strcmp(label, "lowpassFilterStages")){
+            sscanf(line, "%s\t%d\n", label, &numberValue);
+            config->lowpassFilterStages = (numberValue > 0) ? (unsigned) numberValue : 1;
+        #ifdef DEBUG
+            printf("%s = %d\n", label, config->lowpassFilterStages);
+        #endif
+            continue;
+        }
+
         if(!strcmp(label, "enableThresholdRecording")){
             sscanf(line, "%s\t%d\n", label, &numberValue);
             config->enableThresholdRecording = (unsigned) numberValue;
@@ -214,33 +299,378 @@ void set_config(const char* configFile, amt_config* config){
         #endif
             continue;
         }
+
+        if(!strcmp(label, "minSleepToStopDevice")){
+            sscanf(line, "%s\t%d\n", label, &numberValue);
+            config->minSleepToStopDevice = (float) numberValue;
+        #ifdef DEBUG
+            printf("%s = %.1f\n", label, config->minSleepToStopDevice);
+        #endif
+            continue;
+        }
+
+        if(!strcmp(label, "recordingReleasedBFS")){
+            sscanf(line, "%s\t%d\n", label, &numberValue);
+            config->recordingReleasedBFS = (float) numberValue;
+        #ifdef DEBUG
+            printf("%s = %.1f\n", label, config->recordingReleasedBFS);
+        #endif
+            continue;
+        }
+
+        if(!strcmp(label, "recordingHoldTime")){
+            sscanf(line, "%s\t%d\n", label, &numberValue);
+            config->recordingHoldTime = (float) numberValue;
+        #ifdef DEBUG
+            printf("%s = %.1f\n", label, config->recordingHoldTime);
+        #endif
+            continue;
+        }
+
+        if(!strcmp(label, "enableAdaptiveThreshold")){
+            sscanf(line, "%s\t%d\n", label, &numberValue);
+            config->enableAdaptiveThreshold = (unsigned) numberValue;
+        #ifdef DEBUG
+            printf("%s = %d\n", label, config->enableAdaptiveThreshold);
+        #endif
+            continue;
+        }
+
+        if(!strcmp(label, "noiseFloorPercentile")){
+            sscanf(line, "%s\t%d\n", label, &numberValue);
+            config->noiseFloorPercentile = (numberValue >= 1 && numberValue <= 99) ? (unsigned) numberValue : 90;
+        #ifdef DEBUG
+            printf("%s = %d\n", label, config->noiseFloorPercentile);
+        #endif
+            continue;
+        }
+
+        if(!strcmp(label, "noiseFloorWindow")){
+            sscanf(line, "%s\t%d\n", label, &numberValue);
+            config->noiseFloorWindow = (numberValue > 0) ? (float) numberValue : 600.0f;
+        #ifdef DEBUG
+            printf("%s = %.1f\n", label, config->noiseFloorWindow);
+        #endif
+            continue;
+        }
+
+        if(!strcmp(label, "noiseFloorMargin")){
+            sscanf(line, "%s\t%d\n", label, &numberValue);
+            config->noiseFloorMargin = (float) numberValue;
+        #ifdef DEBUG
+            printf("%s = %.1f\n", label, config->noiseFloorMargin);
+        #endif
+            continue;
+        }
+
+        if(!strcmp(label, "outputFileFormat")){
+            sscanf(line, "%s\t%s\n", label, stringValue);
+            config->outputFileFormat = strcmp(stringValue, "flac") ? WAV_FORMAT : FLAC_FORMAT;
+        #ifdef DEBUG
+            printf("%s = %s\n", label, config->outputFileFormat == FLAC_FORMAT ? "flac" : "wav");
+        #endif
+            continue;
+        }
+
+        if(!strcmp(label, "outputBitDepth")){
+            sscanf(line, "%s\t%d\n", label, &numberValue);
+            config->outputBitDepth = (numberValue == 16 || numberValue == 24) ? (unsigned) numberValue : 32;
+        #ifdef DEBUG
+            printf("%s = %d\n", label, config->outputBitDepth);
+        #endif
+            continue;
+        }
+
+        if(!strcmp(label, "flacCompressionLevel")){
+            sscanf(line, "%s\t%d\n", label, &numberValue);
+            config->flacCompressionLevel = (numberValue >= 0 && numberValue <= 8) ? (unsigned) numberValue : 5;
+        #ifdef DEBUG
+            printf("%s = %d\n", label, config->flacCompressionLevel);
+        #endif
+            continue;
+        }
+
+        if(!strcmp(label, "enableDither")){
+            sscanf(line, "%s\t%d\n", label, &numberValue);
+            config->enableDither = (unsigned) numberValue;
+        #ifdef DEBUG
+            printf("%s = %d\n", label, config->enableDither);
+        #endif
+            continue;
+        }
+
+        if(!strcmp(label, "enableRecordingSummary")){
+            sscanf(line, "%s\t%d\n", label, &numberValue);
+            config->enableRecordingSummary = (unsigned) numberValue;
+        #ifdef DEBUG
+            printf("%s = %d\n", label, config->enableRecordingSummary);
+        #endif
+            continue;
+        }
+
+        if(!strcmp(label, "recordingSyncInterval")){
+            sscanf(line, "%s\t%d\n", label, &numberValue);
+            config->recordingSyncInterval = (numberValue > 0) ? (float) numberValue : 0.0f;
+        #ifdef DEBUG
+            printf("%s = %.1f\n", label, config->recordingSyncInterval);
+        #endif
+            continue;
+        }
+
+        if(!strcmp(label, "writerBufferCapacity")){
+            sscanf(line, "%s\t%d\n", label, &numberValue);
+            config->writerBufferCapacity = (float) numberValue;
+        #ifdef DEBUG
+            printf("%s = %.1f\n", label, config->writerBufferCapacity);
+        #endif
+            continue;
+        }
+
+        if(!strcmp(label, "writerBufferHighWaterMark")){
+            sscanf(line, "%s\t%d\n", label, &numberValue);
+            config->writerBufferHighWaterMark = (float) numberValue;
+        #ifdef DEBUG
+            printf("%s = %.1f\n", label, config->writerBufferHighWaterMark);
+        #endif
+            continue;
+        }
+
+        if(!strcmp(label, "enableAudioRecording")){
+            sscanf(line, "%s\t%d\n", label, &numberValue);
+            config->enableAudioRecording = (unsigned) numberValue;
+        #ifdef DEBUG
+            printf("%s = %d\n", label, config->enableAudioRecording);
+        #endif
+            continue;
+        }
+
+        if(!strcmp(label, "storageQuota")){
+            sscanf(line, "%s\t%d\n", label, &numberValue);
+            config->storageQuota = (numberValue > 0) ? (float) numberValue : 0.0f;
+        #ifdef DEBUG
+            printf("%s = %.1f\n", label, config->storageQuota);
+        #endif
+            continue;
+        }
+
+        if(!strcmp(label, "minFreeSpace")){
+            sscanf(line, "%s\t%d\n", label, &numberValue);
+            config->minFreeSpace = (numberValue > 0) ? (float) numberValue : 0.0f;
+        #ifdef DEBUG
+            printf("%s = %.1f\n", label, config->minFreeSpace);
+        #endif
+            continue;
+        }
+
+        if(!strcmp(label, "enableStorageDowngrade")){
+            sscanf(line, "%s\t%d\n", label, &numberValue);
+            config->enableStorageDowngrade = (unsigned) numberValue;
+        #ifdef DEBUG
+            printf("%s = %d\n", label, config->enableStorageDowngrade);
+        #endif
+            continue;
+        }
+
+        if(!strcmp(label, "bandLevelResolution")){
+            sscanf(line, "%s\t%d\n", label, &numberValue);
+            config->bandLevelResolution = (unsigned) numberValue;
+        #ifdef DEBUG
+            printf("%s = %d\n", label, config->bandLevelResolution);
+        #endif
+            continue;
+        }
+
+        if(!strcmp(label, "bandLevelPeriod")){
+            sscanf(line, "%s\t%d\n", label, &numberValue);
+            config->bandLevelPeriod = (float) numberValue;
+        #ifdef DEBUG
+            printf("%s = %.1f\n", label, config->bandLevelPeriod);
+        #endif
+            continue;
+        }
+
+        if(!strcmp(label, "acousticIndexPeriod")){
+            sscanf(line, "%s\t%d\n", label, &numberValue);
+            config->acousticIndexPeriod = (numberValue > 0) ? (float) numberValue : 0.0f;
+        #ifdef DEBUG
+            printf("%s = %.1f\n", label, config->acousticIndexPeriod);
+        #endif
+            continue;
+        }
+
+        if(!strcmp(label, "adiThresholddBFS")){
+            sscanf(line, "%s\t%d\n", label, &numberValue);
+            config->adiThresholddBFS = (float) numberValue;
+        #ifdef DEBUG
+            printf("%s = %.1f\n", label, config->adiThresholddBFS);
+        #endif
+            continue;
+        }
+
+        if(!strcmp(label, "levelFrequencyWeighting")){
+            sscanf(line, "%s\t%s\n", label, stringValue);
+            if(!strcmp(stringValue, "A")){
+                config->levelFrequencyWeighting = A_WEIGHTING;
+            }
+            else if(!strcmp(stringValue, "C")){
+                config->levelFrequencyWeighting = C_WEIGHTING;
+            }
+            else {
+                config->levelFrequencyWeighting = Z_WEIGHTING;
+            }
+        #ifdef DEBUG
+            printf("%s = %s\n", label, stringValue);
+        #endif
+            continue;
+        }
+
+        if(!strcmp(label, "levelTimeWeighting")){
+            sscanf(line, "%s\t%s\n", label, stringValue);
+            if(!strcmp(stringValue, "fast")){
+                config->levelTimeWeighting = FAST_TIME_WEIGHTING;
+            }
+            else if(!strcmp(stringValue, "slow")){
+                config->levelTimeWeighting = SLOW_TIME_WEIGHTING;
+            }
+            else {
+                config->levelTimeWeighting = BLOCK_TIME_WEIGHTING;
+            }
+        #ifdef DEBUG
+            printf("%s = %s\n", label, stringValue);
+        #endif
+            continue;
+        }
+
+        if(!strcmp(label, "enableBandTrigger")){
+            sscanf(line, "%s\t%d\n", label, &numberValue);
+            config->enableBandTrigger = (unsigned) numberValue;
+        #ifdef DEBUG
+            printf("%s = %d\n", label, config->enableBandTrigger);
+        #endif
+            continue;
+        }
+
+        // comma separated list of lower-upper band edges in Hz, e.g. 2000-8000,15000-20000
+        if(!strcmp(label, "triggerBands")){
+            sscanf(line, "%s\t%s\n", label, stringValue);
+            unsigned count = 1;
+            for(unsigned n = 0; stringValue[n]; n++){
+                count += (stringValue[n] == ',');
+            }
+            free(config->triggerBandLowerFrequencies);
+            free(config->triggerBandUpperFrequencies);
+            config->triggerBandLowerFrequencies = malloc(count * sizeof(float));
+            config->triggerBandUpperFrequencies = malloc(count * sizeof(float));
+            config->numberOfTriggerBands = 0;
+            for(char* band = strtok(stringValue, ","); band; band = strtok(NULL, ",")){
+                float lowerFrequency, upperFrequency;
+                if(sscanf(band, "%f-%f", &lowerFrequency, &upperFrequency) == 2 && upperFrequency > lowerFrequency){
+                    config->triggerBandLowerFrequencies[config->numberOfTriggerBands] = lowerFrequency;
+                    config->triggerBandUpperFrequencies[config->numberOfTriggerBands] = upperFrequency;
+                    config->numberOfTriggerBands++;
+                #ifdef DEBUG
+                    printf("%s: %.0f-%.0f Hz\n", label, lowerFrequency, upperFrequency);
+                #endif
+                }
+            }
+            continue;
+        }
+
+        if(!strcmp(label, "triggerBandRatio")){
+            sscanf(line, "%s\t%d\n", label, &numberValue);
+            config->triggerBandRatio = (float) numberValue;
+        #ifdef DEBUG
+            printf("%s = %.1f\n", label, config->triggerBandRatio);
+        #endif
+            continue;
+        }
+
+        if(!strcmp(label, "triggerBandCombination")){
+            sscanf(line, "%s\t%s\n", label, stringValue);
+            config->triggerBandCombination = strcmp(stringValue, "all") ? BAND_TRIGGER_ANY : BAND_TRIGGER_ALL;
+        #ifdef DEBUG
+            printf("%s = %s\n", label, config->triggerBandCombination == BAND_TRIGGER_ALL ? "all" : "any");
+        #endif
+            continue;
+        }
+
+        if(!strcmp(label, "enableTelemetry")){
+            sscanf(line, "%s\t%d\n", label, &numberValue);
+            config->enableTelemetry = (unsigned) numberValue;
+        #ifdef DEBUG
+            printf("%s = %d\n", label, config->enableTelemetry);
+        #endif
+            continue;
+        }
+
+        if(!strcmp(label, "telemetryPeriod")){
+            sscanf(line, "%s\t%d\n", label, &numberValue);
+            config->telemetryPeriod = (float) numberValue;
+        #ifdef DEBUG
+            printf("%s = %.1f\n", label, config->telemetryPeriod);
+        #endif
+            continue;
+        }
+
+        if(!strcmp(label, "enableConfigReload")){
+            sscanf(line, "%s\t%d\n", label, &numberValue);
+            config->enableConfigReload = (unsigned) numberValue;
+        #ifdef DEBUG
+            printf("%s = %d\n", label, config->enableConfigReload);
+        #endif
+            continue;
+        }
         
     }
     fclose(file);
+
+    // without release threshold there is no hysteresis
+    if(isnan(config->recordingReleasedBFS)){
+        config->recordingReleasedBFS = config->recordingThresholddBFS;
+    }
+    return 0;
+}
+
+/**
+ * @brief free the allocated fields (recording hours, dates and trigger bands) of an AMT configuration struct
+ *
+*/
+void free_config(amt_config* config){
+    free(config->triggerBandLowerFrequencies);
+    free(config->triggerBandUpperFrequencies);
+    free(config->recordingHours);
+    free(config->firstRecordingDate);
+    free(config->lastRecordingDate);
 }
 
 /**
- * @brief function used to update output wav file name
+ * @brief function used to update output wav file name, directory ends with a path separator
  *
 */
-void update_output_file_name(char * ptr, unsigned size)
+void update_output_file_name(char * ptr, unsigned size, const char* directory, const struct timeval* timestamp, const char* extension)
 {
-    time_t rawtime;
-    struct tm *info;
-    time( &rawtime );
-    info = localtime( &rawtime );
-    char tmp[MAX_CHAR_LENGTH] = OUTPUT_WAV_FILE_DIR;
+    struct timeval tmnow;
+    struct tm info;
+    if(timestamp){
+        tmnow = *timestamp;
+    }
+    else {
+        gettimeofday(&tmnow, NULL);
+    }
+    time_t rawtime = tmnow.tv_sec;
+    // called from the writer thread, localtime would share its result with other threads
+    localtime_r(&rawtime, &info);
+    char tmp[MAX_CHAR_LENGTH];
+    strcpy(tmp, directory);
 #ifdef PC_TEST
-    strftime(ptr, size, strcat(strcat(strcat(tmp, DEVICE_NAME),OUTPUT_WAV_FILE_SUFFIX),".wav"), info);
+    strftime(ptr, size, strcat(strcat(strcat(tmp, DEVICE_NAME),OUTPUT_WAV_FILE_SUFFIX),extension), &info);
 #else
     char hostname[1024];
     gethostname(hostname,1024);
     // strftime(ptr, size, strcat(strcat(tmp,hostname), OUTPUT_WAV_FILE_SUFFIX), info);
-    struct timeval tmnow;
-    char usec_buf[6];
-    gettimeofday(&tmnow, NULL);
+    char usec_buf[7];
     sprintf(usec_buf,"%d",(int)tmnow.tv_usec);
-    strftime(ptr, size, strcat(strcat(strcat(strcat(tmp,hostname), OUTPUT_WAV_FILE_SUFFIX), usec_buf),".wav"), info);
+    strftime(ptr, size, strcat(strcat(strcat(strcat(tmp,hostname), OUTPUT_WAV_FILE_SUFFIX), usec_buf),extension), &info);
 #endif
 }
 
@@ -33,16 +33,55 @@ typedef struct{
     char* firstRecordingDate;
     char* lastRecordingDate;
     float sampleRate;
+    unsigned decimationFactor;
+    unsigned enableFixedPointProcessing:1;
     unsigned enableHighpassFilter:1;
     float highpassFilterCutoff;
+    unsigned highpassFilterStages;
     unsigned enableLowpasssFilter:1;
     float lowpassFilterCutoff;
+    unsigned lowpassFilterStages;
     unsigned enableThresholdRecording:1;
     float recordingThresholddBFS;
     float recordedTimeBeforeThreshold;
+    float recordingReleasedBFS;
+    float recordingHoldTime;
+    unsigned enableAdaptiveThreshold:1;
+    unsigned noiseFloorPercentile;
+    float noiseFloorWindow;
+    float noiseFloorMargin;
+    float minSleepToStopDevice;
+    unsigned outputFileFormat;
+    unsigned outputBitDepth;
+    unsigned flacCompressionLevel;
+    unsigned enableDither:1;
+    unsigned enableRecordingSummary:1;
+    float recordingSyncInterval;
+    float writerBufferCapacity;
+    float writerBufferHighWaterMark;
+    unsigned enableAudioRecording:1;
+    float storageQuota;
+    float minFreeSpace;
+    unsigned enableStorageDowngrade:1;
+    unsigned bandLevelResolution;
+    float bandLevelPeriod;
+    float acousticIndexPeriod;
+    float adiThresholddBFS;
+    unsigned levelFrequencyWeighting;
+    unsigned levelTimeWeighting;
+    unsigned enableBandTrigger:1;
+    float* triggerBandLowerFrequencies;
+    float* triggerBandUpperFrequencies;
+    float triggerBandRatio;
+    unsigned triggerBandCombination;
+    unsigned enableTelemetry:1;
+    unsigned enableConfigReload:1;
+    float telemetryPeriod;
     /* internal usage fields */
     unsigned numberOfRecordingHours;
+    unsigned numberOfTriggerBands;
     float micGainFactor;
+    float processingSampleRate;
 } amt_config;
 
 /**
@@ -54,12 +93,27 @@ typedef enum {
     MONTH
 } amt_date;
 
+/**
+ * @brief AMT output file format enum
+ *
+*/
+typedef enum {
+    WAV_FORMAT,
+    FLAC_FORMAT
+} amt_output_format;
+
 /**
  * @brief set AMT configuration struct fields based on 
- * data read from input amt.config
+ * data read from input amt.config, returns 0 on success
+ *
+*/
+int set_config(const char* configFile, amt_config* config);
+
+/**
+ * @brief free the allocated fields (recording hours, dates and trigger bands) of an AMT configuration struct
  *
 */
-void set_config(const char* configFile, amt_config* config);
+void free_config(amt_config* config);
 
 /**
  * @brief function used to update output wav file name
@@ -71,7 +125,7 @@ char* get_current_date_time();
  * @brief get current hour extracted from from current date
  *
 */
-void update_output_file_name(char * buffer, unsigned size);
+void update_output_file_name(char * buffer, unsigned size, const char* directory, const struct timeval* timestamp, const char* extension);
 
 /**
  * @brief get current minute extracted from from current date